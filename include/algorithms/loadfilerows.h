@@ -0,0 +1,19 @@
+#pragma once
+#include "datastructures/abuf.h"
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+// the rows of a file, borrowing their bytes from one shared arena.
+struct LoadedFileRows {
+    // backs every row that has not been edited since loading. Keep it alive
+    // for as long as any of the rows (or their copies) are.
+    std::shared_ptr<char[]> arena;
+    std::vector<abuf> rows;
+    bool isValidUtf8 = true;
+};
+
+// load the file at `path`, split into rows at '\n' (dropping trailing '\r').
+// The file is mapped, and copied into the arena and split in parallel chunks.
+// Return `false` (with `errno` set) if the file cannot be read.
+bool loadFileRows(const std::filesystem::path& path, LoadedFileRows* out);
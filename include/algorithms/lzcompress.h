@@ -0,0 +1,12 @@
+#pragma once
+#include <string>
+
+// A small LZ77 codec in the style of LZ4: a greedy single pass with a hash
+// table of 4 byte prefixes, emitting (literals, back reference) sequences.
+// Fast enough to run on every undo memento; for cold data, not for archival.
+
+// compress `src[0:len)`, appending to `out`.
+void lzCompress(const char* src, int len, std::string* out);
+// decompress `src[0:len)`, which must decompress to exactly `dstLen` bytes,
+// into `dst`. Return `false` if `src` is malformed.
+bool lzDecompress(const char* src, int len, char* dst, int dstLen);
@@ -0,0 +1,15 @@
+#pragma once
+#include "datastructures/abuf.h"
+#include "datastructures/rope.h"
+#include <filesystem>
+
+// write `rows`, joined by '\n', to the file at `path`, atomically: the rows
+// are streamed into a temporary file next to `path` with batched `writev`s
+// (never concatenated in memory), which is `fsync`ed and then `rename`d over
+// `path`. A crash at any point leaves either the old or the new contents.
+// Return `false` (with `errno` set) on failure, in which case `path` is untouched.
+// If `path` is a symlink, the file it points to is replaced, and the link kept.
+// A new file is created with the permissions `open` would give it.
+// Only reads the bytes of the rows, so it is safe to call on a snapshot of
+// rows that another thread keeps editing.
+bool saveFileRows(const std::filesystem::path& path, const Rope<abuf>& rows);
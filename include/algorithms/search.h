@@ -0,0 +1,205 @@
+#pragma once
+#include <assert.h>
+#include <string.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define SEARCH_HAVE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// Byte-string search over `hay[0:n)`. All functions return the index of the
+// match, or `-1` if there is none.
+//   . single bytes use `memchr`, which libc vectorizes.
+//   . short needles are found with a vector filter on their first and last
+//     byte, verifying candidates with `memcmp`.
+//   . long needles use Horspool, whose skip table lets it jump up to `m`
+//     bytes per step.
+
+// needles at least this long are searched with Horspool.
+static const int SEARCH_HORSPOOL_MIN_NEEDLE_LEN = 32;
+
+// first index `i >= 0` such that `hay[i] = c`.
+static int search_find_byte(const char* hay, int n, char c)
+{
+    if (n <= 0) {
+        return -1;
+    }
+    const char* p = (const char*)memchr(hay, c, n);
+    return p ? p - hay : -1;
+}
+
+// last index `i < n` such that `hay[i] = c`.
+static int search_rfind_byte(const char* hay, int n, char c)
+{
+#if defined(__GLIBC__)
+    if (n <= 0) {
+        return -1;
+    }
+    const char* p = (const char*)memrchr(hay, c, n);
+    return p ? p - hay : -1;
+#else
+    for (int i = n - 1; i >= 0; --i) {
+        if (hay[i] == c) {
+            return i;
+        }
+    }
+    return -1;
+#endif
+}
+
+// Horspool: first index `i` such that `hay[i:i+m] = needle[0:m]`.
+static int search_find_horspool(const char* hay, int n, const char* needle, int m)
+{
+    assert(m > 0);
+    int skip[256];
+    for (int c = 0; c < 256; ++c) {
+        skip[c] = m;
+    }
+    for (int i = 0; i < m - 1; ++i) {
+        skip[(unsigned char)needle[i]] = m - 1 - i;
+    }
+    const char last = needle[m - 1];
+    for (int i = 0; i + m <= n;) {
+        const char c = hay[i + m - 1];
+        if (c == last && memcmp(hay + i, needle, m - 1) == 0) {
+            return i;
+        }
+        i += skip[(unsigned char)c];
+    }
+    return -1;
+}
+
+// Horspool, run right to left: last index `i` such that `hay[i:i+m] = needle[0:m]`.
+static int search_rfind_horspool(const char* hay, int n, const char* needle, int m)
+{
+    assert(m > 0);
+    int skip[256];
+    for (int c = 0; c < 256; ++c) {
+        skip[c] = m;
+    }
+    for (int i = m - 1; i > 0; --i) {
+        skip[(unsigned char)needle[i]] = i;
+    }
+    const char first = needle[0];
+    for (int i = n - m; i >= 0;) {
+        const char c = hay[i];
+        if (c == first && memcmp(hay + i + 1, needle + 1, m - 1) == 0) {
+            return i;
+        }
+        i -= skip[(unsigned char)c];
+    }
+    return -1;
+}
+
+// short needles: anchor on the first byte with `memchr`, then verify.
+static int search_find_short_scalar(const char* hay, int n, const char* needle, int m)
+{
+    assert(m > 0);
+    for (int i = 0; i + m <= n;) {
+        const int j = search_find_byte(hay + i, n - m + 1 - i, needle[0]);
+        if (j == -1) {
+            return -1;
+        }
+        i += j;
+        if (memcmp(hay + i + 1, needle + 1, m - 1) == 0) {
+            return i;
+        }
+        i++;
+    }
+    return -1;
+}
+
+#ifdef SEARCH_HAVE_SSE2
+// short needles: compare 16 windows at once against the first and last
+// needle byte, and only `memcmp` the windows where both agree.
+static int search_find_short_sse2(const char* hay, int n, const char* needle, int m)
+{
+    assert(m > 1);
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[m - 1]);
+    int i = 0;
+    for (; i + m - 1 + 16 <= n; i += 16) {
+        const __m128i blockFirst = _mm_loadu_si128((const __m128i*)(hay + i));
+        const __m128i blockLast = _mm_loadu_si128((const __m128i*)(hay + i + m - 1));
+        unsigned mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(blockFirst, first),
+            _mm_cmpeq_epi8(blockLast, last)));
+        while (mask) {
+            const int k = __builtin_ctz(mask);
+            if (memcmp(hay + i + k + 1, needle + 1, m - 2) == 0) {
+                return i + k;
+            }
+            mask &= mask - 1;
+        }
+    }
+    const int rest = search_find_short_scalar(hay + i, n - i, needle, m);
+    return rest == -1 ? -1 : i + rest;
+}
+#endif // SEARCH_HAVE_SSE2
+
+// first index `i` such that `hay[i:i+m] = needle[0:m]`.
+static int search_find(const char* hay, int n, const char* needle, int m)
+{
+    assert(m >= 0);
+    if (m == 0) {
+        return 0;
+    }
+    if (m > n) {
+        return -1;
+    }
+    if (m == 1) {
+        return search_find_byte(hay, n, needle[0]);
+    }
+    if (m >= SEARCH_HORSPOOL_MIN_NEEDLE_LEN) {
+        return search_find_horspool(hay, n, needle, m);
+    }
+#ifdef SEARCH_HAVE_SSE2
+    return search_find_short_sse2(hay, n, needle, m);
+#else
+    return search_find_short_scalar(hay, n, needle, m);
+#endif
+}
+
+// last index `i` such that `hay[i:i+m] = needle[0:m]`.
+static int search_rfind(const char* hay, int n, const char* needle, int m)
+{
+    assert(m >= 0);
+    if (m == 0) {
+        return n;
+    }
+    if (m > n) {
+        return -1;
+    }
+    if (m == 1) {
+        return search_rfind_byte(hay, n, needle[0]);
+    }
+    return search_rfind_horspool(hay, n, needle, m);
+}
+
+// first index `i` at which any of the `k` needles matches. If `which` is
+// not null, it is set to the index of the needle that matched (the first
+// one listed, if several match at `i`).
+// Positions are filtered by a table of the needles' first bytes, so this
+// is a single pass over `hay` regardless of `k`.
+static int search_find_any(const char* hay, int n,
+    const char* const* needles, const int* needle_lens, int k, int* which)
+{
+    bool isFirstByte[256] = { false };
+    for (int j = 0; j < k; ++j) {
+        assert(needle_lens[j] > 0);
+        isFirstByte[(unsigned char)needles[j][0]] = true;
+    }
+    for (int i = 0; i < n; ++i) {
+        if (!isFirstByte[(unsigned char)hay[i]]) {
+            continue;
+        }
+        for (int j = 0; j < k; ++j) {
+            if (needle_lens[j] <= n - i && memcmp(hay + i, needles[j], needle_lens[j]) == 0) {
+                if (which) {
+                    *which = j;
+                }
+                return i;
+            }
+        }
+    }
+    return -1;
+}
@@ -1,6 +1,8 @@
 #pragma once
 #include "mathutil.h"
+#include <stdint.h>
 #include <string>
+#include <vector>
 
 struct abuf {
     abuf() = default;
@@ -10,9 +12,23 @@ struct abuf {
     static abuf from_copy_str(const char* str);
     static abuf from_steal_buf(char* buf, int len);
     static abuf from_copy_buf(const char* buf, int len);
+    // view `buf[0:len)` without copying it. The bytes are never written to:
+    // the first edit copies them. Invariant: they outlive every copy of this abuf.
+    static abuf from_borrow_buf(const char* buf, int len);
 
     abuf& operator=(const abuf& other);
     abuf(const abuf& other);
+    abuf& operator=(abuf&& other) noexcept;
+    abuf(abuf&& other) noexcept;
+
+    // make room for `nbytes` bytes in total, so that growing up to `nbytes`
+    // does not allocate.
+    void reserve(int nbytes);
+    // number of bytes that fit without allocating.
+    int capacity() const;
+    // number of bytes of heap storage owned by this buffer. `0` for inline
+    // and borrowed buffers.
+    int heapCapacity() const;
 
     void appendbuf(const char* s, int slen);
 
@@ -57,6 +73,10 @@ struct abuf {
     // Return `-1` otherwise.
     int find_sub_buf(const char* findbuf, int findbuf_len, int begin_ix) const;
 
+    // Return last index `i` such that `i + len <= end_ix` and `buf[i:i+len] = s[0:len]`.
+    // Return `-1` otherwise.
+    int rfind_sub_buf(const char* findbuf, int findbuf_len, int end_ix) const;
+
     // Return first index `i >= begin_ix` such that `buf[i:i+len] = s[0:len]`.
     // Return `-1` otherwise.
     int find_substr(const char* findstr, int begin_ix) const;
@@ -107,7 +127,12 @@ struct abuf {
     Size<Byte> getBytesTill(Size<Codepoint> n) const;
 
     // TODO: move this out.
+    // render column of codepoint `cx`: tabs expand to the next tab stop, and
+    // wide glyphs take two columns.
     int cxToRx(Size<Codepoint> cx) const;
+    // the codepoint drawn at render column `rx`. Columns past the end of the
+    // row map to `ncodepoints()`.
+    Size<Codepoint> rxToCx(int rx) const;
 
     // it is size, since we can ask to place the data at the *end* of the string, past the
     // final.
@@ -123,7 +148,54 @@ struct abuf {
     void truncateNCodepoints(Size<Codepoint> ncodepoints_new);
 
 protected:
-    char* _buf = nullptr;
+    // short rows live in `_inline`, longer ones on the heap. The live bytes are
+    // `_buf[0:_len)`, where `_buf` points into `_storage` at some head offset,
+    // so that dropping a prefix is O(1).
+    static const int INLINE_CAPACITY = 32;
+    char _inline[INLINE_CAPACITY];
+    char* _storage = _inline;
+    int _cap = INLINE_CAPACITY;
+    char* _buf = _inline;
     int _len = 0;
     bool _is_dirty = true;
+    bool _borrowed = false; // `_storage` is someone else's, and read-only.
+
+    bool _isInline() const;
+    bool _ownsHeap() const;
+    // if borrowed, forget the borrowed bytes and become empty.
+    void _dropBorrowed();
+    // ensure `_buf[0:nbytes)` is backed by storage, growing geometrically or
+    // compacting away the head offset. Invalidates pointers into the buffer.
+    void _reserve(int nbytes);
+    // steal the storage of `other`, leaving it empty. Assumes `this` owns no heap storage.
+    void _moveFrom(abuf& other);
+
+    // codepoint index: every `CHECKPOINT_STRIDE` codepoints, we remember the
+    // byte offset at which that codepoint begins, so that finding the
+    // byte offset of a codepoint is a lookup plus a walk of < STRIDE codepoints.
+    static const int CHECKPOINT_STRIDE = 64;
+    // number of codepoints, or `-1` if it needs to be recomputed.
+    mutable int _ncodepoints = -1;
+    // _checkpoints[k] = byte offset of codepoint `(k + 1) * CHECKPOINT_STRIDE`.
+    // Only a prefix of the checkpoints is materialized, and it is extended lazily.
+    mutable std::vector<int> _checkpoints;
+    // _rxCheckpoints[k] = render column of codepoint `(k + 1) * CHECKPOINT_STRIDE`.
+    // Never longer than `_checkpoints`, and invalidated along with it.
+    mutable std::vector<int> _rxCheckpoints;
+
+    // byte offset at which codepoint `ix` begins. `ix = ncodepoints()` returns `len()`.
+    int _byteIxOfCodepoint(int ix) const;
+    // materialize the first `k` checkpoints. Invariant: `k * STRIDE <= ncodepoints()`.
+    void _extendCheckpoints(int k) const;
+    void _extendRxCheckpoints(int k) const;
+    // advance `rx` past the codepoint at `p`.
+    static int _rxAdvance(int rx, const char* p);
+    // a codepoint was inserted/deleted at byte offset `byteIx`, and the
+    // number of codepoints changed by `delta`. Drop the checkpoints it made stale.
+    void _indexEditedAt(int byteIx, int delta);
+    // drop the entire codepoint index.
+    void _indexInvalidate();
 };
+
+// hash of the bytes of `buf`. Lets ropes of rows be hashed (see `Rope::hash`).
+uint64_t hashValue(const abuf& buf);
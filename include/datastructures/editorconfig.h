@@ -6,6 +6,12 @@
 #include "views/tilde.h"
 #include "views/ctrlp.h"
 #include "datastructures/abbreviationdict.h"
+#include "datastructures/filesaver.h"
+#include "datastructures/leanserverregistry.h"
+#include "definitions/undobudget.h"
+#include <algorithm>
+#include <memory>
+#include <unordered_map>
 
 struct EditorConfig {
     Zipper<FileLocation> file_location_history;
@@ -21,6 +27,14 @@ struct EditorConfig {
     CompletionView completion;
     compileView::CompileView compileView;
     AbbreviationDict abbrevDict;
+    std::string searchNeedle; // last needle searched for, repeated by `n` / `N`.
+    bool searchWholeWord = false; // whether `searchNeedle` came from `*`, and only matches whole words.
+    std::string searchPrompt; // needle being typed in `VM_SEARCH`.
+    FileSaver fileSaver; // writes files on a background I/O thread.
+    LeanServerRegistry leanServers; // the lean servers that the open files share.
+    // bounds on the memory held by undo histories: of each file, and of all of them.
+    size_t undoBudgetPerFile = UNDO_BUDGET_PER_FILE_BYTES;
+    size_t undoBudgetTotal = UNDO_BUDGET_TOTAL_BYTES;
 
     EditorConfig() { statusmsg[0] = '\0'; }
 
@@ -30,39 +44,62 @@ struct EditorConfig {
             return NULL;
         } else {
             assert(fileIx < files.size());
-            return &files[fileIx];
+            return files[fileIx].get();
         }
     };
 
+    // the open file at `path`, or NULL if there is none.
+    FileConfig* getOpenFile(const fs::path& path)
+    {
+        auto it = this->fileIxByPath.find(canonicalPath(path).string());
+        return it == this->fileIxByPath.end() ? NULL : this->files[it->second].get();
+    }
+
+    // call `f(FileConfig&)` on each open file.
+    template <typename F>
+    void forEachFile(F f)
+    {
+        for (std::unique_ptr<FileConfig>& file : this->files) {
+            f(*file);
+        }
+    }
+
+    // focus the file at `file_loc`, at its cursor. If the file is open, it
+    // keeps its state: rows, undo history, lean server. Otherwise it is loaded.
+    // The cursor is clamped to the rows, which may have been edited since
+    // `file_loc` was recorded.
     void getOrOpenNewFile(FileLocation file_loc, bool isUndoRedo = false)
     {
         tilde::tildeWrite("%s %s:%d:%d", __FUNCTION__, file_loc.absolute_filepath.c_str(),
             file_loc.cursor.row,
             file_loc.cursor.col.size);
         assert(file_loc.absolute_filepath.is_absolute());
+        file_loc.absolute_filepath = canonicalPath(file_loc.absolute_filepath);
 
         if (!isUndoRedo) {
             if (this->fileIx != -1) {
                 assert(this->fileIx >= 0);
                 assert(this->fileIx < this->files.size());
-                file_location_history.push_back(FileLocation(this->files[this->fileIx]));
+                file_location_history.push_back(FileLocation(*this->files[this->fileIx]));
             }
             file_location_history.push_back(file_loc);
         }
 
-        // look if file exists.
-        // for(int i = 0; i < this->files.size(); ++i) {
-        //   if (this->files[i].absolute_filepath == file_loc.absolute_filepath) {
-        //     assert(false && "found an existing file");
-        //     this->fileIx = i;
-        //     this->files[this->fileIx].cursor = file_loc.cursor;
-        //     return;
-        //   }
-        // }
-        // we were unable to find an already open file, so make a new file.
-        this->files.push_back(FileConfig(file_loc));
-        this->fileIx = this->files.size() - 1;
-        this->files[this->fileIx].cursor = file_loc.cursor;
+        auto it = this->fileIxByPath.find(file_loc.absolute_filepath.string());
+        if (it != this->fileIxByPath.end()) {
+            this->fileIx = it->second;
+        } else {
+            // we were unable to find an already open file, so make a new file.
+            this->files.push_back(std::make_unique<FileConfig>(file_loc));
+            this->fileIx = this->files.size() - 1;
+            this->fileIxByPath[file_loc.absolute_filepath.string()] = this->fileIx;
+            this->files[this->fileIx]->setUndoBudget(this->undoBudgetPerFile);
+        }
+        FileConfig* f = this->files[this->fileIx].get();
+        fileConfigFlushActiveRow(f);
+        const int row = std::clamp(file_loc.cursor.row, 0, std::max(f->rows.size() - 1, 0));
+        const int ncols = row < f->rows.size() ? f->rows[row].ncodepoints().size : 0;
+        f->cursor = Cursor(row, std::clamp(file_loc.cursor.col.size, 0, ncols));
     }
 
     void undoFileMove()
@@ -86,8 +123,21 @@ struct EditorConfig {
     }
 
 private:
-    std::vector<FileConfig> files;
+    // open files, in the order they were opened. Held by pointer, so that a
+    // `FileConfig*` stays valid as files are opened.
+    std::vector<std::unique_ptr<FileConfig>> files;
+    // index into `files` of the file at each canonical path.
+    std::unordered_map<std::string, int> fileIxByPath;
     int fileIx = -1;
+
+    // the path that identifies the file at `path`, whichever way it is spelled:
+    // through symlinks, `.` or `..`.
+    static fs::path canonicalPath(const fs::path& path)
+    {
+        std::error_code ec;
+        fs::path out = fs::weakly_canonical(path, ec);
+        return ec ? path.lexically_normal() : out;
+    }
 };
 
 extern EditorConfig g_editor; // global editor handle.
\ No newline at end of file
@@ -1,27 +1,169 @@
 #pragma once
+#include <string.h>
 #include <vector>
 #include "datastructures/cursor.h"
 #include <filesystem>
+#include <memory>
 #include "datastructures/undoer.h"
+#include "datastructures/gapbuffer.h"
+#include "datastructures/goalprefetch.h"
 #include "datastructures/leanserverstate.h"
+#include "datastructures/lspgoalcache.h"
+#include "datastructures/lspchangelog.h"
+#include "datastructures/rope.h"
+#include "datastructures/rowseditlog.h"
 #include "definitions/infoviewtab.h"
 #include "lean_lsp.h"
 
 namespace fs = std::filesystem;
+// the part of the view that undo/redo restores along with the rows.
+struct FileConfigUndoView {
+    Cursor cursor;
+    int cursor_render_col = 0;
+    int scroll_row_offset = 0;
+    int scroll_col_offset = 0;
+};
+
+// the edits between two undo mementos, and the view at either end.
+struct FileConfigUndoDelta {
+    std::vector<RowsEdit> edits;
+    FileConfigUndoView before;
+    FileConfigUndoView after;
+
+    // only file state is part of undo state for debouncing.
+    bool empty() const
+    {
+        return edits.empty();
+    }
+
+    size_t nbytes() const
+    {
+        return RowsEditLog::nbytes(edits);
+    }
+
+    void serialize(std::string* out) const
+    {
+        out->append((const char*)&before, sizeof(FileConfigUndoView));
+        out->append((const char*)&after, sizeof(FileConfigUndoView));
+        RowsEditLog::serialize(edits, out);
+    }
+
+    static bool deserialize(const char* p, const char* end, FileConfigUndoDelta* out)
+    {
+        if (end - p < 2 * (int)sizeof(FileConfigUndoView)) {
+            return false;
+        }
+        memcpy(&out->before, p, sizeof(FileConfigUndoView));
+        memcpy(&out->after, p + sizeof(FileConfigUndoView), sizeof(FileConfigUndoView));
+        p += 2 * sizeof(FileConfigUndoView);
+        return RowsEditLog::deserialize(&p, end, &out->edits) && p == end;
+    }
+};
+
 // NOTE:
 // TextDocument for LSP does not need to be cached, as its value monotonically increases,
 // even during undo/redo.
 struct FileConfigUndoState {
-    std::vector<abuf> rows;
+    using Delta = FileConfigUndoDelta;
+
+    Rope<abuf> rows;
     Cursor cursor;
     int cursor_render_col = 0;
     int scroll_row_offset = 0;
     int scroll_col_offset = 0;
 
-    // TODO: should we use a different fn rather than `==`?
-    bool operator==(const FileConfigUndoState& other) const
+    // every edit of `rows` goes through these, so that it can be undone,
+    // and sent to the lean server.
+    abuf& rowsGetMut(int at)
+    {
+        this->_leanLog.getMut(this->rows, at);
+        return this->_rowsLog.getMut(this->rows, at);
+    }
+    void rowsInsert(int at, abuf row)
     {
-        return rows == other.rows; // only file state is part of undo state for debouncing.
+        this->_leanLog.close(this->rows);
+        this->_rowsLog.insert(this->rows, at, std::move(row));
+        this->_leanLog.replaced(this->rows, at, nullptr, 0, 1);
+    }
+    void rowsErase(int at)
+    {
+        this->_leanLog.close(this->rows);
+        const abuf deleted = this->rows[at];
+        this->_rowsLog.erase(this->rows, at);
+        this->_leanLog.replaced(this->rows, at, &deleted, 1, 0);
+    }
+
+    // the changes of `rows` since the last call, including those made by undo / redo.
+    std::vector<LspContentChange> takeLeanChanges()
+    {
+        return this->_leanLog.take(this->rows);
+    }
+
+    // the edits since the last call.
+    Delta takeDelta()
+    {
+        Delta out;
+        out.edits = this->_rowsLog.take(this->rows);
+        out.before = this->_deltaView;
+        out.after = this->_view();
+        if (!out.empty()) {
+            this->_deltaView = out.after;
+        }
+        return out;
+    }
+
+    uint64_t stateHash() const
+    {
+        return this->rows.hash();
+    }
+
+    void applyDelta(const Delta& delta, bool forward)
+    {
+        assert(this->_rowsLog.empty());
+        this->_leanLog.close(this->rows);
+        // replay one edit at a time, to log each with the rows right after it.
+        const int n = delta.edits.size();
+        for (int k = 0; k < n; ++k) {
+            const RowsEdit& edit = delta.edits[forward ? k : n - 1 - k];
+            if (edit.inPlace()) {
+                // the edit only keeps the bytes that changed, so the lean
+                // log reads the row before it.
+                this->_leanLog.getMut(this->rows, edit.at);
+                RowsEditLog::replay(this->rows, edit, forward);
+                this->_leanLog.close(this->rows);
+                continue;
+            }
+            RowsEditLog::replay(this->rows, edit, forward);
+            const std::vector<abuf>& deleted = forward ? edit.deleted : edit.inserted;
+            const int ninserted = forward ? edit.inserted.size() : edit.deleted.size();
+            this->_leanLog.replaced(this->rows, edit.at, deleted.data(), deleted.size(), ninserted);
+        }
+        this->_deltaView = forward ? delta.after : delta.before;
+        this->_setView(this->_deltaView);
+    }
+
+private:
+    RowsEditLog _rowsLog;
+    LspChangeLog _leanLog;
+    // the view when the last non-empty delta was taken.
+    FileConfigUndoView _deltaView;
+
+    FileConfigUndoView _view() const
+    {
+        FileConfigUndoView out;
+        out.cursor = this->cursor;
+        out.cursor_render_col = this->cursor_render_col;
+        out.scroll_row_offset = this->scroll_row_offset;
+        out.scroll_col_offset = this->scroll_col_offset;
+        return out;
+    }
+
+    void _setView(const FileConfigUndoView& view)
+    {
+        this->cursor = view.cursor;
+        this->cursor_render_col = view.cursor_render_col;
+        this->scroll_row_offset = view.scroll_row_offset;
+        this->scroll_col_offset = view.scroll_col_offset;
     }
 };
 
@@ -31,6 +173,10 @@ fs::path ctrlpGetGoodRootDirAbsolute(const fs::path absolute_startdir);
 // Do I want a *global* undo/redo? Probably not, no?
 // TODO: think about just copying the sublime text API :)
 struct FileLocation;
+struct FileConfig;
+void fileConfigFlushActiveRow(FileConfig* f);
+void fileConfigDeactivateRow(FileConfig* f);
+
 struct FileConfig : public Undoer<FileConfigUndoState> {
     FileConfig(FileLocation loc);
 
@@ -41,20 +187,35 @@ struct FileConfig : public Undoer<FileConfigUndoState> {
     int scroll_col_offset = 0;
 
     fs::path absolute_filepath;
+    // rows that have not been edited since the file was loaded borrow their
+    // bytes from here, so it must live as long as any undo state does.
+    std::shared_ptr<char[]> loadArena;
 
-    // lean server for file.
-    LeanServerState lean_server_state;
+    // lean server of the file's workspace, shared with the other files in it.
+    // Owned by `g_editor.leanServers`. NULL until launched.
+    LeanServerState* lean_server_state = NULL;
 
     // TextDocument for LSP
     int lsp_file_version = -1;
+    // identifies the file to its server, which has the document open for at
+    // most one file. Once the server was sent the document with `didOpen`,
+    // it is sent the changes since the last sync with `didChange`. If another
+    // file opens the same path, it takes the document over, and this file
+    // opens it again on its next sync.
+    int lsp_document_owner = -1;
 
     // diagonstics from LSP.
     std::vector<LspDiagnostic> lspDiagnostics;
 
     Cursor leanInfoViewRequestedCursor; // the cursor at which the info view was requested.
+    int leanInfoViewRequestedVersion = -1; // the `lsp_file_version` at which the info view was requested.
     LspNonblockingResponse leanInfoViewPlainGoal;
     LspNonblockingResponse leanInfoViewPlainTermGoal;
     LspNonblockingResponse leanHoverViewHover;
+    // the answers at the positions that were asked about, or prefetched.
+    LspGoalCache leanGoalCache;
+    // the goals around the cursor, fetched while the user is idle.
+    GoalPrefetcher leanGoalPrefetch;
     // TODO: implement definition
     InfoViewTab infoViewTab = IVT_Tactic;
     LspNonblockingResponse leanGotoRequest;
@@ -70,19 +231,32 @@ struct FileConfig : public Undoer<FileConfigUndoState> {
     };
     ProgressBar progressbar;
 
+    // the row under the cursor, while it is being typed into, is held as a
+    // gap buffer at the cursor rather than in `rows`. `rows[activeRowIx]` is
+    // stale while `activeRowDirty`; read rows via `fileConfigRow`.
+    GapBuffer activeRow;
+    int activeRowIx = -1; // `-1` if no row is active.
+    bool activeRowDirty = false;
+
+    // `makeDirty` marks that the rows may have changed. Whether they really
+    // differ from what was last saved (resp. synced with lean) is decided by
+    // comparing hashes of the rows, which is O(1) unless they were edited.
     bool isSaveDirty() const
     {
-        return this->_is_dirty_save;
+        return this->_is_dirty_save && (this->activeRowDirty || !this->_hasSavedHash || this->rows.hash() != this->_savedHash);
     }
 
     bool isLeanSyncDirty() const
     {
-        return this->_is_dirty_lean_sync;
+        return this->_is_dirty_lean_sync && (this->activeRowDirty || !this->_hasLeanSyncedHash || this->rows.hash() != this->_leanSyncedHash);
     }
 
     void undirtyLeanSync()
     {
+        fileConfigFlushActiveRow(this);
         this->_is_dirty_lean_sync = false;
+        this->_leanSyncedHash = this->rows.hash();
+        this->_hasLeanSyncedHash = true;
     }
     // if 'b' is true, then mark the state as dirty.
     // if 'b' is false, then leave the dirty state as-is.
@@ -92,16 +266,49 @@ struct FileConfig : public Undoer<FileConfigUndoState> {
         this->_is_dirty_lean_sync = true;
     }
 
+    // mark only the on-disk state as stale, e.g. when a save failed.
+    void makeDirtySave()
+    {
+        this->_is_dirty_save = true;
+        this->_hasSavedHash = false;
+    }
+
+    // if the rows differ from what was last saved, return `true` and
+    // consider the current rows saved.
     bool whenDirtySave()
     {
-        bool out = _is_dirty_save;
-        _is_dirty_save = false;
+        fileConfigFlushActiveRow(this);
+        const bool out = this->isSaveDirty();
+        this->_is_dirty_save = false;
+        this->_savedHash = this->rows.hash();
+        this->_hasSavedHash = true;
         return out;
     }
 
+protected:
+    FileConfigUndoDelta takeDelta() override
+    {
+        fileConfigFlushActiveRow(this);
+        return Undoer<FileConfigUndoState>::takeDelta();
+    }
+
+    void applyDelta(const FileConfigUndoDelta& delta, bool forward) override
+    {
+        // `takeDelta` flushed the active row, and the replayed rows supersede it.
+        assert(!this->activeRowDirty);
+        fileConfigDeactivateRow(this);
+        Undoer<FileConfigUndoState>::applyDelta(delta, forward);
+        this->makeDirty();
+    }
+
 private:
     bool _is_dirty_save = true;
     bool _is_dirty_lean_sync = true;
+    // `rows.hash()` when the rows were last saved / synced with lean.
+    uint64_t _savedHash = 0;
+    bool _hasSavedHash = false;
+    uint64_t _leanSyncedHash = 0;
+    bool _hasLeanSyncedHash = false;
 };
 
 void fileConfigSyncLeanState(FileConfig* file_config);
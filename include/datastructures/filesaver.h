@@ -0,0 +1,59 @@
+#pragma once
+#include "datastructures/abuf.h"
+#include "datastructures/rope.h"
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// outcome of a save, reported back to the main thread.
+struct FileSaveResult {
+    std::filesystem::path path;
+    bool ok = false;
+    int err = 0; // `errno` of the failure, if `!ok`.
+};
+
+// Saves files on a background I/O thread, so that the main loop never blocks
+// on disk. Saves are handed a snapshot of the rows (copying a `Rope` is O(1)),
+// which the main thread is free to keep editing.
+// Snapshots are only ever destroyed on the main thread (in `pollFinished`),
+// so the main thread's copy-on-write checks on rope nodes never race with
+// the I/O thread dropping its reference.
+struct FileSaver {
+    FileSaver() = default;
+    // finish all queued saves, then stop the I/O thread.
+    ~FileSaver();
+    FileSaver(const FileSaver&) = delete;
+    FileSaver& operator=(const FileSaver&) = delete;
+
+    // queue a save of `rows` to `path`. `arena` keeps the bytes that the rows
+    // borrow alive. A queued save of the same path that has not started yet
+    // is superseded. Starts the I/O thread on first use.
+    void save(std::filesystem::path path, Rope<abuf> rows, std::shared_ptr<char[]> arena);
+    // pop the result of a finished save. Never blocks on disk.
+    bool pollFinished(FileSaveResult* out);
+    // number of saves queued or being written.
+    int ninflight();
+    // block until every queued save has been written.
+    void drain();
+
+private:
+    struct Job {
+        std::filesystem::path path;
+        Rope<abuf> rows;
+        std::shared_ptr<char[]> arena;
+        FileSaveResult result;
+    };
+
+    std::mutex _mutex;
+    std::condition_variable _cv; // signalled on new jobs, finished jobs, and quit.
+    std::deque<Job> _pending;
+    std::deque<Job> _finished;
+    bool _busy = false; // the I/O thread is writing a job.
+    bool _quit = false;
+    std::thread _thread;
+
+    void _run();
+};
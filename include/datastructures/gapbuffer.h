@@ -0,0 +1,51 @@
+#pragma once
+#include "datastructures/abuf.h"
+#include "mathutil.h"
+#include <vector>
+
+// A row of text with a gap at the edit position: `_data[0:_gapBegin)` is the
+// text before the gap, `_data[_gapEnd:)` the text after it. Inserting and
+// deleting at the gap is O(1) amortized; moving the gap by `k` codepoints is O(k).
+// The text before the gap is contiguous, so readers that only look behind the
+// cursor (like abbreviation matching) can use it directly.
+struct GapBuffer {
+    GapBuffer() = default;
+
+    // build a gap buffer holding `row`, with the gap before codepoint `at`.
+    static GapBuffer fromAbuf(const abuf& row, Size<Codepoint> at);
+    // compact the text into an `abuf`.
+    abuf toAbuf() const;
+
+    Size<Byte> nbytes() const;
+    Size<Codepoint> ncodepoints() const;
+
+    // number of codepoints before the gap.
+    Size<Codepoint> gapCodepoint() const;
+    // move the gap to be before codepoint `at`.
+    void moveGapTo(Size<Codepoint> at);
+
+    // the text before the gap, which is `nbytesBeforeGap()` bytes long.
+    const char* beforeGap() const;
+    Size<Byte> nbytesBeforeGap() const;
+
+    // insert a single codepoint / byte at the gap. The gap moves past the
+    // inserted data.
+    void insertCodepointAtGap(const char* codepoint);
+    void insertByteAtGap(char c);
+
+    // delete the codepoint right before / right after the gap.
+    void delCodepointBeforeGap();
+    void delCodepointAfterGap();
+
+private:
+    std::vector<char> _data;
+    int _gapBegin = 0;
+    int _gapEnd = 0;
+    int _ncodepoints = 0;
+    int _gapCodepoint = 0; // number of codepoints before the gap.
+
+    int _gapLen() const;
+    // make the gap at least `n` bytes long, growing geometrically.
+    void _reserveGap(int n);
+    void _insertAtGap(const char* s, int len);
+};
@@ -0,0 +1,83 @@
+#pragma once
+#include "datastructures/cursor.h"
+#include "datastructures/lspnonblockingresponse.h"
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+// the user is idle once they have not moved, scrolled or edited for this long.
+static const std::chrono::milliseconds GOAL_PREFETCH_IDLE_DELAY = std::chrono::milliseconds(1000);
+// the most requests that the prefetch of a file sends in any minute, so that
+// an idle editor does not keep the server busy.
+static const int GOAL_PREFETCH_BUDGET_PER_MINUTE = 60;
+// a `$/lean/plainGoal` and a `$/lean/plainTermGoal` per position.
+static const int GOAL_PREFETCH_REQUESTS_PER_POSITION = 2;
+// how far above the window to look for the declaration that it starts in.
+static const int GOAL_PREFETCH_MAX_LOOKBACK = 256;
+// the rows of the window, when the size of the screen is not known.
+static const int GOAL_PREFETCH_DEFAULT_WINDOW_ROWS = 50;
+
+// the positions at which to prefetch goals, for the window of rows
+// [top, bottom) of a lean file of `nrows` rows: the tactic rows of the
+// window other than the row of `cursor`, nearest it first, each at the column
+// that `cursor` lands on when it steps there row by row (see
+// `fileConfigMoveCursor`). `rowAt(r)` is the text of row `r`; it need only
+// live until the next call.
+// Tactic rows are told apart by indentation: after a row that ends in `by`,
+// the rows indented deeper than the statement that it ends, up to the first
+// row that is not indented at least as deep as the first of them.
+std::vector<Cursor> goalPrefetchTargets(int nrows, int top, int bottom, Cursor cursor,
+    const std::function<std::string_view(int)>& rowAt);
+
+// Fetches the goals at the tactic rows around the cursor while the user is
+// idle, so that stepping onto one of them needs no round trip to the server.
+// A move or a scroll replans the prefetch, and an edit also cancels it.
+// Positions are fetched one at a time, within `GOAL_PREFETCH_BUDGET_PER_MINUTE`.
+// Only decides what to fetch: the caller writes the requests, fills
+// `plainGoal` and `plainTermGoal` with their responses, and keeps them (see
+// `LspGoalCache`).
+struct GoalPrefetcher {
+    using Clock = std::chrono::steady_clock;
+
+    // the responses to the requests in flight, if `inFlight()`.
+    LspNonblockingResponse plainGoal;
+    LspNonblockingResponse plainTermGoal;
+
+    // note the state of the file at `now`: its cursor, the first row of its
+    // window, the version of its text that the server has, and whether it has
+    // edits that the server was not sent. Return whether the requests in
+    // flight must be cancelled, because the text changed.
+    bool observe(Cursor cursor, int top, int version, bool editing, Clock::time_point now);
+    // whether nothing was observed to change for `GOAL_PREFETCH_IDLE_DELAY`.
+    bool idle(Clock::time_point now) const;
+    // whether the positions to fetch are known since the last change.
+    bool planned() const { return this->_planned; }
+    // fetch at `targets`, in order, other than the position in flight.
+    void plan(const std::vector<Cursor>& targets);
+    // the position to fetch next, if the budget allows it and nothing is in
+    // flight. Its requests are in flight from `now`.
+    std::optional<Cursor> next(Clock::time_point now);
+    bool inFlight() const { return this->_inFlightAt.has_value(); }
+    // the position in flight. Only valid if `inFlight()`.
+    Cursor inFlightAt() const { return *this->_inFlightAt; }
+    // forget the responses in `plainGoal` and `plainTermGoal`, and make room
+    // for the next position.
+    void finish();
+
+    int nplanned() const { return (int)this->_targets.size(); }
+
+private:
+    // what was last observed.
+    Cursor _cursor;
+    int _top = -1;
+    int _version = -1;
+    Clock::time_point _lastChange;
+    bool _planned = false;
+    std::deque<Cursor> _targets;
+    std::optional<Cursor> _inFlightAt;
+    // when each request of the last minute was sent, oldest first.
+    std::deque<Clock::time_point> _sentAt;
+};
@@ -1,6 +1,7 @@
 #pragma once
 #include <json-c/json.h>
 #include <json-c/json_util.h>
+#include <utility>
 
 struct json_object_ptr {
     json_object_ptr(json_object* obj = nullptr)
@@ -71,6 +72,15 @@ struct json_object_ptr {
         return m_obj;
     }
 
+    // give up the reference, without dropping it, to whoever takes the
+    // returned object.
+    json_object* release()
+    {
+        json_object* out = m_obj;
+        m_obj = nullptr;
+        return out;
+    }
+
 private:
     json_object* m_obj;
 };
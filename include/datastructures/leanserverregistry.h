@@ -0,0 +1,39 @@
+#pragma once
+#include "datastructures/leanserverstate.h"
+#include <map>
+#include <memory>
+#include <optional>
+
+// The running lean servers, one per Lake workspace, and one `lean --server`
+// for every file outside of a workspace. A server loads the `.olean`s of its
+// workspace once, and the documents of all the files in it are multiplexed
+// onto it, so opening many files of a project costs one server, not one each.
+// Servers are held by pointer, so files can keep a `LeanServerState*`.
+struct LeanServerRegistry {
+    // the server of the workspace at `lakefile_dirpath` (see
+    // `leanWorkspaceDirpath`), launching it if it is not running.
+    LeanServerState* getOrLaunch(std::optional<fs::path> lakefile_dirpath)
+    {
+        std::unique_ptr<LeanServerState>& server = this->_servers[lakefile_dirpath];
+        if (!server) {
+            server = std::make_unique<LeanServerState>();
+            server->init(lakefile_dirpath);
+        }
+        return server.get();
+    }
+
+    // call `f(LeanServerState&)` on each running server.
+    template <typename F>
+    void forEachServer(F f)
+    {
+        for (auto& it : this->_servers) {
+            f(*it.second);
+        }
+    }
+
+    int size() const { return this->_servers.size(); }
+
+private:
+    // servers by workspace. `std::nullopt` is the server of files without one.
+    std::map<std::optional<fs::path>, std::unique_ptr<LeanServerState>> _servers;
+};
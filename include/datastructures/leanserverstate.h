@@ -1,16 +1,27 @@
 #pragma once
 #include <filesystem>
 #include <map>
+#include <memory>
 #include <optional>
+#include <set>
 #include "subprocess.h"
 #include "datastructures/abuf.h"
 #include "datastructures/jsonobjectptr.h"
+#include "datastructures/lspiothread.h"
 #include "datastructures/lsprequestid.h"
 #include "datastructures/lspnonblockingresponse.h"
+#include "datastructures/lspresponsestore.h"
+#include "datastructures/lspscheduler.h"
+#include "definitions/lsprequestkind.h"
 #include "lean_lsp.h"
 
 namespace fs = std::filesystem;
 
+// environment variable with the command line (split at whitespace) of a server
+// to launch instead of `lean --server` or `lake serve`, such as the
+// `fake-lean-server` of the tests, to load the client without lean.
+static const char* const LEAN_SERVER_ENV = "ELIDE_LEAN_SERVER";
+
 struct LeanServerCursorInfo {
     fs::path file_path;
     int row;
@@ -23,7 +34,46 @@ enum class LeanServerInitializedKind {
     Initialized
 };
 
+// the directory of the Lake workspace (the closest `lakefile.lean` among its
+// parents) that the lean file at `absolute_filepath` belongs to, if any.
+std::optional<fs::path> leanWorkspaceDirpath(fs::path absolute_filepath);
+
+// a request whose response has not arrived.
+struct LspPendingRequest {
+    fs::path document; // empty if the request is not about a document.
+    LspRequestKind kind = LRK_None;
+};
+
+// a request about a document that waits for its turn (see `LspScheduler`).
+struct LspQueuedRequest {
+    fs::path document;
+    LspRequestKind kind = LRK_None;
+    std::string method;
+    json_object_ptr params;
+};
+
+// a document that a lean server was sent, by its path.
+struct LeanServerDocument {
+    // the `FileConfig::lsp_document_owner` of the file that has the document
+    // open with the server, or `-1` if it is closed.
+    int owner = -1;
+    // version of the document last sent to the server. Changing it cancels
+    // every pending request about the document, since their responses would
+    // describe old text. Never decreases, even across owners.
+    int version = -1;
+    // the latest request of each kind, or `-1`. Only its response is worth
+    // keeping: the next request of the kind cancels it if it is still
+    // pending, and drops its response if it went unclaimed.
+    LspRequestId latest_request_of_kind[LRK_NumKinds];
+    // notifications about the document (`textDocument/publishDiagnostics`,
+    // `$/lean/fileProgress`), oldest first. Each supersedes the earlier
+    // notification of its method, so there is at most one per method.
+    std::vector<json_object_ptr> notifications;
+};
+
 // https://tldp.org/LDP/lpg/node11.html
+// One server per Lake workspace (or one `lean --server` for the files outside
+// of any), shared by every open file of the workspace: see `LeanServerRegistry`.
 struct LeanServerState {
     LeanServerInitializedKind initialized = LeanServerInitializedKind::Uninitialized; // whether this lean server has been initalized.
     LspRequestId initialize_request_id;
@@ -32,8 +82,6 @@ struct LeanServerState {
     // int parent_buffer_to_child_stdin[2]; // pipe.
     // int child_stdout_to_parent_buffer[2]; // pipe.
     // int child_stderr_to_parent_buffer[2]; // pipe.
-    abuf child_stdout_buffer; // buffer to store child stdout data that has not
-                              // been slurped yet.
     // abuf child_stderr_buffer; // buffer to store child stderr data that has not
     //                           // been slurped yet.
     // FILE* child_stdin_log_file; // file handle of stdout logging
@@ -41,44 +89,79 @@ struct LeanServerState {
     // FILE* child_stderr_log_file; // file handle of stderr logging
     // pid_t childpid;
     subprocess_s process;
+    // reads and writes the pipes of `process`. Held by pointer, so that the
+    // I/O thread is not disturbed when the state is moved.
+    std::unique_ptr<LspIoThread> io;
     int next_request_id = 0; // ID that will be assigned to the next request.
     // number of responses that have been read.
     // invariant: nresponses_read < next_request_id. Otherwise we will deadlock.
     int nresponses_read = 0;
 
-    // server-requests that were recieved when trying to wait for a
-    // server-response to a client-request
+    // server-requests and notifications that are not about a document.
     std::vector<json_object_ptr> unhandled_server_requests;
+    // the documents sent to the server. Notifications about a document are
+    // routed to it; those about a document that is not here are dropped.
+    std::map<fs::path, LeanServerDocument> documents;
+
+    // responses that have arrived, until they are claimed with `take_response`.
+    LspResponseStore responses;
 
-    // vector of LSP requests to responses.
-    std::map<LspRequestId, json_object_ptr> request2response;
-
-    // low-level API to write strings directly.
-    int _write_str_to_child(const char* buf, int len) const;
-    // low-level API: read from stdout and write into buffer
-    // 'child_stdout_buffer'.
-    int _read_stdout_str_from_child_nonblocking();
-    // int _read_stderr_str_from_child_blocking();
-    // tries to read the next JSON record from the buffer, in a nonblocking fashion.
-    // If insufficied data is in the buffer, then return NULL.
-    json_object_ptr _read_next_json_record_from_buffer_nonblocking();
-    // read the next json record from the buffer, and if the buffer is not full,
-    // then read in more data until successful read. Will either hang indefinitely
-    // or return a `json_object*`. Will never return NULL.
-    // json_object_ptr _read_next_json_record_from_buffer_blocking();
+    // decides when the requests about documents are sent.
+    LspScheduler scheduler;
+    // requests about documents that the scheduler has not let through yet.
+    std::map<LspRequestId, LspQueuedRequest> queued_requests;
+    // requests of a kind other than `LRK_None` that were sent, and whose
+    // response has not arrived.
+    std::map<LspRequestId, LspPendingRequest> pending_requests;
+    // requests cancelled by `$/cancelRequest`. Their responses are dropped
+    // when they arrive, and never reach `responses`.
+    std::set<LspRequestId> cancelled_requests;
+    int nresponses_dropped = 0;
 
     // high level APIs to write strutured requests and read responses.
+    // Messages are handed to the I/O thread, which serializes them and
+    // writes them when the server reads (see `LspOutbox`), so they only
+    // block if its queue is full. A request that is cancelled before it is
+    // written is never sent.
     // write a request, and return the request sequence number.
     // this CONSUMES params.
     LspRequestId write_request_to_child_blocking(const char* method, json_object* params);
+    // queue a request about the open document at `document` with the
+    // scheduler, superseding the request of the same `kind` about it. It is
+    // sent when its class has room in flight, and if it is not answered by
+    // its deadline, it is cancelled and answered with a `RequestCancelled` error.
+    // this CONSUMES params.
+    LspRequestId write_document_request_to_child_blocking(const fs::path& document,
+        const char* method, json_object* params, LspRequestKind kind);
+    // send `$/cancelRequest` for a pending request, and drop its response.
+    void cancel_request(LspRequestId request_id);
+    // forget the latest request of `kind` about the document at `document`:
+    // unqueue it if it was not sent yet, cancel it if it is pending, and
+    // drop its response if it arrived.
+    void cancel_document_request(const fs::path& document, LspRequestKind kind);
+
+    // whether the file `owner` has the document at `path` open with the server.
+    bool is_document_open(const fs::path& path, int owner) const;
+    // make the file `owner` the one that has the document at `path` open,
+    // closing it (`textDocument/didClose`) for the file that had it, if any.
+    // Return the least version the `textDocument/didOpen` to follow may carry.
+    int claim_document(const fs::path& path, int owner);
+    // record that the server was sent `version` of the document at `path`.
+    void set_document_version(const fs::path& path, int version);
+    // pop the oldest notification about the document at `path`, if any.
+    std::optional<json_object_ptr> take_document_notification(const fs::path& path);
     // high level APIs to write a notification.
     // this CONSUMES params.
     void write_notification_to_child_blocking(const char* method,
         json_object* params);
-    // performs a tick of processing.
+    // performs a tick of processing: handles every message the I/O thread has
+    // read, gives up on requests past their deadline, sends the requests
+    // the scheduler lets through, and expires unclaimed responses.
     void tick_nonblocking();
 
-    std::optional<json_object_ptr> read_json_response_from_child_nonblocking(LspRequestId request_id);
+    // claim the response to `request_id`, if it has arrived. The caller takes
+    // ownership: a response can only be taken once.
+    std::optional<json_object_ptr> take_response(LspRequestId request_id);
 
     // high level APIs
     void get_tactic_mode_goal_state(LeanServerState state,
@@ -89,8 +172,18 @@ struct LeanServerState {
         LeanServerCursorInfo cinfo);
     LeanServerState() {};
 
-    void init(std::optional<fs::path> file_path);
+    // launch `lake serve` in `lakefile_dirpath`, or `lean --server` if there
+    // is none. `LEAN_SERVER_ENV` replaces either command.
+    void init(std::optional<fs::path> lakefile_dirpath);
 
 private:
+    // the capture of the server's traffic, if `LSP_CAPTURE_ENV` asks for one.
+    std::unique_ptr<LspCaptureWriter> _open_capture();
+    // cancel every queued or pending request about the document at `path`.
+    void _cancel_document_requests(const fs::path& path);
+    // write the request `id`, whose ID is already taken. this CONSUMES params.
+    void _write_request(LspRequestId id, const char* method, json_object* params);
+    // send the queued requests that the scheduler lets through.
+    void _dispatch_requests(LspScheduler::Clock::time_point now);
 };
 
@@ -0,0 +1,65 @@
+#pragma once
+#include "datastructures/jsonobjectptr.h"
+#include "definitions/lspcapturedirection.h"
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// environment variable that makes every lean server record its traffic: the
+// first server to `$ELIDE_LSP_CAPTURE`, the next ones to `$ELIDE_LSP_CAPTURE.1`, ...
+static const char* const LSP_CAPTURE_ENV = "ELIDE_LSP_CAPTURE";
+// first bytes of a capture file. The last one is the format version.
+static const char LSP_CAPTURE_MAGIC[8] = { 'E', 'L', 'S', 'P', 'C', 'A', 'P', 1 };
+
+// bytes that went over a server's pipes in one direction, in one write or read.
+struct LspCaptureRecord {
+    LspCaptureDirection dir;
+    int64_t tMicros; // since the capture started.
+    std::string bytes;
+};
+
+// a whole message of a capture, with the time its last byte was recorded.
+struct LspCaptureMessage {
+    LspCaptureDirection dir;
+    int64_t tMicros;
+    json_object_ptr msg;
+};
+
+// Records both directions of a server's pipes, byte for byte, to a capture
+// file: `LSP_CAPTURE_MAGIC`, then one record per write or read: the direction
+// (one byte), the microseconds since the previous record and the length (both
+// LEB128 varints), and the bytes. Used from a single thread.
+struct LspCaptureWriter {
+    using Clock = std::chrono::steady_clock;
+
+    // start a capture at `path`, at time `start`. Return null if the file
+    // cannot be created.
+    static std::unique_ptr<LspCaptureWriter> open(const fs::path& path, Clock::time_point start);
+    ~LspCaptureWriter();
+    LspCaptureWriter(const LspCaptureWriter&) = delete;
+    LspCaptureWriter& operator=(const LspCaptureWriter&) = delete;
+
+    void record(LspCaptureDirection dir, const char* buf, int len, Clock::time_point now);
+    // write out the records so far.
+    void flush();
+
+private:
+    LspCaptureWriter(FILE* file, Clock::time_point start);
+    FILE* _file;
+    Clock::time_point _start;
+    int64_t _lastMicros = 0;
+    void _writeVarint(uint64_t v);
+};
+
+// read the records of the capture file at `path`. Return false if it cannot
+// be read, or is not a capture.
+bool lspCaptureRead(const fs::path& path, std::vector<LspCaptureRecord>* out);
+// frame and parse the records of a capture into messages, in the order they
+// were completed.
+std::vector<LspCaptureMessage> lspCaptureMessages(const std::vector<LspCaptureRecord>& records);
@@ -0,0 +1,41 @@
+#pragma once
+#include "datastructures/abuf.h"
+#include "datastructures/rope.h"
+#include "lean_lsp.h"
+#include <vector>
+
+// Logs the edits made to a `Rope<abuf>` as LSP content changes, so that the
+// language server is sent only what changed since the last sync
+// (`textDocument/didChange`), not the whole document. The document is the
+// rows joined by '\n'. Repeated in-place edits of the same row are coalesced
+// into a single change of the part of the row that differs. If more than
+// `LSP_CHANGELOG_MAX_CHANGES` are logged between syncs (say, for a file that
+// is never synced), they are dropped for a single change of the whole document.
+static const int LSP_CHANGELOG_MAX_CHANGES = 1024;
+
+struct LspChangeLog {
+    // log that `rows[at]` is about to be edited in place. The new value of the
+    // row is read when the edit is closed, which is at the next logged edit or `take`.
+    void getMut(const Rope<abuf>& rows, int at);
+    // close the open in-place edit. Call this before every edit of `rows`
+    // that is not logged by `getMut`, while `rows` is still in the state
+    // right after the in-place edit.
+    void close(const Rope<abuf>& rows);
+    // log that `deleted[0:ndeleted)`, at `rows[at]`, was replaced by
+    // `rows[at:at+ninserted)`. `rows` is in the state right after the edit.
+    void replaced(const Rope<abuf>& rows, int at, const abuf* deleted, int ndeleted, int ninserted);
+
+    bool empty() const;
+    // the changes logged so far, in order. Leaves the log empty.
+    std::vector<LspContentChange> take(const Rope<abuf>& rows);
+
+private:
+    std::vector<LspContentChange> _changes;
+    bool _changedWhole = false; // if the changes were dropped for the whole document.
+    // the row of the open in-place edit, and its value before the edit.
+    int _openRowIx = -1;
+    abuf _openRowBefore;
+
+    void _changeRow(int at, const abuf& before, const abuf& after);
+    void _push(LspContentChange change);
+};
@@ -0,0 +1,68 @@
+#pragma once
+#include <json-c/json.h>
+#include <string>
+
+// the most bytes of a line kept while looking for the next header: enough
+// for a `Content-Length` field.
+static const int LSP_FRAMER_RESYNC_LINE_LEN = 64;
+
+// Splits the byte stream of a language server into messages
+// (`Content-Length: n\r\n\r\n` followed by `n` bytes of JSON) and parses them.
+// Bytes are consumed as they arrive: headers are parsed incrementally, and
+// bodies are streamed into one reused `json_tokener`, so no payload is ever
+// copied or buffered whole, and every byte passed to `feed` is consumed by
+// the time it returns. A single read buffer can thus be reused for every read.
+// A header without a valid `Content-Length` is dropped as malformed, and the
+// framer skips ahead to the next `Content-Length` field.
+struct LspFramer {
+    LspFramer();
+    ~LspFramer();
+    LspFramer(const LspFramer&) = delete;
+    LspFramer& operator=(const LspFramer&) = delete;
+
+    // consume `buf[0:len)`, calling `onMessage(json_object*)` with every
+    // message completed by it, in order. `onMessage` owns the message.
+    // Return the number of messages.
+    template <typename F>
+    int feed(const char* buf, int len, F onMessage)
+    {
+        int nmessages = 0;
+        int i = 0;
+        while (i < len) {
+            json_object* o = nullptr;
+            i += this->_feedSome(buf + i, len - i, &o);
+            if (o) {
+                onMessage(o);
+                nmessages++;
+            }
+        }
+        return nmessages;
+    }
+
+    // number of messages whose body was not valid JSON, or whose header had
+    // no valid `Content-Length`, and were dropped.
+    int nmalformed() const { return this->_nmalformed; }
+
+private:
+    json_tokener* _tok = nullptr;
+    bool _inBody = false;
+    // while in a header: the line read so far, and the `Content-Length`
+    // seen so far (`-1` if none).
+    std::string _line;
+    int _contentLength = -1;
+    // whether a header without a valid `Content-Length` was dropped, and the
+    // next `Content-Length` field is yet to be found.
+    bool _resyncing = false;
+    // while in a body: bytes of it yet to be consumed, and whether the
+    // tokener has already produced the message (the rest is whitespace).
+    int _bodyRemaining = 0;
+    json_object* _body = nullptr;
+    bool _bodyMalformed = false;
+    int _nmalformed = 0;
+
+    // consume a prefix of `buf[0:len)` that is part of a single header or
+    // body, and return its length. Set `*out` if it completes a message.
+    int _feedSome(const char* buf, int len, json_object** out);
+    int _feedHeader(const char* buf, int len);
+    int _feedBody(const char* buf, int len, json_object** out);
+};
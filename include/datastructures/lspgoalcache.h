@@ -0,0 +1,57 @@
+#pragma once
+#include "datastructures/cursor.h"
+#include "datastructures/jsonobjectptr.h"
+#include "definitions/lsprequestkind.h"
+#include <list>
+#include <map>
+#include <optional>
+#include <utility>
+
+// the most positions that an `LspGoalCache` holds answers at.
+static const int LSP_GOAL_CACHE_MAX_POSITIONS = 1024;
+
+// The answers of a lean server to the requests about a position of a
+// document (`LRK_PlainGoal`, `LRK_PlainTermGoal` and `LRK_Hover`), so that
+// moving the cursor back to a position is answered from memory.
+// The answers are of one version of the document. An edit moves the cache
+// to the next version, keeping the answers at the rows before the first
+// changed row, since lean only elaborates again from the change on, and
+// forgetting the others. Rows, rather than positions, are compared, as the
+// columns of a change need not count what the cursor counts.
+// Holds answers at no more than `LSP_GOAL_CACHE_MAX_POSITIONS`, forgetting the
+// least recently used position first.
+struct LspGoalCache {
+    // the version of the document that the answers are of.
+    int version() const { return this->_version; }
+    // remember `response`, the answer to the request of `kind` at `at` in
+    // `version`. An error, such as a missed deadline, is not remembered, and
+    // neither is an answer about another version.
+    void insert(int version, Cursor at, LspRequestKind kind, json_object_ptr response);
+    // the answer to the request of `kind` at `at` in `version`, if remembered.
+    std::optional<json_object_ptr> find(int version, Cursor at, LspRequestKind kind);
+    // whether there is an answer to the request of `kind` at `at` in `version`.
+    bool contains(int version, Cursor at, LspRequestKind kind) const;
+    // the document was edited into `version`, from the row `firstChangedRow`
+    // on. `0` forgets every answer, say, when the whole document was replaced.
+    void edit(int version, int firstChangedRow);
+
+    int npositions() const { return (int)this->_entries.size(); }
+    long long nhits() const { return this->_nhits; }
+    long long nmisses() const { return this->_nmisses; }
+
+private:
+    using Key = std::pair<int, int>; // (row, column).
+    struct Entry {
+        json_object_ptr answers[3]; // by `_slot`, `NULL` if not remembered.
+        std::list<Key>::iterator lru;
+    };
+    static int _slot(LspRequestKind kind);
+
+    int _version = -1;
+    // ordered by position, so that an edit forgets a suffix.
+    std::map<Key, Entry> _entries;
+    // most recently used first.
+    std::list<Key> _lru;
+    long long _nhits = 0;
+    long long _nmisses = 0;
+};
@@ -0,0 +1,85 @@
+#pragma once
+#include "datastructures/jsonobjectptr.h"
+#include "datastructures/lspcapture.h"
+#include "datastructures/lspframer.h"
+#include "datastructures/lspoutbox.h"
+#include "datastructures/spscqueue.h"
+#include <atomic>
+#include <json-c/json.h>
+#include <memory>
+#include <stdio.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+// number of messages each way that can be in flight between the UI thread
+// and the I/O thread of a server.
+static const int LSP_IO_QUEUE_CAPACITY = 4096;
+// bytes read from the server at a time.
+static const int LSP_IO_READ_SIZE = 1 << 16;
+// error code of the response to a cancelled request (`RequestCancelled`).
+static const int LSP_REQUEST_CANCELLED = -32800;
+
+// the response that a server gives to request `id` when it is cancelled.
+json_object* lspRequestCancelledResponse(LspRequestId id);
+
+// Talks to a language server on a dedicated thread, so that the UI loop never
+// waits on the server's pipes. The I/O thread sleeps in `poll` until the
+// server writes, the server can take more of what is queued for it, or the UI
+// queues a message. It reads, frames and parses every complete message right
+// away (see `LspFramer`), and hands them to the UI thread over a lock-free
+// queue. Messages for the server reach it over a second queue, and wait in
+// an `LspOutbox` until the server reads them, so that neither thread blocks
+// on a server that does not read its stdin. Requests that the outbox drops
+// with their `$/cancelRequest` are answered with a `RequestCancelled` error,
+// as the server would.
+// Only one (UI) thread may call `write`, `send` and `tryRead`.
+struct LspIoThread {
+    // start the I/O thread on the server's (non-blocking) stdout, and stdin.
+    // If `capture` is given, the I/O thread records all of the traffic to it.
+    LspIoThread(int stdoutFd, FILE* stdinFile, std::unique_ptr<LspCaptureWriter> capture = nullptr);
+    // stop and join the I/O thread. Unread and unwritten messages are dropped.
+    ~LspIoThread();
+    LspIoThread(const LspIoThread&) = delete;
+    LspIoThread& operator=(const LspIoThread&) = delete;
+
+    // queue the framed message `msg` to be written to the server as-is.
+    void write(std::string msg);
+    // queue the message `msg` to be serialized and written to the server.
+    // The I/O thread takes it over: the caller must not touch it, nor any
+    // part of it, again.
+    void send(json_object_ptr msg);
+    // pop the next message from the server, or return null if there is none yet.
+    json_object_ptr tryRead();
+    // whether the server closed its stdout.
+    bool serverExited() const;
+
+private:
+    const int _stdoutFd;
+    const int _stdinFd;
+    int _wakeFds[2]; // pipe the UI thread writes to, to wake the I/O thread from `poll`.
+    std::atomic<bool> _quit { false };
+    std::atomic<bool> _serverExited { false };
+    SpscQueue<json_object*> _inbound;
+    SpscQueue<LspOutboundMessage> _outbound;
+
+    // owned by the I/O thread.
+    // the framer consumes every read in full, so one buffer serves every read.
+    std::unique_ptr<char[]> _readBuf;
+    LspFramer _framer;
+    std::unique_ptr<LspCaptureWriter> _capture;
+    // parsed messages waiting for room in `_inbound`, oldest first.
+    std::vector<json_object*> _backlog;
+    LspOutbox _outbox;
+    bool _serverClosedStdin = false;
+
+    std::thread _thread;
+
+    void _run();
+    void _wake();
+    void _pushOutbound(LspOutboundMessage m);
+    // queue what the UI sent, and write what the server takes. Never blocks.
+    void _writeOutbound();
+    // read and parse what the server has written so far. Never blocks.
+    void _readStdout();
+};
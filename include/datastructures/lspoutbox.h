@@ -0,0 +1,78 @@
+#pragma once
+#include "datastructures/jsonobjectptr.h"
+#include "datastructures/lspcapture.h"
+#include "datastructures/lsprequestid.h"
+#include <deque>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// messages written by a single `writev`.
+static const int LSP_OUTBOX_MAX_IOVECS = 64;
+// bytes of messages serialized for a single `writev`, about what a pipe
+// holds. A larger message is written on its own.
+static const int LSP_OUTBOX_MAX_WRITE_SIZE = 1 << 16;
+// buffers kept for reuse once their message is written.
+static const int LSP_OUTBOX_POOL_SIZE = 64;
+// buffers larger than this (say, of a large `textDocument/didOpen`) are
+// freed once written, rather than kept for reuse.
+static const int LSP_OUTBOX_POOL_MAX_BUFFER_SIZE = 1 << 20;
+
+// a message for a server, as the UI thread hands it to the I/O thread:
+// either a JSON-RPC message, or bytes that are written as-is.
+struct LspOutboundMessage {
+    json_object_ptr msg;
+    std::string raw; // framed. Only if `msg` is null.
+};
+
+// The messages waiting to be written to a server, oldest first. They are
+// written with non-blocking `writev`s, so that a server that does not read
+// its stdin (say, because it is busy elaborating) never blocks the writer.
+// Each message is serialized and framed once, right before it is first
+// written, into a buffer from a pool.
+// Until its first byte is written, a queued message can be superseded:
+// - a `$/cancelRequest` of a queued request drops both. Nobody will answer
+//   the request, so it is reported by `takeDroppedRequests`.
+// - a `textDocument/didChange` is merged into the previous queued
+//   `didChange` of its document, if no other message about the document
+//   is queued between them: its content changes are appended to those of
+//   the previous one, whose version becomes its version.
+// Raw messages are never superseded, nor merged across. Used from a single thread.
+struct LspOutbox {
+    void push(LspOutboundMessage m);
+    // write what `fd`, which must be non-blocking, takes right now, recording
+    // it to `capture` if it is not null. Return false if the server closed
+    // its stdin, in which case every queued message is dropped.
+    bool flush(int fd, LspCaptureWriter* capture);
+
+    bool empty() const { return this->_queue.empty(); }
+    // number of queued messages.
+    int size() const { return (int)this->_queue.size(); }
+    // the requests dropped with their `$/cancelRequest` since the last call.
+    std::vector<LspRequestId> takeDroppedRequests();
+    // number of messages dropped or merged away, over the lifetime of the outbox.
+    int64_t ncoalesced() const { return this->_ncoalesced; }
+
+private:
+    struct Entry {
+        json_object_ptr msg; // null if raw.
+        std::string bytes; // framed. Empty until serialized, unless raw.
+        LspRequestId request; // if the message is a request.
+        std::string document; // URI of the document the message is about, if any.
+        bool didChange = false;
+    };
+    std::deque<Entry> _queue;
+    int _headWritten = 0; // bytes of the first message already written.
+    std::vector<std::string> _pool;
+    std::vector<LspRequestId> _dropped;
+    int64_t _ncoalesced = 0;
+
+    // whether `_queue[ix]` may still be dropped or changed.
+    bool _isUnstarted(int ix) const { return ix > 0 || this->_headWritten == 0; }
+    bool _dropRequest(LspRequestId id);
+    // merge every unstarted `didChange` of `document` into the previous one,
+    // where no other message about it is queued between them.
+    void _mergeDidChanges(const std::string& document);
+    void _serialize(Entry* e);
+    void _recycle(std::string* buf);
+};
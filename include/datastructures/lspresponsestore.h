@@ -0,0 +1,67 @@
+#pragma once
+#include "datastructures/jsonobjectptr.h"
+#include "datastructures/lsprequestid.h"
+#include <chrono>
+#include <optional>
+#include <stdint.h>
+#include <vector>
+
+// a response that nobody claims within this long is dropped.
+static const std::chrono::seconds LSP_RESPONSE_TTL = std::chrono::seconds(60);
+// smallest number of slots of an `LspResponseStore`. A power of 2.
+static const int LSP_RESPONSE_STORE_MIN_CAPACITY = 16;
+
+// Responses from a language server that are waiting to be claimed, keyed by
+// request. The store owns each response until `take` hands it to its
+// claimant, and drops responses that are not claimed within a
+// `LSP_RESPONSE_TTL`, so that it stays as small as the set of outstanding
+// responses, however long the session.
+// A flat, linearly probed hash table: lookups touch one or two adjacent slots,
+// rather than chasing tree nodes, and deletion shifts the following slots
+// back instead of leaving tombstones. The table grows and shrinks with its size.
+struct LspResponseStore {
+    using Clock = std::chrono::steady_clock;
+
+    LspResponseStore();
+
+    // store the response to `id`, which arrived at `now`.
+    // There must not already be one.
+    void insert(LspRequestId id, json_object_ptr response, Clock::time_point now);
+    // whether there is a response to `id`.
+    bool contains(LspRequestId id) const;
+    // hand over the response to `id`, if it has arrived, and forget it.
+    std::optional<json_object_ptr> take(LspRequestId id);
+    // drop the response to `id`, if any, because nobody will claim it.
+    // Return whether there was one.
+    bool drop(LspRequestId id);
+    // drop every response that arrived before `now - LSP_RESPONSE_TTL`.
+    // Return the number dropped.
+    int expire(Clock::time_point now);
+
+    // number of responses held.
+    int size() const { return this->_size; }
+    // number of slots in the table.
+    int capacity() const { return (int)this->_slots.size(); }
+    // number of responses dropped by `drop` or `expire`, over the lifetime of the store.
+    int ndropped() const { return this->_ndropped; }
+
+private:
+    struct Slot {
+        int id = -1; // `-1` if empty.
+        json_object_ptr response;
+        Clock::time_point arrived;
+    };
+    std::vector<Slot> _slots;
+    int _size = 0;
+    int _ndropped = 0;
+
+    int _home(int id) const;
+    // index of the slot holding `id`, or `-1`.
+    int _find(int id) const;
+    // empty slot `ix`, and shift back the slots probed past it.
+    void _erase(int ix);
+    // move every entry into a table of `capacity` slots.
+    void _rehash(int capacity);
+    // shrink the table after removals, if it is mostly empty.
+    void _maybeShrink();
+};
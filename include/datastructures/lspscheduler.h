@@ -0,0 +1,93 @@
+#pragma once
+#include "datastructures/lsprequestid.h"
+#include "definitions/lsprequestclass.h"
+#include "definitions/lsprequestkind.h"
+#include <chrono>
+#include <deque>
+#include <map>
+#include <optional>
+#include <stdint.h>
+#include <vector>
+
+// how many requests of a class may be in flight at once, and how long after
+// it is queued a request of the class is given up on.
+struct LspRequestClassPolicy {
+    int maxInFlight;
+    std::chrono::milliseconds deadline;
+};
+
+// a goal is only answered once the server has elaborated up to it, which
+// takes a while for a large file that was just opened.
+static const LspRequestClassPolicy LSP_REQUEST_CLASS_POLICIES[LRC_NumClasses] = {
+    { 4, std::chrono::seconds(60) }, // LRC_Interactive: plain goal, plain term goal and hover, and one more.
+    { 1, std::chrono::seconds(20) }, // LRC_Goto
+    { 1, std::chrono::seconds(10) }, // LRC_Completion
+    { 2, std::chrono::seconds(30) }, // LRC_Background
+};
+
+// the class of the requests of `kind`.
+LspRequestClass lspRequestClassOfKind(LspRequestKind kind);
+// name of `cls`, for reports.
+const char* lspRequestClassName(LspRequestClass cls);
+
+// what became of the requests of a class, over the lifetime of a scheduler.
+struct LspRequestClassStats {
+    int nsent = 0;
+    int nanswered = 0;
+    int nexpired = 0;
+    // from queued to sent, of the sent requests.
+    std::chrono::microseconds totalWait { 0 };
+    // from queued to answered, of the answered requests.
+    std::chrono::microseconds totalLatency { 0 };
+    std::chrono::microseconds maxLatency { 0 };
+};
+
+// a request given up on by `LspScheduler::expire`.
+struct LspExpiredRequest {
+    LspRequestId id;
+    bool inFlight; // if it was sent, and must be cancelled.
+};
+
+// Decides when the requests to a server are sent. Requests are queued by
+// class, and `next` hands out the oldest request of the most urgent class
+// that has room in flight (see `LSP_REQUEST_CLASS_POLICIES`), so that, say,
+// a burst of completions never delays the goal view. A request that is not
+// answered by its class's deadline is given up on by `expire`, whether it
+// was sent or not.
+// Only tracks IDs: the requests themselves are kept by the caller.
+struct LspScheduler {
+    using Clock = std::chrono::steady_clock;
+
+    // queue the request `id` of class `cls`, at `now`.
+    void enqueue(LspRequestId id, LspRequestClass cls, Clock::time_point now);
+    // forget the queued request `id`, which will not be sent.
+    // Return whether it was queued.
+    bool unqueue(LspRequestId id);
+    // the request to send next, if any may be sent. It is in flight from `now`.
+    std::optional<LspRequestId> next(Clock::time_point now);
+    // the request `id` is no longer in flight, because it was answered at
+    // `now`, or cancelled. Does nothing if it is not in flight.
+    void finish(LspRequestId id, bool answered, Clock::time_point now);
+    // give up on, and forget, every request past its deadline at `now`.
+    std::vector<LspExpiredRequest> expire(Clock::time_point now);
+
+    int nqueued(LspRequestClass cls) const { return (int)this->_queued[cls].size(); }
+    int ninFlight(LspRequestClass cls) const { return this->_ninFlight[cls]; }
+    const LspRequestClassStats& stats(LspRequestClass cls) const { return this->_stats[cls]; }
+
+private:
+    struct Queued {
+        LspRequestId id;
+        Clock::time_point queuedAt;
+    };
+    struct InFlight {
+        LspRequestClass cls;
+        Clock::time_point queuedAt;
+    };
+    // oldest first. As deadlines only depend on the class, the oldest
+    // request of a class is also the first to expire.
+    std::deque<Queued> _queued[LRC_NumClasses];
+    std::map<LspRequestId, InFlight> _inFlight;
+    int _ninFlight[LRC_NumClasses] = {};
+    LspRequestClassStats _stats[LRC_NumClasses];
+};
@@ -0,0 +1,376 @@
+#pragma once
+#include <assert.h>
+#include <stdint.h>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// A persistent sequence of `T`, stored as an implicit treap (a balanced binary
+// tree keyed by position, with random heap priorities).
+//   . lookup, insert and erase at an index are O(log n).
+//   . copying a rope is O(1): the copy shares every node with the original.
+//   . mutation is copy-on-write: only the nodes on the path to the edited
+//     index are cloned, and only if they are shared with another rope.
+//   . `hash()` is a polynomial hash of the sequence. Every node caches the
+//     hash of its subtree, so after `k` edits only the `k` edited paths are
+//     rehashed, in O(k log n).
+// This makes a `Rope` a cheap immutable snapshot, which is what the undo
+// stack wants.
+template <typename T>
+struct Rope {
+    Rope() = default;
+
+    // build a rope from `vals` in O(n) (Cartesian tree construction).
+    explicit Rope(std::vector<T> vals)
+    {
+        // right spine of the tree built so far, root at the bottom.
+        std::vector<NodePtr> spine;
+        for (T& v : vals) {
+            NodePtr n = std::make_shared<Node>(std::move(v));
+            NodePtr last;
+            while (!spine.empty() && spine.back()->prio < n->prio) {
+                last = std::move(spine.back());
+                spine.pop_back();
+                update(last.get());
+            }
+            n->l = std::move(last);
+            if (!spine.empty()) {
+                spine.back()->r = n;
+            }
+            spine.push_back(std::move(n));
+        }
+        while (!spine.empty()) {
+            update(spine.back().get());
+            if (spine.size() == 1) {
+                _root = std::move(spine.back());
+            }
+            spine.pop_back();
+        }
+    }
+
+    int size() const
+    {
+        return sizeOf(_root);
+    }
+
+    bool empty() const
+    {
+        return _root == nullptr;
+    }
+
+    // read the value at index `i`. Invariant: `0 <= i < size()`.
+    const T& operator[](int i) const
+    {
+        assert(i >= 0 && i < size());
+        const Node* n = _root.get();
+        while (true) {
+            const int ls = sizeOf(n->l);
+            if (i < ls) {
+                n = n->l.get();
+            } else if (i == ls) {
+                return n->val;
+            } else {
+                i -= ls + 1;
+                n = n->r.get();
+            }
+        }
+    }
+
+    // get a mutable reference to the value at index `i`, cloning the path to
+    // it if it is shared with a snapshot. The reference is invalidated by
+    // the next structural edit (insert/erase) of this rope.
+    T& getMut(int i)
+    {
+        assert(i >= 0 && i < size());
+        NodePtr* p = &_root;
+        while (true) {
+            Node* n = own(*p);
+            n->hashValid = false;
+            const int ls = sizeOf(n->l);
+            if (i < ls) {
+                p = &n->l;
+            } else if (i == ls) {
+                n->valHashValid = false;
+                return n->val;
+            } else {
+                i -= ls + 1;
+                p = &n->r;
+            }
+        }
+    }
+
+    // insert `val` such that it lives at index `at`, shifting later values.
+    // Invariant: `0 <= at <= size()`.
+    void insert(int at, T val)
+    {
+        assert(at >= 0 && at <= size());
+        NodePtr l, r;
+        split(std::move(_root), at, l, r);
+        _root = merge(merge(std::move(l), std::make_shared<Node>(std::move(val))), std::move(r));
+    }
+
+    // erase the value at index `at`. Invariant: `0 <= at < size()`.
+    void erase(int at)
+    {
+        assert(at >= 0 && at < size());
+        NodePtr l, mid, r;
+        split(std::move(_root), at, l, r);
+        split(std::move(r), 1, mid, r);
+        _root = merge(std::move(l), std::move(r));
+    }
+
+    void push_back(T val)
+    {
+        insert(size(), std::move(val));
+    }
+
+    void pop_back()
+    {
+        erase(size() - 1);
+    }
+
+    void clear()
+    {
+        _root = nullptr;
+    }
+
+    // call `f(i, val)` on each value, in order. O(n).
+    template <typename F>
+    void forEach(F f) const
+    {
+        int ix = 0;
+        forEachNode(_root.get(), ix, f);
+    }
+
+    // hash of the sequence, combining `hashValue(val)` (found by ADL) of each
+    // value. Equal sequences have equal hashes. O(1) if the rope has not been
+    // edited since the last call.
+    uint64_t hash() const
+    {
+        if (!_root) {
+            return 0;
+        }
+        rehash(_root.get());
+        return _root->hash;
+    }
+
+    // returns true if both ropes are the same snapshot. O(1).
+    bool isSameSnapshot(const Rope<T>& other) const
+    {
+        return _root == other._root;
+    }
+
+    // O(n) at worst, but subtrees that both ropes share at the same index are
+    // skipped without being walked, so comparing a rope with an edited copy
+    // of it is O(k log n) after `k` edits.
+    bool operator==(const Rope<T>& other) const
+    {
+        if (isSameSnapshot(other)) {
+            return true;
+        }
+        if (size() != other.size()) {
+            return false;
+        }
+        // hashes that are already known reject for free; computing them would
+        // cost as much as the walk.
+        if (_root->hashValid && other._root->hashValid && _root->hash != other._root->hash) {
+            return false;
+        }
+        // in order, what is left of each rope: subtrees to walk, or single
+        // values once their subtree is opened. The next item is at the back.
+        struct Item {
+            const Node* n;
+            bool whole;
+        };
+        std::vector<Item> a = { { _root.get(), true } };
+        std::vector<Item> b = { { other._root.get(), true } };
+        auto open = [](std::vector<Item>& s) {
+            const Node* n = s.back().n;
+            s.pop_back();
+            if (n->r) {
+                s.push_back({ n->r.get(), true });
+            }
+            s.push_back({ n, false });
+            if (n->l) {
+                s.push_back({ n->l.get(), true });
+            }
+        };
+        while (!a.empty()) {
+            assert(!b.empty());
+            const Item x = a.back();
+            const Item y = b.back();
+            if (x.whole && y.whole && x.n == y.n) {
+                a.pop_back();
+                b.pop_back();
+            } else if (x.whole && (!y.whole || x.n->size >= y.n->size)) {
+                open(a);
+            } else if (y.whole) {
+                open(b);
+            } else {
+                if (!(x.n->val == y.n->val)) {
+                    return false;
+                }
+                a.pop_back();
+                b.pop_back();
+            }
+        }
+        return true;
+    }
+
+private:
+    struct Node;
+    using NodePtr = std::shared_ptr<Node>;
+
+    struct Node {
+        T val;
+        uint64_t prio;
+        int size = 1;
+        NodePtr l;
+        NodePtr r;
+        // `hash()` of the subtree, and `HASH_BASE^size`. Valid if `hashValid`.
+        mutable uint64_t hash = 0;
+        mutable uint64_t pow = 1;
+        mutable uint64_t valHash = 0; // `hashValue(val)`, reduced. Valid if `valHashValid`.
+        mutable bool hashValid = false;
+        mutable bool valHashValid = false;
+
+        explicit Node(T val)
+            : val(std::move(val))
+            , prio(nextPriority())
+        {
+        }
+    };
+
+    // splitmix64 over a global counter: cheap, deterministic priorities.
+    static uint64_t nextPriority()
+    {
+        static uint64_t state = 0;
+        uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    static int sizeOf(const NodePtr& p)
+    {
+        return p ? p->size : 0;
+    }
+
+    static void update(Node* n)
+    {
+        n->size = 1 + sizeOf(n->l) + sizeOf(n->r);
+        n->hashValid = false;
+    }
+
+    // hashes are polynomials in `HASH_BASE`, modulo the Mersenne prime `2^61 - 1`.
+    static const uint64_t HASH_MOD = (1ull << 61) - 1;
+    static const uint64_t HASH_BASE = 0x1F2E3D4C5B6A798ull % HASH_MOD;
+
+    static uint64_t hashMul(uint64_t a, uint64_t b)
+    {
+        const __uint128_t p = (__uint128_t)a * b;
+        const uint64_t out = (uint64_t)(p & HASH_MOD) + (uint64_t)(p >> 61);
+        return out >= HASH_MOD ? out - HASH_MOD : out;
+    }
+
+    static uint64_t hashAdd(uint64_t a, uint64_t b)
+    {
+        const uint64_t out = a + b;
+        return out >= HASH_MOD ? out - HASH_MOD : out;
+    }
+
+    // recompute the cached hashes in the subtree of `n` that were invalidated.
+    // hash(l ++ [val] ++ r) = (hash(l) * B + hash(val)) * B^|r| + hash(r).
+    static void rehash(const Node* n)
+    {
+        if (n->hashValid) {
+            return;
+        }
+        if (!n->valHashValid) {
+            // never `0`, so that appending a value always changes the hash.
+            n->valHash = hashValue(n->val) % (HASH_MOD - 1) + 1;
+            n->valHashValid = true;
+        }
+        uint64_t hash = 0;
+        uint64_t pow = 1;
+        if (n->l) {
+            rehash(n->l.get());
+            hash = n->l->hash;
+            pow = n->l->pow;
+        }
+        hash = hashAdd(hashMul(hash, HASH_BASE), n->valHash);
+        pow = hashMul(pow, HASH_BASE);
+        if (n->r) {
+            rehash(n->r.get());
+            hash = hashAdd(hashMul(hash, n->r->pow), n->r->hash);
+            pow = hashMul(pow, n->r->pow);
+        }
+        n->hash = hash;
+        n->pow = pow;
+        n->hashValid = true;
+    }
+
+    // make `p` uniquely owned by cloning it if it is shared, and return it.
+    static Node* own(NodePtr& p)
+    {
+        assert(p);
+        if (p.use_count() > 1) {
+            p = std::make_shared<Node>(*p);
+        }
+        return p.get();
+    }
+
+    // split `p` into `l = p[0, k)` and `r = p[k, n)`.
+    static void split(NodePtr p, int k, NodePtr& l, NodePtr& r)
+    {
+        if (!p) {
+            l = r = nullptr;
+            return;
+        }
+        Node* n = own(p);
+        if (sizeOf(n->l) < k) {
+            split(std::move(n->r), k - sizeOf(n->l) - 1, n->r, r);
+            update(n);
+            l = std::move(p);
+        } else {
+            split(std::move(n->l), k, l, n->l);
+            update(n);
+            r = std::move(p);
+        }
+    }
+
+    // concatenate `l` and `r`.
+    static NodePtr merge(NodePtr l, NodePtr r)
+    {
+        if (!l) {
+            return r;
+        }
+        if (!r) {
+            return l;
+        }
+        if (l->prio > r->prio) {
+            Node* n = own(l);
+            n->r = merge(std::move(n->r), std::move(r));
+            update(n);
+            return l;
+        } else {
+            Node* n = own(r);
+            n->l = merge(std::move(l), std::move(n->l));
+            update(n);
+            return r;
+        }
+    }
+
+    template <typename F>
+    static void forEachNode(const Node* n, int& ix, F& f)
+    {
+        if (!n) {
+            return;
+        }
+        forEachNode(n->l.get(), ix, f);
+        f(ix++, n->val);
+        forEachNode(n->r.get(), ix, f);
+    }
+
+    NodePtr _root;
+};
@@ -0,0 +1,61 @@
+#pragma once
+#include "datastructures/abuf.h"
+#include "datastructures/rope.h"
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+// one edit of a sequence of rows. Either an in-place edit of `rows[at]`, if
+// `byteIx != -1`: its bytes `[byteIx, byteIx + deletedBytes.size())` were
+// replaced by `insertedBytes`. Or an edit of whole rows:
+// `rows[at:at+deleted.size())` was replaced by `inserted`.
+struct RowsEdit {
+    int at = 0;
+    int byteIx = -1;
+    std::string deletedBytes;
+    std::string insertedBytes;
+    std::vector<abuf> deleted;
+    std::vector<abuf> inserted;
+
+    bool inPlace() const { return this->byteIx != -1; }
+};
+
+// Logs the edits made to a `Rope<abuf>`, so that they can be undone and redone.
+// An in-place edit stores only the bytes between the common prefix and suffix
+// of the row before and after it, and inserting or erasing a row stores that
+// row, so the log costs O(edit size), not O(row size) or O(file size).
+// Repeated in-place edits of the same row are coalesced into a single edit.
+struct RowsEditLog {
+    // log that `rows[at]` is about to be edited in place, and return it.
+    // The new value of the row is read when the edit is closed, which is at
+    // the next logged edit or `take`.
+    abuf& getMut(Rope<abuf>& rows, int at);
+    void insert(Rope<abuf>& rows, int at, abuf row);
+    void erase(Rope<abuf>& rows, int at);
+
+    bool empty() const;
+    // the edits logged so far, in order. Leaves the log empty.
+    std::vector<RowsEdit> take(const Rope<abuf>& rows);
+
+    // replay `edits` on `rows` (`forward = true`), or revert them (`forward = false`).
+    // Invariant: `rows` is in the state right before (resp. after) the edits.
+    static void replay(Rope<abuf>& rows, const std::vector<RowsEdit>& edits, bool forward);
+    static void replay(Rope<abuf>& rows, const RowsEdit& edit, bool forward);
+
+    // bytes of memory held by `edits`.
+    static size_t nbytes(const std::vector<RowsEdit>& edits);
+    // append a flat encoding of `edits` to `out`, e.g. to compress it.
+    static void serialize(const std::vector<RowsEdit>& edits, std::string* out);
+    // decode edits encoded by `serialize` from `[*p, end)`, advancing `*p`.
+    // Return `false` if the encoding is malformed.
+    static bool deserialize(const char** p, const char* end, std::vector<RowsEdit>* out);
+
+private:
+    std::vector<RowsEdit> _edits;
+    // the row of the open in-place edit, whose new value has not been read
+    // yet, and its value before the edit. `-1` if there is none.
+    int _openRowIx = -1;
+    abuf _openRowBefore;
+
+    void _closeOpenEdit(const Rope<abuf>& rows);
+};
@@ -0,0 +1,75 @@
+#pragma once
+#include <assert.h>
+#include <atomic>
+#include <memory>
+#include <stddef.h>
+#include <utility>
+
+// A bounded lock-free queue between exactly one producer thread and one
+// consumer thread. Neither side ever blocks: `tryPush` fails when the queue
+// is full, and `tryPop` when it is empty.
+// Each index is written by a single thread, and each side caches the other
+// side's index, so that it only reads the other side's cache line when the
+// queue looks full (resp. empty).
+template <typename T>
+struct SpscQueue {
+    // `capacity` must be a power of two.
+    explicit SpscQueue(int capacity)
+        : _slots(new T[capacity])
+        , _mask(capacity - 1)
+    {
+        assert(capacity > 0 && (capacity & (capacity - 1)) == 0);
+    }
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    // producer only. Move `val` into the queue and return `true`, or leave
+    // `val` as-is and return `false` if the queue is full.
+    bool tryPush(T&& val)
+    {
+        const size_t tail = this->_tail.load(std::memory_order_relaxed);
+        if (tail - this->_cachedHead > this->_mask) {
+            this->_cachedHead = this->_head.load(std::memory_order_acquire);
+            if (tail - this->_cachedHead > this->_mask) {
+                return false;
+            }
+        }
+        this->_slots[tail & this->_mask] = std::move(val);
+        this->_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer only. Move the oldest value into `*out` and return `true`,
+    // or return `false` if the queue is empty.
+    bool tryPop(T* out)
+    {
+        const size_t head = this->_head.load(std::memory_order_relaxed);
+        if (head == this->_cachedTail) {
+            this->_cachedTail = this->_tail.load(std::memory_order_acquire);
+            if (head == this->_cachedTail) {
+                return false;
+            }
+        }
+        *out = std::move(this->_slots[head & this->_mask]);
+        this->_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // number of queued values. Only a snapshot if the other side is running.
+    int size() const
+    {
+        return this->_tail.load(std::memory_order_acquire) - this->_head.load(std::memory_order_acquire);
+    }
+
+private:
+    static const int CACHE_LINE = 64;
+    const std::unique_ptr<T[]> _slots;
+    const size_t _mask;
+    // indices grow without wrapping; a slot is `index & _mask`.
+    // written by the consumer.
+    alignas(CACHE_LINE) std::atomic<size_t> _head { 0 };
+    size_t _cachedTail = 0;
+    // written by the producer.
+    alignas(CACHE_LINE) std::atomic<size_t> _tail { 0 };
+    size_t _cachedHead = 0;
+};
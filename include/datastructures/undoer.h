@@ -1,42 +1,72 @@
 #pragma once
+#include "algorithms/lzcompress.h"
 #include "datastructures/debouncer.h"
-#include <stack>
+#include "definitions/undobudget.h"
+#include <assert.h>
+#include <deque>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <utility>
 
-// T is a memento, from which the prior state can be
-// entirely reconstructed.
+// memory held by the undo history of one `Undoer`.
+struct UndoMemoryStats {
+    int nundo = 0; // number of undo steps.
+    int nredo = 0; // number of redo steps.
+    int ncompressed = 0; // number of steps, of either kind, held compressed.
+    size_t undoBytes = 0;
+    size_t redoBytes = 0;
+    int nevicted = 0; // number of undo steps dropped to stay within budget.
+};
+
+// T is the undoable state. Rather than snapshotting T, the undoer keeps the
+// edits between consecutive mementos, which T logs as it is edited:
+//   . `T::Delta T::takeDelta()` returns the edits made since the last call.
+//   . `void T::applyDelta(const T::Delta& d, bool forward)` replays `d`
+//     (`forward = true`) or reverts it (`forward = false`).
+//   . `bool T::Delta::empty() const` is true if `d` does not change the state.
+//   . `uint64_t T::stateHash()` hashes the state, in O(1) when it is unchanged.
+// So each memento costs O(edit size), as does each undo / redo step.
+// The history is kept within a byte budget: all but the newest
+// `UNDO_NHOT_ENTRIES` steps of each stack are compressed, and the oldest
+// undo steps are evicted when over budget. For this, deltas also provide
+//   . `size_t T::Delta::nbytes() const`, the memory held by the delta.
+//   . `void T::Delta::serialize(std::string* out) const`, and
+//     `static bool T::Delta::deserialize(const char* p, const char* end, Delta* out)`.
 template <typename T>
 struct Undoer : public T {
 public:
+    using Delta = typename T::Delta;
+
     // invariant: once we are `inUndoRedo`, the top of the `undoStack`
-    // is the current state.
+    // is the delta into the current state.
     void doUndo()
     {
-        if (undoStack.empty()) {
+        if (!this->hasMemento) {
             return;
         }
         if (!this->inUndoRedo) {
             this->inUndoRedo = true;
-            // we are entering into undo/redo. Save the state right before
-            // we began undo/redo, so that the user can redo their way
-            // back to the 'earliest' state.
-            T cur = getCheckpoint();
-            redoStack.push(cur);
-
-            T prev = undoStack.top();
-            this->setCheckpoint(prev); // apply to setup the invariant.
+            // we are entering into undo/redo. Save the edits since the last
+            // memento, so that the user can redo their way back to the
+            // 'earliest' state.
+            Delta cur = takeDelta();
+            this->applyDelta(cur, /*forward=*/false); // apply to setup the invariant.
+            this->pushRedo(std::move(cur));
+            this->mementoHash = this->stateHash();
         } else {
             assert(this->inUndoRedo);
-            if (this->undoStack.size() == 1) {
+            if (this->undoStack.empty()) {
                 return; // this is already the state.
             }
-            assert(this->undoStack.size() >= 2);
+            // edits made during undo/redo are not part of the history.
+            this->applyDelta(takeDelta(), /*forward=*/false);
             // once the user has started undoing, then can only stop by
             // creating an undo memento.
-            T cur = undoStack.top();
-            redoStack.push(cur); // push the checkpoint of our state.
-            undoStack.pop(); // pop cur.
-            T prev = undoStack.top();
-            this->setCheckpoint(prev); // apply.
+            Delta cur = popEntry(&this->undoStack, &this->undoBytes); // pop cur.
+            this->applyDelta(cur, /*forward=*/false); // apply.
+            this->pushRedo(std::move(cur)); // push the delta out of our state.
+            this->mementoHash = this->stateHash();
         }
     }
 
@@ -46,11 +76,11 @@ public:
             return;
         }
         assert(this->inUndoRedo);
-        T val = redoStack.top();
-        undoStack.push(val); // push into redos.
-
-        redoStack.pop();
-        this->setCheckpoint(val); // apply the invariant.
+        this->applyDelta(takeDelta(), /*forward=*/false);
+        Delta val = popEntry(&this->redoStack, &this->redoBytes);
+        this->applyDelta(val, /*forward=*/true); // apply the invariant.
+        this->pushUndo(std::move(val)); // push into undos.
+        this->mementoHash = this->stateHash();
     }
 
     // save the current state for later undoing and redoing.
@@ -59,15 +89,23 @@ public:
         // abort being in undo/redo mode.
         this->inUndoRedo = false;
         redoStack = {}; // nuke redo stack.
+        redoBytes = 0;
 
-        T cur = getCheckpoint();
-        if (!undoStack.empty()) {
-            T& top = undoStack.top();
-            if (top == cur) {
-                return;
-            } // state has not changed, no point.
+        Delta cur = takeDelta();
+        const uint64_t hash = this->stateHash();
+        if (!this->hasMemento) {
+            // the first memento is the oldest state we can undo to.
+            this->hasMemento = true;
+            this->mementoHash = hash;
+            return;
         }
-        undoStack.push(cur);
+        // edits that cancel out (say, typing and deleting a character)
+        // leave the hash as-is.
+        if (cur.empty() || hash == this->mementoHash) {
+            return;
+        } // state has not changed, no point.
+        this->pushUndo(std::move(cur));
+        this->mementoHash = hash;
     }
 
     // save the current state, and debounce the save by 1 second.
@@ -84,26 +122,145 @@ public:
         mkUndoMemento();
     }
 
+    // bound the memory of the undo history to `nbytes`.
+    void setUndoBudget(size_t nbytes)
+    {
+        this->undoBudget = nbytes;
+        this->evictUndoHistory(nbytes);
+    }
+
+    // drop the oldest undo steps until the history fits in `nbytes`, or
+    // there are no undo steps left. Return the number of steps dropped.
+    int evictUndoHistory(size_t nbytes)
+    {
+        int nevicted = 0;
+        while (this->undoBytes + this->redoBytes > nbytes && !this->undoStack.empty()) {
+            // the state after the oldest step becomes the oldest we can undo to.
+            this->undoBytes -= this->undoStack.front().nbytes;
+            this->undoStack.pop_front();
+            nevicted++;
+        }
+        this->nevicted += nevicted;
+        return nevicted;
+    }
+
+    UndoMemoryStats undoMemoryStats() const
+    {
+        UndoMemoryStats out;
+        out.nundo = this->undoStack.size();
+        out.nredo = this->redoStack.size();
+        for (const Entry& e : this->undoStack) {
+            out.ncompressed += e.isCompressed;
+        }
+        for (const Entry& e : this->redoStack) {
+            out.ncompressed += e.isCompressed;
+        }
+        out.undoBytes = this->undoBytes;
+        out.redoBytes = this->redoBytes;
+        out.nevicted = this->nevicted;
+        return out;
+    }
+
     Undoer() { }
     virtual ~Undoer() { }
 
 protected:
-    virtual T getCheckpoint()
+    virtual Delta takeDelta()
     {
-        return *(T*)(this);
+        return T::takeDelta();
     };
-    virtual void setCheckpoint(T state)
+    virtual void applyDelta(const Delta& delta, bool forward)
     {
-        *(T*)(this) = state;
+        T::applyDelta(delta, forward);
     };
 
 private:
+    // a step of the undo or redo stack. Cold steps are held compressed.
+    struct Entry {
+        Delta delta; // valid if `!isCompressed`.
+        std::string compressed; // compressed serialization of `delta`, if `isCompressed`.
+        int rawLen = 0; // length of the serialization, if `isCompressed`.
+        bool isCompressed = false;
+        size_t nbytes = 0; // memory held by the entry.
+    };
+
     bool inUndoRedo = false; // if we are performing undo/redo.
-    std::stack<T> undoStack; // stack of undos.
-    std::stack<T> redoStack; // stack of redos.
+    bool hasMemento = false; // if a memento has been made. The first one has no delta.
+    uint64_t mementoHash = 0; // `stateHash()` of the state at the top of the `undoStack`.
+    // stacks of undos and redos, with the top at the back.
+    std::deque<Entry> undoStack;
+    std::deque<Entry> redoStack;
+    size_t undoBytes = 0; // sum of `nbytes` of the `undoStack`.
+    size_t redoBytes = 0;
+    size_t undoBudget = UNDO_BUDGET_PER_FILE_BYTES;
+    int nevicted = 0;
     // make it greater than `0.1` seconds so it is 2x the perceptible limit
     // for humans. So it is a pause, but not necessarily a long one.
-    Debouncer debouncer = Debouncer(std::chrono::seconds(0), 
+    Debouncer debouncer = Debouncer(std::chrono::seconds(0),
         std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::milliseconds(150)));
-};
 
+    void pushUndo(Delta delta)
+    {
+        pushEntry(&this->undoStack, &this->undoBytes, std::move(delta));
+        this->evictUndoHistory(this->undoBudget);
+    }
+
+    void pushRedo(Delta delta)
+    {
+        pushEntry(&this->redoStack, &this->redoBytes, std::move(delta));
+    }
+
+    // push `delta`, and compress the step that just went cold.
+    static void pushEntry(std::deque<Entry>* stack, size_t* nbytes, Delta delta)
+    {
+        Entry e;
+        e.nbytes = sizeof(Entry) + delta.nbytes();
+        e.delta = std::move(delta);
+        *nbytes += e.nbytes;
+        stack->push_back(std::move(e));
+        if ((int)stack->size() > UNDO_NHOT_ENTRIES) {
+            Entry& cold = (*stack)[stack->size() - 1 - UNDO_NHOT_ENTRIES];
+            *nbytes -= cold.nbytes;
+            compressEntry(&cold);
+            *nbytes += cold.nbytes;
+        }
+    }
+
+    static Delta popEntry(std::deque<Entry>* stack, size_t* nbytes)
+    {
+        Entry e = std::move(stack->back());
+        stack->pop_back();
+        *nbytes -= e.nbytes;
+        if (!e.isCompressed) {
+            return std::move(e.delta);
+        }
+        std::string raw(e.rawLen, '\0');
+        Delta out;
+        const bool ok = lzDecompress(e.compressed.data(), e.compressed.size(), &raw[0], raw.size())
+            && Delta::deserialize(raw.data(), raw.data() + raw.size(), &out);
+        assert(ok && "corrupt undo history");
+        return out;
+    }
+
+    // compress the step, if that saves memory.
+    static void compressEntry(Entry* e)
+    {
+        if (e->isCompressed) {
+            return;
+        }
+        std::string raw;
+        e->delta.serialize(&raw);
+        std::string compressed;
+        lzCompress(raw.data(), raw.size(), &compressed);
+        compressed.shrink_to_fit();
+        const size_t nbytes = sizeof(Entry) + compressed.capacity();
+        if (nbytes >= e->nbytes) {
+            return;
+        }
+        e->delta = Delta();
+        e->compressed = std::move(compressed);
+        e->rawLen = raw.size();
+        e->isCompressed = true;
+        e->nbytes = nbytes;
+    }
+};
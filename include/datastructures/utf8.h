@@ -1,29 +1,38 @@
 #pragma once
 #include <assert.h>
+#include <stdint.h>
+
+// x86-64 always has SSE2. AVX2 kernels are compiled with a target attribute
+// and only called if the CPU reports support at runtime.
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define UTF8_HAVE_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+// return whether `c` is a continuation byte (10xxxxxx) of a multi-byte code point.
+// Every byte that is *not* a continuation byte begins a new code point.
+static bool utf8_is_continuation_byte(char c)
+{
+    return (c & 0xC0) == 0x80;
+}
 
 // return the length (in _buf) of the next code point.
 static int utf8_next_code_point_len(const char* str)
 {
     assert(str);
-    char c = str[0];
-    const bool b7 = c & (1 << 7);
-    const bool b6 = c & (1 << 6);
-    const bool b5 = c & (1 << 5);
-    const bool b4 = c & (1 << 4);
-    const bool b3 = c & (1 << 3);
-    if (b7 == 0) {
-        return 1;
-    } else if (b7 == 1 && b6 == 1 && b5 == 0) {
-        return 2;
-    } else if (b7 == 1 && b6 == 1 && b5 == 1 && b4 == 0) {
-        return 3;
-    } else if (b7 == 1 && b6 == 1 && b5 == 1 && b4 == 1 && b3 == 0) {
-        return 4;
-    } else {
-        assert(false && "unknown UTF-8 width");
-    }
-    assert(false && "unknown UTF-8 width");
-    return 0;
+    // indexed by the top 5 bits of the lead byte. `0` marks bytes that cannot
+    // begin a code point (continuation bytes, and 11111xxx).
+    static const int8_t LEN_BY_TOP5[32] = {
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0xxxxxxx
+        0, 0, 0, 0, 0, 0, 0, 0, // 10xxxxxx
+        2, 2, 2, 2, // 110xxxxx
+        3, 3, // 1110xxxx
+        4, // 11110xxx
+        0 // 11111xxx
+    };
+    const int len = LEN_BY_TOP5[(unsigned char)str[0] >> 3];
+    assert(len != 0 && "unknown UTF-8 width");
+    return len;
 };
 
 // return the pointer to the next code point.
@@ -33,6 +42,18 @@ static const char* utf8_next_code_point(const char* str)
     return str + utf8_next_code_point_len(str);
 }
 
+// return the byte index at which the code point that ends right before `ix`
+// begins. That is, step back from `ix` over continuation bytes.
+// Invariant: `ix > 0`.
+static int utf8_prev_code_point_begin(const char* str, int ix)
+{
+    assert(ix > 0);
+    do {
+        ix--;
+    } while (ix > 0 && utf8_is_continuation_byte(str[ix]));
+    return ix;
+}
+
 // return the length (in _buf) of the previous code point at index `ix`.
 // If incomplete, then returns `0`.
 // byte1    | byte2    |  byte3   | byte4    |
@@ -43,75 +64,365 @@ static const char* utf8_next_code_point(const char* str)
 static int utf8_prev_code_point_len(const char* str, int ix)
 {
     assert(ix >= 0);
-    int c0 = str[ix];
-    const bool b0_7 = c0 & (1 << 7);
-    const bool b0_6 = c0 & (1 << 6);
-    if (b0_7 == 0) {
-        // 0xxxxxxx
-        // ^~~~~ix
-        return 1;
-    }
-    assert(b0_7);
-    assert(b0_6 == 0);
-    // 10xxxxxx
-    // ^~~~~ix
-
-    // ### it is at least 2 characters long.
-    assert(ix >= 1);
-    unsigned char c1 = str[ix - 1];
-    const bool b1_7 = c1 & (1 << 7);
-    const bool b1_6 = c1 & (1 << 6);
-    const bool b1_5 = c1 & (1 << 5);
-    assert(b1_7);
-    // 1xxxxxxxx; 10xxxxxx
-    //            ^~~~~ix
-    if (b1_6) {
-        // 11xxxxxx ; 10xxxxxx
-        //            ^~~~~ix
-        assert(b1_5 == 0);
-        // 110xxxxx ; 10xxxxxx
-        //            ^~~~~ix
+    const int begin = utf8_prev_code_point_begin(str, ix + 1);
+    const int len = ix + 1 - begin;
+    // the lead byte we stopped at must agree with the number of bytes we skipped.
+    assert(len == utf8_next_code_point_len(str + begin));
+    return len;
+};
+
+// decode the code point that begins at `str`.
+static uint32_t utf8_decode_code_point(const char* str)
+{
+    const unsigned char* s = (const unsigned char*)str;
+    switch (utf8_next_code_point_len(str)) {
+    case 1:
+        return s[0];
+    case 2:
+        return ((s[0] & 0x1F) << 6) | (s[1] & 0x3F);
+    case 3:
+        return ((s[0] & 0x0F) << 12) | ((s[1] & 0x3F) << 6) | (s[2] & 0x3F);
+    default:
+        return ((s[0] & 0x07) << 18) | ((s[1] & 0x3F) << 12) | ((s[2] & 0x3F) << 6) | (s[3] & 0x3F);
+    }
+}
+
+struct Utf8CodePointRange {
+    uint32_t lo;
+    uint32_t hi; // inclusive.
+};
+
+// return whether `cp` lies in one of the sorted, disjoint `ranges`.
+static bool utf8_code_point_in_ranges(uint32_t cp, const Utf8CodePointRange* ranges, int n)
+{
+    int lo = 0, hi = n - 1;
+    while (lo <= hi) {
+        const int mid = (lo + hi) / 2;
+        if (cp < ranges[mid].lo) {
+            hi = mid - 1;
+        } else if (cp > ranges[mid].hi) {
+            lo = mid + 1;
+        } else {
+            return true;
+        }
+    }
+    return false;
+}
+
+// combining marks, zero width spaces and variation selectors.
+static const Utf8CodePointRange UTF8_ZERO_WIDTH_RANGES[] = {
+    { 0x0300, 0x036F }, { 0x0483, 0x0489 }, { 0x0591, 0x05BD }, { 0x0610, 0x061A },
+    { 0x064B, 0x065F }, { 0x200B, 0x200F }, { 0x20D0, 0x20FF }, { 0xFE00, 0xFE0F },
+    { 0xFE20, 0xFE2F }, { 0xE0100, 0xE01EF },
+};
+
+// East Asian Wide / Fullwidth, and emoji that are presented wide by default.
+static const Utf8CodePointRange UTF8_WIDE_RANGES[] = {
+    { 0x1100, 0x115F }, { 0x231A, 0x231B }, { 0x2329, 0x232A }, { 0x23E9, 0x23EC },
+    { 0x23F0, 0x23F0 }, { 0x23F3, 0x23F3 }, { 0x25FD, 0x25FE }, { 0x2614, 0x2615 },
+    { 0x2648, 0x2653 }, { 0x267F, 0x267F }, { 0x2693, 0x2693 }, { 0x26A1, 0x26A1 },
+    { 0x26AA, 0x26AB }, { 0x26BD, 0x26BE }, { 0x26C4, 0x26C5 }, { 0x26CE, 0x26CE },
+    { 0x26D4, 0x26D4 }, { 0x26EA, 0x26EA }, { 0x26F2, 0x26F3 }, { 0x26F5, 0x26F5 },
+    { 0x26FA, 0x26FA }, { 0x26FD, 0x26FD }, { 0x2705, 0x2705 }, { 0x270A, 0x270B },
+    { 0x2728, 0x2728 }, { 0x274C, 0x274C }, { 0x274E, 0x274E }, { 0x2753, 0x2755 },
+    { 0x2757, 0x2757 }, { 0x2795, 0x2797 }, { 0x27B0, 0x27B0 }, { 0x27BF, 0x27BF },
+    { 0x2B1B, 0x2B1C }, { 0x2B50, 0x2B50 }, { 0x2B55, 0x2B55 }, { 0x2E80, 0x303E },
+    { 0x3041, 0x33FF }, { 0x3400, 0x4DBF }, { 0x4E00, 0x9FFF }, { 0xA000, 0xA4CF },
+    { 0xA960, 0xA97F }, { 0xAC00, 0xD7A3 }, { 0xF900, 0xFAFF }, { 0xFE10, 0xFE19 },
+    { 0xFE30, 0xFE6F }, { 0xFF00, 0xFF60 }, { 0xFFE0, 0xFFE6 }, { 0x16FE0, 0x16FE4 },
+    { 0x17000, 0x18AFF }, { 0x1B000, 0x1B2FF }, { 0x1F004, 0x1F004 }, { 0x1F0CF, 0x1F0CF },
+    { 0x1F18E, 0x1F18E }, { 0x1F191, 0x1F19A }, { 0x1F200, 0x1F251 }, { 0x1F300, 0x1F64F },
+    { 0x1F680, 0x1F6FF }, { 0x1F900, 0x1F9FF }, { 0x1FA70, 0x1FAFF }, { 0x20000, 0x2FFFD },
+    { 0x30000, 0x3FFFD },
+};
+
+// number of screen columns the code point at `str` occupies: `0` for
+// combining marks, `2` for wide glyphs, `1` otherwise. Tabs are the
+// caller's business, since their width depends on the column.
+static int utf8_code_point_display_width(const char* str)
+{
+    if (!(str[0] & 0x80)) {
+        return 1; // ASCII fast path.
+    }
+    const uint32_t cp = utf8_decode_code_point(str);
+    if (utf8_code_point_in_ranges(cp, UTF8_ZERO_WIDTH_RANGES,
+            sizeof(UTF8_ZERO_WIDTH_RANGES) / sizeof(UTF8_ZERO_WIDTH_RANGES[0]))) {
+        return 0;
+    }
+    if (utf8_code_point_in_ranges(cp, UTF8_WIDE_RANGES,
+            sizeof(UTF8_WIDE_RANGES) / sizeof(UTF8_WIDE_RANGES[0]))) {
         return 2;
     }
-    assert(b1_6 == 0);
-    // 10xxxxxxx; 10xxxxxx
-    //            ^~~~~ix
-
-    // ### it is at least 3 characters long.
-    assert(ix >= 2);
-    unsigned char c2 = str[ix - 2];
-    const bool b2_7 = c2 & (1 << 7);
-    const bool b2_6 = c2 & (1 << 6);
-    const bool b2_5 = c2 & (1 << 5);
-    const bool b2_4 = c2 & (1 << 4);
-    assert(b2_7);
-    // 1xxxxxx; 10xxxxxxx; 10xxxxxx
-    //                     ^~~~~ix
-    if (b2_6) {
-        assert(b2_5);
-        assert(b2_4 == 0);
-        // 1110xxxx; 10xxxxxxx; 10xxxxxx
-        //                      ^~~~~ix
-        return 3;
-    }
-    assert(b1_6 == 0);
-    // 10xxxxx; 10xxxxxxx; 10xxxxxx
-    //                     ^~~~~ix
-
-    // ### it must be 4 characters long.
-    assert(ix >= 3);
-    unsigned char c3 = str[ix - 3];
-    const bool b3_7 = c3 & (1 << 7);
-    const bool b3_6 = c3 & (1 << 6);
-    const bool b3_5 = c3 & (1 << 5);
-    const bool b3_4 = c3 & (1 << 4);
-    const bool b3_3 = c3 & (1 << 3);
-    assert(b3_7);
-    assert(b3_6);
-    assert(b3_5);
-    assert(b3_4);
-    assert(b3_3 == 0);
-    // 11110xxx; 10xxxxx; 10xxxxxxx; 10xxxxxx
-    //                                ^~~~~ix
-    return 4;
+    return 1;
+}
+
+/*** scalar kernels ***/
+
+// count the number of code points in `str[0:len)`, by counting the bytes
+// that begin a code point.
+static int utf8_count_code_points_scalar(const char* str, int len)
+{
+    int count = 0;
+    for (int i = 0; i < len; ++i) {
+        count += !utf8_is_continuation_byte(str[i]);
+    }
+    return count;
+}
+
+// return the byte index at which code point `n` of `str[0:len)` begins.
+// If `n` is the number of code points, return `len`.
+static int utf8_byte_ix_of_code_point_scalar(const char* str, int len, int n)
+{
+    for (int i = 0; i < len; ++i) {
+        if (utf8_is_continuation_byte(str[i])) {
+            continue;
+        }
+        if (n == 0) {
+            return i;
+        }
+        n--;
+    }
+    assert(n == 0 && "code point index out of bounds");
+    return len;
+}
+
+// validate the code point at `str[i]`, and return the index of the next code
+// point. Return `-1` if it is not well-formed UTF-8 (this includes overlong
+// encodings, surrogates, and code points past U+10FFFF).
+static int utf8_validate_code_point(const unsigned char* str, int len, int i)
+{
+    const unsigned char c = str[i];
+    if (c < 0x80) {
+        return i + 1;
+    }
+    int n = 0;
+    unsigned char lo = 0x80, hi = 0xBF; // bounds of the second byte.
+    if (c >= 0xC2 && c <= 0xDF) {
+        n = 2;
+    } else if (c >= 0xE0 && c <= 0xEF) {
+        n = 3;
+        if (c == 0xE0) { lo = 0xA0; } // overlong.
+        if (c == 0xED) { hi = 0x9F; } // surrogates.
+    } else if (c >= 0xF0 && c <= 0xF4) {
+        n = 4;
+        if (c == 0xF0) { lo = 0x90; } // overlong.
+        if (c == 0xF4) { hi = 0x8F; } // > U+10FFFF.
+    } else {
+        return -1;
+    }
+    if (i + n > len) {
+        return -1;
+    }
+    if (str[i + 1] < lo || str[i + 1] > hi) {
+        return -1;
+    }
+    for (int k = 2; k < n; ++k) {
+        if (!utf8_is_continuation_byte(str[i + k])) {
+            return -1;
+        }
+    }
+    return i + n;
+}
+
+// return whether `str[0:len)` is well-formed UTF-8.
+static bool utf8_validate_scalar(const char* str, int len)
+{
+    const unsigned char* s = (const unsigned char*)str;
+    for (int i = 0; i < len;) {
+        i = utf8_validate_code_point(s, len, i);
+        if (i == -1) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*** SIMD kernels ***/
+// All kernels share the same trick: a byte begins a code point iff it is not
+// of the form 10xxxxxx, i.e. iff as a *signed* byte it is > -65 (0xBF).
+// The validators skip runs of ASCII a vector at a time, and fall back to the
+// scalar validator on vectors that contain multi-byte code points.
+#ifdef UTF8_HAVE_X86_SIMD
+
+static int utf8_count_code_points_sse2(const char* str, int len)
+{
+    const __m128i lastContinuation = _mm_set1_epi8(-65);
+    int count = 0;
+    int i = 0;
+    for (; i + 16 <= len; i += 16) {
+        const __m128i x = _mm_loadu_si128((const __m128i*)(str + i));
+        const unsigned mask = _mm_movemask_epi8(_mm_cmpgt_epi8(x, lastContinuation));
+        count += __builtin_popcount(mask);
+    }
+    return count + utf8_count_code_points_scalar(str + i, len - i);
+}
+
+static int utf8_byte_ix_of_code_point_sse2(const char* str, int len, int n)
+{
+    const __m128i lastContinuation = _mm_set1_epi8(-65);
+    int i = 0;
+    for (; i + 16 <= len; i += 16) {
+        const __m128i x = _mm_loadu_si128((const __m128i*)(str + i));
+        const int c = __builtin_popcount(_mm_movemask_epi8(_mm_cmpgt_epi8(x, lastContinuation)));
+        if (c > n) {
+            break; // code point `n` begins in this vector.
+        }
+        n -= c;
+    }
+    return i + utf8_byte_ix_of_code_point_scalar(str + i, len - i, n);
+}
+
+static bool utf8_validate_sse2(const char* str, int len)
+{
+    const unsigned char* s = (const unsigned char*)str;
+    int i = 0;
+    while (i < len) {
+        if (i + 16 <= len) {
+            const __m128i x = _mm_loadu_si128((const __m128i*)(str + i));
+            if (_mm_movemask_epi8(x) == 0) {
+                i += 16; // all ASCII.
+                continue;
+            }
+        }
+        const int end = i + 16 < len ? i + 16 : len;
+        while (i < end) {
+            i = utf8_validate_code_point(s, len, i);
+            if (i == -1) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+__attribute__((target("avx2,popcnt"))) static int utf8_count_code_points_avx2(const char* str, int len)
+{
+    const __m256i lastContinuation = _mm256_set1_epi8(-65);
+    int count = 0;
+    int i = 0;
+    for (; i + 32 <= len; i += 32) {
+        const __m256i x = _mm256_loadu_si256((const __m256i*)(str + i));
+        const unsigned mask = _mm256_movemask_epi8(_mm256_cmpgt_epi8(x, lastContinuation));
+        count += __builtin_popcount(mask);
+    }
+    return count + utf8_count_code_points_scalar(str + i, len - i);
+}
+
+__attribute__((target("avx2,popcnt"))) static int utf8_byte_ix_of_code_point_avx2(const char* str, int len, int n)
+{
+    const __m256i lastContinuation = _mm256_set1_epi8(-65);
+    int i = 0;
+    for (; i + 32 <= len; i += 32) {
+        const __m256i x = _mm256_loadu_si256((const __m256i*)(str + i));
+        const int c = __builtin_popcount(_mm256_movemask_epi8(_mm256_cmpgt_epi8(x, lastContinuation)));
+        if (c > n) {
+            break; // code point `n` begins in this vector.
+        }
+        n -= c;
+    }
+    return i + utf8_byte_ix_of_code_point_scalar(str + i, len - i, n);
+}
+
+__attribute__((target("avx2"))) static bool utf8_validate_avx2(const char* str, int len)
+{
+    const unsigned char* s = (const unsigned char*)str;
+    int i = 0;
+    while (i < len) {
+        if (i + 32 <= len) {
+            const __m256i x = _mm256_loadu_si256((const __m256i*)(str + i));
+            if (_mm256_movemask_epi8(x) == 0) {
+                i += 32; // all ASCII.
+                continue;
+            }
+        }
+        const int end = i + 32 < len ? i + 32 : len;
+        while (i < end) {
+            i = utf8_validate_code_point(s, len, i);
+            if (i == -1) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+#endif // UTF8_HAVE_X86_SIMD
+
+/*** dispatch ***/
+
+enum Utf8Isa {
+    UTF8_ISA_SCALAR,
+    UTF8_ISA_SSE2,
+    UTF8_ISA_AVX2,
 };
+
+// the best instruction set available on this CPU, detected once.
+static Utf8Isa utf8_isa()
+{
+#ifdef UTF8_HAVE_X86_SIMD
+    static const Utf8Isa isa = __builtin_cpu_supports("avx2") ? UTF8_ISA_AVX2 : UTF8_ISA_SSE2;
+    return isa;
+#else
+    return UTF8_ISA_SCALAR;
+#endif
+}
+
+// count the number of code points in `str[0:len)`.
+static int utf8_count_code_points(const char* str, int len)
+{
+#ifdef UTF8_HAVE_X86_SIMD
+    switch (utf8_isa()) {
+    case UTF8_ISA_AVX2:
+        return utf8_count_code_points_avx2(str, len);
+    case UTF8_ISA_SSE2:
+        return utf8_count_code_points_sse2(str, len);
+    case UTF8_ISA_SCALAR:
+        break;
+    }
+#endif
+    return utf8_count_code_points_scalar(str, len);
+}
+
+// return the byte index at which code point `n` of `str[0:len)` begins.
+// If `n` is the number of code points, return `len`.
+static int utf8_byte_ix_of_code_point(const char* str, int len, int n)
+{
+#ifdef UTF8_HAVE_X86_SIMD
+    switch (utf8_isa()) {
+    case UTF8_ISA_AVX2:
+        return utf8_byte_ix_of_code_point_avx2(str, len, n);
+    case UTF8_ISA_SSE2:
+        return utf8_byte_ix_of_code_point_sse2(str, len, n);
+    case UTF8_ISA_SCALAR:
+        break;
+    }
+#endif
+    return utf8_byte_ix_of_code_point_scalar(str, len, n);
+}
+
+// return whether `str[0:len)` is well-formed UTF-8.
+static bool utf8_validate(const char* str, int len)
+{
+#ifdef UTF8_HAVE_X86_SIMD
+    switch (utf8_isa()) {
+    case UTF8_ISA_AVX2:
+        return utf8_validate_avx2(str, len);
+    case UTF8_ISA_SSE2:
+        return utf8_validate_sse2(str, len);
+    case UTF8_ISA_SCALAR:
+        break;
+    }
+#endif
+    return utf8_validate_scalar(str, len);
+}
+
+// count the number of UTF-16 code units needed to encode `str[0:len)`, which
+// is how LSP counts columns: code points past U+FFFF (4 byte sequences) take
+// a surrogate pair, and all others take one unit.
+static int utf8_count_utf16_code_units(const char* str, int len)
+{
+    int count = utf8_count_code_points(str, len);
+    for (int i = 0; i < len; ++i) {
+        count += (unsigned char)str[i] >= 0xF0;
+    }
+    return count;
+}
@@ -0,0 +1,7 @@
+#pragma once
+// which way bytes recorded in an LSP capture went. Stored as a byte in
+// capture files, so the values must not change.
+enum LspCaptureDirection {
+    LCD_ClientToServer = 0,
+    LCD_ServerToClient = 1,
+};
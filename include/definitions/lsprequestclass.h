@@ -0,0 +1,10 @@
+#pragma once
+// how urgent a request to the LSP server is, most urgent first. A queued
+// request is sent before every queued request of a less urgent class.
+enum LspRequestClass {
+    LRC_Interactive, // the goal and hover views that the user is looking at.
+    LRC_Goto,
+    LRC_Completion,
+    LRC_Background, // prefetches that nobody waits on yet.
+    LRC_NumClasses
+};
@@ -0,0 +1,15 @@
+#pragma once
+// what a request to the LSP server is for. At most one request of each kind
+// (other than `LRK_None`) is outstanding per document: a newer one
+// supersedes, and cancels, the previous one.
+enum LspRequestKind {
+    LRK_None, // not tracked, never cancelled.
+    LRK_PlainGoal,
+    LRK_PlainTermGoal,
+    LRK_Hover,
+    LRK_Goto,
+    LRK_Completion,
+    LRK_PrefetchPlainGoal, // the goals that `GoalPrefetcher` fetches ahead of the cursor.
+    LRK_PrefetchPlainTermGoal,
+    LRK_NumKinds
+};
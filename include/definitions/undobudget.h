@@ -0,0 +1,10 @@
+#pragma once
+#include <stddef.h>
+
+// default budgets for the memory held by undo histories: of each open file,
+// and of all of them together.
+static const size_t UNDO_BUDGET_PER_FILE_BYTES = 32 << 20;
+static const size_t UNDO_BUDGET_TOTAL_BYTES = 256 << 20;
+// the newest steps of each undo / redo stack are the likeliest to be
+// replayed, and are kept uncompressed.
+static const int UNDO_NHOT_ENTRIES = 16;
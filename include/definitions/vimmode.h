@@ -8,4 +8,5 @@ enum VimMode {
     VM_CTRLP, // mode where control-p search anything results show up.
     VM_TILDE, // mode where the editor logs its info, like the infamous quake `~`.
     VM_COMPILE, // mode where `lake build` is called.
+    VM_SEARCH, // mode where the needle to search the file for is typed, after `/`.
 };
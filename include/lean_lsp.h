@@ -110,7 +110,7 @@ struct Uri {
     {
         std::string decoded;
         decoded.resize(strlen(uri_str) + 1);
-        uri_decode(uri_str, strlen(uri_str), &decoded[0]);
+        decoded.resize(uri_decode(uri_str, strlen(uri_str), &decoded[0]));
 
         const char* FILE = "file://";
         assert(decoded.size() > strlen(FILE));
@@ -176,24 +176,11 @@ static json_object* lspCreateDidOpenTextDocumentNotifiation(TextDocumentItem ite
     return o;
 };
 
-// https://microsoft.github.io/language-server-protocol/specifications/lsp/3.17/specification/#textDocument_didChange
-static json_object* lspCreateDidChangeTextDocumentRequest(TextDocumentItem item)
+// https://microsoft.github.io/language-server-protocol/specifications/lsp/3.17/specification/#cancelRequest
+static json_object* lspCreateCancelRequestNotification(int request_id)
 {
     json_object* o = json_object_new_object();
-    // VersionedTextDocumentIdentifier
-    json_object* textDocument = json_object_new_object();
-    json_object_object_add(textDocument, "uri", json_object_new_uri(item.uri));
-    json_object_object_add(textDocument, "version", json_object_new_int(item.version));
-
-    json_object_object_add(o, "textDocument", textDocument);
-
-    json_object* contentChanges = json_object_new_array();
-
-    json_object* contentChangeEvent = json_object_new_object();
-    json_object_object_add(contentChangeEvent, "text", json_object_new_string(item.text.c_str()));
-
-    json_object_array_add(contentChanges, contentChangeEvent);
-    json_object_object_add(o, "contentChanges", contentChanges);
+    json_object_object_add(o, "id", json_object_new_int(request_id));
     return o;
 }
 
@@ -203,16 +190,16 @@ static json_object* lspCreateInitializedNotification()
     return json_object_new_object();
 }
 
-// https://microsoft.github.io/language-server-protocol/specifications/lsp/3.17/specification/#textDocument_didChange
-// static json_object *lspCreateDidCloseTextDocumentRequest(const char *uri) {
-
-//   json_object *o = json_object_new_object();
-//   // textDocumentIdentifier
-//   json_object *textDocument = json_object_new_object();
-//   json_object_object_add(textDocument, "uri", json_object_new_uri(strdup(uri)));
-//   json_object_object_add(o, "textDocument", textDocument);
-//   return o;
-// }
+// https://microsoft.github.io/language-server-protocol/specifications/lsp/3.17/specification/#textDocument_didClose
+static json_object* lspCreateDidCloseTextDocumentNotification(Uri uri)
+{
+    json_object* o = json_object_new_object();
+    // textDocumentIdentifier
+    json_object* textDocument = json_object_new_object();
+    json_object_object_add(textDocument, "uri", json_object_new_uri(uri));
+    json_object_object_add(o, "textDocument", textDocument);
+    return o;
+}
 
 // TODO: rename to JsonLspPosition.
 struct LspPosition {
@@ -242,6 +229,51 @@ static json_object* json_object_new_position(LspPosition position)
     return o;
 }
 
+static json_object* json_object_new_range(LspRange range)
+{
+    json_object* o = json_object_new_object();
+    json_object_object_add(o, "start", json_object_new_position(range.start));
+    json_object_object_add(o, "end", json_object_new_position(range.end));
+    return o;
+}
+
+// https://microsoft.github.io/language-server-protocol/specifications/lsp/3.17/specification/#textDocumentContentChangeEvent
+// replace the text in `range` by `text`. Columns of `range` count UTF-16 code units.
+struct LspContentChange {
+    std::optional<LspRange> range; // none to replace the whole document.
+    std::string text;
+
+    LspContentChange(std::optional<LspRange> range, std::string text)
+        : range(range)
+        , text(std::move(text))
+    {
+    }
+};
+
+// https://microsoft.github.io/language-server-protocol/specifications/lsp/3.17/specification/#textDocument_didChange
+// `changes` are applied in order, each to the document left by the previous one.
+static json_object* lspCreateDidChangeTextDocumentNotification(Uri uri, int version, const std::vector<LspContentChange>& changes)
+{
+    json_object* o = json_object_new_object();
+    // VersionedTextDocumentIdentifier
+    json_object* textDocument = json_object_new_object();
+    json_object_object_add(textDocument, "uri", json_object_new_uri(uri));
+    json_object_object_add(textDocument, "version", json_object_new_int(version));
+    json_object_object_add(o, "textDocument", textDocument);
+
+    json_object* contentChanges = json_object_new_array();
+    for (const LspContentChange& change : changes) {
+        json_object* contentChangeEvent = json_object_new_object();
+        if (change.range) {
+            json_object_object_add(contentChangeEvent, "range", json_object_new_range(*change.range));
+        }
+        json_object_object_add(contentChangeEvent, "text", json_object_new_string_len(change.text.data(), change.text.size()));
+        json_object_array_add(contentChanges, contentChangeEvent);
+    }
+    json_object_object_add(o, "contentChanges", contentChanges);
+    return o;
+}
+
 static LspPosition json_object_parse_position(json_object* o)
 {
     assert(o != nullptr);
@@ -40,19 +40,16 @@ struct FileConfig;
 static InfoViewTab infoViewTabCycleNext(FileConfig* f, InfoViewTab t);
 static InfoViewTab infoViewTabCyclePrevious(FileConfig* f, InfoViewTab t);
 
-// returns true if it was filled in this turn.
+// returns true if it was filled in this turn. `o` takes ownership of the
+// response, which is gone from `state` afterwards.
 static bool whenFillLspNonblockingResponse(LeanServerState& state, LspNonblockingResponse& o)
 {
     if (o.response.has_value()) {
         return false;
     }
 
-    auto it = state.request2response.find(o.request);
-    if (it != state.request2response.end()) {
-        o.response = it->second;
-        return true;
-    }
-    return false;
+    o.response = state.take_response(o.request);
+    return o.response.has_value();
 }
 
 
@@ -71,19 +68,48 @@ int editorReadKey();
 void getCursorPosition(int* rows, int* cols);
 int getWindowSize(int* rows, int* cols);
 void fileConfigInsertRowBefore(FileConfig* f, int at, const char* s, size_t len);
+// read row `row`, seeing edits to the active row.
+const abuf& fileConfigRow(FileConfig* f, int row);
+// get row `row` for mutation as an `abuf`, compacting it if it is the active row.
+abuf* fileConfigRowMut(FileConfig* f, int row);
+// make the cursor row active, with the gap at the cursor, and return it for editing.
+GapBuffer* fileConfigActivateRow(FileConfig* f);
+// compact the active row if the cursor has left it.
+void fileConfigSyncActiveRowWithCursor(FileConfig* f);
 void editorDelRow(int at);
 // Delete character at location `at`.
 // Invariant: `at in [0, row->size)`.
 bool is_space_or_tab(char c);
 void fileConfigInsertEnterKey(FileConfig* f);
 void fileConfigInsertCharBeforeCursor(FileConfig* f, int c); // 32 bit.
+void fileConfigBackspace(FileConfig* f);
+// move the cursor as the vim motion `key` (one of `hjklwb`, ...) would.
+void fileConfigMoveCursor(FileConfig* f, int key);
 void fileConfigDelChar(FileConfig* f);
 std::string fileConfigRowsToCppString(FileConfig* file);
 void fileConfigRowsToBuf(FileConfig* f, abuf* buf);
 void fileConfigDebugPrint(FileConfig* f, abuf* buf);
 void fileConfigCursorMoveWordNext(FileConfig* f);
 void fileConfigCursorMoveWordPrevious(FileConfig* f);
+// move the cursor to the next match of `needle[0:len)` after the cursor, or the
+// previous one before it if `!forward`, wrapping around the file. Matches do
+// not span rows. If `wholeWord`, a match must not be preceded or followed by
+// a letter or a digit. Return whether a match was found.
+bool fileConfigSearch(FileConfig* f, const char* needle, int len, bool forward, bool wholeWord);
+// search forward for the whole word under the cursor, like vim's `*`, and
+// remember it as the needle.
+bool fileConfigSearchWordUnderCursor(FileConfig* f);
 void fileConfigSave(FileConfig* f);
+// report saves finished by the background I/O thread. Called every tick.
+void editorTickFileSaves();
+// keep the undo histories of all open files within `g_editor.undoBudgetTotal`.
+void editorTrimUndoHistory();
+// one line per open file, describing the memory held by its undo history.
+std::vector<std::string> editorUndoMemoryReport();
+// one line per running lean server, describing the responses it holds,
+// followed by one line per request class, describing its queue, requests in
+// flight, and latency.
+std::vector<std::string> editorLspResponseReport();
 void fileConfigGotoDefinitionNonblocking(FileConfig* f);
 LspPosition cursorToLspPosition(Cursor c);
 
@@ -0,0 +1,118 @@
+#include "algorithms/loadfilerows.h"
+#include "algorithms/search.h"
+#include "datastructures/utf8.h"
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <iterator>
+#include <limits.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+// below this size, threads cost more than they save.
+static const int LOAD_FILE_ROWS_MIN_CHUNK_SIZE = 1 << 20;
+
+// a line-aligned range `[begin, end)` of the file, and the rows found in it.
+struct LoadChunk {
+    int begin = 0;
+    int end = 0;
+    std::vector<abuf> rows;
+    bool isValidUtf8 = true;
+};
+
+// copy the chunk from the mapping into the arena, then split it into rows
+// that borrow from the arena.
+static void loadChunk(const char* mapping, char* arena, LoadChunk* chunk)
+{
+    memcpy(arena + chunk->begin, mapping + chunk->begin, chunk->end - chunk->begin);
+    // chunks begin at the start of a line, so they are code point aligned.
+    chunk->isValidUtf8 = utf8_validate(arena + chunk->begin, chunk->end - chunk->begin);
+
+    for (int begin = chunk->begin; begin < chunk->end;) {
+        const int newline = search_find_byte(arena + begin, chunk->end - begin, '\n');
+        const int next = newline == -1 ? chunk->end : begin + newline + 1;
+        int end = newline == -1 ? chunk->end : begin + newline;
+        while (end > begin && arena[end - 1] == '\r') {
+            end--;
+        }
+        chunk->rows.push_back(abuf::from_borrow_buf(arena + begin, end - begin));
+        begin = next;
+    }
+}
+
+bool loadFileRows(const std::filesystem::path& path, LoadedFileRows* out)
+{
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        close(fd);
+        return false;
+    }
+    if (st.st_size > INT_MAX) {
+        close(fd);
+        errno = EFBIG; // rows are indexed with `int`s.
+        return false;
+    }
+    const int size = st.st_size;
+    if (size == 0) {
+        close(fd);
+        return true;
+    }
+
+    const char* mapping = (const char*)mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // the mapping keeps the file alive.
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+    madvise((void*)mapping, size, MADV_SEQUENTIAL);
+
+    // NOTE: rows borrow from a private copy rather than from the mapping, since
+    // truncating the file (e.g. when saving it) would turn reads of the
+    // mapping into SIGBUS.
+    out->arena = std::shared_ptr<char[]>(new char[size]);
+
+    // split the file into chunks, moving each boundary to the start of a line.
+    const int nthreads = std::max<int>(1,
+        std::min<int>(std::thread::hardware_concurrency(), size / LOAD_FILE_ROWS_MIN_CHUNK_SIZE));
+    std::vector<LoadChunk> chunks(nthreads);
+    int begin = 0;
+    for (int t = 0; t < nthreads; ++t) {
+        int end = (int)((long long)size * (t + 1) / nthreads);
+        if (t + 1 < nthreads && end > begin) {
+            const int newline = search_find_byte(mapping + end - 1, size - end + 1, '\n');
+            end = newline == -1 ? size : end + newline;
+        }
+        end = std::max<int>(begin, end);
+        chunks[t].begin = begin;
+        chunks[t].end = end;
+        begin = end;
+    }
+    assert(begin == size);
+
+    std::vector<std::thread> threads;
+    for (int t = 1; t < nthreads; ++t) {
+        threads.emplace_back(loadChunk, mapping, out->arena.get(), &chunks[t]);
+    }
+    loadChunk(mapping, out->arena.get(), &chunks[0]);
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    munmap((void*)mapping, size);
+
+    int nrows = 0;
+    for (const LoadChunk& chunk : chunks) {
+        nrows += chunk.rows.size();
+    }
+    out->rows.reserve(nrows);
+    for (LoadChunk& chunk : chunks) {
+        out->isValidUtf8 = out->isValidUtf8 && chunk.isValidUtf8;
+        std::move(chunk.rows.begin(), chunk.rows.end(), std::back_inserter(out->rows));
+    }
+    return true;
+}
@@ -0,0 +1,138 @@
+#include "algorithms/lzcompress.h"
+#include <stdint.h>
+#include <string.h>
+
+// a sequence is:
+//   token: (#literals (4 bits), match length - LZ_MIN_MATCH (4 bits)). A
+//     nibble of 15 is followed by bytes of 255 and a final byte < 255, all summed.
+//   literals
+//   offset of the match (2 bytes, little endian), absent for the final sequence.
+static const int LZ_MIN_MATCH = 4;
+static const int LZ_MAX_OFFSET = 0xFFFF;
+static const int LZ_HASH_LOG = 12;
+
+static uint32_t lzRead32(const char* p)
+{
+    uint32_t out;
+    memcpy(&out, p, 4);
+    return out;
+}
+
+static int lzHash(uint32_t x)
+{
+    return (x * 2654435761u) >> (32 - LZ_HASH_LOG);
+}
+
+// write the length `n - 15` (after a nibble of 15) as bytes of 255 and a remainder.
+static void lzWriteLenExtension(int n, std::string* out)
+{
+    n -= 15;
+    for (; n >= 255; n -= 255) {
+        out->push_back((char)255);
+    }
+    out->push_back((char)n);
+}
+
+static void lzWriteSequence(const char* literals, int nliterals, int offset, int matchLen, std::string* out)
+{
+    const int litNibble = nliterals < 15 ? nliterals : 15;
+    const int matchNibble = matchLen == 0 ? 0 : (matchLen - LZ_MIN_MATCH < 15 ? matchLen - LZ_MIN_MATCH : 15);
+    out->push_back((char)((litNibble << 4) | matchNibble));
+    if (litNibble == 15) {
+        lzWriteLenExtension(nliterals, out);
+    }
+    out->append(literals, nliterals);
+    if (matchLen == 0) {
+        return; // final sequence.
+    }
+    out->push_back((char)(offset & 0xFF));
+    out->push_back((char)(offset >> 8));
+    if (matchNibble == 15) {
+        lzWriteLenExtension(matchLen - LZ_MIN_MATCH, out);
+    }
+}
+
+void lzCompress(const char* src, int len, std::string* out)
+{
+    int table[1 << LZ_HASH_LOG];
+    for (int& pos : table) {
+        pos = -1;
+    }
+    int anchor = 0; // start of the pending literals.
+    int i = 0;
+    while (i + LZ_MIN_MATCH <= len) {
+        const uint32_t prefix = lzRead32(src + i);
+        const int h = lzHash(prefix);
+        const int candidate = table[h];
+        table[h] = i;
+        if (candidate == -1 || i - candidate > LZ_MAX_OFFSET || lzRead32(src + candidate) != prefix) {
+            i++;
+            continue;
+        }
+        int matchLen = LZ_MIN_MATCH;
+        while (i + matchLen < len && src[candidate + matchLen] == src[i + matchLen]) {
+            matchLen++;
+        }
+        lzWriteSequence(src + anchor, i - anchor, i - candidate, matchLen, out);
+        i += matchLen;
+        anchor = i;
+    }
+    lzWriteSequence(src + anchor, len - anchor, 0, 0, out);
+}
+
+// read a length extension (after a nibble of 15) into `*n`.
+static bool lzReadLenExtension(const unsigned char*& p, const unsigned char* end, int* n)
+{
+    while (true) {
+        if (p == end) {
+            return false;
+        }
+        const int b = *p++;
+        *n += b;
+        if (b != 255) {
+            return true;
+        }
+    }
+}
+
+bool lzDecompress(const char* src, int len, char* dst, int dstLen)
+{
+    const unsigned char* p = (const unsigned char*)src;
+    const unsigned char* end = p + len;
+    int o = 0;
+    while (p < end) {
+        const int token = *p++;
+        int nliterals = token >> 4;
+        if (nliterals == 15 && !lzReadLenExtension(p, end, &nliterals)) {
+            return false;
+        }
+        if (nliterals > end - p || nliterals > dstLen - o) {
+            return false;
+        }
+        memcpy(dst + o, p, nliterals);
+        p += nliterals;
+        o += nliterals;
+        if (p == end) {
+            break; // final sequence.
+        }
+        if (end - p < 2) {
+            return false;
+        }
+        const int offset = p[0] | (p[1] << 8);
+        p += 2;
+        int matchLen = token & 0xF;
+        if (matchLen == 15 && !lzReadLenExtension(p, end, &matchLen)) {
+            return false;
+        }
+        matchLen += LZ_MIN_MATCH;
+        if (offset == 0 || offset > o || matchLen > dstLen - o) {
+            return false;
+        }
+        // the match may overlap the bytes it produces, so copy forwards.
+        for (int k = 0; k < matchLen; ++k) {
+            dst[o + k] = dst[o - offset + k];
+        }
+        o += matchLen;
+    }
+    return o == dstLen;
+}
@@ -0,0 +1,141 @@
+#include "algorithms/savefilerows.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <vector>
+
+// number of `iovec`s handed to a single `writev`.
+#if defined(IOV_MAX) && IOV_MAX < 1024
+static const int SAVE_FILE_ROWS_BATCH_LEN = IOV_MAX;
+#else
+static const int SAVE_FILE_ROWS_BATCH_LEN = 1024;
+#endif
+
+// write all of `iov[0:n)`, resuming after short writes. Clobbers `iov`.
+static bool writevAll(int fd, struct iovec* iov, int n)
+{
+    while (n > 0) {
+        const ssize_t nwritten = writev(fd, iov, n);
+        if (nwritten == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        // skip the fully written iovecs, and trim the partially written one.
+        size_t rest = nwritten;
+        while (n > 0 && rest >= iov->iov_len) {
+            rest -= iov->iov_len;
+            iov++;
+            n--;
+        }
+        if (n > 0) {
+            iov->iov_base = (char*)iov->iov_base + rest;
+            iov->iov_len -= rest;
+        }
+    }
+    return true;
+}
+
+// the umask of the process, to create files with. `umask` can only be read by
+// setting it, so it is read once, at startup, before there are threads that
+// could create files in between.
+static const mode_t SAVE_FILE_ROWS_UMASK = [] {
+    const mode_t mask = umask(0);
+    umask(mask);
+    return mask;
+}();
+
+// the file that `path` names: the target of the symlink, if it is one,
+// followed through chains of links. The target need not exist.
+static std::filesystem::path resolveSymlinks(std::filesystem::path path)
+{
+    // the limit on symlinks followed when resolving a path, as `SYMLOOP_MAX`.
+    for (int i = 0; i < 40; ++i) {
+        std::error_code ec;
+        if (!std::filesystem::is_symlink(path, ec)) {
+            break;
+        }
+        const std::filesystem::path link = std::filesystem::read_symlink(path, ec);
+        if (ec) {
+            break;
+        }
+        path = link.is_absolute() ? link : path.parent_path() / link;
+    }
+    return path;
+}
+
+// fail with `errno` preserved, after removing the temporary file.
+static bool saveFileRowsAbort(int fd, const char* tmppath)
+{
+    const int err = errno;
+    if (fd != -1) {
+        close(fd);
+    }
+    unlink(tmppath);
+    errno = err;
+    return false;
+}
+
+bool saveFileRows(const std::filesystem::path& linkpath, const Rope<abuf>& rows)
+{
+    // replace the file that a symlink points to, rather than the link.
+    const std::filesystem::path path = resolveSymlinks(linkpath);
+    // the temporary file must be on the same file system for `rename` to be atomic.
+    std::string tmppath = path.parent_path() / ("." + path.filename().string() + ".save-XXXXXX");
+    const int fd = mkstemp(tmppath.data());
+    if (fd == -1) {
+        return false;
+    }
+    // keep the permissions of the file we replace. `mkstemp` creates the file
+    // as 0600, so a new file gets what `open` would have given it.
+    struct stat st;
+    if (stat(path.c_str(), &st) == 0) {
+        fchmod(fd, st.st_mode & 07777);
+    } else {
+        fchmod(fd, 0666 & ~SAVE_FILE_ROWS_UMASK);
+    }
+
+    static const char newline = '\n';
+    std::vector<struct iovec> batch;
+    batch.reserve(SAVE_FILE_ROWS_BATCH_LEN);
+    bool ok = true;
+    rows.forEach([&](int r, const abuf& row) {
+        if (!ok) {
+            return;
+        }
+        if (r > 0) {
+            batch.push_back({ (void*)&newline, 1 });
+        }
+        if (row.len() > 0) {
+            batch.push_back({ (void*)row.buf(), (size_t)row.len() });
+        }
+        if ((int)batch.size() + 2 > SAVE_FILE_ROWS_BATCH_LEN) {
+            ok = writevAll(fd, batch.data(), batch.size());
+            batch.clear();
+        }
+    });
+    ok = ok && writevAll(fd, batch.data(), batch.size());
+    if (!ok || fsync(fd) == -1) {
+        return saveFileRowsAbort(fd, tmppath.c_str());
+    }
+    if (close(fd) == -1) {
+        return saveFileRowsAbort(-1, tmppath.c_str());
+    }
+    if (rename(tmppath.c_str(), path.c_str()) == -1) {
+        return saveFileRowsAbort(-1, tmppath.c_str());
+    }
+    // persist the rename itself. The save has already happened, so failing
+    // to sync the directory is not an error.
+    const int dirfd = open(path.parent_path().c_str(), O_RDONLY | O_DIRECTORY);
+    if (dirfd != -1) {
+        fsync(dirfd);
+        close(dirfd);
+    }
+    return true;
+}
@@ -1,32 +1,35 @@
 #pragma once
 #include "datastructures/abuf.h"
+#include "algorithms/search.h"
 #include "datastructures/utf8.h"
 #include "definitions/nspacespertab.h"
+#include <algorithm>
 #include <stdarg.h>
 #include <stdio.h>
 #include <string.h>
 
-abuf::~abuf() { free(_buf); }
+abuf::~abuf()
+{
+    if (this->_ownsHeap()) {
+        free(this->_storage);
+    }
+}
 
 abuf abuf::from_steal_str(char* str)
 {
-    abuf out;
-    out._buf = str;
-    out._len = strlen(str);
-    return out;
+    return from_steal_buf(str, strlen(str));
 }
 
 abuf abuf::from_copy_str(const char* str)
 {
-    abuf out;
-    out._buf = strdup(str);
-    out._len = strlen(str);
-    return out;
+    return from_copy_buf(str, strlen(str));
 }
 
 abuf abuf::from_steal_buf(char* buf, int len)
 {
     abuf out;
+    out._storage = buf;
+    out._cap = len;
     out._buf = buf;
     out._len = len;
     return out;
@@ -39,21 +42,49 @@ abuf abuf::from_copy_buf(const char* buf, int len)
     return out;
 }
 
-abuf& abuf::operator=(const abuf& other)
+abuf abuf::from_borrow_buf(const char* buf, int len)
 {
-    _len = other._len;
+    if (len <= INLINE_CAPACITY) {
+        return from_copy_buf(buf, len); // as cheap as borrowing, and has better locality.
+    }
+    abuf out;
+    out._storage = (char*)buf;
+    out._cap = len;
+    out._buf = out._storage;
+    out._len = len;
+    out._borrowed = true;
+    return out;
+}
 
-    if (_len == 0) {
-        _buf = nullptr;
-        this->_is_dirty = other._is_dirty;
+abuf& abuf::operator=(const abuf& other)
+{
+    if (this == &other) {
         return *this;
     }
-    free(_buf);
-    _buf = (char*)malloc(sizeof(char) * _len);
-    if (_len > 0) {
-        memcpy(_buf, other._buf, _len);
+    if (other._borrowed) {
+        // the borrowed bytes are immutable, so they can be shared.
+        if (this->_ownsHeap()) {
+            free(this->_storage);
+        }
+        this->_storage = other._storage;
+        this->_cap = other._cap;
+        this->_buf = other._buf;
+        this->_borrowed = true;
+    } else {
+        // reuse our storage if it is large enough.
+        this->_dropBorrowed();
+        this->_buf = this->_storage;
+        this->_len = 0;
+        this->_reserve(other._len);
+        if (other._len > 0) {
+            memcpy(this->_buf, other._buf, other._len);
+        }
     }
+    this->_len = other._len;
     this->_is_dirty = other._is_dirty;
+    this->_ncodepoints = other._ncodepoints;
+    this->_checkpoints = other._checkpoints;
+    this->_rxCheckpoints = other._rxCheckpoints;
     return *this;
 }
 abuf::abuf(const abuf& other)
@@ -61,17 +92,138 @@ abuf::abuf(const abuf& other)
     *this = other;
 }
 
+abuf& abuf::operator=(abuf&& other) noexcept
+{
+    if (this == &other) {
+        return *this;
+    }
+    if (this->_ownsHeap()) {
+        free(this->_storage);
+    }
+    this->_moveFrom(other);
+    return *this;
+}
+
+abuf::abuf(abuf&& other) noexcept
+{
+    this->_moveFrom(other);
+}
+
+void abuf::_moveFrom(abuf& other)
+{
+    if (other._isInline()) {
+        // inline bytes cannot be stolen, but they are few.
+        this->_storage = this->_inline;
+        this->_cap = INLINE_CAPACITY;
+        this->_buf = this->_inline + (other._buf - other._inline);
+        memcpy(this->_buf, other._buf, other._len);
+    } else {
+        this->_storage = other._storage;
+        this->_cap = other._cap;
+        this->_buf = other._buf;
+    }
+    this->_borrowed = other._borrowed;
+    this->_len = other._len;
+    this->_is_dirty = other._is_dirty;
+    this->_ncodepoints = other._ncodepoints;
+    this->_checkpoints = std::move(other._checkpoints);
+    this->_rxCheckpoints = std::move(other._rxCheckpoints);
+
+    other._storage = other._inline;
+    other._cap = INLINE_CAPACITY;
+    other._buf = other._inline;
+    other._borrowed = false;
+    other._len = 0;
+    other._is_dirty = true;
+    other._indexInvalidate();
+}
+
+bool abuf::_isInline() const
+{
+    return this->_storage == this->_inline;
+}
+
+bool abuf::_ownsHeap() const
+{
+    return !this->_isInline() && !this->_borrowed;
+}
+
+void abuf::_dropBorrowed()
+{
+    if (this->_borrowed) {
+        this->_storage = this->_inline;
+        this->_cap = INLINE_CAPACITY;
+        this->_buf = this->_inline;
+        this->_len = 0;
+        this->_borrowed = false;
+    }
+}
+
+void abuf::_reserve(int nbytes)
+{
+    assert(nbytes >= 0);
+    const int head = this->_buf - this->_storage;
+    // borrowed bytes are read-only, so any write needs a copy.
+    if (!this->_borrowed && head + nbytes <= this->_cap) {
+        return;
+    }
+    // only compact if that leaves us at most half full, so that a buffer
+    // that is consumed from the front and appended to at the back does not
+    // move its bytes on every append.
+    if (!this->_borrowed && nbytes <= this->_cap / 2) {
+        memmove(this->_storage, this->_buf, this->_len);
+        this->_buf = this->_storage;
+        return;
+    }
+    const int cap = std::max<int>(nbytes, 2 * this->_cap);
+    char* storage = (char*)malloc(cap);
+    assert(storage && "unable to grow buffer");
+    if (this->_len > 0) {
+        memcpy(storage, this->_buf, this->_len);
+    }
+    if (this->_ownsHeap()) {
+        free(this->_storage);
+    }
+    this->_storage = storage;
+    this->_cap = cap;
+    this->_buf = storage;
+    this->_borrowed = false;
+}
+
+void abuf::reserve(int nbytes)
+{
+    this->_reserve(nbytes);
+}
+
+int abuf::capacity() const
+{
+    if (this->_borrowed) {
+        return 0;
+    }
+    return this->_cap - (this->_buf - this->_storage);
+}
+
+int abuf::heapCapacity() const
+{
+    return this->_ownsHeap() ? this->_cap : 0;
+}
+
 void abuf::appendbuf(const char* s, int slen)
 {
     assert(slen >= 0 && "negative length!");
     if (slen == 0) {
         return;
     }
-    this->_buf = (char*)realloc(this->_buf, this->_len + slen);
-    assert(this->_buf && "unable to append string");
+    // `s` must not alias our storage, since growing can free it.
+    assert(s + slen <= this->_storage || s >= this->_storage + this->_cap);
+    this->_reserve(this->_len + slen);
     memcpy(this->_buf + this->_len, s, slen);
     this->_len += slen;
     this->_is_dirty = true;
+    // appending does not move any existing codepoint, so only the count changes.
+    if (this->_ncodepoints != -1) {
+        this->_ncodepoints += utf8_count_code_points(s, slen);
+    }
 }
 
 void abuf::appendbuf(const abuf* other)
@@ -94,19 +246,19 @@ void abuf::prependbuf(const char* s, int slen)
     if (slen == 0) {
         return;
     }
-    this->_buf = (char*)realloc(this->_buf, this->_len + slen);
-
-    // shift data forward.
-    for (int i = 0; i < _len; ++i) {
-        this->_buf[this->_len - 1 - i] = this->_buf[this->_len + slen - 1 - i];
-    }
-
-    for (int i = 0; i < slen; ++i) {
-        this->_buf[i] = s[i];
+    assert(s + slen <= this->_storage || s >= this->_storage + this->_cap);
+    if (!this->_borrowed && this->_buf - this->_storage >= slen) {
+        // there is room before the head: grow backwards.
+        this->_buf -= slen;
+    } else {
+        this->_reserve(this->_len + slen);
+        memmove(this->_buf + slen, this->_buf, this->_len);
     }
+    memcpy(this->_buf, s, slen);
 
     this->_len += slen;
     this->_is_dirty = true;
+    this->_indexInvalidate();
 }
 
 void abuf::prependbuf(const abuf* other)
@@ -140,45 +292,35 @@ void abuf::insertCodepointBefore(Size<Codepoint> at, const char* codepoint)
     assert(at.size >= 0);
     assert(at.size <= this->_len);
 
-    // TODO: refactor by changing type to `abuf`.
-    Size<Byte> n_bufUptoAt = Size<Byte>(0);
-    for (Ix<Codepoint> i(0); i < at; i++) {
-        n_bufUptoAt += this->getCodepointBytesAt(i);
-    }
+    const Size<Byte> n_bufUptoAt(this->_byteIxOfCodepoint(at.size));
 
     const Size<Byte> nNew_buf(utf8_next_code_point_len(codepoint));
-    this->_buf = (char*)realloc(this->_buf, this->_len + nNew_buf.size);
-
-    for (int oldix = this->_len - 1; oldix >= n_bufUptoAt.size; oldix--) {
-        // push _buf from `i` into `i + nNew_buf`.
-        this->_buf[oldix + nNew_buf.size] = this->_buf[oldix];
-    }
+    this->_reserve(this->_len + nNew_buf.size);
 
+    // push _buf from `i` into `i + nNew_buf`.
+    memmove(this->_buf + n_bufUptoAt.size + nNew_buf.size,
+        this->_buf + n_bufUptoAt.size,
+        this->_len - n_bufUptoAt.size);
     // copy new _buf into into location.
-    for (int i = 0; i < nNew_buf.size; ++i) {
-        this->_buf[n_bufUptoAt.size + i] = codepoint[i];
-    }
+    memcpy(this->_buf + n_bufUptoAt.size, codepoint, nNew_buf.size);
     this->_len += nNew_buf.size;
     this->_is_dirty = true;
+    this->_indexEditedAt(n_bufUptoAt.size, +1);
 }
 
 void abuf::delCodepointAt(Ix<Codepoint> at)
 {
-    // TODO: refactor by changing type to `abuf`.
-    Size<Byte> startIx = Size<Byte>(0);
-    for (Ix<Codepoint> i(0); i < at; i++) {
-        startIx += this->getCodepointBytesAt(i);
-    }
-
-    const Size<Byte> ntoskip = this->getCodepointBytesAt(at);
+    const Size<Byte> startIx(this->_byteIxOfCodepoint(at.ix));
+    const Size<Byte> ntoskip(utf8_next_code_point_len(this->_buf + startIx.size));
+    this->_reserve(this->_len); // own the bytes before writing to them.
 
-    for (int i = startIx.size; i < this->_len - ntoskip.size; i++) {
-        this->_buf[i] = this->_buf[i + ntoskip.size];
-    }
+    memmove(this->_buf + startIx.size,
+        this->_buf + startIx.size + ntoskip.size,
+        this->_len - startIx.size - ntoskip.size);
+    // keep the capacity: the row is likely to grow again.
     this->_len -= ntoskip.size;
-    // resize to eliminate leftover.
-    this->_buf = (char*)realloc(this->_buf, this->_len);
     this->_is_dirty = true;
+    this->_indexEditedAt(startIx.size, -1);
 }
 
 // append a sequence of n UTF-8 codepoints.
@@ -240,24 +382,22 @@ std::string abuf::to_std_string() const
 // Return `-1` otherwise.
 int abuf::find_sub_buf(const char* findbuf, int findbuf_len, int begin_ix) const
 {
-    for (int i = begin_ix; i < this->_len; ++i) {
-        int match_len = 0;
-        while (i + match_len < this->_len && match_len < findbuf_len) {
-            if (this->_buf[i + match_len] == findbuf[match_len]) {
-                match_len++;
-            } else {
-                break;
-            }
-        }
-        // we matched, return index.
-        if (match_len == findbuf_len) {
-            return i;
-        }
-    };
-    // no match, return -1;
-    return -1;
+    assert(begin_ix >= 0);
+    if (begin_ix >= this->_len) {
+        return -1;
+    }
+    const int ix = search_find(this->_buf + begin_ix, this->_len - begin_ix, findbuf, findbuf_len);
+    return ix == -1 ? -1 : begin_ix + ix;
 };
 
+// Return last index `i` such that `i + len <= end_ix` and `buf[i:i+len] = s[0:len]`.
+// Return `-1` otherwise.
+int abuf::rfind_sub_buf(const char* findbuf, int findbuf_len, int end_ix) const
+{
+    assert(end_ix >= 0);
+    return search_rfind(this->_buf, std::min<int>(end_ix, this->_len), findbuf, findbuf_len);
+}
+
 // Return first index `i >= begin_ix` such that `buf[i:i+len] = s[0:len]`.
 // Return `-1` otherwise.
 int abuf::find_substr(const char* findstr, int begin_ix) const
@@ -267,7 +407,12 @@ int abuf::find_substr(const char* findstr, int begin_ix) const
 
 // Return first index `i >= begin_ix` such that `buf[i] = c`.
 // Return `-1` otherwise.
-int abuf::find_char(char c, int begin_ix) const { return find_sub_buf(&c, 1, begin_ix); }
+int abuf::find_char(char c, int begin_ix) const
+{
+    assert(begin_ix >= 0);
+    const int ix = search_find_byte(this->_buf + begin_ix, this->_len - begin_ix, c);
+    return ix == -1 ? -1 : begin_ix + ix;
+}
 
 // append a string onto this string.
 void abuf::appendstr(const char* s)
@@ -294,12 +439,15 @@ void abuf::appendfmtstr(int len, const char* fmt, ...)
 void abuf::dropNBytesMut(int drop_len)
 {
     assert(drop_len >= 0);
-    char* bnew = (char*)malloc(sizeof(char) * (_len - drop_len));
-    memcpy(bnew, this->_buf + drop_len, this->_len - drop_len);
-    free(this->_buf);
-    this->_buf = bnew;
+    assert(drop_len <= this->_len);
+    // advance the head rather than moving the tail.
+    this->_buf += drop_len;
     this->_len -= drop_len;
+    if (this->_len == 0) {
+        this->_buf = this->_storage;
+    }
     this->_is_dirty = true;
+    this->_indexInvalidate();
 }
 
 int abuf::len() const
@@ -346,14 +494,79 @@ Size<Byte> abuf::nbytes() const
 
 Size<Codepoint> abuf::ncodepoints() const
 {
-    int count = 0;
-    int ix = 0;
-    while (ix < this->_len) {
-        ix += utf8_next_code_point_len(this->_buf + ix);
-        count++;
+    if (this->_ncodepoints == -1) {
+        this->_ncodepoints = utf8_count_code_points(this->_buf, this->_len);
     }
-    assert(ix == this->_len);
-    return Size<Codepoint>(count);
+    return Size<Codepoint>(this->_ncodepoints);
+}
+
+int abuf::_byteIxOfCodepoint(int ix) const
+{
+    assert(ix >= 0);
+    assert(ix <= this->ncodepoints().size);
+    if (ix == this->ncodepoints().size) {
+        return this->_len;
+    }
+
+    // extend the materialized checkpoints till they cover `ix`.
+    const int k = ix / CHECKPOINT_STRIDE;
+    this->_extendCheckpoints(k);
+
+    // walk from the checkpoint to `ix`.
+    const int b = k == 0 ? 0 : this->_checkpoints[k - 1];
+    return b + utf8_byte_ix_of_code_point(this->_buf + b, this->_len - b, ix - k * CHECKPOINT_STRIDE);
+}
+
+void abuf::_extendCheckpoints(int k) const
+{
+    while ((int)this->_checkpoints.size() < k) {
+        const int b = this->_checkpoints.empty() ? 0 : this->_checkpoints.back();
+        this->_checkpoints.push_back(b + utf8_byte_ix_of_code_point(this->_buf + b, this->_len - b, CHECKPOINT_STRIDE));
+    }
+}
+
+void abuf::_extendRxCheckpoints(int k) const
+{
+    this->_extendCheckpoints(k);
+    while ((int)this->_rxCheckpoints.size() < k) {
+        const int j = this->_rxCheckpoints.size();
+        int rx = j == 0 ? 0 : this->_rxCheckpoints[j - 1];
+        const char* p = this->_buf + (j == 0 ? 0 : this->_checkpoints[j - 1]);
+        for (int i = 0; i < CHECKPOINT_STRIDE; ++i) {
+            rx = _rxAdvance(rx, p);
+            p += utf8_next_code_point_len(p);
+        }
+        this->_rxCheckpoints.push_back(rx);
+    }
+}
+
+int abuf::_rxAdvance(int rx, const char* p)
+{
+    if (*p == '\t') {
+        return rx + NSPACES_PER_TAB - (rx % NSPACES_PER_TAB);
+    }
+    return rx + utf8_code_point_display_width(p);
+}
+
+void abuf::_indexEditedAt(int byteIx, int delta)
+{
+    if (this->_ncodepoints != -1) {
+        this->_ncodepoints += delta;
+    }
+    // codepoints at or before `byteIx` kept their index and their offset.
+    while (!this->_checkpoints.empty() && this->_checkpoints.back() > byteIx) {
+        this->_checkpoints.pop_back();
+    }
+    if (this->_rxCheckpoints.size() > this->_checkpoints.size()) {
+        this->_rxCheckpoints.resize(this->_checkpoints.size());
+    }
+}
+
+void abuf::_indexInvalidate()
+{
+    this->_ncodepoints = -1;
+    this->_checkpoints.clear();
+    this->_rxCheckpoints.clear();
 }
 
 const char* abuf::debugToString() const
@@ -369,11 +582,7 @@ const char* abuf::debugToString() const
 const char* abuf::getCodepoint(Ix<Codepoint> ix) const
 {
     assert(ix < this->ncodepoints());
-    int delta = 0;
-    for (Ix<Codepoint> i(0); i < ix; i++) {
-        delta += utf8_next_code_point_len(this->_buf + delta);
-    }
-    return this->_buf + delta;
+    return this->_buf + this->_byteIxOfCodepoint(ix.ix);
 }
 
 // TODO: think about why we need the other version.
@@ -382,11 +591,7 @@ const char* abuf::getCodepoint(Ix<Codepoint> ix) const
 const char* abuf::getCodepoint(Size<Codepoint> sz) const
 {
     assert(sz <= this->ncodepoints());
-    int delta = 0;
-    for (Ix<Codepoint> i(0); i < sz; i++) {
-        delta += utf8_next_code_point_len(this->_buf + delta);
-    }
-    return this->_buf + delta;
+    return this->_buf + this->_byteIxOfCodepoint(sz.size);
 }
 
 // get the raw _buf. While functionally equivalent to
@@ -403,48 +608,61 @@ const char* abuf::getRawBytesPtrUnsafe() const
 // }
 Size<Byte> abuf::getBytesTill(Size<Codepoint> n) const
 {
-    Size<Byte> out(0);
-    for (Ix<Codepoint> i(0); i < n; ++i) {
-        out += getCodepointBytesAt(i);
-    }
-    return out;
+    return Size<Byte>(this->_byteIxOfCodepoint(n.size));
 }
 
 int abuf::cxToRx(Size<Codepoint> cx) const
 {
     assert(cx <= this->ncodepoints());
-    int rx = 0;
-    char* p = this->_buf;
-    for (Ix<Codepoint> j(0); j < cx; ++j) {
-        if (*p == '\t') {
-            rx += NSPACES_PER_TAB - (rx % NSPACES_PER_TAB);
-        } else {
-            rx += 1; // just 1.
-        }
-        p += this->getCodepointBytesAt(j).size;
+    // start from the last checkpoint at or before `cx`.
+    const int k = cx.size / CHECKPOINT_STRIDE;
+    this->_extendRxCheckpoints(k);
+    int rx = k == 0 ? 0 : this->_rxCheckpoints[k - 1];
+    const char* p = this->_buf + (k == 0 ? 0 : this->_checkpoints[k - 1]);
+    for (int i = k * CHECKPOINT_STRIDE; i < cx.size; ++i) {
+        rx = _rxAdvance(rx, p);
+        p += utf8_next_code_point_len(p);
     }
     return rx;
 }
 
+Size<Codepoint> abuf::rxToCx(int rx) const
+{
+    assert(rx >= 0);
+    const int n = this->ncodepoints().size;
+    // materialize checkpoints till one lies past `rx`, then binary search them.
+    while ((int)this->_rxCheckpoints.size() < n / CHECKPOINT_STRIDE
+        && (this->_rxCheckpoints.empty() || this->_rxCheckpoints.back() <= rx)) {
+        this->_extendRxCheckpoints(this->_rxCheckpoints.size() + 1);
+    }
+    const int k = std::upper_bound(this->_rxCheckpoints.begin(), this->_rxCheckpoints.end(), rx)
+        - this->_rxCheckpoints.begin();
+    int cur = k == 0 ? 0 : this->_rxCheckpoints[k - 1];
+    const char* p = this->_buf + (k == 0 ? 0 : this->_checkpoints[k - 1]);
+    for (int i = k * CHECKPOINT_STRIDE; i < n; ++i) {
+        const int next = _rxAdvance(cur, p);
+        if (next > rx) {
+            return Size<Codepoint>(i);
+        }
+        cur = next;
+        p += utf8_next_code_point_len(p);
+    }
+    return Size<Codepoint>(n);
+}
+
 // it is size, since we can ask to place the data at the *end* of the string, past the
 // final.
 void abuf::insertByte(Size<Codepoint> at, int c)
 {
     assert(at.size >= 0);
     assert(at.size <= this->_len);
-    _buf = (char*)realloc(_buf, this->_len + 1);
-
-    Size<Byte> byte_at(0);
-    for (Ix<Codepoint> i(0); i < at; ++i) {
-        byte_at += this->getCodepointBytesAt(i);
-    }
-
-    for (int i = this->_len; i >= byte_at.size + 1; i--) {
-        this->_buf[i] = this->_buf[i - 1];
-    }
+    const Size<Byte> byte_at(this->_byteIxOfCodepoint(at.size));
+    this->_reserve(this->_len + 1);
+    memmove(this->_buf + byte_at.size + 1, this->_buf + byte_at.size, this->_len - byte_at.size);
     _buf[byte_at.size] = c;
     this->_len += 1;
     this->_is_dirty = true;
+    this->_indexEditedAt(byte_at.size, utf8_is_continuation_byte(c) ? 0 : 1);
 }
 
 // set the data.
@@ -452,37 +670,65 @@ void abuf::insertByte(Size<Codepoint> at, int c)
 // TODO: force copy codepoint by codepoint.
 void abuf::setBytes(const char* buf, int len)
 {
-    this->_len = len;
-    _buf = (char*)realloc(_buf, sizeof(char) * this->_len);
-    for (int i = 0; i < len; ++i) {
-        _buf[i] = buf[i];
+    assert(buf + len <= this->_storage || buf >= this->_storage + this->_cap);
+    this->_dropBorrowed();
+    this->_buf = this->_storage;
+    this->_len = 0;
+    this->_reserve(len);
+    if (len > 0) {
+        memcpy(this->_buf, buf, len);
     }
+    this->_len = len;
     this->_is_dirty = true;
+    this->_indexInvalidate();
 }
 
 abuf abuf::takeNBytes(Size<Byte> bytes) const
 {
     assert(bytes.size >= 0);
     assert(bytes.size <= this->_len);
-    abuf buf;
-    buf._len = bytes.size;
-    buf._buf = (char*)calloc(sizeof(char), buf._len);
-    buf._is_dirty = true;
-    for (int i = 0; i < buf._len; ++i) {
-        buf._buf[i] = this->_buf[i];
-    }
-    return buf;
+    return from_copy_buf(this->_buf, bytes.size);
 };
 
 // truncate to `ncodepoints_new` codepoints.
 void abuf::truncateNCodepoints(Size<Codepoint> ncodepoints_new)
 {
     assert(ncodepoints_new <= this->ncodepoints());
-    Size<Byte> nbytes(0);
-    for (Ix<Codepoint> i(0); i < ncodepoints_new; i++) {
-        nbytes += this->getCodepointBytesAt(i);
-    }
-    this->_buf = (char*)realloc(this->_buf, nbytes.size);
+    const Size<Byte> nbytes(this->_byteIxOfCodepoint(ncodepoints_new.size));
     this->_len = nbytes.size;
     this->_is_dirty = true;
+    this->_ncodepoints = ncodepoints_new.size;
+    while (!this->_checkpoints.empty() && this->_checkpoints.back() >= nbytes.size) {
+        this->_checkpoints.pop_back();
+    }
+    if (this->_rxCheckpoints.size() > this->_checkpoints.size()) {
+        this->_rxCheckpoints.resize(this->_checkpoints.size());
+    }
+}
+
+uint64_t hashValue(const abuf& buf)
+{
+    // multiply-xorshift over 8 byte words, finished with murmur3's fmix64.
+    const char* p = buf.buf();
+    const int len = buf.len();
+    uint64_t h = 0x9E3779B97F4A7C15ull ^ (uint64_t)len;
+    int i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t w;
+        memcpy(&w, p + i, 8);
+        h = (h ^ w) * 0xFF51AFD7ED558CCDull;
+        h ^= h >> 32;
+    }
+    if (i < len) {
+        uint64_t w = 0;
+        memcpy(&w, p + i, len - i);
+        h = (h ^ w) * 0xFF51AFD7ED558CCDull;
+        h ^= h >> 32;
+    }
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ull;
+    h ^= h >> 33;
+    return h;
 }
@@ -0,0 +1,94 @@
+#include "datastructures/filesaver.h"
+#include "algorithms/savefilerows.h"
+#include <errno.h>
+
+FileSaver::~FileSaver()
+{
+    {
+        std::unique_lock<std::mutex> lock(this->_mutex);
+        this->_quit = true;
+    }
+    this->_cv.notify_all();
+    if (this->_thread.joinable()) {
+        this->_thread.join();
+    }
+}
+
+void FileSaver::save(std::filesystem::path path, Rope<abuf> rows, std::shared_ptr<char[]> arena)
+{
+    {
+        std::unique_lock<std::mutex> lock(this->_mutex);
+        if (!this->_thread.joinable()) {
+            this->_thread = std::thread(&FileSaver::_run, this);
+        }
+        bool superseded = false;
+        for (Job& job : this->_pending) {
+            if (job.path == path) {
+                job.rows = std::move(rows);
+                job.arena = std::move(arena);
+                superseded = true;
+                break;
+            }
+        }
+        if (!superseded) {
+            Job job;
+            job.path = std::move(path);
+            job.rows = std::move(rows);
+            job.arena = std::move(arena);
+            this->_pending.push_back(std::move(job));
+        }
+    }
+    this->_cv.notify_all();
+}
+
+bool FileSaver::pollFinished(FileSaveResult* out)
+{
+    Job job;
+    {
+        std::unique_lock<std::mutex> lock(this->_mutex);
+        if (this->_finished.empty()) {
+            return false;
+        }
+        job = std::move(this->_finished.front());
+        this->_finished.pop_front();
+    }
+    *out = std::move(job.result);
+    return true; // `job` (and its snapshot) dies here, on the main thread.
+}
+
+int FileSaver::ninflight()
+{
+    std::unique_lock<std::mutex> lock(this->_mutex);
+    return this->_pending.size() + (this->_busy ? 1 : 0);
+}
+
+void FileSaver::drain()
+{
+    std::unique_lock<std::mutex> lock(this->_mutex);
+    this->_cv.wait(lock, [this] { return this->_pending.empty() && !this->_busy; });
+}
+
+void FileSaver::_run()
+{
+    std::unique_lock<std::mutex> lock(this->_mutex);
+    while (true) {
+        this->_cv.wait(lock, [this] { return this->_quit || !this->_pending.empty(); });
+        if (this->_pending.empty()) {
+            assert(this->_quit);
+            return;
+        }
+        Job job = std::move(this->_pending.front());
+        this->_pending.pop_front();
+        this->_busy = true;
+
+        lock.unlock();
+        job.result.path = job.path;
+        job.result.ok = saveFileRows(job.path, job.rows);
+        job.result.err = job.result.ok ? 0 : errno;
+        lock.lock();
+
+        this->_busy = false;
+        this->_finished.push_back(std::move(job));
+        this->_cv.notify_all();
+    }
+}
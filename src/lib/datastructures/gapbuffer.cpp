@@ -0,0 +1,127 @@
+#include "datastructures/gapbuffer.h"
+#include "datastructures/utf8.h"
+#include <algorithm>
+#include <string.h>
+
+GapBuffer GapBuffer::fromAbuf(const abuf& row, Size<Codepoint> at)
+{
+    GapBuffer out;
+    out._reserveGap(row.len());
+    out._insertAtGap(row.buf(), row.len());
+    out.moveGapTo(at);
+    return out;
+}
+
+abuf GapBuffer::toAbuf() const
+{
+    abuf out;
+    out.reserve(this->nbytes().size);
+    out.appendbuf(this->_data.data(), this->_gapBegin);
+    out.appendbuf(this->_data.data() + this->_gapEnd, this->_data.size() - this->_gapEnd);
+    return out;
+}
+
+Size<Byte> GapBuffer::nbytes() const
+{
+    return Size<Byte>(this->_data.size() - this->_gapLen());
+}
+
+Size<Codepoint> GapBuffer::ncodepoints() const
+{
+    return Size<Codepoint>(this->_ncodepoints);
+}
+
+Size<Codepoint> GapBuffer::gapCodepoint() const
+{
+    return Size<Codepoint>(this->_gapCodepoint);
+}
+
+void GapBuffer::moveGapTo(Size<Codepoint> at)
+{
+    assert(at.size >= 0);
+    assert(at.size <= this->_ncodepoints);
+    char* data = this->_data.data();
+    while (this->_gapCodepoint > at.size) {
+        // move the codepoint before the gap to after it.
+        const int begin = utf8_prev_code_point_begin(data, this->_gapBegin);
+        const int len = this->_gapBegin - begin;
+        memmove(data + this->_gapEnd - len, data + begin, len);
+        this->_gapBegin -= len;
+        this->_gapEnd -= len;
+        this->_gapCodepoint--;
+    }
+    while (this->_gapCodepoint < at.size) {
+        // move the codepoint after the gap to before it.
+        const int len = utf8_next_code_point_len(data + this->_gapEnd);
+        memmove(data + this->_gapBegin, data + this->_gapEnd, len);
+        this->_gapBegin += len;
+        this->_gapEnd += len;
+        this->_gapCodepoint++;
+    }
+}
+
+const char* GapBuffer::beforeGap() const
+{
+    return this->_data.data();
+}
+
+Size<Byte> GapBuffer::nbytesBeforeGap() const
+{
+    return Size<Byte>(this->_gapBegin);
+}
+
+void GapBuffer::insertCodepointAtGap(const char* codepoint)
+{
+    this->_insertAtGap(codepoint, utf8_next_code_point_len(codepoint));
+}
+
+void GapBuffer::insertByteAtGap(char c)
+{
+    this->_insertAtGap(&c, 1);
+}
+
+void GapBuffer::delCodepointBeforeGap()
+{
+    assert(this->_gapCodepoint > 0);
+    this->_gapBegin = utf8_prev_code_point_begin(this->_data.data(), this->_gapBegin);
+    this->_gapCodepoint--;
+    this->_ncodepoints--;
+}
+
+void GapBuffer::delCodepointAfterGap()
+{
+    assert(this->_gapCodepoint < this->_ncodepoints);
+    this->_gapEnd += utf8_next_code_point_len(this->_data.data() + this->_gapEnd);
+    this->_ncodepoints--;
+}
+
+int GapBuffer::_gapLen() const
+{
+    return this->_gapEnd - this->_gapBegin;
+}
+
+void GapBuffer::_reserveGap(int n)
+{
+    if (this->_gapLen() >= n) {
+        return;
+    }
+    const int ntail = this->_data.size() - this->_gapEnd;
+    const int size = std::max<int>(this->_data.size() * 2, this->nbytes().size + n);
+    this->_data.resize(size);
+    // slide the text after the gap to the end of the new storage.
+    memmove(this->_data.data() + size - ntail, this->_data.data() + this->_gapEnd, ntail);
+    this->_gapEnd = size - ntail;
+}
+
+void GapBuffer::_insertAtGap(const char* s, int len)
+{
+    if (len == 0) {
+        return;
+    }
+    this->_reserveGap(len);
+    memcpy(this->_data.data() + this->_gapBegin, s, len);
+    this->_gapBegin += len;
+    const int n = utf8_count_code_points(s, len);
+    this->_gapCodepoint += n;
+    this->_ncodepoints += n;
+}
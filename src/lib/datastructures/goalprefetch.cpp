@@ -0,0 +1,198 @@
+#include "datastructures/goalprefetch.h"
+#include <algorithm>
+#include <assert.h>
+
+// the indentation of `row`, or `-1` if it is blank or a comment.
+static int leanRowIndent(std::string_view row)
+{
+    int i = 0;
+    while (i < (int)row.size() && (row[i] == ' ' || row[i] == '\t')) {
+        i++;
+    }
+    if (i == (int)row.size() || row.substr(i, 2) == "--") {
+        return -1;
+    }
+    return i;
+}
+
+// `row` without its trailing comment and whitespace.
+static std::string_view leanRowCode(std::string_view row)
+{
+    const size_t comment = row.find("--");
+    if (comment != std::string_view::npos) {
+        row = row.substr(0, comment);
+    }
+    while (!row.empty() && (row.back() == ' ' || row.back() == '\t')) {
+        row.remove_suffix(1);
+    }
+    return row;
+}
+
+// whether `code` ends with the keyword `word`.
+static bool endsWithWord(std::string_view code, std::string_view word)
+{
+    if (code.size() < word.size() || code.substr(code.size() - word.size()) != word) {
+        return false;
+    }
+    if (code.size() == word.size()) {
+        return true;
+    }
+    const char c = code[code.size() - word.size() - 1];
+    return c == ' ' || c == '\t' || c == '(';
+}
+
+static int ncodepoints(std::string_view row)
+{
+    int n = 0;
+    for (char c : row) {
+        n += ((unsigned char)c & 0xC0) != 0x80;
+    }
+    return n;
+}
+
+std::vector<Cursor> goalPrefetchTargets(int nrows, int top, int bottom, Cursor cursor,
+    const std::function<std::string_view(int)>& rowAt)
+{
+    top = std::clamp(top, 0, nrows);
+    bottom = std::clamp(bottom, top, nrows);
+    if (top == bottom) {
+        return {};
+    }
+    // start at the declaration that the window starts in, so that the
+    // blocks open at its top are known.
+    int first = top;
+    while (first > 0 && top - first < GOAL_PREFETCH_MAX_LOOKBACK && leanRowIndent(rowAt(first)) != 0) {
+        first--;
+    }
+
+    struct Block {
+        int indent;
+        bool tactic; // opened by `by`, rather than `:=`.
+    };
+    std::vector<Block> blocks;
+    // the block that the row before opens, if any.
+    std::optional<bool> opening;
+    std::vector<bool> isTactic(bottom - top, false);
+    std::vector<int> lengths(bottom - top, 0);
+    for (int r = first; r < bottom; ++r) {
+        const std::string_view row = rowAt(r);
+        if (r >= top) {
+            lengths[r - top] = ncodepoints(row);
+        }
+        const int indent = leanRowIndent(row);
+        if (indent < 0) {
+            continue;
+        }
+        while (!blocks.empty() && blocks.back().indent > indent) {
+            blocks.pop_back();
+        }
+        // deeper than the statement that opens it, which may span rows.
+        if (opening && indent > (blocks.empty() ? 0 : blocks.back().indent)) {
+            blocks.push_back(Block { indent, *opening });
+        }
+        if (r >= top) {
+            isTactic[r - top] = !blocks.empty() && blocks.back().tactic;
+        }
+        const std::string_view code = leanRowCode(row);
+        opening.reset();
+        if (endsWithWord(code, "by")) {
+            opening = true;
+        } else if (code.size() >= 2 && code.substr(code.size() - 2) == ":=") {
+            opening = false;
+        }
+    }
+
+    // outward from the cursor, one row down then one row up, carrying the
+    // column along as `j` and `k` clamp it to each row they pass.
+    const int center = std::clamp(cursor.row, top, bottom - 1);
+    int colDown = cursor.col.size;
+    int colUp = cursor.col.size;
+    if (center != cursor.row) {
+        colDown = colUp = std::min(colDown, lengths[center - top]);
+    }
+    std::vector<Cursor> out;
+    if (center != cursor.row && isTactic[center - top]) {
+        out.push_back(Cursor(center, colDown));
+    }
+    for (int d = 1; center + d < bottom || center - d >= top; ++d) {
+        if (center + d < bottom) {
+            colDown = std::min(colDown, lengths[center + d - top]);
+            if (isTactic[center + d - top]) {
+                out.push_back(Cursor(center + d, colDown));
+            }
+        }
+        if (center - d >= top) {
+            colUp = std::min(colUp, lengths[center - d - top]);
+            if (isTactic[center - d - top]) {
+                out.push_back(Cursor(center - d, colUp));
+            }
+        }
+    }
+    return out;
+}
+
+bool GoalPrefetcher::observe(Cursor cursor, int top, int version, bool editing, Clock::time_point now)
+{
+    const bool edited = editing || version != this->_version;
+    const bool moved = cursor != this->_cursor || top != this->_top;
+    if (!edited && !moved) {
+        return false;
+    }
+    this->_cursor = cursor;
+    this->_top = top;
+    this->_lastChange = now;
+    this->_planned = false;
+    this->_targets.clear();
+    if (!edited) {
+        return false; // what is in flight is still worth having.
+    }
+    this->_version = version;
+    const bool cancel = this->_inFlightAt.has_value();
+    this->_inFlightAt.reset();
+    this->plainGoal = LspNonblockingResponse();
+    this->plainTermGoal = LspNonblockingResponse();
+    return cancel;
+}
+
+bool GoalPrefetcher::idle(Clock::time_point now) const
+{
+    return now - this->_lastChange >= GOAL_PREFETCH_IDLE_DELAY;
+}
+
+void GoalPrefetcher::plan(const std::vector<Cursor>& targets)
+{
+    this->_targets.clear();
+    for (const Cursor& c : targets) {
+        if (!(this->_inFlightAt && *this->_inFlightAt == c)) {
+            this->_targets.push_back(c);
+        }
+    }
+    this->_planned = true;
+}
+
+std::optional<Cursor> GoalPrefetcher::next(Clock::time_point now)
+{
+    if (this->_inFlightAt || this->_targets.empty()) {
+        return {};
+    }
+    while (!this->_sentAt.empty() && now - this->_sentAt.front() >= std::chrono::minutes(1)) {
+        this->_sentAt.pop_front();
+    }
+    if ((int)this->_sentAt.size() + GOAL_PREFETCH_REQUESTS_PER_POSITION > GOAL_PREFETCH_BUDGET_PER_MINUTE) {
+        return {};
+    }
+    for (int i = 0; i < GOAL_PREFETCH_REQUESTS_PER_POSITION; ++i) {
+        this->_sentAt.push_back(now);
+    }
+    this->_inFlightAt = this->_targets.front();
+    this->_targets.pop_front();
+    return this->_inFlightAt;
+}
+
+void GoalPrefetcher::finish()
+{
+    assert(this->_inFlightAt);
+    this->_inFlightAt.reset();
+    this->plainGoal = LspNonblockingResponse();
+    this->plainTermGoal = LspNonblockingResponse();
+}
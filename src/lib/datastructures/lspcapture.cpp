@@ -0,0 +1,121 @@
+#include "datastructures/lspcapture.h"
+#include "datastructures/lspframer.h"
+#include <assert.h>
+#include <string.h>
+
+std::unique_ptr<LspCaptureWriter> LspCaptureWriter::open(const fs::path& path, Clock::time_point start)
+{
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file) {
+        return nullptr;
+    }
+    fwrite(LSP_CAPTURE_MAGIC, 1, sizeof(LSP_CAPTURE_MAGIC), file);
+    return std::unique_ptr<LspCaptureWriter>(new LspCaptureWriter(file, start));
+}
+
+LspCaptureWriter::LspCaptureWriter(FILE* file, Clock::time_point start)
+    : _file(file)
+    , _start(start)
+{
+}
+
+LspCaptureWriter::~LspCaptureWriter()
+{
+    fclose(this->_file);
+}
+
+void LspCaptureWriter::_writeVarint(uint64_t v)
+{
+    unsigned char buf[10];
+    int n = 0;
+    do {
+        buf[n] = v & 0x7f;
+        v >>= 7;
+        buf[n] |= v ? 0x80 : 0;
+        n++;
+    } while (v);
+    fwrite(buf, 1, n, this->_file);
+}
+
+void LspCaptureWriter::record(LspCaptureDirection dir, const char* buf, int len, Clock::time_point now)
+{
+    int64_t t = std::chrono::duration_cast<std::chrono::microseconds>(now - this->_start).count();
+    t = t < this->_lastMicros ? this->_lastMicros : t; // records are in order, even if `now` is not.
+    fputc(dir, this->_file);
+    this->_writeVarint(t - this->_lastMicros);
+    this->_writeVarint(len);
+    fwrite(buf, 1, len, this->_file);
+    this->_lastMicros = t;
+}
+
+void LspCaptureWriter::flush()
+{
+    fflush(this->_file);
+}
+
+// read a LEB128 varint from `f`. Return false at the end of the file.
+static bool readVarint(FILE* f, uint64_t* out)
+{
+    *out = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        const int c = fgetc(f);
+        if (c == EOF) {
+            return false;
+        }
+        *out |= (uint64_t)(c & 0x7f) << shift;
+        if (!(c & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool lspCaptureRead(const fs::path& path, std::vector<LspCaptureRecord>* out)
+{
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) {
+        return false;
+    }
+    char magic[sizeof(LSP_CAPTURE_MAGIC)];
+    bool ok = fread(magic, 1, sizeof(magic), f) == sizeof(magic)
+        && memcmp(magic, LSP_CAPTURE_MAGIC, sizeof(magic)) == 0;
+    int64_t t = 0;
+    while (ok) {
+        const int dir = fgetc(f);
+        if (dir == EOF) {
+            break; // a capture ends between records.
+        }
+        uint64_t dt = 0;
+        uint64_t len = 0;
+        if ((dir != LCD_ClientToServer && dir != LCD_ServerToClient)
+            || !readVarint(f, &dt) || !readVarint(f, &len) || len > (1u << 30)) {
+            ok = false;
+            break;
+        }
+        t += dt;
+        LspCaptureRecord r;
+        r.dir = (LspCaptureDirection)dir;
+        r.tMicros = t;
+        r.bytes.resize(len);
+        ok = fread(&r.bytes[0], 1, len, f) == len;
+        out->push_back(std::move(r));
+    }
+    fclose(f);
+    return ok;
+}
+
+std::vector<LspCaptureMessage> lspCaptureMessages(const std::vector<LspCaptureRecord>& records)
+{
+    std::vector<LspCaptureMessage> out;
+    LspFramer framers[2];
+    for (const LspCaptureRecord& r : records) {
+        framers[r.dir].feed(r.bytes.data(), r.bytes.size(), [&](json_object* o) {
+            LspCaptureMessage m;
+            m.dir = r.dir;
+            m.tMicros = r.tMicros;
+            m.msg = json_object_ptr(o);
+            out.push_back(std::move(m));
+        });
+    }
+    return out;
+}
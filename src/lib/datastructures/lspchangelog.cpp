@@ -0,0 +1,140 @@
+#include "datastructures/lspchangelog.h"
+#include "datastructures/utf8.h"
+
+static int utf16Len(const char* buf, int len)
+{
+    return utf8_count_utf16_code_units(buf, len);
+}
+
+void LspChangeLog::getMut(const Rope<abuf>& rows, int at)
+{
+    if (this->_openRowIx == at) {
+        return;
+    }
+    this->close(rows);
+    this->_openRowIx = at;
+    this->_openRowBefore = rows[at];
+}
+
+void LspChangeLog::close(const Rope<abuf>& rows)
+{
+    if (this->_openRowIx == -1) {
+        return;
+    }
+    this->_changeRow(this->_openRowIx, this->_openRowBefore, rows[this->_openRowIx]);
+    this->_openRowIx = -1;
+    this->_openRowBefore = abuf();
+}
+
+void LspChangeLog::replaced(const Rope<abuf>& rows, int at, const abuf* deleted, int ndeleted, int ninserted)
+{
+    assert(this->_openRowIx == -1 && "close the in-place edit first");
+    if (ndeleted == 1 && ninserted == 1) {
+        this->_changeRow(at, deleted[0], rows[at]);
+        return;
+    }
+    const int nrowsBefore = rows.size() - ninserted + ndeleted;
+    std::string text;
+    if (at + ndeleted < nrowsBefore) {
+        // the deleted rows are followed by a newline, so whole lines are replaced.
+        for (int i = 0; i < ninserted; ++i) {
+            const abuf& row = rows[at + i];
+            text.append(row.buf(), row.len());
+            text += '\n';
+        }
+        this->_push(LspContentChange(LspRange(LspPosition(at, 0), LspPosition(at + ndeleted, 0)), std::move(text)));
+        return;
+    }
+    // the deleted rows run to the end of the document, which has no trailing
+    // newline. So replace from the end of the previous row, if there is one.
+    LspPosition start(0, 0);
+    if (at > 0) {
+        const abuf& prev = rows[at - 1];
+        start = LspPosition(at - 1, utf16Len(prev.buf(), prev.len()));
+    }
+    LspPosition end = start;
+    if (ndeleted > 0) {
+        const abuf& last = deleted[ndeleted - 1];
+        end = LspPosition(at + ndeleted - 1, utf16Len(last.buf(), last.len()));
+    }
+    for (int i = 0; i < ninserted; ++i) {
+        if (at > 0 || i > 0) {
+            text += '\n';
+        }
+        const abuf& row = rows[at + i];
+        text.append(row.buf(), row.len());
+    }
+    this->_push(LspContentChange(LspRange(start, end), std::move(text)));
+}
+
+bool LspChangeLog::empty() const
+{
+    return this->_changes.empty() && !this->_changedWhole && this->_openRowIx == -1;
+}
+
+std::vector<LspContentChange> LspChangeLog::take(const Rope<abuf>& rows)
+{
+    this->close(rows);
+    std::vector<LspContentChange> out = std::move(this->_changes);
+    this->_changes.clear();
+    if (this->_changedWhole) {
+        this->_changedWhole = false;
+        std::string text;
+        rows.forEach([&](int r, const abuf& row) {
+            if (r > 0) {
+                text += '\n';
+            }
+            text.append(row.buf(), row.len());
+        });
+        out.push_back(LspContentChange(std::nullopt, std::move(text)));
+    }
+    return out;
+}
+
+void LspChangeLog::_push(LspContentChange change)
+{
+    if (this->_changedWhole) {
+        return;
+    }
+    if ((int)this->_changes.size() == LSP_CHANGELOG_MAX_CHANGES) {
+        this->_changes = {};
+        this->_changedWhole = true;
+        return;
+    }
+    this->_changes.push_back(std::move(change));
+}
+
+// change the row `at` from `before` to `after`, by replacing only the bytes
+// between their common prefix and suffix.
+void LspChangeLog::_changeRow(int at, const abuf& before, const abuf& after)
+{
+    const char* b = before.buf();
+    const char* a = after.buf();
+    const int blen = before.len();
+    const int alen = after.len();
+    const int minlen = blen < alen ? blen : alen;
+
+    int prefix = 0;
+    while (prefix < minlen && b[prefix] == a[prefix]) {
+        prefix++;
+    }
+    if (prefix == blen && prefix == alen) {
+        return; // unchanged.
+    }
+    // the ends of the changed bytes must be code point boundaries in both rows.
+    while (prefix > 0 && ((prefix < blen && utf8_is_continuation_byte(b[prefix])) || (prefix < alen && utf8_is_continuation_byte(a[prefix])))) {
+        prefix--;
+    }
+    int suffix = 0;
+    while (suffix < minlen - prefix && b[blen - 1 - suffix] == a[alen - 1 - suffix]) {
+        suffix++;
+    }
+    while (suffix > 0 && (utf8_is_continuation_byte(b[blen - suffix]) || utf8_is_continuation_byte(a[alen - suffix]))) {
+        suffix--;
+    }
+
+    const int startCol = utf16Len(b, prefix);
+    const int endCol = startCol + utf16Len(b + prefix, blen - suffix - prefix);
+    this->_push(LspContentChange(LspRange(LspPosition(at, startCol), LspPosition(at, endCol)),
+        std::string(a + prefix, alen - suffix - prefix)));
+}
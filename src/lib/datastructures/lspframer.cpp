@@ -0,0 +1,127 @@
+#include "datastructures/lspframer.h"
+#include "algorithms/search.h"
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+LspFramer::LspFramer()
+{
+    this->_tok = json_tokener_new();
+}
+
+LspFramer::~LspFramer()
+{
+    json_object_put(this->_body);
+    json_tokener_free(this->_tok);
+}
+
+int LspFramer::_feedSome(const char* buf, int len, json_object** out)
+{
+    if (this->_inBody) {
+        return this->_feedBody(buf, len, out);
+    }
+    return this->_feedHeader(buf, len);
+}
+
+// the value of a `Content-Length` field, or `-1` if it is not a number of bytes.
+static int parseContentLength(const char* s)
+{
+    while (*s == ' ' || *s == '\t') {
+        s++;
+    }
+    if (!isdigit((unsigned char)*s)) {
+        return -1; // `strtol` would take a sign.
+    }
+    errno = 0;
+    char* end = nullptr;
+    const long n = strtol(s, &end, 10);
+    while (*end == ' ' || *end == '\t') {
+        end++;
+    }
+    if (errno == ERANGE || *end != '\0' || n > INT_MAX) {
+        return -1;
+    }
+    return n;
+}
+
+// consume up to and including the next '\n', and handle the header line it ends.
+int LspFramer::_feedHeader(const char* buf, int len)
+{
+    const char* CONTENT_LENGTH_STR = "Content-Length:";
+    const int CONTENT_LENGTH_LEN = strlen(CONTENT_LENGTH_STR);
+    const int newline = search_find_byte(buf, len, '\n');
+    if (newline == -1) {
+        this->_line.append(buf, len);
+        // while resyncing, this may be a body of any size: only its end can
+        // hold the start of the next header.
+        if (this->_resyncing && (int)this->_line.size() > LSP_FRAMER_RESYNC_LINE_LEN) {
+            this->_line.erase(0, this->_line.size() - LSP_FRAMER_RESYNC_LINE_LEN);
+        }
+        return len;
+    }
+    this->_line.append(buf, newline);
+    if (!this->_line.empty() && this->_line.back() == '\r') {
+        this->_line.pop_back();
+    }
+
+    if (this->_resyncing) {
+        // skip to the next `Content-Length`, wherever it starts in the line:
+        // the body it follows need not end with a newline.
+        const int at = search_find(this->_line.data(), this->_line.size(), CONTENT_LENGTH_STR, CONTENT_LENGTH_LEN);
+        if (at == -1) {
+            this->_line.clear();
+            return newline + 1;
+        }
+        this->_line.erase(0, at);
+        this->_resyncing = false;
+    }
+
+    if (this->_line.empty()) {
+        // the blank line that ends the header.
+        if (this->_contentLength > 0) {
+            this->_inBody = true;
+            this->_bodyRemaining = this->_contentLength;
+            json_tokener_reset(this->_tok);
+        } else {
+            // an empty body is not JSON. Without a valid `Content-Length`, it
+            // is not known where the body ends: skip to the next header.
+            this->_nmalformed++;
+            this->_resyncing = this->_contentLength < 0;
+        }
+        this->_contentLength = -1;
+    } else if ((int)this->_line.size() >= CONTENT_LENGTH_LEN
+        && strncasecmp(this->_line.c_str(), CONTENT_LENGTH_STR, CONTENT_LENGTH_LEN) == 0) {
+        this->_contentLength = parseContentLength(this->_line.c_str() + CONTENT_LENGTH_LEN);
+    } // other fields, such as `Content-Type`, are ignored.
+    this->_line.clear();
+    return newline + 1;
+}
+
+int LspFramer::_feedBody(const char* buf, int len, json_object** out)
+{
+    const int n = len < this->_bodyRemaining ? len : this->_bodyRemaining;
+    if (!this->_body && !this->_bodyMalformed && n > 0) {
+        this->_body = json_tokener_parse_ex(this->_tok, buf, n);
+        if (!this->_body && json_tokener_get_error(this->_tok) != json_tokener_continue) {
+            this->_bodyMalformed = true;
+        }
+    }
+    this->_bodyRemaining -= n;
+    if (this->_bodyRemaining > 0) {
+        return n;
+    }
+
+    if (this->_body) {
+        *out = this->_body;
+    } else {
+        // an error, or a body that ended in the middle of a value.
+        this->_nmalformed++;
+    }
+    this->_body = nullptr;
+    this->_bodyMalformed = false;
+    this->_inBody = false;
+    return n;
+}
@@ -0,0 +1,71 @@
+#include "datastructures/lspgoalcache.h"
+#include <assert.h>
+#include <limits.h>
+
+int LspGoalCache::_slot(LspRequestKind kind)
+{
+    switch (kind) {
+    case LRK_PlainGoal:
+        return 0;
+    case LRK_PlainTermGoal:
+        return 1;
+    case LRK_Hover:
+        return 2;
+    default:
+        assert(false && "request kind is not about a position");
+        return 0;
+    }
+}
+
+void LspGoalCache::insert(int version, Cursor at, LspRequestKind kind, json_object_ptr response)
+{
+    if (version != this->_version || !response || !json_object_object_get_ex(response, "result", nullptr)) {
+        return;
+    }
+    const Key key(at.row, at.col.size);
+    auto it = this->_entries.find(key);
+    if (it == this->_entries.end()) {
+        if ((int)this->_entries.size() >= LSP_GOAL_CACHE_MAX_POSITIONS) {
+            this->_entries.erase(this->_lru.back());
+            this->_lru.pop_back();
+        }
+        this->_lru.push_front(key);
+        it = this->_entries.emplace(key, Entry()).first;
+        it->second.lru = this->_lru.begin();
+    } else {
+        this->_lru.splice(this->_lru.begin(), this->_lru, it->second.lru);
+    }
+    it->second.answers[_slot(kind)] = std::move(response);
+}
+
+std::optional<json_object_ptr> LspGoalCache::find(int version, Cursor at, LspRequestKind kind)
+{
+    const int slot = _slot(kind);
+    auto it = version == this->_version ? this->_entries.find(Key(at.row, at.col.size)) : this->_entries.end();
+    if (it == this->_entries.end() || !it->second.answers[slot]) {
+        this->_nmisses++;
+        return {};
+    }
+    this->_nhits++;
+    this->_lru.splice(this->_lru.begin(), this->_lru, it->second.lru);
+    return it->second.answers[slot];
+}
+
+bool LspGoalCache::contains(int version, Cursor at, LspRequestKind kind) const
+{
+    if (version != this->_version) {
+        return false;
+    }
+    auto it = this->_entries.find(Key(at.row, at.col.size));
+    return it != this->_entries.end() && it->second.answers[_slot(kind)] != nullptr;
+}
+
+void LspGoalCache::edit(int version, int firstChangedRow)
+{
+    assert(version > this->_version);
+    this->_version = version;
+    for (auto it = this->_entries.lower_bound(Key(firstChangedRow, INT_MIN)); it != this->_entries.end();) {
+        this->_lru.erase(it->second.lru);
+        it = this->_entries.erase(it);
+    }
+}
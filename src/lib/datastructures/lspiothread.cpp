@@ -0,0 +1,196 @@
+#include "datastructures/lspiothread.h"
+#include "algorithms/checkposixcall.h"
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+json_object* lspRequestCancelledResponse(LspRequestId id)
+{
+    json_object* error = json_object_new_object();
+    json_object_object_add(error, "code", json_object_new_int(LSP_REQUEST_CANCELLED));
+    json_object_object_add(error, "message", json_object_new_string("Request cancelled"));
+    json_object* o = json_object_new_object();
+    json_object_object_add(o, "jsonrpc", json_object_new_string("2.0"));
+    json_object_object_add(o, "id", json_object_new_int(id.id));
+    json_object_object_add(o, "error", error);
+    return o;
+}
+
+LspIoThread::LspIoThread(int stdoutFd, FILE* stdinFile, std::unique_ptr<LspCaptureWriter> capture)
+    : _stdoutFd(stdoutFd)
+    , _stdinFd(fileno(stdinFile))
+    , _inbound(LSP_IO_QUEUE_CAPACITY)
+    , _outbound(LSP_IO_QUEUE_CAPACITY)
+    , _capture(std::move(capture))
+{
+    CHECK_POSIX_CALL_0(pipe(this->_wakeFds));
+    // neither end may block: a wake-up that does not fit is redundant anyway.
+    for (int fd : this->_wakeFds) {
+        CHECK_POSIX_CALL_M1(fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK));
+    }
+    // only our end of the server's stdin: the server's end stays as it expects.
+    CHECK_POSIX_CALL_M1(fcntl(this->_stdinFd, F_SETFL, fcntl(this->_stdinFd, F_GETFL) | O_NONBLOCK));
+    this->_readBuf.reset(new char[LSP_IO_READ_SIZE]);
+    this->_thread = std::thread([this]() { this->_run(); });
+}
+
+LspIoThread::~LspIoThread()
+{
+    this->_quit.store(true, std::memory_order_release);
+    this->_wake();
+    this->_thread.join();
+    json_object* o = nullptr;
+    while (this->_inbound.tryPop(&o)) {
+        json_object_put(o);
+    }
+    for (json_object* b : this->_backlog) {
+        json_object_put(b);
+    }
+    close(this->_wakeFds[0]);
+    close(this->_wakeFds[1]);
+}
+
+void LspIoThread::write(std::string msg)
+{
+    LspOutboundMessage m;
+    m.raw = std::move(msg);
+    this->_pushOutbound(std::move(m));
+}
+
+void LspIoThread::send(json_object_ptr msg)
+{
+    LspOutboundMessage m;
+    m.msg = std::move(msg);
+    this->_pushOutbound(std::move(m));
+}
+
+void LspIoThread::_pushOutbound(LspOutboundMessage m)
+{
+    // the I/O thread drains the queue on every wake-up, so a full queue
+    // frees up shortly.
+    while (!this->_outbound.tryPush(std::move(m))) {
+        this->_wake();
+        std::this_thread::yield();
+    }
+    this->_wake();
+}
+
+json_object_ptr LspIoThread::tryRead()
+{
+    json_object* o = nullptr;
+    if (!this->_inbound.tryPop(&o)) {
+        return json_object_ptr();
+    }
+    return json_object_ptr(o);
+}
+
+bool LspIoThread::serverExited() const
+{
+    return this->_serverExited.load(std::memory_order_acquire);
+}
+
+void LspIoThread::_wake()
+{
+    const char c = 0;
+    (void)!::write(this->_wakeFds[1], &c, 1);
+}
+
+void LspIoThread::_run()
+{
+    // writing to a server that exited fails with `EPIPE`, rather than killing us.
+    sigset_t sigpipe;
+    sigemptyset(&sigpipe);
+    sigaddset(&sigpipe, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &sigpipe, NULL);
+
+    while (!this->_quit.load(std::memory_order_acquire)) {
+        struct pollfd fds[3] = {};
+        int nfds = 0;
+        fds[nfds].fd = this->_wakeFds[0];
+        fds[nfds++].events = POLLIN;
+        const int stdoutIx = this->_serverExited.load(std::memory_order_relaxed) ? -1 : nfds++;
+        if (stdoutIx != -1) {
+            fds[stdoutIx].fd = this->_stdoutFd;
+            fds[stdoutIx].events = POLLIN;
+        }
+        if (!this->_outbox.empty()) {
+            fds[nfds].fd = this->_stdinFd;
+            fds[nfds++].events = POLLOUT;
+        }
+        // if the UI has not made room for the backlog yet, retry shortly.
+        const int timeoutMs = this->_backlog.empty() ? -1 : 1;
+        if (poll(fds, nfds, timeoutMs) == -1 && errno != EINTR) {
+            perror("poll on lean server stdout failed");
+            abort();
+        }
+
+        char drain[64];
+        while (read(this->_wakeFds[0], drain, sizeof(drain)) > 0) { }
+        this->_writeOutbound();
+
+        if (stdoutIx != -1 && (fds[stdoutIx].revents & (POLLIN | POLLHUP | POLLERR))) {
+            this->_readStdout();
+        }
+
+        int npushed = 0;
+        while (npushed < (int)this->_backlog.size() && this->_inbound.tryPush(std::move(this->_backlog[npushed]))) {
+            npushed++;
+        }
+        this->_backlog.erase(this->_backlog.begin(), this->_backlog.begin() + npushed);
+        if (this->_capture) {
+            this->_capture->flush();
+        }
+    }
+}
+
+void LspIoThread::_writeOutbound()
+{
+    LspOutboundMessage m;
+    while (this->_outbound.tryPop(&m)) {
+        if (!this->_serverClosedStdin) {
+            this->_outbox.push(std::move(m));
+        }
+        m = LspOutboundMessage();
+    }
+    if (!this->_outbox.empty() && !this->_outbox.flush(this->_stdinFd, this->_capture.get())) {
+        this->_serverClosedStdin = true;
+    }
+    // answer the requests that the server never saw, as it would have.
+    for (LspRequestId id : this->_outbox.takeDroppedRequests()) {
+        this->_backlog.push_back(lspRequestCancelledResponse(id));
+    }
+}
+
+void LspIoThread::_readStdout()
+{
+    while (true) {
+        const int nread = read(this->_stdoutFd, this->_readBuf.get(), LSP_IO_READ_SIZE);
+        if (nread > 0) {
+            if (this->_capture) {
+                this->_capture->record(LCD_ServerToClient, this->_readBuf.get(), nread, LspCaptureWriter::Clock::now());
+            }
+            this->_framer.feed(this->_readBuf.get(), nread, [this](json_object* o) {
+                this->_backlog.push_back(o);
+            });
+            continue;
+        }
+        if (nread == 0) {
+            this->_serverExited.store(true, std::memory_order_release);
+            return;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return; // read everything there is for now.
+        }
+        perror("unable to read from stdout of child lean server");
+        abort();
+    }
+}
@@ -0,0 +1,199 @@
+#include "datastructures/lspoutbox.h"
+#include <algorithm>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+
+// `o[key]`, or null.
+static json_object* lspField(json_object* o, const char* key)
+{
+    json_object* v = NULL;
+    json_object_object_get_ex(o, key, &v);
+    return v;
+}
+
+// the method of `o`, or the empty string if it is a response.
+static const char* lspMethod(json_object* o)
+{
+    json_object* methodo = lspField(o, "method");
+    return methodo ? json_object_get_string(methodo) : "";
+}
+
+void LspOutbox::push(LspOutboundMessage m)
+{
+    Entry e;
+    if (!m.msg) {
+        e.bytes = std::move(m.raw);
+        this->_queue.push_back(std::move(e));
+        return;
+    }
+    json_object* params = lspField(m.msg, "params");
+    const char* method = lspMethod(m.msg);
+    if (strcmp(method, "$/cancelRequest") == 0 && this->_dropRequest(json_object_get_int(lspField(params, "id")))) {
+        return;
+    }
+    json_object* urio = lspField(lspField(params, "textDocument"), "uri");
+    e.document = urio ? json_object_get_string(urio) : "";
+    e.didChange = strcmp(method, "textDocument/didChange") == 0;
+    json_object* ido = lspField(m.msg, "id");
+    e.request = ido && *method ? LspRequestId(json_object_get_int(ido)) : LspRequestId(-1);
+    e.msg = std::move(m.msg);
+    this->_queue.push_back(std::move(e));
+    if (this->_queue.back().didChange) {
+        this->_mergeDidChanges(this->_queue.back().document);
+    }
+}
+
+bool LspOutbox::_dropRequest(LspRequestId id)
+{
+    for (int i = this->_queue.size() - 1; i >= 0; --i) {
+        if (this->_queue[i].msg && this->_queue[i].request == id) {
+            if (!this->_isUnstarted(i)) {
+                return false; // the server will see it, and must see the cancel.
+            }
+            const std::string document = this->_queue[i].document;
+            this->_recycle(&this->_queue[i].bytes);
+            this->_queue.erase(this->_queue.begin() + i);
+            this->_dropped.push_back(id);
+            this->_ncoalesced += 2; // with its cancel.
+            // the request may have been all that kept two `didChange`s apart.
+            this->_mergeDidChanges(document);
+            return true;
+        }
+    }
+    return false;
+}
+
+void LspOutbox::_mergeDidChanges(const std::string& document)
+{
+    if (document.empty()) {
+        return;
+    }
+    int into = -1; // the unstarted `didChange` that is the last message about the document, if any.
+    for (int i = this->_isUnstarted(0) ? 0 : 1; i < (int)this->_queue.size();) {
+        Entry& e = this->_queue[i];
+        if (!e.msg) {
+            into = -1; // may be about anything.
+        } else if (e.document == document && !e.didChange) {
+            into = -1; // would see the version in between.
+        } else if (e.document == document && into == -1) {
+            into = i;
+        } else if (e.document == document) {
+            json_object* params = lspField(e.msg, "params");
+            json_object* intoParams = lspField(this->_queue[into].msg, "params");
+            json_object* changes = lspField(params, "contentChanges");
+            json_object* intoChanges = lspField(intoParams, "contentChanges");
+            for (int j = 0; j < (int)json_object_array_length(changes); ++j) {
+                json_object_array_add(intoChanges, json_object_get(json_object_array_get_idx(changes, j)));
+            }
+            const int version = json_object_get_int(lspField(lspField(params, "textDocument"), "version"));
+            json_object_object_add(lspField(intoParams, "textDocument"), "version", json_object_new_int(version));
+            this->_recycle(&this->_queue[into].bytes); // serialized before the merge.
+            this->_recycle(&e.bytes);
+            this->_queue.erase(this->_queue.begin() + i);
+            this->_ncoalesced++;
+            continue;
+        }
+        ++i;
+    }
+}
+
+void LspOutbox::_serialize(Entry* e)
+{
+    if (!e->msg || !e->bytes.empty()) {
+        return;
+    }
+    if (!this->_pool.empty()) {
+        e->bytes = std::move(this->_pool.back());
+        this->_pool.pop_back();
+    }
+    size_t len = 0;
+    const char* body = json_object_to_json_string_length(e->msg, JSON_C_TO_STRING_PLAIN, &len);
+    char header[64];
+    const int headerLen = snprintf(header, sizeof(header), "Content-Length: %zu\r\n\r\n", len);
+    e->bytes.append(header, headerLen);
+    e->bytes.append(body, len);
+}
+
+void LspOutbox::_recycle(std::string* buf)
+{
+    if (buf->empty()) {
+        return; // never serialized.
+    }
+    if (buf->capacity() <= LSP_OUTBOX_POOL_MAX_BUFFER_SIZE && (int)this->_pool.size() < LSP_OUTBOX_POOL_SIZE) {
+        buf->clear();
+        this->_pool.push_back(std::move(*buf));
+    }
+    *buf = std::string();
+}
+
+bool LspOutbox::flush(int fd, LspCaptureWriter* capture)
+{
+    while (!this->_queue.empty()) {
+        struct iovec iov[LSP_OUTBOX_MAX_IOVECS];
+        // a message left partly written means that the server's pipe was
+        // full: write the rest of it alone, rather than serialize messages
+        // that may yet be superseded.
+        const int maxiov = std::min<int>(this->_queue.size(), this->_headWritten > 0 ? 1 : LSP_OUTBOX_MAX_IOVECS);
+        int niov = 0;
+        size_t nbytes = 0;
+        while (niov < maxiov && nbytes < LSP_OUTBOX_MAX_WRITE_SIZE) {
+            Entry& e = this->_queue[niov];
+            this->_serialize(&e);
+            const int skip = niov == 0 ? this->_headWritten : 0;
+            iov[niov].iov_base = &e.bytes[skip];
+            iov[niov].iov_len = e.bytes.size() - skip;
+            nbytes += iov[niov].iov_len;
+            niov++;
+        }
+        const ssize_t nwritten = writev(fd, iov, niov);
+        if (nwritten < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return true; // the server is busy. Try again once it reads.
+            }
+            if (errno == EPIPE) {
+                this->_queue.clear();
+                this->_headWritten = 0;
+                return false;
+            }
+            perror("unable to write to stdin of child lean server");
+            abort();
+        }
+
+        const LspCaptureWriter::Clock::time_point now = LspCaptureWriter::Clock::now();
+        ssize_t left = nwritten;
+        for (int i = 0; i < niov && left > 0; ++i) {
+            const int k = std::min<ssize_t>(left, iov[i].iov_len);
+            if (capture) {
+                capture->record(LCD_ClientToServer, (const char*)iov[i].iov_base, k, now);
+            }
+            left -= k;
+        }
+        left = nwritten;
+        while (left > 0) {
+            Entry& head = this->_queue.front();
+            const int remaining = head.bytes.size() - this->_headWritten;
+            if (left < remaining) {
+                this->_headWritten += left;
+                break;
+            }
+            left -= remaining;
+            this->_headWritten = 0;
+            this->_recycle(&head.bytes);
+            this->_queue.pop_front();
+        }
+    }
+    return true;
+}
+
+std::vector<LspRequestId> LspOutbox::takeDroppedRequests()
+{
+    std::vector<LspRequestId> out;
+    out.swap(this->_dropped);
+    return out;
+}
@@ -0,0 +1,145 @@
+#include "datastructures/lspresponsestore.h"
+#include <assert.h>
+#include <utility>
+
+LspResponseStore::LspResponseStore()
+    : _slots(LSP_RESPONSE_STORE_MIN_CAPACITY)
+{
+}
+
+// fibonacci hashing: take the top bits of the ID times 2^32 / phi.
+int LspResponseStore::_home(int id) const
+{
+    const uint32_t h = (uint32_t)id * 2654435769u;
+    return (int)(h >> (32 - __builtin_ctz(this->_slots.size())));
+}
+
+int LspResponseStore::_find(int id) const
+{
+    if (id < 0) {
+        return -1; // not a request, and would match an empty slot.
+    }
+    const int mask = this->_slots.size() - 1;
+    for (int ix = this->_home(id);; ix = (ix + 1) & mask) {
+        if (this->_slots[ix].id == id) {
+            return ix;
+        }
+        if (this->_slots[ix].id == -1) {
+            return -1;
+        }
+    }
+}
+
+void LspResponseStore::insert(LspRequestId id, json_object_ptr response, Clock::time_point now)
+{
+    assert(id.id >= 0);
+    assert(!this->contains(id));
+    // keep the load factor at most 1/2, so probe sequences stay short.
+    if (2 * (this->_size + 1) > (int)this->_slots.size()) {
+        this->_rehash(2 * this->_slots.size());
+    }
+    const int mask = this->_slots.size() - 1;
+    int ix = this->_home(id.id);
+    while (this->_slots[ix].id != -1) {
+        ix = (ix + 1) & mask;
+    }
+    this->_slots[ix].id = id.id;
+    this->_slots[ix].response = std::move(response);
+    this->_slots[ix].arrived = now;
+    this->_size++;
+}
+
+bool LspResponseStore::contains(LspRequestId id) const
+{
+    return this->_find(id.id) != -1;
+}
+
+std::optional<json_object_ptr> LspResponseStore::take(LspRequestId id)
+{
+    const int ix = this->_find(id.id);
+    if (ix == -1) {
+        return {};
+    }
+    std::optional<json_object_ptr> out(std::move(this->_slots[ix].response));
+    this->_erase(ix);
+    this->_maybeShrink();
+    return out;
+}
+
+bool LspResponseStore::drop(LspRequestId id)
+{
+    const int ix = this->_find(id.id);
+    if (ix == -1) {
+        return false;
+    }
+    this->_erase(ix);
+    this->_ndropped++;
+    this->_maybeShrink();
+    return true;
+}
+
+int LspResponseStore::expire(Clock::time_point now)
+{
+    int ndropped = 0;
+    int ix = 0;
+    while (ix < (int)this->_slots.size()) {
+        const Slot& s = this->_slots[ix];
+        if (s.id != -1 && now - s.arrived > LSP_RESPONSE_TTL) {
+            // `_erase` may shift a later slot into `ix`, so look at it again.
+            this->_erase(ix);
+            ndropped++;
+        } else {
+            ix++;
+        }
+    }
+    this->_ndropped += ndropped;
+    this->_maybeShrink();
+    return ndropped;
+}
+
+void LspResponseStore::_erase(int ix)
+{
+    const int mask = this->_slots.size() - 1;
+    this->_slots[ix].id = -1;
+    this->_slots[ix].response = json_object_ptr();
+    this->_size--;
+    // move back each following entry whose probe sequence passes `ix`, so
+    // that no lookup stops at the hole.
+    int hole = ix;
+    for (int next = (hole + 1) & mask; this->_slots[next].id != -1; next = (next + 1) & mask) {
+        const int home = this->_home(this->_slots[next].id);
+        // distance from its home to `next`, and to the hole, along the probe sequence.
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            this->_slots[hole] = std::move(this->_slots[next]);
+            this->_slots[next].id = -1;
+            hole = next;
+        }
+    }
+}
+
+void LspResponseStore::_rehash(int capacity)
+{
+    assert(capacity >= LSP_RESPONSE_STORE_MIN_CAPACITY);
+    assert((capacity & (capacity - 1)) == 0);
+    assert(2 * this->_size <= capacity);
+    std::vector<Slot> old(capacity);
+    std::swap(old, this->_slots);
+    const int mask = capacity - 1;
+    for (Slot& s : old) {
+        if (s.id == -1) {
+            continue;
+        }
+        int ix = this->_home(s.id);
+        while (this->_slots[ix].id != -1) {
+            ix = (ix + 1) & mask;
+        }
+        this->_slots[ix] = std::move(s);
+    }
+}
+
+void LspResponseStore::_maybeShrink()
+{
+    while ((int)this->_slots.size() > LSP_RESPONSE_STORE_MIN_CAPACITY && 8 * this->_size < (int)this->_slots.size()) {
+        this->_rehash(this->_slots.size() / 2);
+    }
+}
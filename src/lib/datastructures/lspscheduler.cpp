@@ -0,0 +1,133 @@
+#include "datastructures/lspscheduler.h"
+#include <algorithm>
+#include <assert.h>
+
+LspRequestClass lspRequestClassOfKind(LspRequestKind kind)
+{
+    switch (kind) {
+    case LRK_PlainGoal:
+    case LRK_PlainTermGoal:
+    case LRK_Hover:
+        return LRC_Interactive;
+    case LRK_Goto:
+        return LRC_Goto;
+    case LRK_Completion:
+        return LRC_Completion;
+    case LRK_PrefetchPlainGoal:
+    case LRK_PrefetchPlainTermGoal:
+        return LRC_Background;
+    default:
+        assert(false && "request kind has no class");
+        return LRC_Background;
+    }
+}
+
+const char* lspRequestClassName(LspRequestClass cls)
+{
+    switch (cls) {
+    case LRC_Interactive:
+        return "interactive";
+    case LRC_Goto:
+        return "goto";
+    case LRC_Completion:
+        return "completion";
+    case LRC_Background:
+        return "background";
+    default:
+        assert(false && "unknown request class");
+        return "?";
+    }
+}
+
+void LspScheduler::enqueue(LspRequestId id, LspRequestClass cls, Clock::time_point now)
+{
+    assert(cls >= 0 && cls < LRC_NumClasses);
+    Queued q;
+    q.id = id;
+    q.queuedAt = now;
+    this->_queued[cls].push_back(q);
+}
+
+bool LspScheduler::unqueue(LspRequestId id)
+{
+    for (std::deque<Queued>& queue : this->_queued) {
+        for (auto it = queue.begin(); it != queue.end(); ++it) {
+            if (it->id == id) {
+                queue.erase(it);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+std::optional<LspRequestId> LspScheduler::next(Clock::time_point now)
+{
+    for (int cls = 0; cls < LRC_NumClasses; ++cls) {
+        std::deque<Queued>& queue = this->_queued[cls];
+        if (queue.empty() || this->_ninFlight[cls] >= LSP_REQUEST_CLASS_POLICIES[cls].maxInFlight) {
+            continue;
+        }
+        const Queued q = queue.front();
+        queue.pop_front();
+        InFlight& f = this->_inFlight[q.id];
+        f.cls = (LspRequestClass)cls;
+        f.queuedAt = q.queuedAt;
+        this->_ninFlight[cls]++;
+        LspRequestClassStats& stats = this->_stats[cls];
+        stats.nsent++;
+        stats.totalWait += std::chrono::duration_cast<std::chrono::microseconds>(now - q.queuedAt);
+        return q.id;
+    }
+    return {};
+}
+
+void LspScheduler::finish(LspRequestId id, bool answered, Clock::time_point now)
+{
+    auto it = this->_inFlight.find(id);
+    if (it == this->_inFlight.end()) {
+        return;
+    }
+    const LspRequestClass cls = it->second.cls;
+    this->_ninFlight[cls]--;
+    if (answered) {
+        LspRequestClassStats& stats = this->_stats[cls];
+        const std::chrono::microseconds latency = std::chrono::duration_cast<std::chrono::microseconds>(now - it->second.queuedAt);
+        stats.nanswered++;
+        stats.totalLatency += latency;
+        stats.maxLatency = std::max(stats.maxLatency, latency);
+    }
+    this->_inFlight.erase(it);
+}
+
+std::vector<LspExpiredRequest> LspScheduler::expire(Clock::time_point now)
+{
+    std::vector<LspExpiredRequest> out;
+    for (int cls = 0; cls < LRC_NumClasses; ++cls) {
+        const Clock::time_point cutoff = now - LSP_REQUEST_CLASS_POLICIES[cls].deadline;
+        std::deque<Queued>& queue = this->_queued[cls];
+        while (!queue.empty() && queue.front().queuedAt <= cutoff) {
+            LspExpiredRequest e;
+            e.id = queue.front().id;
+            e.inFlight = false;
+            out.push_back(e);
+            this->_stats[cls].nexpired++;
+            queue.pop_front();
+        }
+    }
+    for (auto it = this->_inFlight.begin(); it != this->_inFlight.end();) {
+        const LspRequestClass cls = it->second.cls;
+        if (it->second.queuedAt > now - LSP_REQUEST_CLASS_POLICIES[cls].deadline) {
+            ++it;
+            continue;
+        }
+        LspExpiredRequest e;
+        e.id = it->first;
+        e.inFlight = true;
+        out.push_back(e);
+        this->_stats[cls].nexpired++;
+        this->_ninFlight[cls]--;
+        it = this->_inFlight.erase(it);
+    }
+    return out;
+}
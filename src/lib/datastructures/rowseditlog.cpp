@@ -0,0 +1,253 @@
+#include "datastructures/rowseditlog.h"
+#include <string.h>
+
+abuf& RowsEditLog::getMut(Rope<abuf>& rows, int at)
+{
+    if (this->_openRowIx != at) {
+        this->_closeOpenEdit(rows);
+        this->_openRowIx = at;
+        this->_openRowBefore = rows[at];
+    }
+    return rows.getMut(at);
+}
+
+void RowsEditLog::insert(Rope<abuf>& rows, int at, abuf row)
+{
+    this->_closeOpenEdit(rows);
+    RowsEdit edit;
+    edit.at = at;
+    edit.inserted.push_back(row);
+    this->_edits.push_back(std::move(edit));
+    rows.insert(at, std::move(row));
+}
+
+void RowsEditLog::erase(Rope<abuf>& rows, int at)
+{
+    this->_closeOpenEdit(rows);
+    RowsEdit edit;
+    edit.at = at;
+    edit.deleted.push_back(rows[at]);
+    this->_edits.push_back(std::move(edit));
+    rows.erase(at);
+}
+
+bool RowsEditLog::empty() const
+{
+    return this->_edits.empty() && this->_openRowIx == -1;
+}
+
+std::vector<RowsEdit> RowsEditLog::take(const Rope<abuf>& rows)
+{
+    this->_closeOpenEdit(rows);
+    std::vector<RowsEdit> out = std::move(this->_edits);
+    this->_edits.clear();
+    return out;
+}
+
+// replace `rows[at:at+n)` by `vals`.
+static void replaceRows(Rope<abuf>& rows, int at, int n, const std::vector<abuf>& vals)
+{
+    if (n == 1 && vals.size() == 1) {
+        rows.getMut(at) = vals[0];
+        return;
+    }
+    for (int i = 0; i < n; ++i) {
+        rows.erase(at);
+    }
+    for (int i = 0; i < (int)vals.size(); ++i) {
+        rows.insert(at + i, vals[i]);
+    }
+}
+
+void RowsEditLog::replay(Rope<abuf>& rows, const std::vector<RowsEdit>& edits, bool forward)
+{
+    if (forward) {
+        for (const RowsEdit& edit : edits) {
+            replay(rows, edit, forward);
+        }
+    } else {
+        for (int i = (int)edits.size() - 1; i >= 0; --i) {
+            replay(rows, edits[i], forward);
+        }
+    }
+}
+
+void RowsEditLog::replay(Rope<abuf>& rows, const RowsEdit& edit, bool forward)
+{
+    if (edit.inPlace()) {
+        const std::string& from = forward ? edit.deletedBytes : edit.insertedBytes;
+        const std::string& to = forward ? edit.insertedBytes : edit.deletedBytes;
+        const abuf& row = rows[edit.at];
+        assert(edit.byteIx + (int)from.size() <= row.len());
+        assert(memcmp(row.buf() + edit.byteIx, from.data(), from.size()) == 0);
+        const int suffix = row.len() - edit.byteIx - from.size();
+        abuf out;
+        out.reserve(edit.byteIx + to.size() + suffix);
+        out.appendbuf(row.buf(), edit.byteIx);
+        out.appendbuf(to.data(), to.size());
+        out.appendbuf(row.buf() + edit.byteIx + from.size(), suffix);
+        rows.getMut(edit.at) = std::move(out);
+        return;
+    }
+    if (forward) {
+        replaceRows(rows, edit.at, edit.deleted.size(), edit.inserted);
+    } else {
+        replaceRows(rows, edit.at, edit.inserted.size(), edit.deleted);
+    }
+}
+
+// bytes of heap memory held by `s`: none if it fits in the string itself.
+static size_t heapBytes(const std::string& s)
+{
+    return s.capacity() > std::string().capacity() ? s.capacity() + 1 : 0;
+}
+
+size_t RowsEditLog::nbytes(const std::vector<RowsEdit>& edits)
+{
+    size_t out = edits.capacity() * sizeof(RowsEdit);
+    for (const RowsEdit& edit : edits) {
+        out += heapBytes(edit.deletedBytes) + heapBytes(edit.insertedBytes);
+        out += (edit.deleted.capacity() + edit.inserted.capacity()) * sizeof(abuf);
+        for (const abuf& row : edit.deleted) {
+            out += row.heapCapacity();
+        }
+        for (const abuf& row : edit.inserted) {
+            out += row.heapCapacity();
+        }
+    }
+    return out;
+}
+
+static void serializeInt(int x, std::string* out)
+{
+    out->append((const char*)&x, sizeof(int));
+}
+
+static void serializeBytes(const std::string& bytes, std::string* out)
+{
+    serializeInt(bytes.size(), out);
+    out->append(bytes);
+}
+
+static void serializeRows(const std::vector<abuf>& rows, std::string* out)
+{
+    serializeInt(rows.size(), out);
+    for (const abuf& row : rows) {
+        serializeInt(row.len(), out);
+        out->append(row.buf(), row.len());
+    }
+}
+
+void RowsEditLog::serialize(const std::vector<RowsEdit>& edits, std::string* out)
+{
+    serializeInt(edits.size(), out);
+    for (const RowsEdit& edit : edits) {
+        serializeInt(edit.at, out);
+        serializeInt(edit.byteIx, out);
+        if (edit.inPlace()) {
+            serializeBytes(edit.deletedBytes, out);
+            serializeBytes(edit.insertedBytes, out);
+        } else {
+            serializeRows(edit.deleted, out);
+            serializeRows(edit.inserted, out);
+        }
+    }
+}
+
+static bool deserializeInt(const char** p, const char* end, int* x)
+{
+    if (end - *p < (int)sizeof(int)) {
+        return false;
+    }
+    memcpy(x, *p, sizeof(int));
+    *p += sizeof(int);
+    return true;
+}
+
+static bool deserializeBytes(const char** p, const char* end, std::string* bytes)
+{
+    int len = 0;
+    if (!deserializeInt(p, end, &len) || len < 0 || end - *p < len) {
+        return false;
+    }
+    bytes->assign(*p, len);
+    *p += len;
+    return true;
+}
+
+static bool deserializeRows(const char** p, const char* end, std::vector<abuf>* rows)
+{
+    int nrows = 0;
+    // each row takes at least its length, so a corrupt count is caught
+    // before it is allocated for.
+    if (!deserializeInt(p, end, &nrows) || nrows < 0 || nrows > (end - *p) / (int)sizeof(int)) {
+        return false;
+    }
+    rows->reserve(nrows);
+    for (int i = 0; i < nrows; ++i) {
+        int len = 0;
+        if (!deserializeInt(p, end, &len) || len < 0 || end - *p < len) {
+            return false;
+        }
+        rows->push_back(abuf::from_copy_buf(*p, len));
+        *p += len;
+    }
+    return true;
+}
+
+bool RowsEditLog::deserialize(const char** p, const char* end, std::vector<RowsEdit>* out)
+{
+    int nedits = 0;
+    // each edit takes at least its row, its byte index and two lengths.
+    if (!deserializeInt(p, end, &nedits) || nedits < 0 || nedits > (end - *p) / (4 * (int)sizeof(int))) {
+        return false;
+    }
+    out->resize(nedits);
+    for (RowsEdit& edit : *out) {
+        if (!deserializeInt(p, end, &edit.at) || !deserializeInt(p, end, &edit.byteIx) || edit.byteIx < -1) {
+            return false;
+        }
+        const bool ok = edit.inPlace()
+            ? deserializeBytes(p, end, &edit.deletedBytes) && deserializeBytes(p, end, &edit.insertedBytes)
+            : deserializeRows(p, end, &edit.deleted) && deserializeRows(p, end, &edit.inserted);
+        if (!ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// log the open in-place edit as a replacement of the bytes between the
+// common prefix and suffix of the row before and after it.
+void RowsEditLog::_closeOpenEdit(const Rope<abuf>& rows)
+{
+    if (this->_openRowIx == -1) {
+        return;
+    }
+    const abuf& before = this->_openRowBefore;
+    const abuf& after = rows[this->_openRowIx];
+    const char* b = before.buf();
+    const char* a = after.buf();
+    const int blen = before.len();
+    const int alen = after.len();
+    const int minlen = blen < alen ? blen : alen;
+
+    int prefix = 0;
+    while (prefix < minlen && b[prefix] == a[prefix]) {
+        prefix++;
+    }
+    int suffix = 0;
+    while (suffix < minlen - prefix && b[blen - 1 - suffix] == a[alen - 1 - suffix]) {
+        suffix++;
+    }
+    if (prefix != blen || prefix != alen) {
+        RowsEdit edit;
+        edit.at = this->_openRowIx;
+        edit.byteIx = prefix;
+        edit.deletedBytes.assign(b + prefix, blen - suffix - prefix);
+        edit.insertedBytes.assign(a + prefix, alen - suffix - prefix);
+        this->_edits.push_back(std::move(edit));
+    }
+    this->_openRowIx = -1;
+    this->_openRowBefore = abuf();
+}
@@ -10,7 +10,9 @@
 #include <fcntl.h>
 #include <iostream>
 #include <iterator>
+#include <limits.h>
 #include <signal.h>
+#include <sstream>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -20,9 +22,12 @@
 #include "algorithms/getfilepathamongstparents.h"
 #include "algorithms/appendcolwithcursor.h"
 #include "algorithms/checkposixcall.h"
+#include "algorithms/loadfilerows.h"
+#include "algorithms/search.h"
 #include "definitions/ctrlkey.h"
 #include "definitions/keyevent.h"
 #include "datastructures/editorconfig.h"
+#include "datastructures/utf8.h"
 #include "definitions/escapecode.h"
 #include "imgui/imgui.h"
 
@@ -57,38 +62,77 @@ void _exec_lean_server_on_child(std::optional<fs::path> lakefile_dirpath,
         subprocess_option_inherit_environment |
         subprocess_option_enable_async |
         subprocess_option_no_window | 
-        subprocess_option_search_user_path |
-        subprocess_option_enable_nonblocking;
+        subprocess_option_search_user_path;
 
-    // no lakefile.
     int failure = 1;
-    if (!lakefile_dirpath) {
-        fprintf(stderr, "starting 'lean --server'...\n");
-        const char* process_name = "lean";
-        char* const argv[] = { strdup(process_name), strdup("--server"), NULL };
-        failure = subprocess_create(NULL, argv, subprocess_options, subprocess);
-    } else {
+    // the child inherits the working directory: switch to the workspace only
+    // while it is spawned, so that the editor, and the servers spawned after
+    // this one, keep their own.
+    const fs::path editor_cwd = fs::current_path();
+    if (lakefile_dirpath) {
         std::error_code ec;
         fs::current_path(*lakefile_dirpath, ec);
         if (ec) {
             die("ERROR: unable to switch to 'lakefile.lean' directory");
         };
+    }
+    if (const char* command = getenv(LEAN_SERVER_ENV)) {
+        fprintf(stderr, "starting '%s'...\n", command);
+        std::vector<std::string> words;
+        std::istringstream in(command);
+        for (std::string word; in >> word;) {
+            words.push_back(word);
+        }
+        std::vector<const char*> argv;
+        for (const std::string& word : words) {
+            argv.push_back(word.c_str());
+        }
+        argv.push_back(NULL);
+        failure = words.empty() || subprocess_create(NULL, argv.data(), subprocess_options, subprocess);
+    } else if (!lakefile_dirpath) {
+        fprintf(stderr, "starting 'lean --server'...\n");
+        const char* process_name = "lean";
+        char* const argv[] = { strdup(process_name), strdup("--server"), NULL };
+        failure = subprocess_create(NULL, argv, subprocess_options, subprocess);
+    } else {
         const char* process_name = "lake";
         char* const argv[] = { strdup(process_name), strdup("serve"), NULL };
         failure = subprocess_create(NULL, argv, subprocess_options, subprocess);
-
+    }
+    if (lakefile_dirpath) {
+        std::error_code ec;
+        fs::current_path(editor_cwd, ec);
+        if (ec) {
+            die("ERROR: unable to switch back to '%s'", editor_cwd.c_str());
+        }
     }
 
     if (failure) {
         tilde::tildeWrite("failed to launch lean server");
         abort();
     }
+    // only our end of the pipe: `subprocess_option_enable_nonblocking` also
+    // makes the server's end non-blocking, and a server that does not expect
+    // that loses output when the pipe is full.
+    const int stdoutFd = fileno(subprocess_stdout(subprocess));
+    CHECK_POSIX_CALL_M1(fcntl(stdoutFd, F_SETFL, fcntl(stdoutFd, F_GETFL) | O_NONBLOCK));
 }
 
 
+std::optional<fs::path> leanWorkspaceDirpath(fs::path absolute_filepath)
+{
+    assert(absolute_filepath.is_absolute());
+    std::optional<fs::path> p = getFilePathAmongstParents(absolute_filepath.remove_filename(), "lakefile.lean");
+    if (!p) {
+        return {};
+    }
+    assert(p->is_absolute());
+    return p->remove_filename();
+}
+
 // create a new lean server.
-// if file_path == NULL, then create `lean --server`.
-void LeanServerState::init(std::optional<fs::path> absolute_filepath)
+// if lakefile_dirpath == NULL, then create `lean --server`.
+void LeanServerState::init(std::optional<fs::path> lakefile_dirpath)
 {
     assert(this->initialized == LeanServerInitializedKind::Uninitialized);
     this->initialized = LeanServerInitializedKind::Initializing;
@@ -97,79 +141,115 @@ void LeanServerState::init(std::optional<fs::path> absolute_filepath)
     // CHECK_POSIX_CALL_0(pipe2(this->child_stdout_to_parent_buffer, O_NONBLOCK));
     // CHECK_POSIX_CALL_0(pipe(this->child_stderr_to_parent_buffer));
 
-    if (absolute_filepath) {
-        assert(absolute_filepath->is_absolute());
-        this->lakefile_dirpath = ([&absolute_filepath]() -> std::optional<fs::path> {
-            std::optional<fs::path> p = getFilePathAmongstParents(absolute_filepath->remove_filename(), "lakefile.lean");
-            if (p) {
-                return p->remove_filename();
-            } else {
-                return {};
-            }
-        })();
-        tilde::tildeWrite("lakefile_dirpath: " + (this->lakefile_dirpath ? this->lakefile_dirpath->string() : "NO LAKEFILE"));
-        if (this->lakefile_dirpath) {
-            assert(this->lakefile_dirpath->is_absolute());
-        }
-    }
+    this->lakefile_dirpath = lakefile_dirpath;
+    tilde::tildeWrite("lakefile_dirpath: " + (this->lakefile_dirpath ? this->lakefile_dirpath->string() : "NO LAKEFILE"));
     _exec_lean_server_on_child(this->lakefile_dirpath, &this->process);
+    this->io = std::make_unique<LspIoThread>(fileno(subprocess_stdout(&this->process)),
+        subprocess_stdin(&this->process), _open_capture());
     json_object* req = lspCreateInitializeRequest();
     this->initialize_request_id = write_request_to_child_blocking("initialize", req);
 };
 
+std::unique_ptr<LspCaptureWriter> LeanServerState::_open_capture()
+{
+    static int nservers = 0;
+    const char* path = getenv(LSP_CAPTURE_ENV);
+    if (!path) {
+        return nullptr;
+    }
+    std::string capturePath = path;
+    if (nservers > 0) {
+        capturePath += "." + std::to_string(nservers);
+    }
+    nservers++;
+    std::unique_ptr<LspCaptureWriter> capture = LspCaptureWriter::open(capturePath, LspCaptureWriter::Clock::now());
+    tilde::tildeWrite("LSP capture to '%s'%s", capturePath.c_str(), capture ? "" : " failed");
+    return capture;
+}
+
 struct LspResponse {
     int content_length = -1;
     json_object* response_obj = NULL;
 };
 
-int LeanServerState::_write_str_to_child(const char* buf, int len) const
+LspRequestId LeanServerState::write_document_request_to_child_blocking(const fs::path& document,
+    const char* method, json_object* params, LspRequestKind kind)
 {
-    int nwritten = fwrite(buf, 1, len, subprocess_stdin(&this->process));
-    return nwritten;
-};
+    assert(kind != LRK_None);
+    assert(this->initialized != LeanServerInitializedKind::Uninitialized);
+    auto doc = this->documents.find(document);
+    assert(doc != this->documents.end() && doc->second.owner != -1);
+    // nobody will read the answer to the superseded request.
+    this->cancel_document_request(document, kind);
+    const LspRequestId id = this->next_request_id++;
+    doc->second.latest_request_of_kind[kind] = id;
+    LspQueuedRequest& queued = this->queued_requests[id];
+    queued.document = document;
+    queued.kind = kind;
+    queued.method = method;
+    queued.params = json_object_ptr(params);
+    const LspScheduler::Clock::time_point now = LspScheduler::Clock::now();
+    this->scheduler.enqueue(id, lspRequestClassOfKind(kind), now);
+    this->_dispatch_requests(now);
+    return id;
+}
+
+void LeanServerState::cancel_document_request(const fs::path& document, LspRequestKind kind)
+{
+    assert(kind != LRK_None);
+    auto doc = this->documents.find(document);
+    if (doc == this->documents.end()) {
+        return;
+    }
+    LspRequestId& id = doc->second.latest_request_of_kind[kind];
+    if (this->queued_requests.erase(id)) {
+        this->scheduler.unqueue(id);
+    } else if (this->pending_requests.count(id)) {
+        this->cancel_request(id);
+    } else {
+        this->responses.drop(id);
+    }
+    id = LspRequestId(-1);
+}
 
-int LeanServerState::_read_stdout_str_from_child_nonblocking()
+void LeanServerState::_dispatch_requests(LspScheduler::Clock::time_point now)
 {
-    const int BUFSIZE = 4096;
-    char buf[BUFSIZE];
-    int nread = subprocess_read_stdout_async(&this->process, buf, BUFSIZE);
-    // int nread = read(this->child_stdout_to_parent_buffer[PIPE_READ_IX], buf, BUFSIZE);
-    if (nread == -1) {
-
-        if (errno == EAGAIN) {
-            // EAGAIN = non-blocking I/O, there was no data ro read.
-            return 0;
-        }
-        die("unable to read from stdout of child lean server");
+    while (std::optional<LspRequestId> id = this->scheduler.next(now)) {
+        auto it = this->queued_requests.find(*id);
+        assert(it != this->queued_requests.end());
+        LspPendingRequest& pending = this->pending_requests[*id];
+        pending.document = it->second.document;
+        pending.kind = it->second.kind;
+        // take the request out of the queue before it is handed over: from
+        // `send` on, the I/O thread owns `params`, and must be the only one to
+        // touch it, even its reference count.
+        const std::string method = std::move(it->second.method);
+        json_object* params = it->second.params.release();
+        this->queued_requests.erase(it);
+        this->_write_request(*id, method.c_str(), params);
     }
-    this->child_stdout_buffer.appendbuf(buf, nread);
-
-    return nread;
-};
+}
 
 LspRequestId LeanServerState::write_request_to_child_blocking(const char* method, json_object* params)
 {
     // note: the first request is written before the lean server is fully initialized!
     assert(this->initialized != LeanServerInitializedKind::Uninitialized);
-    const int id = this->next_request_id++;
-    tilde::tildeWrite("LSP request (id=%d), [%s] %s", id, method, json_object_to_json_string(params));
+    const LspRequestId id = this->next_request_id++;
+    this->_write_request(id, method, params);
+    return id;
+}
+
+void LeanServerState::_write_request(LspRequestId id, const char* method, json_object* params)
+{
+    tilde::tildeWrite("LSP request (id=%d), [%s] %s", id.id, method, json_object_to_json_string(params));
     json_object* o = json_object_new_object();
     json_object_object_add(o, "jsonrpc", json_object_new_string("2.0"));
-    json_object_object_add(o, "id", json_object_new_int(id));
+    json_object_object_add(o, "id", json_object_new_int(id.id));
     json_object_object_add(o, "method", json_object_new_string(method));
     if (params) {
         json_object_object_add(o, "params", params);
     }
-
-    const char* obj_str = json_object_to_json_string(o);
-    const int obj_strlen = strlen(obj_str);
-
-    char* request_str = (char*)calloc(sizeof(char), obj_strlen + 128);
-    const int req_len = sprintf(request_str, "Content-Length: %d\r\n\r\n%s", obj_strlen, obj_str);
-    this->_write_str_to_child(request_str, req_len);
-    free(request_str);
-    json_object_put(o);
-    return LspRequestId(id);
+    this->io->send(json_object_ptr(o));
 }
 
 void LeanServerState::write_notification_to_child_blocking(const char* method, json_object* params)
@@ -181,78 +261,175 @@ void LeanServerState::write_notification_to_child_blocking(const char* method, j
     if (params) {
         json_object_object_add(o, "params", params);
     }
-
-    const char* obj_str = json_object_to_json_string(o);
-    const int obj_strlen = strlen(obj_str);
-
-    char* request_str = (char*)calloc(sizeof(char), obj_strlen + 128);
-    const int req_len = sprintf(request_str, "Content-Length: %d\r\n\r\n%s", obj_strlen, obj_str);
-    this->_write_str_to_child(request_str, req_len);
-    json_object_put(o);
-    free(request_str);
+    this->io->send(json_object_ptr(o));
 }
 
-// tries to read the next JSON record from the buffer, in a nonblocking fashion.
-json_object_ptr LeanServerState::_read_next_json_record_from_buffer_nonblocking()
+void LeanServerState::cancel_request(LspRequestId request_id)
 {
-    this->_read_stdout_str_from_child_nonblocking();
-    const char* CONTENT_LENGTH_STR = "Content-Length:";
-    const char* DOUBLE_NEWLINE_STR = "\r\n\r\n";
-
-    const int content_length_begin_ix = child_stdout_buffer.find_substr(CONTENT_LENGTH_STR, 0);
-    const int header_line_begin_ix = child_stdout_buffer.find_substr(DOUBLE_NEWLINE_STR, 0);
+    auto it = this->pending_requests.find(request_id);
+    assert(it != this->pending_requests.end());
+    this->pending_requests.erase(it);
+    this->cancelled_requests.insert(request_id);
+    // the server drops it soon: its slot can go to the next request.
+    this->scheduler.finish(request_id, false, LspScheduler::Clock::now());
+    write_notification_to_child_blocking("$/cancelRequest", lspCreateCancelRequestNotification(request_id.id));
+}
 
-    if (header_line_begin_ix == -1) {
-        return NULL;
+void LeanServerState::_cancel_document_requests(const fs::path& path)
+{
+    for (auto it = this->queued_requests.begin(); it != this->queued_requests.end();) {
+        if (it->second.document == path) {
+            this->scheduler.unqueue(it->first);
+            it = this->queued_requests.erase(it);
+        } else {
+            ++it;
+        }
     }
-    assert(content_length_begin_ix != -1);
+    for (auto it = this->pending_requests.begin(); it != this->pending_requests.end();) {
+        const auto cur = it++; // `cancel_request` erases it.
+        if (cur->second.document == path) {
+            this->cancel_request(cur->first);
+        }
+    }
+}
 
-    // yay, found content length.
-    int content_length = atoi(child_stdout_buffer.buf() + content_length_begin_ix + strlen(CONTENT_LENGTH_STR));
+bool LeanServerState::is_document_open(const fs::path& path, int owner) const
+{
+    auto it = this->documents.find(path);
+    return it != this->documents.end() && it->second.owner == owner;
+}
 
-    // we don't have enough data in the buffer to read the content length
-    const int header_line_end_ix = header_line_begin_ix + strlen(DOUBLE_NEWLINE_STR);
-    if (child_stdout_buffer.len() < header_line_end_ix + content_length) {
-        return NULL;
+int LeanServerState::claim_document(const fs::path& path, int owner)
+{
+    assert(owner != -1);
+    LeanServerDocument& doc = this->documents[path];
+    assert(doc.owner != owner);
+    if (doc.owner != -1) {
+        // another file had it open: what the server has is that file's text.
+        write_notification_to_child_blocking("textDocument/didClose",
+            lspCreateDidCloseTextDocumentNotification(Uri(path)));
     }
+    // the requests and notifications of the previous owner are not for this one.
+    this->_cancel_document_requests(path);
+    for (LspRequestId& id : doc.latest_request_of_kind) {
+        this->responses.drop(id);
+        id = LspRequestId(-1);
+    }
+    doc.notifications.clear();
+    doc.owner = owner;
+    return doc.version + 1;
+}
 
-    tilde::tildeWrite(std::string("got raw LSP response: '") + std::string(child_stdout_buffer.buf() + header_line_end_ix, content_length) + "'");
-
-    // parse.
-    json_tokener* tok = json_tokener_new(); // TODO: do not create/destroy this object each time.
-    json_object* o = json_tokener_parse_ex(tok,
-        child_stdout_buffer.buf() + header_line_end_ix, content_length);
-    assert(o != NULL);
-    json_tokener_free(tok);
+void LeanServerState::set_document_version(const fs::path& path, int version)
+{
+    auto doc = this->documents.find(path);
+    assert(doc != this->documents.end());
+    assert(version >= doc->second.version);
+    if (version == doc->second.version) {
+        return;
+    }
+    doc->second.version = version;
+    this->_cancel_document_requests(path);
+}
 
-    // drop the response from the buffer, now that we have correctly consumes the json request.
-    child_stdout_buffer.dropNBytesMut(header_line_end_ix + content_length);
+std::optional<json_object_ptr> LeanServerState::take_document_notification(const fs::path& path)
+{
+    auto doc = this->documents.find(path);
+    if (doc == this->documents.end() || doc->second.notifications.empty()) {
+        return {};
+    }
+    std::vector<json_object_ptr>& ns = doc->second.notifications;
+    json_object_ptr o = std::move(ns.front());
+    ns.erase(ns.begin());
     return o;
 }
 
+// the document that the notification `o` is about, if any.
+static std::optional<fs::path> lspNotificationDocument(json_object* o)
+{
+    json_object* paramso = NULL;
+    json_object* urio = NULL;
+    if (!json_object_object_get_ex(o, "params", &paramso)) {
+        return {};
+    }
+    if (json_object_get_type(paramso) == json_type_object) {
+        json_object* textDocumento = NULL;
+        if (json_object_object_get_ex(paramso, "textDocument", &textDocumento)) {
+            paramso = textDocumento; // `$/lean/fileProgress`
+        }
+    }
+    if (!json_object_object_get_ex(paramso, "uri", &urio) || json_object_get_type(urio) != json_type_string) {
+        return {};
+    }
+    return Uri::parse(json_object_get_string(urio));
+}
+
 void LeanServerState::tick_nonblocking()
 {
+    // the I/O thread has already framed and parsed these, so handling all of
+    // them is cheap, and a burst of notifications does not trickle in over frames.
+    const LspResponseStore::Clock::time_point now = LspResponseStore::Clock::now();
+    while (json_object_ptr o = this->io->tryRead()) {
+        json_object* response_ido = NULL;
+        if (json_object_object_get_ex(o, "id", &response_ido) && json_object_get_type(response_ido) == json_type_int) {
+            const int response_id = json_object_get_int(response_ido);
+            if (this->cancelled_requests.erase(response_id)) {
+                // either the answer, or a `RequestCancelled` error. Nobody waits on it.
+                tilde::tildeWrite("LSP dropped response to cancelled '%d'", response_id);
+                this->nresponses_dropped++;
+                this->nresponses_read++;
+                continue;
+            }
+            this->pending_requests.erase(response_id);
+            this->scheduler.finish(response_id, true, now);
+            tilde::tildeWrite("LSP response to '%d': '%s'", response_id, json_object_to_json_string(o));
+            this->responses.insert(response_id, std::move(o), now);
+            this->nresponses_read++;
+            continue;
+        }
+        tilde::tildeWrite("LSP ServerRequest: '%s'", json_object_to_json_string(o));
+        const std::optional<fs::path> path = lspNotificationDocument(o);
+        if (!path) {
+            this->unhandled_server_requests.push_back(o);
+            continue;
+        }
+        auto doc = this->documents.find(*path);
+        if (doc == this->documents.end() || doc->second.owner == -1) {
+            continue; // nobody has the document open.
+        }
+        json_object* methodo = NULL;
+        json_object_object_get_ex(o, "method", &methodo);
+        const char* method = json_object_get_string(methodo);
+        std::vector<json_object_ptr>& ns = doc->second.notifications;
+        for (auto it = ns.begin(); it != ns.end(); ++it) {
+            json_object* itMethodo = NULL;
+            json_object_object_get_ex(*it, "method", &itMethodo);
+            if (strcmp(json_object_get_string(itMethodo), method) == 0) {
+                ns.erase(it);
+                break;
+            }
+        }
+        ns.push_back(std::move(o));
+    }
 
-    // TODO: convert to std::optional.
-    json_object_ptr o_optional = _read_next_json_record_from_buffer_nonblocking();
-    if (!o_optional) {
-        return;
+    // whoever waits on a request past its deadline is told that it was cancelled.
+    for (const LspExpiredRequest& e : this->scheduler.expire(now)) {
+        tilde::tildeWrite("LSP request '%d' missed its deadline", e.id.id);
+        if (e.inFlight) {
+            this->cancel_request(e.id);
+        } else {
+            this->queued_requests.erase(e.id);
+        }
+        this->responses.insert(e.id, json_object_ptr(lspRequestCancelledResponse(e.id)), now);
     }
-    json_object* response_ido = NULL;
-    if (json_object_object_get_ex(o_optional, "id", &response_ido) && json_object_get_type(response_ido) == json_type_int) {
-        const int response_id = json_object_get_int(response_ido);
-        tilde::tildeWrite("LSP response to '%d': '%s'", response_id, json_object_to_json_string(o_optional));
-        auto it = this->request2response.find(response_id);
-        assert(it == this->request2response.end());
-        this->request2response[response_id] = o_optional;
-        this->nresponses_read++;
-    } else {
-        tilde::tildeWrite("LSP ServerRequest: '%s'", json_object_to_json_string(o_optional));
-        this->unhandled_server_requests.push_back(o_optional);
+    this->_dispatch_requests(now);
+
+    if (const int nexpired = this->responses.expire(now)) {
+        tilde::tildeWrite("LSP expired %d unclaimed responses", nexpired);
     }
 
     if (this->initialized == LeanServerInitializedKind::Initializing) {
-        std::optional<json_object_ptr> r = read_json_response_from_child_nonblocking(this->initialize_request_id);
+        std::optional<json_object_ptr> r = take_response(this->initialize_request_id);
         if (!r) {
             return;
         }
@@ -262,13 +439,9 @@ void LeanServerState::tick_nonblocking()
     }
 }
 
-std::optional<json_object_ptr> LeanServerState::read_json_response_from_child_nonblocking(LspRequestId request_id)
+std::optional<json_object_ptr> LeanServerState::take_response(LspRequestId request_id)
 {
-    auto it = this->request2response.find(request_id);
-    if (it == this->request2response.end()) {
-        return {};
-    }
-    return std::optional(it->second);
+    return this->responses.take(request_id);
 }
 
 /*** data ***/
@@ -404,6 +577,63 @@ int getWindowSize(int* rows, int* cols)
 
 /*** row operations ***/
 
+void fileConfigFlushActiveRow(FileConfig* f)
+{
+    if (!f->activeRowDirty) {
+        return;
+    }
+    assert(f->activeRowIx >= 0 && f->activeRowIx < f->rows.size());
+    f->rowsGetMut(f->activeRowIx) = f->activeRow.toAbuf();
+    f->activeRowDirty = false;
+}
+
+void fileConfigDeactivateRow(FileConfig* f)
+{
+    if (f->activeRowIx == -1) {
+        return;
+    }
+    fileConfigFlushActiveRow(f);
+    f->activeRowIx = -1;
+    f->activeRow = GapBuffer();
+}
+
+const abuf& fileConfigRow(FileConfig* f, int row)
+{
+    if (row == f->activeRowIx) {
+        fileConfigFlushActiveRow(f);
+    }
+    return f->rows[row];
+}
+
+abuf* fileConfigRowMut(FileConfig* f, int row)
+{
+    if (row == f->activeRowIx) {
+        fileConfigDeactivateRow(f);
+    }
+    return &f->rowsGetMut(row);
+}
+
+GapBuffer* fileConfigActivateRow(FileConfig* f)
+{
+    assert(f->cursor.row < f->rows.size());
+    if (f->activeRowIx != f->cursor.row) {
+        fileConfigDeactivateRow(f);
+        f->activeRow = GapBuffer::fromAbuf(fileConfigRow(f, f->cursor.row), f->cursor.col);
+        f->activeRowIx = f->cursor.row;
+    }
+    f->activeRow.moveGapTo(f->cursor.col);
+    // the caller is about to edit the row.
+    f->activeRowDirty = true;
+    return &f->activeRow;
+}
+
+void fileConfigSyncActiveRowWithCursor(FileConfig* f)
+{
+    if (f->activeRowIx != -1 && f->activeRowIx != f->cursor.row) {
+        fileConfigDeactivateRow(f);
+    }
+}
+
 // insert a new row at location `at`, and store `s` at that row.
 // so rows'[at] = <new str>, rows'[at+k] = rows[at + k - 1];
 // This also copies the indentation from the previous line into the new line.
@@ -416,11 +646,8 @@ void fileConfigInsertRowBefore(FileConfig* f, int at, const char* s, size_t len)
         return;
     }
 
-    f->rows.push_back(abuf());
-    for (int i = f->rows.size() - 1; i >= at + 1; i--) {
-        f->rows[i] = f->rows[i - 1];
-    }
-    f->rows[at].setBytes(s, len);
+    fileConfigDeactivateRow(f);
+    f->rowsInsert(at, abuf::from_copy_buf(s, len));
     f->makeDirty();
 }
 
@@ -429,17 +656,15 @@ void fileConfigInsertRowBefore(FileConfig* f, int at, const char* s, size_t len)
 void fileConfigDeleteCurrentRow(FileConfig* f)
 {
     if (f->cursor.row < f->rows.size()) {
-        for (int i = f->cursor.row; i < f->rows.size() - 1; i++) {
-            f->rows[i] = f->rows[i + 1];
-        }
-        f->rows.pop_back();
+        fileConfigDeactivateRow(f);
+        f->rowsErase(f->cursor.row);
         f->makeDirty();
     }
     if (f->cursor.row == f->rows.size()) {
         f->cursor.col = Size<Codepoint>(0);
     } else {
         f->cursor.col = std::min<Size<Codepoint>>(f->cursor.col,
-            f->rows[f->cursor.row].ncodepoints());
+            fileConfigRow(f, f->cursor.row).ncodepoints());
     }
 }
 
@@ -450,10 +675,8 @@ void fileConfigDelRow(FileConfig* f, int at)
         return;
     }
 
-    for (int i = at; i < f->rows.size() - 1; ++i) {
-        f->rows[i] = f->rows[i + 1];
-    }
-    f->rows.pop_back(); // drop last element.
+    fileConfigDeactivateRow(f);
+    f->rowsErase(at);
 }
 
 bool is_space_or_tab(char c)
@@ -473,7 +696,7 @@ void fileConfigInsertEnterKey(FileConfig* f)
         f->cursor.col = Size<Codepoint>(0);
     } else {
         // at column other than first, so chop row and insert new row.
-        abuf* row = &f->rows[f->cursor.row];
+        const abuf* row = &fileConfigRow(f, f->cursor.row);
         // TODO: simplify code by using `abuf`.
         // legal previous row, copy the indentation.
         // note that the checks 'num_indent < row.size' and 'num_indent < f->cursor.col' are *not* redundant.
@@ -500,10 +723,8 @@ void fileConfigInsertEnterKey(FileConfig* f)
         // create a row at f->cursor.row + 1 containing data;
         fileConfigInsertRowBefore(f, f->cursor.row + 1, new_row_contents.buf(), new_row_contents.len());
 
-        // pointer invalidated, get pointer to current row again,
-        row = &f->rows[f->cursor.row];
         // chop off at row[...:f->cursor.col]
-        row->truncateNCodepoints(Size<Codepoint>(f->cursor.col));
+        fileConfigRowMut(f, f->cursor.row)->truncateNCodepoints(Size<Codepoint>(f->cursor.col));
         f->makeDirty();
         // place cursor at next row (f->cursor.row + 1), column of the indent.
         f->cursor.row++;
@@ -520,14 +741,15 @@ void fileConfigInsertCharBeforeCursor(FileConfig* f, int c)
         fileConfigInsertRowBefore(f, f->rows.size(), "", 0);
     }
 
-    abuf* row = &f->rows[f->cursor.row];
+    // the gap is at the cursor, so the text before the cursor is contiguous.
+    GapBuffer* row = fileConfigActivateRow(f);
 
     // if `c` is one of the delinators of unabbrevs.
     if (row->ncodepoints() > Size<Codepoint>(0) && (c == ' ' || c == '\t' || c == '(' || c == ')' || c == '\\' || ispunct(c))) {
         // we are inserting a space, check if we have had a full match, and if so, use it.
         SuffixUnabbrevInfo info = abbrev_dict_get_unabbrev(&g_editor.abbrevDict,
-            row->getCodepoint(Ix<Codepoint>(0)), // this is a hack to get the buffer...
-            row->getBytesTill(f->cursor.col).size - 1);
+            row->beforeGap(),
+            row->nbytesBeforeGap().size - 1);
         if (info.kind == AMK_EXACT_MATCH) {
             assert(f->cursor.col.size > 0);
 
@@ -535,17 +757,17 @@ void fileConfigInsertCharBeforeCursor(FileConfig* f, int c)
             // the full string, plus the backslash.
             for (int i = 0; i < info.matchlen + 1; ++i) {
                 assert((g_editor.abbrevDict.unabbrevs[info.matchix][i] & (1 << 7)) == 0); // ASCII;
-                row->delCodepointAt(Ix<Codepoint>(f->cursor.col.largestIx()));
+                row->delCodepointBeforeGap();
                 f->cursor.col--;
             }
 
             // TODO: check if we have `toInserts` that are more than 1 codepoint.
             const char* toInsert = g_editor.abbrevDict.abbrevs[info.matchix];
-            row->insertCodepointBefore(f->cursor.col, toInsert);
+            row->insertCodepointAtGap(toInsert);
             f->cursor.col++;
         }
     }
-    row->insertByte(f->cursor.col, c);
+    row->insertByteAtGap(c);
     f->cursor.col++; // move cursor.
 }
 
@@ -558,14 +780,12 @@ void fileConfigXCommand(FileConfig* f)
         return;
     }
 
-    abuf* row = &f->rows[f->cursor.row];
-
     // nothing under cursor.
-    if (f->cursor.col == row->ncodepoints()) {
+    if (f->cursor.col == fileConfigRow(f, f->cursor.row).ncodepoints()) {
         return;
     }
     // delete under the cursor.
-    row->delCodepointAt(f->cursor.col.toIx());
+    fileConfigActivateRow(f)->delCodepointAfterGap();
     f->makeDirty();
 }
 
@@ -581,20 +801,18 @@ void fileConfigBackspace(FileConfig* f)
     }
 
     f->makeDirty();
-    abuf* row = &f->rows[f->cursor.row];
 
     // if col > 0, then delete at cursor. Otherwise, join lines toegether.
     if (f->cursor.col > Size<Codepoint>(0)) {
         // delete at the cursor.
-        row->delCodepointAt(f->cursor.col.largestIx());
+        fileConfigActivateRow(f)->delCodepointBeforeGap();
         f->cursor.col--;
     } else {
         // place cursor at last column of prev row.
-        f->cursor.col = f->rows[f->cursor.row - 1].ncodepoints();
+        f->cursor.col = fileConfigRow(f, f->cursor.row - 1).ncodepoints();
         // append string.
-        for (Ix<Codepoint> i(0); i < row->ncodepoints(); ++i) {
-            f->rows[f->cursor.row - 1].appendCodepoint(row->getCodepoint(i));
-        }
+        const abuf row = fileConfigRow(f, f->cursor.row);
+        fileConfigRowMut(f, f->cursor.row - 1)->appendbuf(&row);
         // delete current row
         fileConfigDelRow(f, f->cursor.row);
         // go to previous row.
@@ -607,8 +825,10 @@ void fileConfigBackspace(FileConfig* f)
 void fileConfigLaunchLeanServer(FileConfig* file_config)
 {
     // TODO: find some neat way to maintain this state.
-    assert(file_config->lean_server_state.initialized == LeanServerInitializedKind::Uninitialized);
-    file_config->lean_server_state.init(file_config->absolute_filepath); // start coro for lean --server.
+    assert(file_config->lean_server_state == NULL);
+    // start coro for lean --server, unless another file of the workspace did.
+    file_config->lean_server_state = g_editor.leanServers.getOrLaunch(
+        leanWorkspaceDirpath(file_config->absolute_filepath));
 }
 
 TextDocumentItem fileConfigToTextDocumentItem(FileConfig* file_config)
@@ -624,120 +844,181 @@ void fileConfigSyncLeanState(FileConfig* file_config)
     json_object* req = nullptr;
 
     // if server is not yet initialized, then don't sync state.
-    if (file_config->lean_server_state.initialized != LeanServerInitializedKind::Initialized) {
+    LeanServerState* server = file_config->lean_server_state;
+    if (!server || server->initialized != LeanServerInitializedKind::Initialized) {
+        return;
+    }
+
+    if (!server->is_document_open(file_config->absolute_filepath, file_config->lsp_document_owner)) {
+        file_config->undirtyLeanSync();
+        file_config->takeLeanChanges(); // the server is sent all of the rows.
+        // versions of the document must keep increasing, even if another
+        // file had it open before.
+        const int minVersion = server->claim_document(file_config->absolute_filepath, file_config->lsp_document_owner);
+        file_config->lsp_file_version = std::max(file_config->lsp_file_version + 1, minVersion);
+        file_config->lspDiagnostics.clear();
+        file_config->leanGoalCache.edit(file_config->lsp_file_version, 0);
+        // the server has not processed this version yet.
+        file_config->progressbar.finished = false;
+        // textDocument/didOpen
+        req = lspCreateDidOpenTextDocumentNotifiation(fileConfigToTextDocumentItem(file_config));
+        server->write_notification_to_child_blocking("textDocument/didOpen", req);
+        server->set_document_version(file_config->absolute_filepath, file_config->lsp_file_version);
+        return;
+    }
+
+    // the server already has these contents.
+    if (!file_config->isLeanSyncDirty()) {
+        file_config->takeLeanChanges(); // edits that cancel out.
         return;
     }
 
     file_config->undirtyLeanSync();
+    const std::vector<LspContentChange> changes = file_config->takeLeanChanges();
+    if (changes.empty()) {
+        return;
+    }
 
     file_config->lsp_file_version += 1;
-    // textDocument/didOpen
-    req = lspCreateDidOpenTextDocumentNotifiation(fileConfigToTextDocumentItem(file_config));
-    file_config->lean_server_state.write_notification_to_child_blocking("textDocument/didOpen", req);
+    // each change only moves what follows its start, so nothing before the
+    // earliest start changed.
+    int firstChangedRow = INT_MAX;
+    for (const LspContentChange& change : changes) {
+        firstChangedRow = std::min(firstChangedRow, change.range ? change.range->start.row : 0);
+    }
+    file_config->leanGoalCache.edit(file_config->lsp_file_version, firstChangedRow);
+    file_config->progressbar.finished = false;
+    // textDocument/didChange
+    req = lspCreateDidChangeTextDocumentNotification(Uri(file_config->absolute_filepath),
+        file_config->lsp_file_version,
+        changes);
+    server->write_notification_to_child_blocking("textDocument/didChange", req);
+    server->set_document_version(file_config->absolute_filepath, file_config->lsp_file_version);
+}
+
+// fill `out` with the answer to the request of `kind` (`method`, made by
+// `create`) at the cursor of `file_config`: from its `leanGoalCache` if the
+// answer is there, or else from a new request, which supersedes the last one.
+static void fileConfigRequestAtCursor(FileConfig* file_config, LeanServerState* server,
+    LspRequestKind kind, const char* method, json_object* (*create)(Uri, const LspPosition),
+    LspNonblockingResponse* out)
+{
+    std::optional<json_object_ptr> cached = file_config->leanGoalCache.find(file_config->lsp_file_version,
+        file_config->cursor, kind);
+    if (cached) {
+        server->cancel_document_request(file_config->absolute_filepath, kind);
+        *out = LspNonblockingResponse();
+        out->response = std::move(*cached);
+        return;
+    }
+    json_object* req = create(Uri(file_config->absolute_filepath), cursorToLspPosition(file_config->cursor));
+    *out = LspNonblockingResponse(server->write_document_request_to_child_blocking(file_config->absolute_filepath,
+        method, req, kind));
 }
 
 void fileConfigRequestGoalState(FileConfig* file_config)
 {
-    json_object* req = nullptr;
-    LspRequestId request_id;
-    // TODO: keep track of last hover position, and don't cancel request if cursor has not moved.
+    // ask again if the cursor moved, or the text changed, since the last ask.
+    // The pending requests, if any, are superseded, and the server cancels
+    // them. Positions that were asked about before are answered from memory.
+    const bool stale = file_config->leanInfoViewRequestedCursor != file_config->cursor
+        || file_config->leanInfoViewRequestedVersion != file_config->lsp_file_version;
+    LeanServerState* server = file_config->lean_server_state;
+    if (!server || !server->is_document_open(file_config->absolute_filepath, file_config->lsp_document_owner)) {
+        return; // `fileConfigSyncLeanState` opens it first.
+    }
+    // whether `r` was never asked for.
+    auto unasked = [](const LspNonblockingResponse& r) { return r.request == -1 && !r.response; };
 
     // $/lean/plainGoal
 
     // TODO: need to convert col to 'bytes'
-    if (file_config->leanInfoViewPlainGoal.request == -1 || file_config->leanInfoViewRequestedCursor != file_config->cursor) {
-        req = lspCreateLeanPlainGoalRequest(Uri(file_config->absolute_filepath),
-            cursorToLspPosition(file_config->cursor));
-        request_id = file_config->lean_server_state.write_request_to_child_blocking("$/lean/plainGoal", req);
-        file_config->leanInfoViewPlainGoal = LspNonblockingResponse(request_id);
+    if (stale || unasked(file_config->leanInfoViewPlainGoal)) {
+        fileConfigRequestAtCursor(file_config, server, LRK_PlainGoal, "$/lean/plainGoal",
+            lspCreateLeanPlainGoalRequest, &file_config->leanInfoViewPlainGoal);
     }
-    // file_config->lean_server_state.read_json_response_from_child_blocking(request_id);
 
     // $/lean/plainTermGoal
-    if (file_config->leanInfoViewPlainTermGoal.request == -1 || file_config->leanInfoViewRequestedCursor != file_config->cursor) {
-        req = lspCreateLeanPlainTermGoalRequest(Uri(file_config->absolute_filepath),
-            cursorToLspPosition(file_config->cursor));
-        request_id = file_config->lean_server_state.write_request_to_child_blocking("$/lean/plainTermGoal", req);
-        file_config->leanInfoViewPlainTermGoal = LspNonblockingResponse(request_id);
+    if (stale || unasked(file_config->leanInfoViewPlainTermGoal)) {
+        fileConfigRequestAtCursor(file_config, server, LRK_PlainTermGoal, "$/lean/plainTermGoal",
+            lspCreateLeanPlainTermGoalRequest, &file_config->leanInfoViewPlainTermGoal);
     }
-    // file_config->leanInfoViewPlainTermGoal = file_config->lean_server_state.read_json_response_from_child_blocking(request_id);
 
     // textDocument/hover
-
-    if (file_config->leanInfoViewPlainTermGoal.request == -1 || file_config->leanInfoViewRequestedCursor != file_config->cursor) {
-        req = lspCreateTextDocumentHoverRequest(Uri(file_config->absolute_filepath),
-            cursorToLspPosition(file_config->cursor));
-        request_id = file_config->lean_server_state.write_request_to_child_blocking("textDocument/hover", req);
-        file_config->leanHoverViewHover = LspNonblockingResponse(request_id);
+    if (stale || unasked(file_config->leanHoverViewHover)) {
+        fileConfigRequestAtCursor(file_config, server, LRK_Hover, "textDocument/hover",
+            lspCreateTextDocumentHoverRequest, &file_config->leanHoverViewHover);
     }
 
     file_config->leanInfoViewRequestedCursor = file_config->cursor;
-    // file_config->leanHoverViewHover = file_config->lean_server_state.read_json_response_from_child_blocking(request_id);
+    file_config->leanInfoViewRequestedVersion = file_config->lsp_file_version;
 }
 
 /*** file i/o ***/
 FileConfig::FileConfig(FileLocation loc) {
+    static int nextLspDocumentOwner = 0;
     this->cursor = loc.cursor;
     this->absolute_filepath = loc.absolute_filepath;
     assert(this->absolute_filepath.is_absolute());
+    this->lsp_document_owner = nextLspDocumentOwner++;
 
-    std::ifstream file(this->absolute_filepath.string());
-    if (!file.is_open()) {
-        die("ifstream: unable to open file '%s'",
-            this->absolute_filepath.c_str());
+    LoadedFileRows loaded;
+    if (!loadFileRows(this->absolute_filepath, &loaded)) {
+        die("unable to open file '%s'", this->absolute_filepath.c_str());
     }
-
-    std::string line;
-    while (std::getline(file, line)) {
-        // Remove trailing newline or carriage return characters
-        while (!line.empty() && (line.back() == '\n' || line.back() == '\r')) {
-            line.pop_back();
-        }
-        fileConfigInsertRowBefore(this, this->rows.size(), line.c_str(),
-                                  line.length());
+    if (!loaded.isValidUtf8) {
+        tilde::tildeWrite("file '%s' is not valid UTF-8", this->absolute_filepath.c_str());
     }
-
-    file.close();
+    this->loadArena = std::move(loaded.arena);
+    // build the rope in one shot, rather than inserting row by row.
+    this->rows = Rope<abuf>(std::move(loaded.rows));
+    this->makeDirty();
+    // the rows are what is on disk.
+    this->_savedHash = this->rows.hash();
+    this->_hasSavedHash = true;
 }
 
 void fileConfigRowsToBuf(FileConfig* file, abuf* buf)
 {
-    for (int r = 0; r < file->rows.size(); r++) {
+    fileConfigFlushActiveRow(file);
+    file->rows.forEach([&](int r, const abuf& row) {
         if (r > 0) {
             buf->appendChar('\n');
         }
-        buf->appendbuf(file->rows[r].getRawBytesPtrUnsafe(), file->rows[r].nbytes().size);
-    }
+        buf->appendbuf(row.getRawBytesPtrUnsafe(), row.nbytes().size);
+    });
 }
 
 std::string fileConfigRowsToCppString(FileConfig* file)
 {
+    fileConfigFlushActiveRow(file);
     std::string out;
-    for (int r = 0; r < file->rows.size(); r++) {
+    file->rows.forEach([&](int r, const abuf& row) {
         if (r > 0) {
             out += '\n';
         }
-        const char* bytes = file->rows[r].getRawBytesPtrUnsafe();
-        const int len = file->rows[r].nbytes().size;
+        const char* bytes = row.getRawBytesPtrUnsafe();
+        const int len = row.nbytes().size;
         out += std::string(bytes, bytes + len);
-    }
+    });
     return out;
 }
 
 void fileConfigDebugPrint(FileConfig* file, abuf* buf)
 {
-    for (int r = 0; r < file->rows.size(); r++) {
+    fileConfigFlushActiveRow(file);
+    file->rows.forEach([&](int r, const abuf& row) {
         if (r > 0) {
             buf->appendChar('\n');
         }
         Ix<Codepoint> c(0);
         // buf->appendChar('\'');
-        for (; c < file->rows[r].ncodepoints(); c++) {
+        for (; c < row.ncodepoints(); c++) {
             if (r == file->cursor.row && c == file->cursor.col.toIx()) {
                 buf->appendChar('|');
             }
             // TODO: convert 'buf' API to also use Sizes.
-            buf->appendCodepoint(file->rows[r].getCodepoint(c));
+            buf->appendCodepoint(row.getCodepoint(c));
         }
 
         // recall that cursor can occur *after* line end.
@@ -745,7 +1026,7 @@ void fileConfigDebugPrint(FileConfig* file, abuf* buf)
             buf->appendChar('|');
         }
         // buf->appendChar('\'');
-    }
+    });
 }
 
 void fileConfigSave(FileConfig* f)
@@ -754,12 +1035,105 @@ void fileConfigSave(FileConfig* f)
         return;
     }
 
-    abuf buf;
-    fileConfigRowsToBuf(f, &buf);
-    FILE *fp  = fopen(f->absolute_filepath.string().c_str(), "w");
-    int nwritten = fwrite(buf.buf(), 1, buf.len(), fp);
-    assert(nwritten == buf.len() && "wasn't able to write enough bytes");
-    fclose(fp);
+    // the I/O thread writes a snapshot of the rows, so we can keep editing.
+    g_editor.fileSaver.save(f->absolute_filepath, f->rows, f->loadArena);
+}
+
+// report saves that the I/O thread has finished. A failed save leaves the
+// file dirty, so that the next save retries it.
+void editorTickFileSaves()
+{
+    FileSaveResult result;
+    while (g_editor.fileSaver.pollFinished(&result)) {
+        if (result.ok) {
+            tilde::tildeWrite("saved '%s'", result.path.c_str());
+            continue;
+        }
+        tilde::tildeWrite("unable to save '%s': %s", result.path.c_str(), strerror(result.err));
+        if (FileConfig* f = g_editor.getOpenFile(result.path)) {
+            f->makeDirtySave();
+        }
+    }
+}
+
+void editorTrimUndoHistory()
+{
+    size_t total = 0;
+    g_editor.forEachFile([&](FileConfig& f) {
+        const UndoMemoryStats stats = f.undoMemoryStats();
+        total += stats.undoBytes + stats.redoBytes;
+    });
+    // evict from the largest history first, since it is the likeliest to
+    // hold steps that will never be undone.
+    while (total > g_editor.undoBudgetTotal) {
+        FileConfig* largest = NULL;
+        size_t largestBytes = 0;
+        g_editor.forEachFile([&](FileConfig& f) {
+            const UndoMemoryStats stats = f.undoMemoryStats();
+            const size_t nbytes = stats.undoBytes + stats.redoBytes;
+            if (stats.nundo > 0 && nbytes > largestBytes) {
+                largest = &f;
+                largestBytes = nbytes;
+            }
+        });
+        if (!largest) {
+            return; // only redo steps are left, which are never evicted.
+        }
+        const size_t excess = std::min<size_t>(total - g_editor.undoBudgetTotal, largestBytes);
+        largest->evictUndoHistory(largestBytes - excess);
+        const UndoMemoryStats stats = largest->undoMemoryStats();
+        total -= largestBytes - (stats.undoBytes + stats.redoBytes);
+    }
+}
+
+std::vector<std::string> editorUndoMemoryReport()
+{
+    std::vector<std::string> out;
+    g_editor.forEachFile([&](FileConfig& f) {
+        const UndoMemoryStats stats = f.undoMemoryStats();
+        char buf[512];
+        snprintf(buf, sizeof(buf), "undo %s: %d undo (%.1f KiB) | %d redo (%.1f KiB) | %d compressed | %d evicted",
+            f.absolute_filepath.filename().c_str(),
+            stats.nundo, stats.undoBytes / 1024.0,
+            stats.nredo, stats.redoBytes / 1024.0,
+            stats.ncompressed, stats.nevicted);
+        out.push_back(buf);
+    });
+    return out;
+}
+
+std::vector<std::string> editorLspResponseReport()
+{
+    std::vector<std::string> out;
+    g_editor.leanServers.forEachServer([&](LeanServerState& state) {
+        int nopen = 0;
+        for (const auto& it : state.documents) {
+            nopen += it.second.owner != -1;
+        }
+        char buf[512];
+        snprintf(buf, sizeof(buf), "lsp %s: %d documents | %d unclaimed responses (%d slots) | %d pending | %d dropped",
+            state.lakefile_dirpath ? state.lakefile_dirpath->c_str() : "lean --server",
+            nopen,
+            state.responses.size(), state.responses.capacity(),
+            (int)state.pending_requests.size(),
+            state.responses.ndropped() + state.nresponses_dropped);
+        out.push_back(buf);
+        for (int i = 0; i < LRC_NumClasses; ++i) {
+            const LspRequestClass cls = (LspRequestClass)i;
+            const LspRequestClassStats& stats = state.scheduler.stats(cls);
+            const double waitMs = stats.nsent ? stats.totalWait.count() / 1000.0 / stats.nsent : 0;
+            const double latencyMs = stats.nanswered ? stats.totalLatency.count() / 1000.0 / stats.nanswered : 0;
+            snprintf(buf, sizeof(buf), "  %s: %d queued | %d/%d in flight | %d sent after %.1f ms | %d answered in %.1f ms (max %.1f ms) | %d missed deadline",
+                lspRequestClassName(cls),
+                state.scheduler.nqueued(cls),
+                state.scheduler.ninFlight(cls), LSP_REQUEST_CLASS_POLICIES[cls].maxInFlight,
+                stats.nsent, waitMs,
+                stats.nanswered, latencyMs, stats.maxLatency.count() / 1000.0,
+                stats.nexpired);
+            out.push_back(buf);
+        }
+    });
+    return out;
 }
 
 LspPosition cursorToLspPosition(const Cursor c)
@@ -782,6 +1156,11 @@ enum GotoKind {
 
 void fileConfigGotoDefinitionNonblocking(FileConfig* file_config, GotoKind kind)
 {
+    LeanServerState* server = file_config->lean_server_state;
+    if (!server || !server->is_document_open(file_config->absolute_filepath, file_config->lsp_document_owner)) {
+        tilde::tildeWrite("goto: '%s' is not open with a lean server", file_config->absolute_filepath.c_str());
+        return;
+    }
     json_object* req = lspCreateTextDocumentDefinitionRequest(Uri(file_config->absolute_filepath),
         cursorToLspPosition(file_config->cursor));
     tilde::tildeWrite("Request [textDocument/definition] %s", json_object_to_json_string(req));
@@ -795,7 +1174,8 @@ void fileConfigGotoDefinitionNonblocking(FileConfig* file_config, GotoKind kind)
         assert(false && "unknown GotoKind");
     }
     assert(gotoKindStr != "");
-    file_config->leanGotoRequest = LspNonblockingResponse(file_config->lean_server_state.write_request_to_child_blocking(gotoKindStr.c_str(), req));
+    file_config->leanGotoRequest = LspNonblockingResponse(server->write_document_request_to_child_blocking(file_config->absolute_filepath,
+        gotoKindStr.c_str(), req, LRK_Goto));
 }
 
 /*** append buffer ***/
@@ -869,6 +1249,9 @@ void fileConfigDraw(FileConfig* f)
 {
 
     ImGui::Begin(f->absolute_filepath.string().c_str(), nullptr, ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoCollapse);
+    if (g_editor.vim_mode == VM_SEARCH) {
+        ImGui::Text("/%s", g_editor.searchPrompt.c_str());
+    }
     ImGui::End();
     // f->cursor_render_col = 0;
     // assert(f->cursor.row >= 0 && f->cursor.row <= f->rows.size());
@@ -1368,7 +1751,7 @@ void editorDraw()
         }
     }
     // draw the current file.
-    if (g_editor.vim_mode == VM_NORMAL || g_editor.vim_mode == VM_INSERT) {
+    if (g_editor.vim_mode == VM_NORMAL || g_editor.vim_mode == VM_INSERT || g_editor.vim_mode == VM_SEARCH) {
         if (g_editor.curFile()) {
             fileConfigDraw(g_editor.curFile());
         } else {
@@ -1426,7 +1809,7 @@ RowMotionRequest fileRowMoveCursorIntraRow(Cursor *cursor, abuf *row, LRDirectio
 
 enum CharacterType {
     Sigil, // (, <, etc.
-    Alnum, // a-z, \alpha, \beta, etc.
+    Alnum, // a-z, _, \alpha, \beta, etc.
     Space // ' ', '\t', etc.
 };
 
@@ -1436,7 +1819,7 @@ CharacterType getCodepointType(const char* codepoint)
     if (c == ' ' || c == '\t') {
         return CharacterType::Space;
     }
-    if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')) {
+    if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_') {
         return Alnum;
     } else {
         return Sigil;
@@ -1452,7 +1835,7 @@ void fileConfigCursorMoveWordNext(FileConfig* f)
         return;
     }
     assert(f->cursor.row < f->rows.size());
-    abuf* row = &f->rows[f->cursor.row];
+    const abuf* row = &fileConfigRow(f, f->cursor.row);
 
     if (f->cursor.col == row->ncodepoints()) {
         f->cursor.row++;
@@ -1493,11 +1876,11 @@ void fileConfigCursorMoveWordPrev(FileConfig* f)
             return;
         }
         f->cursor.row--;
-        f->cursor.col = f->rows[f->cursor.row].ncodepoints();
+        f->cursor.col = fileConfigRow(f, f->cursor.row).ncodepoints();
         return;
     }
     assert(f->cursor.row < f->rows.size());
-    abuf* row = &f->rows[f->cursor.row];
+    const abuf* row = &fileConfigRow(f, f->cursor.row);
 
     assert(f->cursor.col > Size<Codepoint>(0));
     f->cursor.col = f->cursor.col.prev(); // advance.
@@ -1520,6 +1903,116 @@ void fileConfigCursorMoveWordPrev(FileConfig* f)
     }
 };
 
+// place the cursor at byte `byteIx` of row `row`.
+static void fileConfigCursorSetByte(FileConfig* f, int row, int byteIx)
+{
+    f->cursor.row = row;
+    f->cursor.col = Size<Codepoint>(utf8_count_code_points(fileConfigRow(f, row).buf(), byteIx));
+}
+
+// whether `row[ix:ix+len)` is not preceded or followed by a letter or a digit.
+static bool isWholeWordAt(const abuf& row, int ix, int len)
+{
+    if (ix + len < row.len() && getCodepointType(row.buf() + ix + len) == CharacterType::Alnum) {
+        return false;
+    }
+    if (ix == 0) {
+        return true;
+    }
+    int prev = ix - 1; // the first byte of the codepoint before.
+    while (prev > 0 && ((unsigned char)row.buf()[prev] & 0xC0) == 0x80) {
+        prev--;
+    }
+    return getCodepointType(row.buf() + prev) != CharacterType::Alnum;
+}
+
+// the first match of `needle[0:len)` in `row[begin:end)` if `forward`, or the
+// last one otherwise, as a byte index into `row`. `-1` if there is none.
+static int searchRow(const abuf& row, int begin, int end, const char* needle, int len, bool forward, bool wholeWord)
+{
+    while (begin < end) {
+        int ix = -1;
+        if (forward) {
+            ix = search_find(row.buf() + begin, end - begin, needle, len);
+            ix = ix == -1 ? -1 : begin + ix;
+        } else {
+            ix = row.rfind_sub_buf(needle, len, end);
+            ix = ix < begin ? -1 : ix;
+        }
+        if (ix == -1 || !wholeWord || isWholeWordAt(row, ix, len)) {
+            return ix;
+        }
+        // look past the match that is part of a longer word.
+        if (forward) {
+            begin = ix + 1;
+        } else {
+            end = ix + len - 1;
+        }
+    }
+    return -1;
+}
+
+bool fileConfigSearch(FileConfig* f, const char* needle, int len, bool forward, bool wholeWord)
+{
+    const int nrows = f->rows.size();
+    if (nrows == 0 || len == 0) {
+        return false;
+    }
+    const int start = std::min<int>(f->cursor.row, nrows - 1);
+    const int startByte = f->cursor.row < nrows ? fileConfigRow(f, start).getBytesTill(f->cursor.col).size : 0;
+
+    // visit every row once, starting from the cursor row, then wrap around
+    // back to the cursor row, where only the part behind us is searched.
+    for (int k = 0; k <= nrows; ++k) {
+        const int r = forward ? (start + k) % nrows : (start - k + nrows) % nrows;
+        const abuf& row = fileConfigRow(f, r);
+        int ix = -1;
+        if (forward) {
+            const int begin = k == 0 ? std::min<int>(startByte + 1, row.len()) : 0;
+            const int end = k == nrows ? std::min<int>(startByte + len, row.len()) : row.len();
+            ix = searchRow(row, begin, end, needle, len, forward, wholeWord);
+        } else {
+            const int end = k == 0 ? startByte + len - 1 : row.len();
+            const int begin = k == nrows ? startByte : 0;
+            ix = searchRow(row, begin, end, needle, len, forward, wholeWord);
+        }
+        if (ix != -1) {
+            fileConfigCursorSetByte(f, r, ix);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool fileConfigSearchWordUnderCursor(FileConfig* f)
+{
+    if (f->cursor.row >= f->rows.size()) {
+        return false;
+    }
+    const abuf& row = fileConfigRow(f, f->cursor.row);
+    if (f->cursor.col == row.ncodepoints()) {
+        return false;
+    }
+    const CharacterType ty = getCodepointType(row.getCodepoint(f->cursor.col.toIx()));
+    if (ty != CharacterType::Alnum) {
+        return false;
+    }
+    Size<Codepoint> begin = f->cursor.col;
+    while (begin > Size<Codepoint>(0) && getCodepointType(row.getCodepoint(begin.prev().toIx())) == ty) {
+        begin = begin.prev();
+    }
+    Size<Codepoint> end = f->cursor.col;
+    while (end < row.ncodepoints() && getCodepointType(row.getCodepoint(end.toIx())) == ty) {
+        end = end.next();
+    }
+    const int beginByte = row.getBytesTill(begin).size;
+    g_editor.searchNeedle = std::string(row.buf() + beginByte, row.buf() + row.getBytesTill(end).size);
+    g_editor.searchWholeWord = true;
+    // search from the start of the word, so we do not find the word we are on.
+    f->cursor.col = begin;
+    return fileConfigSearch(f, g_editor.searchNeedle.c_str(), g_editor.searchNeedle.size(), /*forward=*/true, /*wholeWord=*/true);
+}
+
 void fileConfigCursorMoveCharLeft(FileConfig* f)
 {
     if (f->cursor.col > Size<Codepoint>(0)) {
@@ -1527,17 +2020,17 @@ void fileConfigCursorMoveCharLeft(FileConfig* f)
     } else if (f->cursor.row > 0) {
         assert(f->cursor.col == Size<Codepoint>(0));
         f->cursor.row--;
-        f->cursor.col = f->rows[f->cursor.row].ncodepoints();
+        f->cursor.col = fileConfigRow(f, f->cursor.row).ncodepoints();
     }
 }
 
 void fileConfigCursorMoveCharRight(FileConfig* f)
 {
     if (f->cursor.row < f->rows.size()) {
-        if (f->cursor.col < f->rows[f->cursor.row].ncodepoints()) {
+        if (f->cursor.col < fileConfigRow(f, f->cursor.row).ncodepoints()) {
             f->cursor.col++;
         } else {
-            assert(f->cursor.col == f->rows[f->cursor.row].ncodepoints());
+            assert(f->cursor.col == fileConfigRow(f, f->cursor.row).ncodepoints());
             f->cursor.row++;
             f->cursor.col = Size<Codepoint>(0);
         }
@@ -1547,7 +2040,7 @@ void fileConfigCursorMoveCharRight(FileConfig* f)
 void fileConfigCursorMoveEndOfRow(FileConfig* f)
 {
     if (f->cursor.row < f->rows.size()) {
-        f->cursor.col = f->rows[f->cursor.row].ncodepoints();
+        f->cursor.col = fileConfigRow(f, f->cursor.row).ncodepoints();
     }
 }
 
@@ -1562,7 +2055,7 @@ void fileConfigCursorMoveBeginOfRow(FileConfig* f)
 void fileConfigCursorMoveCharRightNoWraparound(FileConfig* f)
 {
     if (f->cursor.row < f->rows.size()) {
-        if (f->cursor.col < f->rows[f->cursor.row].ncodepoints()) {
+        if (f->cursor.col < fileConfigRow(f, f->cursor.row).ncodepoints()) {
             f->cursor.col++;
         }
     }
@@ -1572,7 +2065,7 @@ void fileConfigCursorMoveCharRightNoWraparound(FileConfig* f)
 void fileConfigDeleteTillEndOfRow(FileConfig* f)
 {
     if (f->cursor.row < f->rows.size()) {
-        abuf* row = &f->rows[f->cursor.row];
+        abuf* row = fileConfigRowMut(f, f->cursor.row);
         while (row->ncodepoints() > f->cursor.col) {
             row->delCodepointAt(row->ncodepoints().largestIx());
         }
@@ -1603,25 +2096,25 @@ void fileConfigMoveCursor(FileConfig* f, int key)
         if (f->cursor.row > 0) {
             f->cursor.row--;
         }
-        f->cursor.col = std::min<Size<Codepoint>>(f->cursor.col, f->rows[f->cursor.row].ncodepoints());
+        f->cursor.col = std::min<Size<Codepoint>>(f->cursor.col, fileConfigRow(f, f->cursor.row).ncodepoints());
         break;
     case 'j':
         if (f->cursor.row < f->rows.size()) {
             f->cursor.row++;
         }
         if (f->cursor.row < f->rows.size()) {
-            f->cursor.col = std::min<Size<Codepoint>>(f->cursor.col, f->rows[f->cursor.row].ncodepoints());
+            f->cursor.col = std::min<Size<Codepoint>>(f->cursor.col, fileConfigRow(f, f->cursor.row).ncodepoints());
         }
         break;
     case CTRL_KEY('d'):
         f->cursor.row = clampu<int>(f->cursor.row + g_editor.screenrows / 4, f->rows.size());
         if (f->cursor.row < f->rows.size()) {
-            f->cursor.col = std::min<Size<Codepoint>>(f->cursor.col, f->rows[f->cursor.row].ncodepoints());
+            f->cursor.col = std::min<Size<Codepoint>>(f->cursor.col, fileConfigRow(f, f->cursor.row).ncodepoints());
         }
         break;
     case CTRL_KEY('u'):
         f->cursor.row = clamp0<int>(f->cursor.row - g_editor.screenrows / 4);
-        f->cursor.col = std::min<Size<Codepoint>>(f->cursor.col, f->rows[f->cursor.row].ncodepoints());
+        f->cursor.col = std::min<Size<Codepoint>>(f->cursor.col, fileConfigRow(f, f->cursor.row).ncodepoints());
         break;
     }
 }
@@ -1779,8 +2272,62 @@ void editorHandleGotoResponse(json_object_ptr response)
     g_editor.getOrOpenNewFile(loc);
 }
 
+// while the user is idle, fetch the goals at the tactic rows around the
+// cursor of `f`, once `server` has elaborated it (see `GoalPrefetcher`).
+static void fileConfigTickGoalPrefetch(FileConfig* f, LeanServerState& server)
+{
+    GoalPrefetcher& prefetch = f->leanGoalPrefetch;
+    const GoalPrefetcher::Clock::time_point now = GoalPrefetcher::Clock::now();
+    if (prefetch.observe(f->cursor, f->scroll_row_offset, f->lsp_file_version, f->isLeanSyncDirty(), now)) {
+        server.cancel_document_request(f->absolute_filepath, LRK_PrefetchPlainGoal);
+        server.cancel_document_request(f->absolute_filepath, LRK_PrefetchPlainTermGoal);
+    }
+    if (!server.is_document_open(f->absolute_filepath, f->lsp_document_owner)) {
+        return;
+    }
+    if (prefetch.inFlight()) {
+        whenFillLspNonblockingResponse(server, prefetch.plainGoal);
+        whenFillLspNonblockingResponse(server, prefetch.plainTermGoal);
+        if (!prefetch.plainGoal.response || !prefetch.plainTermGoal.response) {
+            return;
+        }
+        f->leanGoalCache.insert(f->lsp_file_version, prefetch.inFlightAt(), LRK_PlainGoal, *prefetch.plainGoal.response);
+        f->leanGoalCache.insert(f->lsp_file_version, prefetch.inFlightAt(), LRK_PlainTermGoal, *prefetch.plainTermGoal.response);
+        prefetch.finish();
+    }
+    if (!f->progressbar.finished || !prefetch.idle(now)) {
+        return;
+    }
+    if (!prefetch.planned()) {
+        const int nvisible = g_editor.screenrows > 0 ? g_editor.screenrows : GOAL_PREFETCH_DEFAULT_WINDOW_ROWS;
+        const std::vector<Cursor> targets = goalPrefetchTargets(f->rows.size(), f->scroll_row_offset, f->scroll_row_offset + nvisible, f->cursor,
+            [f](int r) {
+                const abuf& row = fileConfigRow(f, r);
+                return std::string_view(row.getRawBytesPtrUnsafe(), row.nbytes().size);
+            });
+        // the positions whose goals are remembered need no fetching.
+        std::vector<Cursor> unknown;
+        for (const Cursor& c : targets) {
+            if (!f->leanGoalCache.contains(f->lsp_file_version, c, LRK_PlainGoal)
+                || !f->leanGoalCache.contains(f->lsp_file_version, c, LRK_PlainTermGoal)) {
+                unknown.push_back(c);
+            }
+        }
+        prefetch.plan(unknown);
+    }
+    if (std::optional<Cursor> at = prefetch.next(now)) {
+        const LspPosition position = cursorToLspPosition(*at);
+        prefetch.plainGoal = LspNonblockingResponse(server.write_document_request_to_child_blocking(f->absolute_filepath,
+            "$/lean/plainGoal", lspCreateLeanPlainGoalRequest(Uri(f->absolute_filepath), position), LRK_PrefetchPlainGoal));
+        prefetch.plainTermGoal = LspNonblockingResponse(server.write_document_request_to_child_blocking(f->absolute_filepath,
+            "$/lean/plainTermGoal", lspCreateLeanPlainTermGoalRequest(Uri(f->absolute_filepath), position), LRK_PrefetchPlainTermGoal));
+    }
+}
+
 void editorTickPostKeypress()
 {
+    editorTickFileSaves();
+    editorTrimUndoHistory();
 
     if (g_editor.vim_mode == VM_CTRLP) {
         ctrlpTickPostKeypress(&g_editor.ctrlp);
@@ -1790,31 +2337,46 @@ void editorTickPostKeypress()
     if (!f) {
         return;
     }
+    // once the cursor has left the row being typed into, compact it back into `rows`.
+    fileConfigSyncActiveRowWithCursor(f);
 
     // tilde::tildeWrite("editorTick() | nresps: %d | nunhandled: %d",
-    //   f->lean_server_state.request2response.size(),
+    //   f->lean_server_state.responses.size(),
     //   f->lean_server_state.unhandled_server_requests.size());
 
     if (f->absolute_filepath.extension() != ".lean") {
         return;
     }
     assert(f->absolute_filepath.extension() == ".lean");
-    if (f->lean_server_state.initialized == LeanServerInitializedKind::Uninitialized) {
+    if (!f->lean_server_state) {
         fileConfigLaunchLeanServer(f);
     }
-    assert(f->lean_server_state.initialized != LeanServerInitializedKind::Uninitialized);
+    LeanServerState& server = *f->lean_server_state;
+    assert(server.initialized != LeanServerInitializedKind::Uninitialized);
 
-    f->lean_server_state.tick_nonblocking();
+    // every server, so that the pipes of the other workspaces do not back up.
+    g_editor.leanServers.forEachServer([](LeanServerState& s) { s.tick_nonblocking(); });
     // TODO: we should know if the state became initialized.
     if (g_editor.vim_mode == VM_COMPLETION) {
         completionTickPostKeypress(f, &g_editor.completion);
     }
 
-    whenFillLspNonblockingResponse(f->lean_server_state, f->leanInfoViewPlainGoal);
-    whenFillLspNonblockingResponse(f->lean_server_state, f->leanInfoViewPlainTermGoal);
-    whenFillLspNonblockingResponse(f->lean_server_state, f->leanHoverViewHover);
+    // the responses are to the requests at the cursor of the last ask.
+    if (whenFillLspNonblockingResponse(server, f->leanInfoViewPlainGoal)) {
+        f->leanGoalCache.insert(f->leanInfoViewRequestedVersion, f->leanInfoViewRequestedCursor, LRK_PlainGoal,
+            *f->leanInfoViewPlainGoal.response);
+    }
+    if (whenFillLspNonblockingResponse(server, f->leanInfoViewPlainTermGoal)) {
+        f->leanGoalCache.insert(f->leanInfoViewRequestedVersion, f->leanInfoViewRequestedCursor, LRK_PlainTermGoal,
+            *f->leanInfoViewPlainTermGoal.response);
+    }
+    if (whenFillLspNonblockingResponse(server, f->leanHoverViewHover)) {
+        f->leanGoalCache.insert(f->leanInfoViewRequestedVersion, f->leanInfoViewRequestedCursor, LRK_Hover,
+            *f->leanHoverViewHover.response);
+    }
+    fileConfigTickGoalPrefetch(f, server);
 
-    if (whenFillLspNonblockingResponse(f->lean_server_state, f->leanGotoRequest)) {
+    if (whenFillLspNonblockingResponse(server, f->leanGotoRequest)) {
         assert(f->leanGotoRequest.response);
         assert(*f->leanGotoRequest.response);
         editorHandleGotoResponse(*f->leanGotoRequest.response);
@@ -1822,13 +2384,20 @@ void editorTickPostKeypress()
         return;
     }
 
-    // handle unhandled requests
-    if (f->lean_server_state.unhandled_server_requests.size() == 0) {
-        return;
+    // handle unhandled requests: those about this file first, then the
+    // server's own. Notifications about the other files of the workspace wait
+    // for them (see `LeanServerDocument::notifications`).
+    json_object_ptr req;
+    if (server.is_document_open(f->absolute_filepath, f->lsp_document_owner)) {
+        req = server.take_document_notification(f->absolute_filepath).value_or(json_object_ptr());
+    }
+    if (!req) {
+        if (server.unhandled_server_requests.size() == 0) {
+            return;
+        }
+        req = server.unhandled_server_requests.front();
+        server.unhandled_server_requests.erase(server.unhandled_server_requests.begin());
     }
-
-    json_object_ptr req = f->lean_server_state.unhandled_server_requests.front();
-    f->lean_server_state.unhandled_server_requests.erase(f->lean_server_state.unhandled_server_requests.begin());
 
     // tilde::tildeWrite("%s: unhandled request is: %s", __PRETTY_FUNCTION__, json_object_to_json_string(req));
 
@@ -1874,6 +2443,16 @@ void editorTickPostKeypress()
         json_object_object_get_ex(req, "params", &paramso);
         assert(paramso);
 
+        // a report about a version before the last one sent does not say
+        // whether the server is done with the text that it has now.
+        json_object* textdocumento = NULL;
+        json_object* versiono = NULL;
+        if (json_object_object_get_ex(paramso, "textDocument", &textdocumento)
+            && json_object_object_get_ex(textdocumento, "version", &versiono)
+            && json_object_get_int(versiono) < f->lsp_file_version) {
+            return;
+        }
+
         json_object* processingo = NULL;
         json_object_object_get_ex(paramso, "processing", &processingo);
         assert(processingo);
@@ -1916,6 +2495,11 @@ bool completionWhenSelected(CompletionView* view)
 
 void completionOpen(CompletionView* view, VimMode previous_state, FileConfig* f)
 {
+    LeanServerState* server = f->lean_server_state;
+    if (!server || !server->is_document_open(f->absolute_filepath, f->lsp_document_owner)) {
+        tilde::tildeWrite("completion: '%s' is not open with a lean server", f->absolute_filepath.c_str());
+        return;
+    }
     view->previous_state = previous_state;
     view->quitPressed = view->selectPressed = false;
     view->items.clear();
@@ -1923,9 +2507,9 @@ void completionOpen(CompletionView* view, VimMode previous_state, FileConfig* f)
     json_object* req = lspCreateTextDocumentCompletionRequest(Uri(f->absolute_filepath),
         cursorToLspPosition(f->cursor),
         CompletionTriggerKind::Invoked);
-    // TODO: need to ask LSP server to ignore request?
-    // I must think about this carefully in terms of semantics.
-    view->completionResponse = LspNonblockingResponse(f->lean_server_state.write_request_to_child_blocking("textDocument/completion", req));
+    // a completion that is still pending from an earlier open is cancelled.
+    view->completionResponse = LspNonblockingResponse(server->write_document_request_to_child_blocking(f->absolute_filepath,
+        "textDocument/completion", req, LRK_Completion));
     g_editor.vim_mode = VM_COMPLETION;
 }
 
@@ -1942,13 +2526,15 @@ void completionHandleInput(CompletionView* view, const SDL_Event &e)
 
 void completionTickPostKeypress(FileConfig* f, CompletionView* view)
 {
-    if (whenFillLspNonblockingResponse(f->lean_server_state, view->completionResponse)) {
+    if (whenFillLspNonblockingResponse(*f->lean_server_state, view->completionResponse)) {
         tilde::tildeWrite("response [textDocument/completion] %s",
             json_object_to_json_string(*view->completionResponse.response));
 
         json_object* oresult = nullptr;
         json_object_object_get_ex(*view->completionResponse.response, "result", &oresult);
-        assert(oresult);
+        if (!oresult) {
+            return; // an error, such as a missed deadline: no completions.
+        }
         assert(json_object_get_type(oresult) == json_type_object);
 
         json_object* items = NULL;
@@ -2100,6 +2686,42 @@ void editorProcessKeypress(SDL_Event e)
         //     return;
         // }
         // }
+    } else if (g_editor.vim_mode == VM_SEARCH) { // typing the needle after `/`.
+        // the needle is read from the text that the keys type, in UTF-8, so
+        // that the keyboard layout, shift and input methods apply.
+        if (e.type == SDL_TEXTINPUT) {
+            g_editor.searchPrompt += e.text.text;
+            return;
+        }
+        if (e.type != SDL_KEYDOWN) {
+            return;
+        }
+        const SDL_Keycode key = e.key.keysym.sym;
+        if (key == SDLK_ESCAPE || (key == SDLK_c && e.key.keysym.mod & KMOD_CTRL)) {
+            g_editor.vim_mode = VM_NORMAL;
+        } else if (key == SDLK_RETURN) {
+            g_editor.vim_mode = VM_NORMAL;
+            // an empty needle repeats the last search, like vim.
+            if (!g_editor.searchPrompt.empty()) {
+                g_editor.searchNeedle = g_editor.searchPrompt;
+                g_editor.searchWholeWord = false;
+            }
+            if (FileConfig* f = g_editor.curFile()) {
+                fileConfigSearch(f, g_editor.searchNeedle.c_str(), g_editor.searchNeedle.size(), /*forward=*/true,
+                    g_editor.searchWholeWord);
+            }
+        } else if (key == SDLK_BACKSPACE) {
+            if (g_editor.searchPrompt.empty()) {
+                g_editor.vim_mode = VM_NORMAL;
+            } else {
+                // the last codepoint, with its continuation bytes.
+                while (((unsigned char)g_editor.searchPrompt.back() & 0xC0) == 0x80) {
+                    g_editor.searchPrompt.pop_back();
+                }
+                g_editor.searchPrompt.pop_back();
+            }
+        }
+        return;
     } else if (g_editor.vim_mode == VM_NORMAL) { // behaviours only in normal mode
         FileConfig* f = g_editor.curFile();
         if (f == nullptr) {
@@ -2117,6 +2739,24 @@ void editorProcessKeypress(SDL_Event e)
 
         // normal mode.
         assert(f != nullptr);
+        // the search keys are read from the text that they type, so that
+        // they do not depend on the keyboard layout.
+        if (e.type == SDL_TEXTINPUT) {
+            const std::string_view text = e.text.text;
+            if (text == "/") {
+                g_editor.searchPrompt.clear();
+                g_editor.vim_mode = VM_SEARCH;
+                return;
+            } else if (text == "*") {
+                fileConfigSearchWordUnderCursor(f);
+                return;
+            } else if (text == "n" || text == "N") {
+                // `n` repeats the last search, `N` repeats it backwards.
+                fileConfigSearch(f, g_editor.searchNeedle.c_str(), g_editor.searchNeedle.size(), /*forward=*/text == "n",
+                    g_editor.searchWholeWord);
+                return;
+            }
+        }
         // switch (c) {
         // case CTRL_KEY('c'): { // resync state.
         //     fileConfigSave(f);
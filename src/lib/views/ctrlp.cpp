@@ -512,13 +512,8 @@ int RgProcess::_read_stdout_str_from_child_nonblocking()
 // return true if line was read.
 bool RgProcess::readLineNonBlocking()
 {
-    int newline_ix = 0;
-    for (; newline_ix < this->child_stdout_buffer.len(); newline_ix++) {
-        if (this->child_stdout_buffer.getByteAt(Ix<Byte>(newline_ix)) == '\n') {
-            break;
-        }
-    }
-    if (newline_ix >= this->child_stdout_buffer.len()) {
+    const int newline_ix = this->child_stdout_buffer.find_char('\n', 0);
+    if (newline_ix == -1) {
         return false;
     }
     assert(newline_ix < this->child_stdout_buffer.len());
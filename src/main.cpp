@@ -308,6 +308,13 @@ int main(int argc, char** argv) {
       if (ImGui::IsKeyPressed(ImGuiKey_GraveAccent)) {
         g_editor.vim_mode = tilde::g_tilde.previousMode;
       }
+      for (const std::string& s : editorUndoMemoryReport()) {
+        ImGui::TextUnformatted(s.c_str());
+      }
+      for (const std::string& s : editorLspResponseReport()) {
+        ImGui::TextUnformatted(s.c_str());
+      }
+      ImGui::Separator();
       for (std::string& s : tilde::g_tilde.log) {
         ImGui::Text(s.c_str());
       }
@@ -0,0 +1,202 @@
+#include "datastructures/abuf.h"
+#include "datastructures/utf8.h"
+#include "definitions/nspacespertab.h"
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+const char *strs[] = {"$", "£", "ह", "𐍈", "∀", "ℕ", "→", "x"};
+const int NSTRS = sizeof(strs) / sizeof(strs[0]);
+
+// byte offset of codepoint `ix` in `s`, computed by walking from the start.
+int naive_byte_ix(const std::string &s, int ix) {
+  int b = 0;
+  for (int i = 0; i < ix; ++i) { b += utf8_next_code_point_len(s.c_str() + b); }
+  return b;
+}
+
+int naive_ncodepoints(const std::string &s) {
+  int n = 0;
+  for (int b = 0; b < (int)s.size(); b += utf8_next_code_point_len(s.c_str() + b)) { n++; }
+  return n;
+}
+
+// check that every codepoint of `buf` is where `expected` says it should be.
+void check(const abuf &buf, const std::string &expected) {
+  assert(buf.len() == (int)expected.size());
+  assert(memcmp(buf.buf(), expected.c_str(), expected.size()) == 0);
+  const int n = naive_ncodepoints(expected);
+  assert(buf.ncodepoints() == Size<Codepoint>(n));
+  for (int i = 0; i <= n; ++i) {
+    assert(buf.getBytesTill(Size<Codepoint>(i)).size == naive_byte_ix(expected, i));
+  }
+}
+
+void test1() {
+  printf("### testing [codepoint index under insert/delete]\n");
+  abuf buf;
+  std::string expected;
+  unsigned seed = 7;
+  for (int i = 0; i < 1500; ++i) {
+    seed = seed * 1103515245 + 12345;
+    const int n = naive_ncodepoints(expected);
+    const int op = (seed >> 16) % 4;
+    if (op < 3 || n == 0) {
+      const char *cp = strs[(seed >> 4) % NSTRS];
+      const int at = (seed >> 8) % (n + 1);
+      buf.insertCodepointBefore(Size<Codepoint>(at), cp);
+      expected.insert(naive_byte_ix(expected, at), cp);
+    } else {
+      const int at = (seed >> 8) % n;
+      buf.delCodepointAt(Ix<Codepoint>(at));
+      const int b = naive_byte_ix(expected, at);
+      expected.erase(b, utf8_next_code_point_len(expected.c_str() + b));
+    }
+    // querying the index here makes the next edit update it incrementally.
+    if (i % 50 == 0) { check(buf, expected); }
+  }
+  check(buf, expected);
+  printf("  ncodepoints: %d\n", buf.ncodepoints().size);
+}
+
+void test2() {
+  printf("### testing [codepoint index under append/truncate]\n");
+  abuf buf;
+  std::string expected;
+  for (int i = 0; i < 500; ++i) {
+    buf.appendstr(strs[i % NSTRS]);
+    expected += strs[i % NSTRS];
+    if (i % 100 == 0) { check(buf, expected); }
+  }
+  check(buf, expected);
+  buf.truncateNCodepoints(Size<Codepoint>(130));
+  expected.resize(naive_byte_ix(expected, 130));
+  check(buf, expected);
+}
+
+void test3() {
+  printf("### testing [prepend/drop/move keep the bytes]\n");
+  abuf buf;
+  std::string expected;
+  for (int i = 0; i < 300; ++i) {
+    const char *s = strs[i % NSTRS];
+    if (i % 3 == 0) {
+      buf.prependbuf(s, strlen(s));
+      expected.insert(0, s);
+    } else {
+      buf.appendstr(s);
+      expected += s;
+    }
+    if (i % 5 == 0) {
+      // consume one codepoint from the front, like a reader of a pipe would.
+      const int n = utf8_next_code_point_len(expected.c_str());
+      buf.dropNBytesMut(n);
+      expected.erase(0, n);
+    }
+    if (i % 50 == 0) { check(buf, expected); }
+  }
+  check(buf, expected);
+
+  // moving out of a heap buffer steals it; moving an inline buffer copies it.
+  const char *heap_bytes = buf.buf();
+  abuf moved(std::move(buf));
+  assert(moved.buf() == heap_bytes);
+  assert(buf.len() == 0);
+  check(moved, expected);
+  abuf small = abuf::from_copy_str("ab");
+  abuf small_moved = std::move(small);
+  check(small_moved, "ab");
+  small_moved = moved;
+  check(small_moved, expected);
+  check(moved, expected);
+
+  // a vector of rows can grow without copying bytes.
+  std::vector<abuf> rows;
+  for (int i = 0; i < 100; ++i) { rows.push_back(abuf::from_copy_str(expected.c_str())); }
+  for (const abuf &row : rows) { check(row, expected); }
+}
+
+void test4() {
+  printf("### testing [capacity grows geometrically]\n");
+  abuf buf;
+  int ngrows = 0;
+  int cap = buf.capacity();
+  for (int i = 0; i < 100000; ++i) {
+    buf.appendChar('x');
+    if (buf.capacity() != cap) { ngrows++; cap = buf.capacity(); }
+  }
+  printf("  grew %d times for 100000 appends\n", ngrows);
+  assert(ngrows < 20);
+  // deleting keeps the capacity around for the next insert.
+  buf.delCodepointAt(Ix<Codepoint>(0));
+  assert(buf.capacity() == cap);
+}
+
+// render column of codepoint `cx`, by walking from the start.
+int naive_rx(const std::string &s, int cx) {
+  int rx = 0, b = 0;
+  for (int i = 0; i < cx; ++i) {
+    if (s[b] == '\t') {
+      rx += NSPACES_PER_TAB - (rx % NSPACES_PER_TAB);
+    } else {
+      rx += utf8_code_point_display_width(s.c_str() + b);
+    }
+    b += utf8_next_code_point_len(s.c_str() + b);
+  }
+  return rx;
+}
+
+void check_rx(const abuf &buf, const std::string &expected) {
+  const int n = naive_ncodepoints(expected);
+  for (int i = 0; i <= n; ++i) {
+    const int rx = naive_rx(expected, i);
+    assert(buf.cxToRx(Size<Codepoint>(i)) == rx);
+    // a column inside codepoint `i` maps back to `i`, unless it has no width.
+    if (i < n && naive_rx(expected, i + 1) > rx) {
+      assert(buf.rxToCx(rx) == Size<Codepoint>(i));
+      assert(buf.rxToCx(naive_rx(expected, i + 1) - 1) == Size<Codepoint>(i));
+    }
+  }
+  assert(buf.rxToCx(naive_rx(expected, n) + 100) == Size<Codepoint>(n));
+}
+
+void test5() {
+  printf("### testing [render column cache with tabs and wide glyphs]\n");
+  // tab, CJK (wide), emoji (wide), combining acute (zero width), Lean symbols.
+  const char *cps[] = {"\t", "x", "漢", "😀", "\xCC\x81", "ℕ", "→", " "};
+  const int NCPS = sizeof(cps) / sizeof(cps[0]);
+  assert(utf8_code_point_display_width("漢") == 2);
+  assert(utf8_code_point_display_width("😀") == 2);
+  assert(utf8_code_point_display_width("\xCC\x81") == 0);
+  assert(utf8_code_point_display_width("ℕ") == 1);
+  abuf buf;
+  std::string expected;
+  unsigned seed = 9;
+  for (int i = 0; i < 600; ++i) {
+    seed = seed * 1103515245 + 12345;
+    const int n = naive_ncodepoints(expected);
+    const int at = (seed >> 8) % (n + 1);
+    if ((seed >> 16) % 4 == 0 && n > 0) {
+      buf.delCodepointAt(Ix<Codepoint>(at == n ? n - 1 : at));
+      const int b = naive_byte_ix(expected, at == n ? n - 1 : at);
+      expected.erase(b, utf8_next_code_point_len(expected.c_str() + b));
+    } else {
+      const char *cp = cps[(seed >> 4) % NCPS];
+      buf.insertCodepointBefore(Size<Codepoint>(at), cp);
+      expected.insert(naive_byte_ix(expected, at), cp);
+    }
+    if (i % 40 == 0) { check_rx(buf, expected); }
+  }
+  check_rx(buf, expected);
+}
+
+int main() {
+  test1();
+  test2();
+  test3();
+  test4();
+  test5();
+  return 0;
+}
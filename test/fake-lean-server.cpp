@@ -0,0 +1,404 @@
+// Stands in for `lean --server` with synthetic answers, to load the client
+// without a lean install (see `LEAN_SERVER_ENV`):
+//
+//   fake-lean-server [--latency-ms <n>] [--progress <n>] [--diagnostics <n>]
+//                    [--goals <n>] [--goal-bytes <n>] [--completions <n>]
+//
+// Speaks the subset of the protocol the client uses: `initialize`,
+// `textDocument/didOpen` and `didChange`, `$/lean/plainGoal`,
+// `$/lean/plainTermGoal`, `textDocument/hover`, `completion`, `definition`,
+// `$/cancelRequest`, `shutdown` and `exit`. Every response is sent
+// `--latency-ms` after its request (0 by default), unless it is cancelled
+// first. Every new version of a document gets, after the same delay,
+// `--progress` `$/lean/fileProgress` notifications (1), then a
+// `textDocument/publishDiagnostics` with `--diagnostics` diagnostics (1),
+// spread over the document's lines, then the final, empty, progress. Goals
+// have `--goal-bytes` bytes (64), and are sent `--goals` at a time (1) by
+// `$/lean/plainGoal`; hovers carry one goal. Completions have `--completions`
+// items (8).
+#include "datastructures/jsonobjectptr.h"
+#include "datastructures/lspframer.h"
+#include <assert.h>
+#include <chrono>
+#include <map>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unistd.h>
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+  int latencyMs = 0;
+  int nprogress = 1;
+  int ndiagnostics = 1;
+  int ngoals = 1;
+  int goalBytes = 64;
+  int ncompletions = 8;
+};
+
+// a document the client opened.
+struct Document {
+  int version = 0;
+  int nlines = 1;
+};
+
+// the number of lines that `text` adds to a document.
+static int countNewlines(const char* text) {
+  int n = 0;
+  for (; *text; ++text) {
+    n += *text == '\n';
+  }
+  return n;
+}
+
+static json_object* position(int line, int character) {
+  json_object* o = json_object_new_object();
+  json_object_object_add(o, "line", json_object_new_int(line));
+  json_object_object_add(o, "character", json_object_new_int(character));
+  return o;
+}
+
+static json_object* range(int startLine, int startCharacter, int endLine, int endCharacter) {
+  json_object* o = json_object_new_object();
+  json_object_object_add(o, "start", position(startLine, startCharacter));
+  json_object_object_add(o, "end", position(endLine, endCharacter));
+  return o;
+}
+
+// `o[key]`, or null.
+static json_object* field(json_object* o, const char* key) {
+  json_object* v = NULL;
+  json_object_object_get_ex(o, key, &v);
+  return v;
+}
+
+struct FakeServer {
+  Options opts;
+  std::string goal; // of `opts.goalBytes` bytes.
+  std::map<std::string, Document> documents; // by URI.
+  // messages to send, by the time they are due. Equal times keep their order.
+  std::multimap<Clock::time_point, json_object_ptr> outbox;
+  // the responses in `outbox`, by request ID, so that they can be cancelled.
+  std::map<int, std::multimap<Clock::time_point, json_object_ptr>::iterator> pending;
+  LspFramer framer;
+  bool clientClosed = false;
+  bool exited = false;
+
+  explicit FakeServer(const Options& opts) : opts(opts) {
+    // hypotheses, one per line, then the target.
+    const std::string target = "⊢ True";
+    std::string hypotheses;
+    for (int i = 0; (int)hypotheses.size() < opts.goalBytes; ++i) {
+      hypotheses += "h" + std::to_string(i) + " : x" + std::to_string(i) + " = x" + std::to_string(i) + "\n";
+    }
+    if (opts.goalBytes < (int)target.size()) {
+      this->goal = hypotheses.substr(0, opts.goalBytes);
+    } else {
+      this->goal = hypotheses.substr(0, opts.goalBytes - target.size());
+      if (!this->goal.empty()) {
+        this->goal.back() = '\n';
+      }
+      this->goal += target;
+    }
+  }
+
+  Clock::time_point due() const {
+    return Clock::now() + std::chrono::milliseconds(this->opts.latencyMs);
+  }
+
+  void notify(const char* method, json_object* params) {
+    json_object* o = json_object_new_object();
+    json_object_object_add(o, "jsonrpc", json_object_new_string("2.0"));
+    json_object_object_add(o, "method", json_object_new_string(method));
+    json_object_object_add(o, "params", params);
+    this->outbox.emplace(this->due(), json_object_ptr(o));
+  }
+
+  void respond(int id, json_object* result) {
+    json_object* o = json_object_new_object();
+    json_object_object_add(o, "jsonrpc", json_object_new_string("2.0"));
+    json_object_object_add(o, "id", json_object_new_int(id));
+    json_object_object_add(o, "result", result);
+    this->pending[id] = this->outbox.emplace(this->due(), json_object_ptr(o));
+  }
+
+  void respondError(int id, int code, const char* message) {
+    json_object* e = json_object_new_object();
+    json_object_object_add(e, "code", json_object_new_int(code));
+    json_object_object_add(e, "message", json_object_new_string(message));
+    json_object* o = json_object_new_object();
+    json_object_object_add(o, "jsonrpc", json_object_new_string("2.0"));
+    json_object_object_add(o, "id", json_object_new_int(id));
+    json_object_object_add(o, "error", e);
+    this->pending[id] = this->outbox.emplace(this->due(), json_object_ptr(o));
+  }
+
+  // `processing` is the array of the parts of the document still being elaborated.
+  void progress(const std::string& uri, int version, json_object* processing) {
+    json_object* textDocument = json_object_new_object();
+    json_object_object_add(textDocument, "uri", json_object_new_string(uri.c_str()));
+    json_object_object_add(textDocument, "version", json_object_new_int(version));
+    json_object* params = json_object_new_object();
+    json_object_object_add(params, "textDocument", textDocument);
+    json_object_object_add(params, "processing", processing);
+    this->notify("$/lean/fileProgress", params);
+  }
+
+  // the progress, diagnostics, and end of progress of a new version of `uri`.
+  void elaborate(const std::string& uri) {
+    const Document& doc = this->documents[uri];
+    for (int i = 0; i < this->opts.nprogress; ++i) {
+      json_object* processing = json_object_new_object();
+      json_object_object_add(processing, "range",
+        range((long)doc.nlines * i / this->opts.nprogress, 0, doc.nlines, 0));
+      json_object_object_add(processing, "kind", json_object_new_int(1));
+      json_object* records = json_object_new_array();
+      json_object_array_add(records, processing);
+      this->progress(uri, doc.version, records);
+    }
+
+    json_object* diagnostics = json_object_new_array();
+    for (int i = 0; i < this->opts.ndiagnostics; ++i) {
+      const int line = i % doc.nlines;
+      json_object* d = json_object_new_object();
+      json_object_object_add(d, "range", range(line, 0, line, 0));
+      json_object_object_add(d, "fullRange", range(line, 0, line, 0));
+      json_object_object_add(d, "severity", json_object_new_int(1 + i % 4));
+      json_object_object_add(d, "source", json_object_new_string("Lean 4"));
+      json_object_object_add(d, "message",
+        json_object_new_string(("fake diagnostic " + std::to_string(i)).c_str()));
+      json_object_array_add(diagnostics, d);
+    }
+    json_object* params = json_object_new_object();
+    json_object_object_add(params, "uri", json_object_new_string(uri.c_str()));
+    json_object_object_add(params, "version", json_object_new_int(doc.version));
+    json_object_object_add(params, "diagnostics", diagnostics);
+    this->notify("textDocument/publishDiagnostics", params);
+
+    this->progress(uri, doc.version, json_object_new_array());
+  }
+
+  void onDidOpen(json_object* params) {
+    json_object* textDocument = field(params, "textDocument");
+    const std::string uri = json_object_get_string(field(textDocument, "uri"));
+    Document& doc = this->documents[uri];
+    doc.version = json_object_get_int(field(textDocument, "version"));
+    doc.nlines = 1 + countNewlines(json_object_get_string(field(textDocument, "text")));
+    this->elaborate(uri);
+  }
+
+  void onDidChange(json_object* params) {
+    json_object* textDocument = field(params, "textDocument");
+    const std::string uri = json_object_get_string(field(textDocument, "uri"));
+    Document& doc = this->documents[uri];
+    doc.version = json_object_get_int(field(textDocument, "version"));
+    json_object* changes = field(params, "contentChanges");
+    for (int i = 0; i < (int)json_object_array_length(changes); ++i) {
+      json_object* change = json_object_array_get_idx(changes, i);
+      const int nnew = countNewlines(json_object_get_string(field(change, "text")));
+      json_object* r = field(change, "range");
+      if (!r) {
+        doc.nlines = 1 + nnew;
+        continue;
+      }
+      const int startLine = json_object_get_int(field(field(r, "start"), "line"));
+      const int endLine = json_object_get_int(field(field(r, "end"), "line"));
+      doc.nlines += nnew - (endLine - startLine);
+    }
+    doc.nlines = doc.nlines < 1 ? 1 : doc.nlines;
+    this->elaborate(uri);
+  }
+
+  void onCancel(json_object* params) {
+    const int id = json_object_get_int(field(params, "id"));
+    auto it = this->pending.find(id);
+    if (it == this->pending.end()) {
+      return; // already answered.
+    }
+    this->outbox.erase(it->second);
+    this->pending.erase(it);
+    // as lean does: the request is answered, with an error.
+    this->respondError(id, -32800, "Request cancelled");
+  }
+
+  void onRequest(int id, const char* method, json_object* params) {
+    json_object* textDocument = field(params, "textDocument");
+    const char* uri = textDocument ? json_object_get_string(field(textDocument, "uri")) : "";
+    json_object* pos = field(params, "position");
+    const int line = pos ? json_object_get_int(field(pos, "line")) : 0;
+    const int character = pos ? json_object_get_int(field(pos, "character")) : 0;
+
+    if (strcmp(method, "initialize") == 0) {
+      json_object* sync = json_object_new_object();
+      json_object_object_add(sync, "openClose", json_object_new_boolean(true));
+      json_object_object_add(sync, "change", json_object_new_int(2)); // incremental.
+      json_object* capabilities = json_object_new_object();
+      json_object_object_add(capabilities, "textDocumentSync", sync);
+      json_object_object_add(capabilities, "hoverProvider", json_object_new_boolean(true));
+      json_object_object_add(capabilities, "completionProvider", json_object_new_object());
+      json_object_object_add(capabilities, "definitionProvider", json_object_new_boolean(true));
+      json_object* serverInfo = json_object_new_object();
+      json_object_object_add(serverInfo, "name", json_object_new_string("fake-lean-server"));
+      json_object* result = json_object_new_object();
+      json_object_object_add(result, "capabilities", capabilities);
+      json_object_object_add(result, "serverInfo", serverInfo);
+      this->respond(id, result);
+    } else if (strcmp(method, "$/lean/plainGoal") == 0) {
+      json_object* goals = json_object_new_array();
+      std::string rendered = "```lean\n";
+      for (int i = 0; i < this->opts.ngoals; ++i) {
+        json_object_array_add(goals, json_object_new_string_len(this->goal.data(), this->goal.size()));
+        rendered += this->goal + "\n";
+      }
+      rendered += "```";
+      json_object* result = json_object_new_object();
+      json_object_object_add(result, "rendered", json_object_new_string_len(rendered.data(), rendered.size()));
+      json_object_object_add(result, "goals", goals);
+      this->respond(id, result);
+    } else if (strcmp(method, "$/lean/plainTermGoal") == 0) {
+      json_object* result = json_object_new_object();
+      json_object_object_add(result, "goal", json_object_new_string_len(this->goal.data(), this->goal.size()));
+      json_object_object_add(result, "range", range(line, character, line, character));
+      this->respond(id, result);
+    } else if (strcmp(method, "textDocument/hover") == 0) {
+      json_object* contents = json_object_new_object();
+      json_object_object_add(contents, "kind", json_object_new_string("markdown"));
+      json_object_object_add(contents, "value", json_object_new_string_len(this->goal.data(), this->goal.size()));
+      json_object* result = json_object_new_object();
+      json_object_object_add(result, "contents", contents);
+      json_object_object_add(result, "range", range(line, character, line, character));
+      this->respond(id, result);
+    } else if (strcmp(method, "textDocument/completion") == 0) {
+      json_object* items = json_object_new_array();
+      for (int i = 0; i < this->opts.ncompletions; ++i) {
+        json_object* item = json_object_new_object();
+        json_object_object_add(item, "label", json_object_new_string(("fake" + std::to_string(i)).c_str()));
+        json_object_object_add(item, "kind", json_object_new_int(3)); // function.
+        json_object_object_add(item, "detail", json_object_new_string("Nat → Nat"));
+        json_object_array_add(items, item);
+      }
+      json_object* result = json_object_new_object();
+      json_object_object_add(result, "isIncomplete", json_object_new_boolean(false));
+      json_object_object_add(result, "items", items);
+      this->respond(id, result);
+    } else if (strcmp(method, "textDocument/definition") == 0
+      || strcmp(method, "textDocument/declaration") == 0
+      || strcmp(method, "textDocument/typeDefinition") == 0) {
+      // the start of the document itself, which always exists.
+      json_object* link = json_object_new_object();
+      json_object_object_add(link, "targetUri", json_object_new_string(uri));
+      json_object_object_add(link, "targetRange", range(0, 0, 0, 0));
+      json_object_object_add(link, "targetSelectionRange", range(0, 0, 0, 0));
+      json_object_object_add(link, "originSelectionRange", range(line, character, line, character));
+      json_object* result = json_object_new_array();
+      json_object_array_add(result, link);
+      this->respond(id, result);
+    } else if (strcmp(method, "shutdown") == 0) {
+      this->respond(id, NULL);
+    } else {
+      this->respondError(id, -32601, "method not found");
+    }
+  }
+
+  void onClientMessage(json_object* o) {
+    json_object* methodo = field(o, "method");
+    if (!methodo) {
+      json_object_put(o);
+      return; // a response to a request of ours: we make none.
+    }
+    const char* method = json_object_get_string(methodo);
+    json_object* params = field(o, "params");
+    if (json_object* ido = field(o, "id")) {
+      this->onRequest(json_object_get_int(ido), method, params);
+    } else if (strcmp(method, "textDocument/didOpen") == 0) {
+      this->onDidOpen(params);
+    } else if (strcmp(method, "textDocument/didChange") == 0) {
+      this->onDidChange(params);
+    } else if (strcmp(method, "$/cancelRequest") == 0) {
+      this->onCancel(params);
+    } else if (strcmp(method, "exit") == 0) {
+      this->exited = true;
+    }
+    json_object_put(o);
+  }
+
+  // wait up to `timeoutMs` (`-1`: forever) for the client, and handle what it sent.
+  void pump(int timeoutMs) {
+    struct pollfd fd = {};
+    fd.fd = STDIN_FILENO;
+    fd.events = POLLIN;
+    if (poll(&fd, 1, timeoutMs) <= 0) {
+      return;
+    }
+    char buf[1 << 16];
+    const int nread = read(STDIN_FILENO, buf, sizeof(buf));
+    if (nread <= 0) {
+      this->clientClosed = true;
+      return;
+    }
+    this->framer.feed(buf, nread, [this](json_object* o) { this->onClientMessage(o); });
+  }
+
+  // send the messages that are due.
+  void flush() {
+    const Clock::time_point now = Clock::now();
+    while (!this->outbox.empty() && this->outbox.begin()->first <= now) {
+      json_object* o = this->outbox.begin()->second;
+      json_object* ido = field(o, "id");
+      if (ido) {
+        this->pending.erase(json_object_get_int(ido));
+      }
+      const char* body = json_object_to_json_string_ext(o, JSON_C_TO_STRING_PLAIN);
+      fprintf(stdout, "Content-Length: %d\r\n\r\n%s", (int)strlen(body), body);
+      this->outbox.erase(this->outbox.begin());
+    }
+    fflush(stdout);
+  }
+
+  void run() {
+    while (!this->exited && !this->clientClosed) {
+      this->flush();
+      int timeoutMs = -1;
+      if (!this->outbox.empty()) {
+        const Clock::duration wait = this->outbox.begin()->first - Clock::now();
+        timeoutMs = std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::milliseconds>(wait).count() + 1);
+      }
+      this->pump(timeoutMs);
+    }
+  }
+};
+
+int main(int argc, char** argv) {
+  Options opts;
+  for (int i = 1; i < argc; ++i) {
+    int* value = NULL;
+    if (strcmp(argv[i], "--latency-ms") == 0) {
+      value = &opts.latencyMs;
+    } else if (strcmp(argv[i], "--progress") == 0) {
+      value = &opts.nprogress;
+    } else if (strcmp(argv[i], "--diagnostics") == 0) {
+      value = &opts.ndiagnostics;
+    } else if (strcmp(argv[i], "--goals") == 0) {
+      value = &opts.ngoals;
+    } else if (strcmp(argv[i], "--goal-bytes") == 0) {
+      value = &opts.goalBytes;
+    } else if (strcmp(argv[i], "--completions") == 0) {
+      value = &opts.ncompletions;
+    }
+    if (!value || i + 1 == argc || atoi(argv[i + 1]) < 0) {
+      fprintf(stderr, "usage: %s [--latency-ms <n>] [--progress <n>] [--diagnostics <n>] "
+        "[--goals <n>] [--goal-bytes <n>] [--completions <n>]\n", argv[0]);
+      return 1;
+    }
+    *value = atoi(argv[++i]);
+  }
+  // a client that hangs up should end the server, not kill it.
+  signal(SIGPIPE, SIG_IGN);
+  FakeServer server(opts);
+  server.run();
+  return 0;
+}
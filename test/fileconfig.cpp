@@ -0,0 +1,241 @@
+#include "lib.h"
+#include "datastructures/editorconfig.h"
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+// a file config for a file on disk holding `contents`, with the cursor at `cursor`.
+FileConfig* openTestFile(const char* path, const std::string& contents, Cursor cursor) {
+  FILE* fp = fopen(path, "wb");
+  fwrite(contents.c_str(), 1, contents.size(), fp);
+  fclose(fp);
+  return new FileConfig(FileLocation(fs::absolute(path), cursor));
+}
+
+// the rows of `f`, as `fileConfigRow` sees them.
+std::vector<std::string> rowsOf(FileConfig* f) {
+  std::vector<std::string> out;
+  for (int i = 0; i < f->rows.size(); ++i) {
+    out.push_back(fileConfigRow(f, i).to_std_string());
+  }
+  return out;
+}
+
+void test1() {
+  printf("### testing [typing and backspace in the active row, then moving off of it]\n");
+  FileConfig* f = openTestFile("fileconfig_test.txt", "abc\ndef\nghi\n", Cursor(1, 1));
+  fileConfigInsertCharBeforeCursor(f, 'x');
+  fileConfigInsertCharBeforeCursor(f, 'y');
+  fileConfigBackspace(f);
+  fileConfigInsertCharBeforeCursor(f, 'z');
+  assert(f->activeRowIx == 1);
+  assert(f->cursor == Cursor(1, 3));
+  // the active row is read while it is being edited.
+  assert(fileConfigRow(f, 1).to_std_string() == "dxzef");
+  assert(rowsOf(f) == std::vector<std::string>({ "abc", "dxzef", "ghi" }));
+
+  fileConfigMoveCursor(f, 'j');
+  fileConfigSyncActiveRowWithCursor(f);
+  assert(f->activeRowIx == -1);
+  assert(rowsOf(f) == std::vector<std::string>({ "abc", "dxzef", "ghi" }));
+
+  // backspace at the start of a row joins it with the row above.
+  f->cursor = Cursor(2, 0);
+  fileConfigBackspace(f);
+  assert(f->cursor == Cursor(1, 5));
+  fileConfigInsertCharBeforeCursor(f, 'w');
+  fileConfigMoveCursor(f, 'k');
+  fileConfigSyncActiveRowWithCursor(f);
+  assert(rowsOf(f) == std::vector<std::string>({ "abc", "dxzefwghi" }));
+  assert(fileConfigRowsToCppString(f) == "abc\ndxzefwghi");
+  delete f;
+}
+
+bool search(FileConfig* f, const char* needle, bool forward) {
+  return fileConfigSearch(f, needle, strlen(needle), forward, /*wholeWord=*/false);
+}
+
+void test2() {
+  printf("### testing [search wraps around the file, and sees the active row]\n");
+  FileConfig* f = openTestFile("fileconfig_test.txt", "foo bar\nbaz foo\nλ foo\nqux\n", Cursor(1, 4));
+  bool found = search(f, "foo", true);
+  assert(found && f->cursor == Cursor(2, 2));
+  found = search(f, "foo", true);
+  assert(found && f->cursor == Cursor(0, 0));
+  found = search(f, "foo", true);
+  assert(found && f->cursor == Cursor(1, 4));
+  found = search(f, "foo", false);
+  assert(found && f->cursor == Cursor(0, 0));
+  found = search(f, "foo", false);
+  assert(found && f->cursor == Cursor(2, 2));
+  found = search(f, "foo", false);
+  assert(found && f->cursor == Cursor(1, 4));
+
+  // the only match is found again, after going around the file.
+  f->cursor = Cursor(0, 4);
+  found = search(f, "bar", true);
+  assert(found && f->cursor == Cursor(0, 4));
+  found = search(f, "bar", false);
+  assert(found && f->cursor == Cursor(0, 4));
+  found = search(f, "zzz", true);
+  assert(!found && f->cursor == Cursor(0, 4));
+
+  // a match that is only in the active row, and not yet in `f->rows`.
+  f->cursor = Cursor(3, 3);
+  fileConfigInsertCharBeforeCursor(f, 'f');
+  fileConfigInsertCharBeforeCursor(f, 'o');
+  fileConfigInsertCharBeforeCursor(f, 'o');
+  assert(f->activeRowIx == 3 && f->activeRowDirty);
+  f->cursor = Cursor(2, 2);
+  found = search(f, "foo", true);
+  assert(found && f->cursor == Cursor(3, 3));
+  found = search(f, "foo", true);
+  assert(found && f->cursor == Cursor(0, 0));
+
+  // `*` searches for the word under the cursor, and `n` repeats it.
+  f->cursor = Cursor(0, 1);
+  found = fileConfigSearchWordUnderCursor(f);
+  assert(found && f->cursor == Cursor(1, 4));
+  assert(g_editor.searchNeedle == "foo" && g_editor.searchWholeWord);
+  found = search(f, g_editor.searchNeedle.c_str(), true);
+  assert(found && f->cursor == Cursor(2, 2));
+  f->cursor = Cursor(0, 3);
+  found = fileConfigSearchWordUnderCursor(f);
+  assert(!found);
+  delete f;
+}
+
+void test3() {
+  printf("### testing [focusing an open file clamps a cursor from before its edits]\n");
+  const fs::path path = fs::absolute("fileconfig_test_focus.txt");
+  FILE* fp = fopen(path.c_str(), "wb");
+  fputs("abcdef\nxyz\n", fp);
+  fclose(fp);
+  g_editor.getOrOpenNewFile(FileLocation(path, Cursor(1, 2)));
+  FileConfig* f = g_editor.curFile();
+  assert(f->cursor == Cursor(1, 2));
+  f->cursor = Cursor(1, 0);
+  fileConfigBackspace(f);
+  fileConfigInsertCharBeforeCursor(f, 'q');
+  assert(rowsOf(f) == std::vector<std::string>({ "abcdefqxyz" }));
+
+  // the location that the history recorded before the edit.
+  g_editor.getOrOpenNewFile(FileLocation(path, Cursor(1, 2)));
+  assert(g_editor.curFile() == f);
+  assert(f->cursor == Cursor(0, 2));
+  g_editor.getOrOpenNewFile(FileLocation(path, Cursor(5, 100)));
+  assert(f->cursor == Cursor(0, 10));
+  fileConfigInsertCharBeforeCursor(f, 'w');
+  assert(rowsOf(f) == std::vector<std::string>({ "abcdefqxyzw" }));
+}
+
+// what SDL sends for text typed at the keyboard.
+void typeText(const char* text) {
+  SDL_Event e;
+  memset(&e, 0, sizeof(e));
+  e.type = SDL_TEXTINPUT;
+  strncpy(e.text.text, text, sizeof(e.text.text) - 1);
+  editorProcessKeypress(e);
+}
+
+void pressKey(SDL_Keycode key) {
+  SDL_Event e;
+  memset(&e, 0, sizeof(e));
+  e.type = SDL_KEYDOWN;
+  e.key.keysym.sym = key;
+  editorProcessKeypress(e);
+}
+
+void test4() {
+  printf("### testing [the needle after / is the text typed, shifted and not ASCII]\n");
+  const fs::path path = fs::absolute("fileconfig_test_prompt.txt");
+  FILE* fp = fopen(path.c_str(), "wb");
+  fputs("have h : h_1\nfoo := h_1 → ∀ x\n", fp);
+  fclose(fp);
+  g_editor.getOrOpenNewFile(FileLocation(path, Cursor(0, 0)));
+  FileConfig* f = g_editor.curFile();
+  assert(g_editor.vim_mode == VM_NORMAL);
+
+  typeText("/");
+  assert(g_editor.vim_mode == VM_SEARCH);
+  // the key that types `_` is only a keydown of `-` with shift held.
+  pressKey(SDLK_MINUS);
+  typeText("h");
+  typeText("_");
+  typeText("1");
+  assert(g_editor.searchPrompt == "h_1");
+  pressKey(SDLK_RETURN);
+  assert(g_editor.vim_mode == VM_NORMAL);
+  assert(f->cursor == Cursor(0, 9));
+  typeText("n");
+  assert(f->cursor == Cursor(1, 7));
+  typeText("N");
+  assert(f->cursor == Cursor(0, 9));
+
+  typeText("/");
+  typeText(":=");
+  pressKey(SDLK_RETURN);
+  assert(f->cursor == Cursor(1, 4));
+
+  // backspace erases the whole of the last codepoint.
+  typeText("/");
+  typeText("→");
+  typeText("∀");
+  pressKey(SDLK_BACKSPACE);
+  assert(g_editor.searchPrompt == "→");
+  pressKey(SDLK_RETURN);
+  assert(f->cursor == Cursor(1, 11));
+  assert(g_editor.searchNeedle == "→");
+
+  // escape forgets the needle typed.
+  typeText("/");
+  typeText("∀");
+  pressKey(SDLK_ESCAPE);
+  assert(g_editor.vim_mode == VM_NORMAL);
+  assert(g_editor.searchNeedle == "→");
+  assert(f->cursor == Cursor(1, 11));
+}
+
+void test5() {
+  printf("### testing [* only finds the word under the cursor, not longer words that contain it]\n");
+  const fs::path path = fs::absolute("fileconfig_test_star.txt");
+  FILE* fp = fopen(path.c_str(), "wb");
+  fputs("have h : h_1 = hh\n-h (h) h_1\n", fp);
+  fclose(fp);
+  g_editor.getOrOpenNewFile(FileLocation(path, Cursor(0, 5)));
+  FileConfig* f = g_editor.curFile();
+
+  typeText("*");
+  assert(g_editor.searchNeedle == "h" && g_editor.searchWholeWord);
+  assert(f->cursor == Cursor(1, 1));
+  typeText("n");
+  assert(f->cursor == Cursor(1, 4));
+  typeText("n");
+  assert(f->cursor == Cursor(0, 5));
+  typeText("N");
+  assert(f->cursor == Cursor(1, 4));
+
+  // `_` is part of a word.
+  f->cursor = Cursor(1, 8);
+  typeText("*");
+  assert(g_editor.searchNeedle == "h_1");
+  assert(f->cursor == Cursor(0, 9));
+
+  // a needle typed after `/` matches inside of words again.
+  typeText("/");
+  typeText("h");
+  pressKey(SDLK_RETURN);
+  assert(!g_editor.searchWholeWord);
+  assert(f->cursor == Cursor(0, 15));
+}
+
+int main() {
+  test1();
+  test2();
+  test3();
+  test4();
+  test5();
+  return 0;
+}
@@ -0,0 +1,175 @@
+#include "algorithms/loadfilerows.h"
+#include "algorithms/savefilerows.h"
+#include "datastructures/filesaver.h"
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+
+std::string readFile(const std::filesystem::path& path) {
+  FILE* fp = fopen(path.c_str(), "rb");
+  assert(fp);
+  std::string out;
+  char buf[4096];
+  int n = 0;
+  while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+    out.append(buf, n);
+  }
+  fclose(fp);
+  return out;
+}
+
+Rope<abuf> ropeOfRows(const std::vector<std::string>& rows) {
+  std::vector<abuf> bufs;
+  for (const std::string& row : rows) {
+    bufs.push_back(abuf::from_copy_str(row.c_str()));
+  }
+  return Rope<abuf>(std::move(bufs));
+}
+
+void save(const std::filesystem::path& path, const Rope<abuf>& rows) {
+  const bool saved = saveFileRows(path, rows);
+  assert(saved);
+}
+
+// no temporary files are left behind next to `path`.
+void assertNoTempFiles(const std::filesystem::path& path) {
+  for (const auto& entry : std::filesystem::directory_iterator(path.parent_path())) {
+    const std::string name = entry.path().filename().string();
+    assert(name.find(".save-") == std::string::npos);
+  }
+}
+
+void test1() {
+  printf("### testing [saveFileRows]\n");
+  const std::filesystem::path path = std::filesystem::absolute("filesaver_test.txt");
+  save(path, ropeOfRows({}));
+  assert(readFile(path) == "");
+  save(path, ropeOfRows({ "" }));
+  assert(readFile(path) == "");
+  save(path, ropeOfRows({ "a", "", "bc" }));
+  assert(readFile(path) == "a\n\nbc");
+
+  // keeps the permissions of the file it replaces.
+  chmod(path.c_str(), 0640);
+  save(path, ropeOfRows({ "x" }));
+  struct stat st;
+  int rc = stat(path.c_str(), &st);
+  assert(rc == 0);
+  assert((st.st_mode & 0777) == 0640);
+
+  // a new file gets `0666 & ~umask`, not the `0600` of a temporary file.
+  remove(path.c_str());
+  const mode_t mask = umask(0);
+  umask(mask);
+  save(path, ropeOfRows({ "x" }));
+  rc = stat(path.c_str(), &st);
+  assert(rc == 0);
+  assert((st.st_mode & 0777) == (0666 & ~mask));
+
+  // saving through a symlink replaces its target, and keeps the link.
+  const std::filesystem::path link = std::filesystem::absolute("filesaver_test_link.txt");
+  remove(link.c_str());
+  std::filesystem::create_symlink(path.filename(), link);
+  save(link, ropeOfRows({ "through", "link" }));
+  assert(std::filesystem::is_symlink(link));
+  assert(readFile(path) == "through\nlink");
+  remove(link.c_str());
+
+  // more rows than fit in one `writev` batch.
+  std::vector<std::string> rows;
+  std::string expected;
+  for (int i = 0; i < 5000; ++i) {
+    rows.push_back(std::to_string(i * i));
+    expected += (i > 0 ? "\n" : "") + rows.back();
+  }
+  save(path, ropeOfRows(rows));
+  assert(readFile(path) == expected);
+  assertNoTempFiles(path);
+
+  // failure leaves no file behind.
+  const std::filesystem::path bad = std::filesystem::absolute("filesaver_no_such_dir/x.txt");
+  const bool saved = saveFileRows(bad, ropeOfRows({ "a" }));
+  assert(!saved);
+  assert(errno == ENOENT);
+  remove(path.c_str());
+}
+
+void test2() {
+  printf("### testing [save rows that borrow from a load arena]\n");
+  const std::filesystem::path path = std::filesystem::absolute("filesaver_test.txt");
+  std::string contents;
+  for (int i = 0; i < 1000; ++i) {
+    contents += std::string(i % 70, 'a' + i % 26) + "\n";
+  }
+  contents += "last";
+  FILE* fp = fopen(path.c_str(), "wb");
+  fwrite(contents.data(), 1, contents.size(), fp);
+  fclose(fp);
+
+  LoadedFileRows loaded;
+  const bool ok = loadFileRows(path, &loaded);
+  assert(ok);
+  Rope<abuf> rows(std::move(loaded.rows));
+  // rewriting the file we loaded from must not disturb the borrowed rows.
+  save(path, rows);
+  assert(readFile(path) == contents);
+  save(path, rows);
+  assert(readFile(path) == contents);
+  remove(path.c_str());
+}
+
+void test3() {
+  printf("### testing [FileSaver writes snapshots in the background]\n");
+  const std::filesystem::path path = std::filesystem::absolute("filesaver_test.txt");
+  FileSaver saver;
+  FileSaveResult result;
+  bool finished = saver.pollFinished(&result);
+  assert(!finished);
+
+  Rope<abuf> rows = ropeOfRows({ "first", "second" });
+  saver.save(path, rows, nullptr);
+  // edits after the save was queued are not part of it.
+  rows.getMut(0).appendstr(" edited");
+  rows.push_back(abuf::from_copy_str("third"));
+  saver.drain();
+  assert(saver.ninflight() == 0);
+  finished = saver.pollFinished(&result);
+  assert(finished);
+  assert(result.ok && result.path == path);
+  finished = saver.pollFinished(&result);
+  assert(!finished);
+  assert(readFile(path) == "first\nsecond");
+
+  // many saves of the same path end with the last snapshot on disk.
+  for (int i = 0; i < 100; ++i) {
+    rows.getMut(0).appendChar('!');
+    saver.save(path, rows, nullptr);
+  }
+  saver.drain();
+  int nresults = 0;
+  while (saver.pollFinished(&result)) {
+    assert(result.ok);
+    nresults++;
+  }
+  assert(nresults >= 1 && nresults <= 100);
+  assert(readFile(path) == "first edited" + std::string(100, '!') + "\nsecond\nthird");
+
+  // failures are reported, not fatal.
+  const std::filesystem::path bad = std::filesystem::absolute("filesaver_no_such_dir/x.txt");
+  saver.save(bad, rows, nullptr);
+  saver.drain();
+  finished = saver.pollFinished(&result);
+  assert(finished);
+  assert(!result.ok && result.err == ENOENT && result.path == bad);
+  remove(path.c_str());
+}
+
+int main() {
+  test1();
+  test2();
+  test3();
+  return 0;
+}
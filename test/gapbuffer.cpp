@@ -0,0 +1,67 @@
+#include "datastructures/gapbuffer.h"
+#include "datastructures/utf8.h"
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+const char *strs[] = {"$", "£", "ह", "𐍈", "∀", "x"};
+const int NSTRS = sizeof(strs) / sizeof(strs[0]);
+
+int naive_byte_ix(const std::string &s, int ix) {
+  int b = 0;
+  for (int i = 0; i < ix; ++i) { b += utf8_next_code_point_len(s.c_str() + b); }
+  return b;
+}
+
+void check(const GapBuffer &gap, const std::string &expected) {
+  const abuf buf = gap.toAbuf();
+  assert(buf.len() == (int)expected.size());
+  assert(memcmp(buf.buf(), expected.c_str(), expected.size()) == 0);
+  assert(gap.nbytes().size == (int)expected.size());
+  assert(gap.ncodepoints() == buf.ncodepoints());
+  // the text before the gap is a contiguous prefix.
+  const int b = naive_byte_ix(expected, gap.gapCodepoint().size);
+  assert(gap.nbytesBeforeGap().size == b);
+  assert(memcmp(gap.beforeGap(), expected.c_str(), b) == 0);
+}
+
+void test1() {
+  printf("### testing [typing and deleting at a moving cursor]\n");
+  GapBuffer gap = GapBuffer::fromAbuf(abuf::from_copy_str("hello £ world"), Size<Codepoint>(5));
+  std::string expected = "hello £ world";
+  int cursor = 5;
+  check(gap, expected);
+  unsigned seed = 5;
+  for (int i = 0; i < 3000; ++i) {
+    seed = seed * 1103515245 + 12345;
+    const int n = gap.ncodepoints().size;
+    const int op = (seed >> 16) % 8;
+    if (op == 0) {
+      cursor = (seed >> 4) % (n + 1);
+      gap.moveGapTo(Size<Codepoint>(cursor));
+    } else if (op == 1 && cursor > 0) {
+      gap.delCodepointBeforeGap();
+      cursor--;
+      const int b = naive_byte_ix(expected, cursor);
+      expected.erase(b, utf8_next_code_point_len(expected.c_str() + b));
+    } else if (op == 2 && cursor < n) {
+      gap.delCodepointAfterGap();
+      const int b = naive_byte_ix(expected, cursor);
+      expected.erase(b, utf8_next_code_point_len(expected.c_str() + b));
+    } else {
+      const char *cp = strs[(seed >> 8) % NSTRS];
+      expected.insert(naive_byte_ix(expected, cursor), cp);
+      gap.insertCodepointAtGap(cp);
+      cursor++;
+    }
+    assert(gap.gapCodepoint().size == cursor);
+    if (i % 100 == 0) { check(gap, expected); }
+  }
+  check(gap, expected);
+  printf("  ncodepoints: %d\n", gap.ncodepoints().size);
+}
+
+int main() {
+  test1();
+  return 0;
+}
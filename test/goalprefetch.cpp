@@ -0,0 +1,199 @@
+#include "datastructures/goalprefetch.h"
+#include <assert.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+using Clock = GoalPrefetcher::Clock;
+
+std::vector<Cursor> targets(const std::vector<std::string>& rows, int top, int bottom, Cursor cursor) {
+  return goalPrefetchTargets(rows.size(), top, bottom, cursor,
+    [&rows](int r) { return std::string_view(rows[r]); });
+}
+
+std::vector<int> targetRows(const std::vector<Cursor>& cs) {
+  std::vector<int> out;
+  for (const Cursor& c : cs) {
+    out.push_back(c.row);
+  }
+  return out;
+}
+
+json_object_ptr response(const char* json) {
+  json_object_ptr o(json_tokener_parse(json));
+  assert(o);
+  return o;
+}
+
+const std::vector<std::string> PROOF = {
+  "theorem foo (n : Nat)", // 0
+  "    (h : 0 < n) : n ≠ 0 := by", // 1
+  "  intro hn", // 2
+  "  -- a comment by", // 3
+  "", // 4
+  "  have h' : 0 < 0 := by", // 5
+  "    rw [hn] at h", // 6
+  "    exact h", // 7
+  "  exact Nat.lt_irrefl 0 h'", // 8
+  "", // 9
+  "def bar : Nat :=", // 10
+  "  let x := 1", // 11
+  "  x + 1", // 12
+  "example : True := by trivial", // 13
+  "example : True := by", // 14
+  "  · simp", // 15
+  "    done", // 16
+};
+
+void test1() {
+  printf("### testing [prefetch targets the tactic rows, nearest the cursor first]\n");
+  std::vector<Cursor> cs = targets(PROOF, 0, PROOF.size(), Cursor(7, 2));
+  assert(targetRows(cs) == std::vector<int>({ 8, 6, 5, 2, 15, 16 }));
+  // where `j` and `k` land: the column is clamped to every row passed,
+  // blank rows included.
+  assert(cs[0] == Cursor(8, 2));
+  assert(cs[1] == Cursor(6, 2));
+  assert(cs[3] == Cursor(2, 0));
+  assert(cs[4] == Cursor(15, 0));
+
+  // a window in the middle of a proof still knows it is in one.
+  cs = targets(PROOF, 6, 9, Cursor(6, 100));
+  assert(targetRows(cs) == std::vector<int>({ 7, 8 }));
+  assert(cs[0] == Cursor(7, 11));
+  assert(cs[1] == Cursor(8, 11));
+
+  // a cursor outside of the window steps into it.
+  cs = targets(PROOF, 14, 17, Cursor(0, 3));
+  assert(targetRows(cs) == std::vector<int>({ 15, 16 }));
+  assert(cs[0] == Cursor(15, 3));
+
+  assert(targets(PROOF, 9, 14, Cursor(10, 0)).empty());
+  assert(targets(PROOF, 5, 5, Cursor(5, 0)).empty());
+  assert(targets({}, 0, 50, Cursor(0, 0)).empty());
+}
+
+void test2() {
+  printf("### testing [prefetch waits for the user to be idle, and fetches one position at a time]\n");
+  GoalPrefetcher p;
+  const Clock::time_point t0 = Clock::now();
+  bool cancelled = p.observe(Cursor(7, 2), 0, 1, false, t0);
+  assert(!cancelled);
+  assert(!p.idle(t0 + GOAL_PREFETCH_IDLE_DELAY / 2));
+  const Clock::time_point t1 = t0 + GOAL_PREFETCH_IDLE_DELAY;
+  cancelled = p.observe(Cursor(7, 2), 0, 1, false, t1);
+  assert(!cancelled);
+  assert(p.idle(t1));
+  assert(!p.planned());
+  p.plan(targets(PROOF, 0, PROOF.size(), Cursor(7, 2)));
+  assert(p.planned());
+
+  std::optional<Cursor> at = p.next(t1);
+  assert(at && *at == Cursor(8, 2));
+  assert(p.inFlight());
+  at = p.next(t1);
+  assert(!at);
+  p.plainGoal.response = response("{\"id\":1,\"result\":{\"goals\":[\"⊢ False\"]}}");
+  p.plainTermGoal.response = response("{\"id\":2,\"result\":null}");
+  p.finish();
+  assert(!p.inFlight());
+  assert(!p.plainGoal.response && !p.plainTermGoal.response);
+
+  at = p.next(t1);
+  assert(at && *at == Cursor(6, 2));
+  // moving replans around the new cursor, without what is in flight, and
+  // the user is not idle anymore.
+  const Clock::time_point t2 = t1 + std::chrono::milliseconds(10);
+  cancelled = p.observe(Cursor(5, 2), 0, 1, false, t2);
+  assert(!cancelled);
+  assert(!p.planned() && !p.idle(t2));
+  p.plan(targets(PROOF, 0, PROOF.size(), Cursor(5, 2)));
+  assert(p.nplanned() == 5);
+  at = p.next(t2);
+  assert(!at);
+  assert(p.inFlightAt() == Cursor(6, 2));
+  p.finish();
+  at = p.next(t2);
+  assert(at && *at == Cursor(7, 2));
+}
+
+void test3() {
+  printf("### testing [prefetch is cancelled by an edit]\n");
+  GoalPrefetcher p;
+  const Clock::time_point t0 = Clock::now();
+  p.observe(Cursor(7, 2), 0, 1, false, t0);
+  p.plan(targets(PROOF, 0, PROOF.size(), Cursor(7, 2)));
+  std::optional<Cursor> at = p.next(t0);
+  assert(at);
+  p.plainGoal.response = response("{\"id\":1,\"result\":null}");
+  p.plainTermGoal.response = response("{\"id\":2,\"result\":null}");
+  p.finish();
+  at = p.next(t0);
+  assert(at);
+  // a move does not cancel what is in flight.
+  bool cancelled = p.observe(Cursor(7, 3), 0, 1, false, t0);
+  assert(!cancelled);
+  assert(p.inFlight());
+  // the user types: the server does not have the text yet.
+  cancelled = p.observe(Cursor(7, 3), 0, 1, true, t0);
+  assert(cancelled);
+  assert(!p.inFlight());
+  assert(!p.plainGoal.response && !p.plainTermGoal.response);
+  // the text is sent: nothing was in flight.
+  cancelled = p.observe(Cursor(7, 3), 0, 2, false, t0);
+  assert(!cancelled);
+  assert(!p.idle(t0 + GOAL_PREFETCH_IDLE_DELAY / 2));
+}
+
+void test4() {
+  printf("### testing [prefetch sends at most its budget of requests in any minute]\n");
+  GoalPrefetcher p;
+  const Clock::time_point t0 = Clock::now();
+  std::vector<std::string> rows = { "example : True := by" };
+  for (int i = 0; i < 2 * GOAL_PREFETCH_BUDGET_PER_MINUTE; ++i) {
+    rows.push_back("  skip");
+  }
+  p.observe(Cursor(0, 0), 0, 1, false, t0);
+  p.plan(targets(rows, 0, rows.size(), Cursor(0, 0)));
+  int nfetched = 0;
+  auto fetchAll = [&](Clock::time_point now) {
+    while (p.next(now)) {
+      p.plainGoal.response = response("{\"result\":null}");
+      p.plainTermGoal.response = response("{\"result\":null}");
+      p.finish();
+      nfetched++;
+    }
+  };
+  fetchAll(t0);
+  assert(nfetched * GOAL_PREFETCH_REQUESTS_PER_POSITION == GOAL_PREFETCH_BUDGET_PER_MINUTE);
+  fetchAll(t0 + std::chrono::seconds(59));
+  assert(nfetched * GOAL_PREFETCH_REQUESTS_PER_POSITION == GOAL_PREFETCH_BUDGET_PER_MINUTE);
+  fetchAll(t0 + std::chrono::seconds(60));
+  assert(nfetched * GOAL_PREFETCH_REQUESTS_PER_POSITION == 2 * GOAL_PREFETCH_BUDGET_PER_MINUTE);
+}
+
+void bench() {
+  printf("### benchmarking [prefetch planning in a long proof]\n");
+  std::vector<std::string> rows = { "theorem big : True := by" };
+  for (int i = 0; i < 100000; ++i) {
+    rows.push_back(i % 10 == 0 ? "  have h : True := by" : "    simp only [foo, bar, baz] at h ⊢");
+  }
+  const int N = 2000;
+  const Clock::time_point start = Clock::now();
+  size_t ntargets = 0;
+  for (int i = 0; i < N; ++i) {
+    const int top = (i * 7) % (rows.size() - 60);
+    ntargets += targets(rows, top, top + 60, Cursor(top + 30, 8)).size();
+  }
+  const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  printf("  %d plans of a 60 row window in %.3fs | %.1f us/plan | %.1f targets/plan\n",
+    N, seconds, 1e6 * seconds / N, (double)ntargets / N);
+}
+
+int main() {
+  test1();
+  test2();
+  test3();
+  test4();
+  bench();
+  return 0;
+}
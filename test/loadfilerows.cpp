@@ -0,0 +1,81 @@
+#include "algorithms/loadfilerows.h"
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+// split `contents` at '\n', dropping trailing '\r', like `std::getline` would.
+std::vector<std::string> naiveSplit(const std::string& contents) {
+  std::vector<std::string> rows;
+  size_t begin = 0;
+  while (begin < contents.size()) {
+    size_t end = contents.find('\n', begin);
+    const size_t next = end == std::string::npos ? contents.size() : end + 1;
+    if (end == std::string::npos) {
+      end = contents.size();
+    }
+    while (end > begin && contents[end - 1] == '\r') {
+      end--;
+    }
+    rows.push_back(contents.substr(begin, end - begin));
+    begin = next;
+  }
+  return rows;
+}
+
+void checkLoad(const std::string& contents) {
+  const char* path = "loadfilerows_test.txt";
+  FILE* fp = fopen(path, "wb");
+  fwrite(contents.c_str(), 1, contents.size(), fp);
+  fclose(fp);
+
+  LoadedFileRows loaded;
+  const bool ok = loadFileRows(std::filesystem::absolute(path), &loaded);
+  assert(ok);
+  const std::vector<std::string> expected = naiveSplit(contents);
+  assert(loaded.rows.size() == expected.size());
+  for (int i = 0; i < (int)expected.size(); ++i) {
+    assert(loaded.rows[i].to_std_string() == expected[i]);
+  }
+  assert(loaded.isValidUtf8);
+
+  // edits copy the borrowed bytes rather than writing through them.
+  if (!loaded.rows.empty() && loaded.rows[0].len() > 0) {
+    abuf copy = loaded.rows[0];
+    loaded.rows[0].delCodepointAt(Ix<Codepoint>(0));
+    assert(copy.to_std_string() == expected[0]);
+    assert(loaded.rows[0].to_std_string() == expected[0].substr(1));
+  }
+  remove(path);
+}
+
+void test1() {
+  printf("### testing [small files]\n");
+  checkLoad("");
+  checkLoad("\n");
+  checkLoad("a");
+  checkLoad("a\nb");
+  checkLoad("a\r\nb\r\n\n");
+  checkLoad("theorem foo : ∀ n : ℕ, n = n := by\n  intro n\n  rfl\n");
+}
+
+void test2() {
+  printf("### testing [large file, split across threads]\n");
+  std::string contents;
+  unsigned seed = 17;
+  while (contents.size() < (8u << 20)) {
+    seed = seed * 1103515245 + 12345;
+    // mix of short (inline) and long (borrowed) rows.
+    const int len = (seed >> 16) % 2 ? (seed >> 8) % 20 : 40 + (seed >> 8) % 200;
+    contents += std::string(len, 'a' + (seed >> 4) % 26);
+    contents += (seed >> 20) % 8 == 0 ? "\r\n" : "\n";
+  }
+  checkLoad(contents);
+}
+
+int main() {
+  test1();
+  test2();
+  return 0;
+}
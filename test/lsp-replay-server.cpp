@@ -0,0 +1,145 @@
+// Stands in for a lean server by playing back a capture (see `LspCaptureWriter`):
+//
+//   lsp-replay-server <capture> [<speed>]
+//
+// Sends the server's messages of the capture, in order. Each one waits until
+// the client has sent as many messages as it had in the capture when the
+// message was sent, and then for as long after the last of them as in the
+// capture, divided by <speed> (1 by default; 0 sends as soon as the client
+// allows). Requests are matched by their position among the client's
+// messages, and responses carry the ID the live client gave the request, so
+// it may number its requests differently than the captured client did.
+#include "datastructures/lspcapture.h"
+#include "datastructures/lspframer.h"
+#include <assert.h>
+#include <map>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+using Clock = std::chrono::steady_clock;
+
+// a server message of the capture.
+struct Send {
+  int anchor; // index of the last client message before it, or `-1`.
+  int64_t delayMicros; // after the anchor, or after the start if there is none.
+  json_object_ptr msg;
+};
+
+struct Replay {
+  std::vector<json_object_ptr> capturedClient;
+  std::vector<Clock::time_point> arrivals; // of the live client's messages.
+  std::map<int, int> capturedToLiveId;
+  LspFramer framer;
+  bool clientClosed = false;
+
+  // the ID of the request `o`, or `-1` if it is not a request.
+  static int requestId(json_object* o) {
+    json_object* ido = NULL;
+    if (!json_object_object_get_ex(o, "id", &ido) || !json_object_object_get_ex(o, "method", NULL)) {
+      return -1;
+    }
+    return json_object_get_int(ido);
+  }
+
+  void onClientMessage(json_object* o) {
+    const int k = this->arrivals.size();
+    this->arrivals.push_back(Clock::now());
+    if (k < (int)this->capturedClient.size()) {
+      const int captured = requestId(this->capturedClient[k]);
+      const int live = requestId(o);
+      if (captured != -1 && live != -1) {
+        this->capturedToLiveId[captured] = live;
+      }
+    }
+    json_object_put(o);
+  }
+
+  // wait up to `timeoutMs` (`-1`: forever) for the client, and handle what it sent.
+  void pump(int timeoutMs) {
+    struct pollfd fd = {};
+    fd.fd = STDIN_FILENO;
+    fd.events = POLLIN;
+    if (poll(&fd, 1, timeoutMs) <= 0) {
+      return;
+    }
+    char buf[1 << 16];
+    const int nread = read(STDIN_FILENO, buf, sizeof(buf));
+    if (nread <= 0) {
+      this->clientClosed = true;
+      return;
+    }
+    this->framer.feed(buf, nread, [this](json_object* o) { this->onClientMessage(o); });
+  }
+
+  void send(json_object* o) {
+    json_object* ido = NULL;
+    if (json_object_object_get_ex(o, "id", &ido) && !json_object_object_get_ex(o, "method", NULL)) {
+      auto it = this->capturedToLiveId.find(json_object_get_int(ido));
+      if (it != this->capturedToLiveId.end()) {
+        json_object_object_add(o, "id", json_object_new_int(it->second));
+      }
+    }
+    const char* body = json_object_to_json_string_ext(o, JSON_C_TO_STRING_PLAIN);
+    fprintf(stdout, "Content-Length: %d\r\n\r\n%s", (int)strlen(body), body);
+    fflush(stdout);
+  }
+};
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s <capture> [<speed>]\n", argv[0]);
+    return 1;
+  }
+  std::vector<LspCaptureRecord> records;
+  if (!lspCaptureRead(argv[1], &records)) {
+    fprintf(stderr, "unable to read capture '%s'\n", argv[1]);
+    return 1;
+  }
+  const double speed = argc > 2 ? atof(argv[2]) : 1.0;
+  // a client that hangs up should end the replay, not kill it.
+  signal(SIGPIPE, SIG_IGN);
+
+  Replay replay;
+  std::vector<int64_t> capturedClientMicros;
+  std::vector<Send> sends;
+  for (LspCaptureMessage& m : lspCaptureMessages(records)) {
+    if (m.dir == LCD_ClientToServer) {
+      replay.capturedClient.push_back(m.msg);
+      capturedClientMicros.push_back(m.tMicros);
+      continue;
+    }
+    Send s;
+    s.anchor = (int)capturedClientMicros.size() - 1;
+    s.delayMicros = m.tMicros - (s.anchor == -1 ? 0 : capturedClientMicros[s.anchor]);
+    s.msg = m.msg;
+    sends.push_back(std::move(s));
+  }
+
+  const Clock::time_point start = Clock::now();
+  for (Send& s : sends) {
+    while ((int)replay.arrivals.size() <= s.anchor && !replay.clientClosed) {
+      replay.pump(-1);
+    }
+    const Clock::time_point base = s.anchor == -1 ? start : replay.arrivals[s.anchor];
+    const Clock::time_point due = speed > 0
+      ? base + std::chrono::microseconds((int64_t)(s.delayMicros / speed))
+      : base;
+    for (Clock::time_point now = Clock::now(); now < due && !replay.clientClosed; now = Clock::now()) {
+      const int64_t waitMs = std::chrono::duration_cast<std::chrono::milliseconds>(due - now).count();
+      replay.pump(waitMs + 1);
+    }
+    if (replay.clientClosed) {
+      return 0;
+    }
+    replay.send(s.msg);
+  }
+  // the client may still write, and expects to be read until it hangs up.
+  while (!replay.clientClosed) {
+    replay.pump(-1);
+  }
+  return 0;
+}
@@ -0,0 +1,210 @@
+#include "datastructures/lspchangelog.h"
+#include "datastructures/rowseditlog.h"
+#include "datastructures/utf8.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+// rows that log their edits for undo and for the server, like `FileConfigUndoState`.
+struct Lines {
+  Rope<abuf> rows;
+  RowsEditLog rowsLog;
+  LspChangeLog leanLog;
+
+  abuf& getMut(int at) {
+    leanLog.getMut(rows, at);
+    return rowsLog.getMut(rows, at);
+  }
+
+  void insert(int at, const std::string& s) {
+    leanLog.close(rows);
+    rowsLog.insert(rows, at, abuf::from_copy_buf(s.data(), s.size()));
+    leanLog.replaced(rows, at, nullptr, 0, 1);
+  }
+
+  void erase(int at) {
+    leanLog.close(rows);
+    const abuf deleted = rows[at];
+    rowsLog.erase(rows, at);
+    leanLog.replaced(rows, at, &deleted, 1, 0);
+  }
+
+  void replay(const std::vector<RowsEdit>& edits, bool forward) {
+    leanLog.close(rows);
+    const int n = edits.size();
+    for (int k = 0; k < n; ++k) {
+      const RowsEdit& edit = edits[forward ? k : n - 1 - k];
+      if (edit.inPlace()) {
+        leanLog.getMut(rows, edit.at);
+        RowsEditLog::replay(rows, edit, forward);
+        leanLog.close(rows);
+        continue;
+      }
+      RowsEditLog::replay(rows, edit, forward);
+      const std::vector<abuf>& deleted = forward ? edit.deleted : edit.inserted;
+      leanLog.replaced(rows, edit.at, deleted.data(), deleted.size(), forward ? edit.inserted.size() : edit.deleted.size());
+    }
+  }
+
+  std::string text() const {
+    std::string out;
+    rows.forEach([&](int r, const abuf& row) {
+      if (r > 0) {
+        out += '\n';
+      }
+      out.append(row.buf(), row.len());
+    });
+    return out;
+  }
+};
+
+// byte offset of the LSP position `p` in `text`, with columns in UTF-16 code units.
+int offsetOfPosition(const std::string& text, LspPosition p) {
+  int i = 0;
+  for (int row = 0; row < p.row; ++row) {
+    i = text.find('\n', i);
+    assert(i != (int)std::string::npos && "row past the end of the document");
+    i++;
+  }
+  int col = 0;
+  while (col < p.col) {
+    assert(i < (int)text.size() && text[i] != '\n' && "column past the end of the row");
+    const int len = utf8_next_code_point_len(text.data() + i);
+    col += utf8_count_utf16_code_units(text.data() + i, len);
+    i += len;
+  }
+  assert(col == p.col && "column inside a surrogate pair");
+  return i;
+}
+
+// the document as the server sees it after `changes`.
+void applyChanges(std::string* text, const std::vector<LspContentChange>& changes) {
+  for (const LspContentChange& change : changes) {
+    if (!change.range) {
+      *text = change.text;
+      continue;
+    }
+    const int start = offsetOfPosition(*text, change.range->start);
+    const int end = offsetOfPosition(*text, change.range->end);
+    assert(start <= end);
+    text->replace(start, end - start, change.text);
+  }
+}
+
+static const char* PIECES[] = { "a", "b", " ", "ℕ", "𝔸", "→", "xyz" };
+
+std::string randomPiece() {
+  return PIECES[rand() % (sizeof(PIECES) / sizeof(PIECES[0]))];
+}
+
+void test1() {
+  printf("### testing [typing into a row is a single small change]\n");
+  Lines lines;
+  lines.insert(0, "theorem foo : 1 = 1 := by");
+  lines.insert(1, "  rfl");
+  std::string server = lines.text();
+  lines.leanLog.take(lines.rows);
+
+  for (const char* s : { "s", "i", "m", "p" }) {
+    abuf& row = lines.getMut(1);
+    row.appendstr(s);
+  }
+  std::vector<LspContentChange> changes = lines.leanLog.take(lines.rows);
+  assert(changes.size() == 1);
+  assert(changes[0].range->start.row == 1 && changes[0].range->start.col == 5);
+  assert(changes[0].range->end.row == 1 && changes[0].range->end.col == 5);
+  assert(changes[0].text == "simp");
+  applyChanges(&server, changes);
+  assert(server == lines.text());
+  assert(lines.leanLog.empty());
+}
+
+void test2() {
+  printf("### testing [columns count UTF-16 code units]\n");
+  Lines lines;
+  lines.insert(0, "𝔸ℕ x");
+  lines.leanLog.take(lines.rows);
+  abuf& row = lines.getMut(0);
+  row.setBytes("𝔸ℕ y", strlen("𝔸ℕ y"));
+  std::vector<LspContentChange> changes = lines.leanLog.take(lines.rows);
+  assert(changes.size() == 1);
+  // '𝔸' is a surrogate pair, 'ℕ' a single unit.
+  assert(changes[0].range->start.col == 4 && changes[0].range->end.col == 5);
+  assert(changes[0].text == "y");
+}
+
+void test3() {
+  printf("### testing [changes replay the edits, including undo / redo]\n");
+  srand(42);
+  for (int iter = 0; iter < 200; ++iter) {
+    Lines lines;
+    const int ninit = rand() % 4;
+    for (int i = 0; i < ninit; ++i) {
+      lines.insert(i, randomPiece());
+    }
+    std::string server = lines.text();
+    lines.leanLog.take(lines.rows);
+    std::vector<std::vector<RowsEdit>> history;
+
+    for (int step = 0; step < 60; ++step) {
+      const int nrows = lines.rows.size();
+      const int op = rand() % 6;
+      if (op == 0 || nrows == 0) {
+        lines.insert(rand() % (nrows + 1), randomPiece() + randomPiece());
+      } else if (op == 1) {
+        lines.erase(rand() % nrows);
+      } else if (op == 2 || op == 3) {
+        // edit in place, sometimes repeatedly, sometimes to the same value.
+        abuf& row = lines.getMut(rand() % nrows);
+        std::string s = row.to_std_string();
+        const int at = utf8_byte_ix_of_code_point(s.data(), s.size(), rand() % (row.ncodepoints().size + 1));
+        s.insert(at, rand() % 4 == 0 ? "" : randomPiece());
+        row.setBytes(s.data(), s.size());
+      } else if (op == 4) {
+        history.push_back(lines.rowsLog.take(lines.rows));
+      } else if (!history.empty()) {
+        // undo the latest batch of edits, and sometimes redo it.
+        history.push_back(lines.rowsLog.take(lines.rows));
+        lines.replay(history.back(), /*forward=*/false);
+        if (rand() % 2) {
+          lines.replay(history.back(), /*forward=*/true);
+        } else {
+          history.pop_back();
+        }
+      }
+      if (rand() % 8 == 0) {
+        applyChanges(&server, lines.leanLog.take(lines.rows));
+        assert(server == lines.text());
+      }
+    }
+    applyChanges(&server, lines.leanLog.take(lines.rows));
+    assert(server == lines.text());
+  }
+}
+
+void test4() {
+  printf("### testing [too many changes become one change of the whole document]\n");
+  Lines lines;
+  lines.insert(0, "");
+  std::string server = lines.text();
+  lines.leanLog.take(lines.rows);
+  for (int i = 0; i < 2 * LSP_CHANGELOG_MAX_CHANGES; ++i) {
+    lines.insert(i % 2, std::to_string(i));
+  }
+  std::vector<LspContentChange> changes = lines.leanLog.take(lines.rows);
+  assert(changes.size() == 1 && !changes[0].range);
+  applyChanges(&server, changes);
+  assert(server == lines.text());
+  changes = lines.leanLog.take(lines.rows);
+  assert(changes.empty());
+}
+
+int main() {
+  test1();
+  test2();
+  test3();
+  test4();
+  return 0;
+}
@@ -0,0 +1,272 @@
+// talks to `fake-lean-server`, whose path is the first argument, and
+// measures the client's transport on the loads it can produce.
+#include "datastructures/lspiothread.h"
+#include "datastructures/lspresponsestore.h"
+#include "lsptestutil.h"
+#include "subprocess.h"
+#include <assert.h>
+#include <fcntl.h>
+#include <map>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+const char* g_fakeServer = nullptr;
+const char* const URI = "file:///tmp/elide-lspfakeserver.lean";
+
+std::string request(int id, const char* method, const std::string& params) {
+  return "{\"jsonrpc\":\"2.0\",\"id\":" + std::to_string(id) + ",\"method\":\"" + method + "\",\"params\":" + params + "}";
+}
+
+std::string notification(const char* method, const std::string& params) {
+  return std::string("{\"jsonrpc\":\"2.0\",\"method\":\"") + method + "\",\"params\":" + params + "}";
+}
+
+std::string positionParams(int line, int character) {
+  return std::string("{\"textDocument\":{\"uri\":\"") + URI + "\"},\"position\":{\"line\":"
+    + std::to_string(line) + ",\"character\":" + std::to_string(character) + "}}";
+}
+
+std::string didOpenParams(int version, const std::string& text) {
+  return std::string("{\"textDocument\":{\"uri\":\"") + URI + "\",\"languageId\":\"lean\",\"version\":"
+    + std::to_string(version) + ",\"text\":\"" + text + "\"}}";
+}
+
+// `o[key]`, which must exist.
+json_object* field(json_object* o, const char* key) {
+  json_object* v = nullptr;
+  const bool found = json_object_object_get_ex(o, key, &v);
+  assert(found);
+  return v;
+}
+
+// a fake server, launched with `args`, and a client talking to it.
+struct FakeSession {
+  subprocess_s process;
+  std::unique_ptr<LspIoThread> io;
+
+  explicit FakeSession(std::vector<const char*> args) {
+    args.insert(args.begin(), g_fakeServer);
+    args.push_back(NULL);
+    // as `LeanServerState` launches servers: only our end is non-blocking.
+    const int options = subprocess_option_inherit_environment | subprocess_option_enable_async;
+    int rc = subprocess_create(NULL, args.data(), options, &this->process);
+    assert(rc == 0);
+    const int stdoutFd = fileno(subprocess_stdout(&this->process));
+    rc = fcntl(stdoutFd, F_SETFL, fcntl(stdoutFd, F_GETFL) | O_NONBLOCK);
+    assert(rc == 0);
+    this->io = std::make_unique<LspIoThread>(stdoutFd, subprocess_stdin(&this->process));
+  }
+
+  ~FakeSession() {
+    this->io.reset();
+    // hang up, so that the server exits.
+    fclose(this->process.stdin_file);
+    this->process.stdin_file = NULL;
+    int ret = -1;
+    const int rc = subprocess_join(&this->process, &ret);
+    assert(rc == 0);
+    assert(ret == 0);
+    subprocess_destroy(&this->process);
+  }
+
+  // the next message from the server, waiting for it.
+  json_object_ptr read() {
+    while (true) {
+      if (json_object_ptr o = this->io->tryRead()) {
+        return o;
+      }
+      assert(!this->io->serverExited());
+      std::this_thread::yield();
+    }
+  }
+
+  // the next message, which must be the response to the request `id`.
+  json_object_ptr readResponse(int id) {
+    json_object_ptr o = this->read();
+    assert(json_object_get_int(field(o, "id")) == id);
+    return o;
+  }
+
+  // the next message, which must be a notification of `method`; its params.
+  json_object_ptr readNotification(const char* method) {
+    json_object_ptr o = this->read();
+    assert(strcmp(json_object_get_string(field(o, "method")), method) == 0);
+    return json_object_ptr(json_object_get(field(o, "params")));
+  }
+};
+
+// check the notifications of an elaboration of `version`, with `nprogress`
+// progress steps and `ndiagnostics` diagnostics over `nlines` lines.
+void checkElaboration(FakeSession& s, int version, int nprogress, int ndiagnostics, int nlines) {
+  for (int i = 0; i < nprogress; ++i) {
+    json_object_ptr p = s.readNotification("$/lean/fileProgress");
+    assert(json_object_get_int(field(field(p, "textDocument"), "version")) == version);
+    assert(json_object_array_length(field(p, "processing")) == 1);
+  }
+  json_object_ptr d = s.readNotification("textDocument/publishDiagnostics");
+  assert(strcmp(json_object_get_string(field(d, "uri")), URI) == 0);
+  assert(json_object_get_int(field(d, "version")) == version);
+  json_object* ds = field(d, "diagnostics");
+  assert((int)json_object_array_length(ds) == ndiagnostics);
+  int maxLine = -1;
+  for (int i = 0; i < ndiagnostics; ++i) {
+    json_object* di = json_object_array_get_idx(ds, i);
+    const int line = json_object_get_int(field(field(field(di, "range"), "start"), "line"));
+    const int severity = json_object_get_int(field(di, "severity"));
+    assert(severity >= 1 && severity <= 4);
+    field(di, "message");
+    maxLine = std::max(maxLine, line);
+  }
+  assert(maxLine == std::min(ndiagnostics, nlines) - 1);
+  json_object_ptr done = s.readNotification("$/lean/fileProgress");
+  assert(json_object_array_length(field(done, "processing")) == 0);
+}
+
+void test1() {
+  printf("### testing [fake server answers what the client asks]\n");
+  FakeSession s({ "--progress", "3", "--diagnostics", "5", "--goals", "2", "--goal-bytes", "200",
+    "--completions", "4" });
+  s.io->write(frame(request(1, "initialize", "{}")));
+  json_object_ptr init = s.readResponse(1);
+  field(field(field(init, "result"), "capabilities"), "textDocumentSync");
+  s.io->write(frame(notification("initialized", "{}")));
+
+  s.io->write(frame(notification("textDocument/didOpen", didOpenParams(0, "a\\nb\\nc"))));
+  checkElaboration(s, 0, 3, 5, 3);
+  // two lines more, at the start.
+  s.io->write(frame(notification("textDocument/didChange",
+    std::string("{\"textDocument\":{\"uri\":\"") + URI + "\",\"version\":1},\"contentChanges\":["
+      + "{\"range\":{\"start\":{\"line\":0,\"character\":0},\"end\":{\"line\":0,\"character\":0}},"
+      + "\"text\":\"x\\ny\\n\"}]}")));
+  checkElaboration(s, 1, 3, 5, 5);
+  // the whole text, of one line.
+  s.io->write(frame(notification("textDocument/didChange",
+    std::string("{\"textDocument\":{\"uri\":\"") + URI + "\",\"version\":2},\"contentChanges\":["
+      + "{\"text\":\"z\"}]}")));
+  checkElaboration(s, 2, 3, 5, 1);
+
+  s.io->write(frame(request(2, "$/lean/plainGoal", positionParams(0, 0))));
+  json_object_ptr goal = s.readResponse(2);
+  json_object* goals = field(field(goal, "result"), "goals");
+  assert(json_object_array_length(goals) == 2);
+  for (int i = 0; i < 2; ++i) {
+    assert(json_object_get_string_len(json_object_array_get_idx(goals, i)) == 200);
+  }
+  field(field(goal, "result"), "rendered");
+
+  s.io->write(frame(request(3, "$/lean/plainTermGoal", positionParams(0, 1))));
+  json_object_ptr termGoal = s.readResponse(3);
+  assert(json_object_get_string_len(field(field(termGoal, "result"), "goal")) == 200);
+
+  s.io->write(frame(request(4, "textDocument/hover", positionParams(0, 0))));
+  json_object_ptr hover = s.readResponse(4);
+  assert(json_object_get_string_len(field(field(field(hover, "result"), "contents"), "value")) == 200);
+
+  s.io->write(frame(request(5, "textDocument/completion", positionParams(0, 1))));
+  json_object_ptr completion = s.readResponse(5);
+  json_object* items = field(field(completion, "result"), "items");
+  assert(json_object_array_length(items) == 4);
+  for (int i = 0; i < 4; ++i) {
+    json_object* item = json_object_array_get_idx(items, i);
+    field(item, "label");
+    field(item, "detail");
+    assert(json_object_get_type(field(item, "kind")) == json_type_int);
+  }
+
+  s.io->write(frame(request(6, "textDocument/definition", positionParams(0, 0))));
+  json_object_ptr definition = s.readResponse(6);
+  json_object* link = json_object_array_get_idx(field(definition, "result"), 0);
+  assert(strcmp(json_object_get_string(field(link, "targetUri")), URI) == 0);
+  field(field(link, "targetSelectionRange"), "start");
+
+  s.io->write(frame(request(7, "textDocument/references", positionParams(0, 0))));
+  json_object_ptr unknown = s.readResponse(7);
+  assert(json_object_get_int(field(field(unknown, "error"), "code")) == -32601);
+
+  s.io->write(frame(request(8, "shutdown", "null")));
+  json_object_ptr shutdown = s.readResponse(8);
+  assert(field(shutdown, "result") == nullptr);
+}
+
+void test2() {
+  printf("### testing [fake server latency and cancellation]\n");
+  const int latencyMs = 100;
+  FakeSession s({ "--latency-ms", "100" });
+  const Clock::time_point start = Clock::now();
+  s.io->write(frame(request(1, "$/lean/plainGoal", positionParams(0, 0))));
+  s.io->write(frame(notification("$/cancelRequest", "{\"id\":1}")));
+  s.io->write(frame(request(2, "textDocument/hover", positionParams(0, 0))));
+  // cancelling a request that was answered does nothing.
+  s.io->write(frame(notification("$/cancelRequest", "{\"id\":42}")));
+
+  json_object_ptr cancelled = s.readResponse(1);
+  assert(json_object_get_int(field(field(cancelled, "error"), "code")) == -32800);
+  json_object_ptr hover = s.readResponse(2);
+  field(hover, "result");
+  assert(Clock::now() - start >= std::chrono::milliseconds(latencyMs));
+}
+
+// the time for `n` messages to arrive, once `send` was written.
+double timeMessages(FakeSession& s, const std::string& send, int n, LspResponseStore* responses) {
+  const Clock::time_point start = Clock::now();
+  s.io->write(send);
+  // dispatch as `LeanServerState::tick_nonblocking` does.
+  for (int i = 0; i < n; ++i) {
+    json_object_ptr o = s.read();
+    json_object* ido = nullptr;
+    if (json_object_object_get_ex(o, "id", &ido)) {
+      const int id = json_object_get_int(ido);
+      responses->insert(id, std::move(o), Clock::now());
+      const bool taken = (bool)responses->take(id);
+      assert(taken);
+    }
+  }
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+void bench() {
+  printf("### benchmarking [fake server storms through the LSP transport]\n");
+  const int nprogress = 1000;
+  const int ndiagnostics = 10000;
+  const int goalBytes = 5 * 1000 * 1000;
+  const int ncompletions = 20000;
+  const std::string nprogressArg = std::to_string(nprogress);
+  const std::string ndiagnosticsArg = std::to_string(ndiagnostics);
+  const std::string goalBytesArg = std::to_string(goalBytes);
+  const std::string ncompletionsArg = std::to_string(ncompletions);
+  FakeSession s({ "--progress", nprogressArg.c_str(), "--diagnostics", ndiagnosticsArg.c_str(),
+    "--goal-bytes", goalBytesArg.c_str(), "--completions", ncompletionsArg.c_str() });
+  LspResponseStore responses;
+
+  std::string text;
+  for (int i = 0; i < 1000; ++i) {
+    text += "theorem t" + std::to_string(i) + " : True := trivial\\n";
+  }
+  const double elaboration = timeMessages(s, frame(notification("textDocument/didOpen", didOpenParams(0, text))),
+    nprogress + 2, &responses);
+  printf("  %d progress notifications and %d diagnostics in %.3fs | %.0f diagnostics/s\n",
+    nprogress + 1, ndiagnostics, elaboration, ndiagnostics / elaboration);
+
+  const double goal = timeMessages(s, frame(request(1, "$/lean/plainGoal", positionParams(0, 0))), 1, &responses);
+  // the goal, and its rendering.
+  const double goalMb = 2 * goalBytes / (1000.0 * 1000.0);
+  printf("  %.0f MB goal in %.3fs | %.1f MB/s\n", goalMb, goal, goalMb / goal);
+
+  const double completion = timeMessages(s, frame(request(2, "textDocument/completion", positionParams(0, 0))), 1, &responses);
+  printf("  %d completion items in %.3fs | %.0f items/s\n", ncompletions, completion, ncompletions / completion);
+  assert(responses.size() == 0);
+}
+
+int main(int argc, char** argv) {
+  assert(argc == 2 && "usage: lspfakeserver <path to fake-lean-server>");
+  g_fakeServer = argv[1];
+  test1();
+  test2();
+  bench();
+  return 0;
+}
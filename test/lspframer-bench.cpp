@@ -0,0 +1,122 @@
+// throughput of `LspFramer` on synthetic multi-MB server output, against the
+// framer it replaced, which kept the unparsed output in an `abuf`, searched it
+// for each header, and created a tokener per message.
+#include "algorithms/search.h"
+#include "datastructures/abuf.h"
+#include "datastructures/lspframer.h"
+#include "lsptestutil.h"
+#include <assert.h>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+// many small notifications, as when lean reports progress and diagnostics.
+std::string notificationsStream(int nbytes) {
+  std::string out;
+  for (int i = 0; (int)out.size() < nbytes; ++i) {
+    out += frame("{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/publishDiagnostics\",\"params\":{\"uri\":\"file:///a/b.lean\",\"version\":"
+      + std::to_string(i) + ",\"diagnostics\":[{\"range\":{\"start\":{\"line\":" + std::to_string(i % 1000)
+      + ",\"character\":2},\"end\":{\"line\":" + std::to_string(i % 1000)
+      + ",\"character\":9}},\"severity\":1,\"message\":\"unknown identifier 'foo'\"}]}}");
+  }
+  return out;
+}
+
+// one large message, as a big goal state or completion list.
+std::string largeMessageStream(int nbytes) {
+  std::string body = "{\"jsonrpc\":\"2.0\",\"id\":1,\"result\":[";
+  for (int i = 0; (int)body.size() < nbytes; ++i) {
+    body += (i ? ",\"" : "\"") + std::string(100, 'a' + i % 26) + "\"";
+  }
+  body += "]}";
+  return frame(body);
+}
+
+// the replaced framer: parse the next message of `buf`, or return null.
+json_object* legacyParseNext(abuf* buf, int* headerScanIx) {
+  const char* CONTENT_LENGTH_STR = "Content-Length:";
+  const char* DOUBLE_NEWLINE_STR = "\r\n\r\n";
+  const int header_line_begin_ix = buf->find_substr(DOUBLE_NEWLINE_STR, *headerScanIx);
+  if (header_line_begin_ix == -1) {
+    *headerScanIx = std::max<int>(0, buf->len() - (int)strlen(DOUBLE_NEWLINE_STR) + 1);
+    return nullptr;
+  }
+  *headerScanIx = header_line_begin_ix;
+  const int content_length_begin_ix = search_find(buf->buf(), header_line_begin_ix,
+    CONTENT_LENGTH_STR, strlen(CONTENT_LENGTH_STR));
+  assert(content_length_begin_ix != -1);
+  const int content_length = atoi(buf->buf() + content_length_begin_ix + strlen(CONTENT_LENGTH_STR));
+  const int header_line_end_ix = header_line_begin_ix + strlen(DOUBLE_NEWLINE_STR);
+  if (buf->len() < header_line_end_ix + content_length) {
+    return nullptr;
+  }
+  json_tokener* tok = json_tokener_new();
+  json_object* o = json_tokener_parse_ex(tok, buf->buf() + header_line_end_ix, content_length);
+  assert(o != NULL);
+  json_tokener_free(tok);
+  buf->dropNBytesMut(header_line_end_ix + content_length);
+  *headerScanIx = 0;
+  return o;
+}
+
+// the replaced I/O loop: read at most `readSize` bytes and parse at most one
+// message per tick, until the stream is drained.
+int legacyFrameAll(const std::string& stream, int readSize) {
+  abuf buf;
+  int headerScanIx = 0;
+  int nmessages = 0;
+  int i = 0;
+  while (true) {
+    const int n = std::min<int>(readSize, stream.size() - i);
+    buf.appendbuf(stream.data() + i, n);
+    i += n;
+    json_object* o = legacyParseNext(&buf, &headerScanIx);
+    if (o) {
+      json_object_put(o);
+      nmessages++;
+    } else if (i == (int)stream.size()) {
+      return nmessages;
+    }
+  }
+}
+
+int framerFrameAll(const std::string& stream, int readSize) {
+  LspFramer framer;
+  int nmessages = 0;
+  for (int i = 0; i < (int)stream.size(); i += readSize) {
+    nmessages += framer.feed(stream.data() + i, std::min<int>(readSize, stream.size() - i),
+      [](json_object* o) { json_object_put(o); });
+  }
+  return nmessages;
+}
+
+template <typename F>
+double seconds(F f) {
+  const auto start = std::chrono::steady_clock::now();
+  f();
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void bench(const char* name, const std::string& stream, int readSize) {
+  int nlegacy = 0;
+  int nframer = 0;
+  const double tlegacy = seconds([&]() { nlegacy = legacyFrameAll(stream, readSize); });
+  const double tframer = seconds([&]() { nframer = framerFrameAll(stream, readSize); });
+  assert(nlegacy == nframer);
+  const double mb = stream.size() / (1024.0 * 1024.0);
+  printf("  %-28s %6.1f MB, %7d messages, %5d B reads | legacy %8.1f MB/s | framer %8.1f MB/s\n",
+    name, mb, nframer, readSize, mb / tlegacy, mb / tframer);
+}
+
+int main() {
+  printf("### benchmarking [LSP framing throughput]\n");
+  const std::string notifications = notificationsStream(8 << 20);
+  bench("notifications", notifications, 4096);
+  bench("notifications", notifications, 1 << 16);
+  const std::string large = largeMessageStream(4 << 20);
+  bench("one large message", large, 4096);
+  bench("one large message", large, 1 << 16);
+  return 0;
+}
@@ -0,0 +1,118 @@
+#include "datastructures/lspframer.h"
+#include "lsptestutil.h"
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+// feed `stream` to a framer in chunks of `chunk` bytes, and return the
+// messages, as JSON strings.
+std::vector<std::string> frameAll(LspFramer* framer, const std::string& stream, int chunk) {
+  std::vector<std::string> out;
+  for (int i = 0; i < (int)stream.size(); i += chunk) {
+    const int len = std::min<int>(chunk, stream.size() - i);
+    framer->feed(stream.data() + i, len, [&](json_object* o) {
+      out.push_back(json_object_to_json_string_ext(o, JSON_C_TO_STRING_PLAIN | JSON_C_TO_STRING_NOSLASHESCAPE));
+      json_object_put(o);
+    });
+  }
+  return out;
+}
+
+void test1() {
+  printf("### testing [messages split at every position]\n");
+  const std::vector<std::string> bodies = {
+    "{\"id\":0,\"result\":null}",
+    "{\"method\":\"textDocument/publishDiagnostics\",\"params\":{\"diagnostics\":[]}}",
+    "{\"id\":2,\"result\":\"ℕ → 𝔸\"}",
+    "{\"id\":3,\"result\":[1,2,3]}",
+  };
+  std::string stream;
+  for (const std::string& body : bodies) {
+    stream += frame(body);
+  }
+  for (int chunk = 1; chunk <= (int)stream.size(); ++chunk) {
+    LspFramer framer;
+    const std::vector<std::string> got = frameAll(&framer, stream, chunk);
+    assert(got.size() == bodies.size());
+    for (int i = 0; i < (int)bodies.size(); ++i) {
+      assert(got[i] == bodies[i]);
+    }
+    assert(framer.nmalformed() == 0);
+  }
+}
+
+void test2() {
+  printf("### testing [header fields, whitespace, and malformed bodies]\n");
+  std::string stream;
+  stream += "Content-Type: application/vscode-jsonrpc; charset=utf-8\r\n"
+            "content-length: 8\r\n\r\n{\"id\":1}";
+  stream += frame("{\"id\":2}  \n"); // whitespace after the value.
+  stream += frame("{\"id\":"); // ends in the middle of the value.
+  stream += frame("{]"); // not JSON.
+  stream += "Content-Length: 0\r\n\r\n";
+  stream += frame("{\"id\":3}");
+  for (int chunk : { 1, 3, 1000 }) {
+    LspFramer framer;
+    const std::vector<std::string> got = frameAll(&framer, stream, chunk);
+    assert(got.size() == 3);
+    assert(got[0] == "{\"id\":1}");
+    assert(got[1] == "{\"id\":2}");
+    assert(got[2] == "{\"id\":3}");
+    assert(framer.nmalformed() == 3);
+  }
+}
+
+void test3() {
+  printf("### testing [a single feed returns every complete message]\n");
+  std::string stream;
+  for (int i = 0; i < 500; ++i) {
+    stream += frame("{\"id\":" + std::to_string(i) + "}");
+  }
+  LspFramer framer;
+  std::vector<int> ids;
+  const int n = framer.feed(stream.data(), stream.size(), [&](json_object* o) {
+    json_object* id = nullptr;
+    const bool found = json_object_object_get_ex(o, "id", &id);
+    assert(found);
+    ids.push_back(json_object_get_int(id));
+    json_object_put(o);
+  });
+  assert(n == 500 && ids.size() == 500);
+  for (int i = 0; i < 500; ++i) {
+    assert(ids[i] == i);
+  }
+}
+
+void test4() {
+  printf("### testing [headers without a valid Content-Length are dropped, and the framer resyncs]\n");
+  std::string stream;
+  stream += "Content-Length: -1\r\n\r\n{\"id\":0}";
+  stream += frame("{\"id\":1}");
+  stream += "Content-Type: application/vscode-jsonrpc\r\n\r\n{\"id\":0}\r\n";
+  stream += frame("{\"id\":2}");
+  stream += "Content-Length: 99999999999999999999\r\n\r\n{\"id\":0}";
+  stream += frame("{\"id\":3}");
+  stream += "Content-Length: 8 bytes\r\n\r\n{\"id\":0}\n\n{\"id\":0}";
+  stream += frame("{\"id\":4}");
+  stream += "Content-Length:\r\n\r\n" + std::string(10000, ' ');
+  stream += frame("{\"id\":5}");
+  for (int chunk : { 1, 3, 1000 }) {
+    LspFramer framer;
+    const std::vector<std::string> got = frameAll(&framer, stream, chunk);
+    assert(got.size() == 5);
+    for (int i = 0; i < 5; ++i) {
+      assert(got[i] == "{\"id\":" + std::to_string(i + 1) + "}");
+    }
+    assert(framer.nmalformed() == 5);
+  }
+}
+
+int main() {
+  test1();
+  test2();
+  test3();
+  test4();
+  return 0;
+}
@@ -0,0 +1,120 @@
+#include "datastructures/lspgoalcache.h"
+#include <assert.h>
+#include <chrono>
+#include <stdio.h>
+#include <string>
+
+json_object_ptr answer(int id) {
+  json_object_ptr o(json_tokener_parse(("{\"id\":" + std::to_string(id) + ",\"result\":{\"goals\":[]}}").c_str()));
+  assert(o);
+  return o;
+}
+
+json_object_ptr error(int id) {
+  json_object_ptr o(json_tokener_parse(("{\"id\":" + std::to_string(id) + ",\"error\":{\"code\":-32800}}").c_str()));
+  assert(o);
+  return o;
+}
+
+void test1() {
+  printf("### testing [goal cache answers by version, position and kind]\n");
+  LspGoalCache c;
+  c.edit(1, 0);
+  json_object_ptr a = answer(1);
+  c.insert(1, Cursor(3, 4), LRK_PlainGoal, a);
+  assert(c.contains(1, Cursor(3, 4), LRK_PlainGoal));
+  assert(!c.contains(1, Cursor(3, 4), LRK_PlainTermGoal));
+  assert(!c.contains(1, Cursor(3, 5), LRK_PlainGoal));
+  assert(!c.contains(2, Cursor(3, 4), LRK_PlainGoal));
+  std::optional<json_object_ptr> found = c.find(1, Cursor(3, 4), LRK_PlainGoal);
+  assert(found && *found == a);
+  found = c.find(1, Cursor(3, 4), LRK_Hover);
+  assert(!found);
+  assert(c.nhits() == 1 && c.nmisses() == 1);
+
+  // errors, and answers about other versions, are not worth keeping.
+  c.insert(1, Cursor(3, 4), LRK_Hover, error(2));
+  c.insert(0, Cursor(5, 0), LRK_PlainGoal, answer(3));
+  assert(!c.contains(1, Cursor(3, 4), LRK_Hover));
+  assert(c.npositions() == 1);
+}
+
+void test2() {
+  printf("### testing [goal cache keeps the answers before an edit, and forgets the others]\n");
+  LspGoalCache c;
+  c.edit(1, 0);
+  for (int row = 0; row < 10; ++row) {
+    c.insert(1, Cursor(row, 2), LRK_PlainGoal, answer(row));
+    c.insert(1, Cursor(row, 2), LRK_Hover, answer(100 + row));
+  }
+  c.edit(2, 6);
+  assert(c.version() == 2);
+  assert(c.npositions() == 6);
+  for (int row = 0; row < 10; ++row) {
+    assert(c.contains(2, Cursor(row, 2), LRK_PlainGoal) == (row < 6));
+    assert(c.contains(2, Cursor(row, 2), LRK_Hover) == (row < 6));
+    assert(!c.contains(1, Cursor(row, 2), LRK_PlainGoal));
+  }
+  // the document was replaced.
+  c.edit(5, 0);
+  assert(c.npositions() == 0);
+}
+
+void test3() {
+  printf("### testing [goal cache forgets the least recently used position]\n");
+  LspGoalCache c;
+  c.edit(1, 0);
+  for (int i = 0; i < LSP_GOAL_CACHE_MAX_POSITIONS; ++i) {
+    c.insert(1, Cursor(i, 0), LRK_PlainGoal, answer(i));
+  }
+  const std::optional<json_object_ptr> found = c.find(1, Cursor(0, 0), LRK_PlainGoal);
+  assert(found);
+  c.insert(1, Cursor(1, 0), LRK_Hover, answer(-1));
+  c.insert(1, Cursor(-1, 0), LRK_PlainGoal, answer(-2));
+  assert(c.npositions() == LSP_GOAL_CACHE_MAX_POSITIONS);
+  assert(c.contains(1, Cursor(0, 0), LRK_PlainGoal));
+  assert(c.contains(1, Cursor(1, 0), LRK_PlainGoal));
+  assert(!c.contains(1, Cursor(2, 0), LRK_PlainGoal));
+  assert(c.contains(1, Cursor(-1, 0), LRK_PlainGoal));
+  // an edit forgets the rows from its first on, however recently used.
+  c.edit(2, 500);
+  c.insert(2, Cursor(700, 0), LRK_PlainGoal, answer(-3));
+  assert(c.npositions() == 501);
+}
+
+void bench() {
+  printf("### benchmarking [goal cache while stepping over a proof, with an edit every so often]\n");
+  LspGoalCache c;
+  int version = 1;
+  c.edit(version, 0);
+  const int NROWS = 200;
+  const int N = 200000;
+  int nrequests = 0;
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (int i = 0; i < N; ++i) {
+    // back and forth over the proof.
+    const int row = (i / NROWS) % 2 ? NROWS - 1 - i % NROWS : i % NROWS;
+    for (LspRequestKind kind : { LRK_PlainGoal, LRK_PlainTermGoal, LRK_Hover }) {
+      if (!c.find(version, Cursor(row, 4), kind)) {
+        nrequests++;
+        c.insert(version, Cursor(row, 4), kind, answer(i));
+      }
+    }
+    // an edit near the end of the proof.
+    if (i % 5000 == 4999) {
+      c.edit(++version, NROWS - 20);
+    }
+  }
+  const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  printf("  %d steps in %.3fs | %.0f ns/step | %.2f%% of lookups answered from memory\n",
+    N, seconds, 1e9 * seconds / N, 100.0 * c.nhits() / (c.nhits() + c.nmisses()));
+  assert(nrequests == c.nmisses());
+}
+
+int main() {
+  test1();
+  test2();
+  test3();
+  bench();
+  return 0;
+}
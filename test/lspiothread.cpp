@@ -0,0 +1,222 @@
+#include "datastructures/lspiothread.h"
+#include "datastructures/spscqueue.h"
+#include "lsptestutil.h"
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+void test1() {
+  printf("### testing [spsc queue is bounded, and FIFO]\n");
+  SpscQueue<std::string> q(4);
+  for (int i = 0; i < 4; ++i) {
+    const bool pushed = q.tryPush(std::to_string(i));
+    assert(pushed);
+  }
+  std::string val = "kept";
+  const bool pushed = q.tryPush(std::move(val));
+  assert(!pushed);
+  assert(val == "kept"); // a failed push leaves the value as-is.
+  assert(q.size() == 4);
+  std::string out;
+  for (int i = 0; i < 4; ++i) {
+    const bool popped = q.tryPop(&out);
+    assert(popped);
+    assert(out == std::to_string(i));
+  }
+  const bool popped = q.tryPop(&out);
+  assert(!popped);
+  assert(q.size() == 0);
+}
+
+void test2() {
+  printf("### testing [spsc queue hands values across threads in order]\n");
+  const int N = 1000000;
+  SpscQueue<int> q(64);
+  std::thread producer([&]() {
+    for (int i = 0; i < N; ++i) {
+      int val = i;
+      while (!q.tryPush(std::move(val))) {
+        std::this_thread::yield();
+      }
+    }
+  });
+  int expected = 0;
+  while (expected < N) {
+    int out = -1;
+    if (!q.tryPop(&out)) {
+      std::this_thread::yield();
+      continue;
+    }
+    assert(out == expected);
+    expected++;
+  }
+  producer.join();
+}
+
+void writeAll(int fd, const std::string& s) {
+  int n = 0;
+  while (n < (int)s.size()) {
+    const int k = write(fd, s.data() + n, s.size() - n);
+    assert(k > 0);
+    n += k;
+  }
+}
+
+// `o[key]`, which must exist.
+json_object* field(json_object* o, const char* key) {
+  json_object* v = nullptr;
+  const bool found = json_object_object_get_ex(o, key, &v);
+  assert(found);
+  return v;
+}
+
+// a fake server: we write its stdout through `serverStdout[1]`, and read its
+// stdin from `serverStdin[0]`. The client writes to `*stdinFile`.
+void makeServerPipes(int serverStdout[2], int serverStdin[2], FILE** stdinFile) {
+  int rc = pipe(serverStdout);
+  assert(rc == 0);
+  rc = pipe(serverStdin);
+  assert(rc == 0);
+  fcntl(serverStdout[0], F_SETFL, fcntl(serverStdout[0], F_GETFL) | O_NONBLOCK);
+  *stdinFile = fdopen(serverStdin[1], "w");
+  assert(*stdinFile);
+}
+
+void test3() {
+  printf("### testing [io thread frames a burst of messages, and writes queued messages]\n");
+  int serverStdout[2];
+  int serverStdin[2];
+  FILE* stdinFile = nullptr;
+  makeServerPipes(serverStdout, serverStdin, &stdinFile);
+
+  const int NMESSAGES = 300;
+  {
+    LspIoThread io(serverStdout[0], stdinFile);
+
+    // the burst arrives in pieces that split headers and bodies.
+    std::string burst;
+    for (int i = 0; i < NMESSAGES; ++i) {
+      burst += frame("{\"id\": " + std::to_string(i) + ", \"result\": \"" + std::string(i % 50, 'x') + "\"}");
+    }
+    for (int i = 0; i < (int)burst.size(); i += 7) {
+      writeAll(serverStdout[1], burst.substr(i, 7));
+    }
+
+    int nread = 0;
+    while (nread < NMESSAGES) {
+      json_object_ptr o = io.tryRead();
+      if (!o) {
+        std::this_thread::yield();
+        continue;
+      }
+      assert(json_object_get_int(field(o, "id")) == nread);
+      nread++;
+    }
+    assert(!io.tryRead());
+
+    std::string expected;
+    for (int i = 0; i < 10; ++i) {
+      const std::string msg = frame("{\"id\": " + std::to_string(i) + "}");
+      io.write(msg);
+      expected += msg;
+    }
+    std::string got;
+    while (got.size() < expected.size()) {
+      char buf[256];
+      const int k = read(serverStdin[0], buf, sizeof(buf));
+      assert(k > 0);
+      got.append(buf, k);
+    }
+    assert(got == expected);
+
+    assert(!io.serverExited());
+    close(serverStdout[1]);
+    while (!io.serverExited()) {
+      std::this_thread::yield();
+    }
+  }
+  fclose(stdinFile);
+  close(serverStdout[0]);
+  close(serverStdin[0]);
+}
+
+void test4() {
+  printf("### testing [io thread keeps reading while the server does not read its stdin]\n");
+  int serverStdout[2];
+  int serverStdin[2];
+  FILE* stdinFile = nullptr;
+  makeServerPipes(serverStdout, serverStdin, &stdinFile);
+  {
+    LspIoThread io(serverStdout[0], stdinFile);
+    // far more than the pipe holds.
+    const std::string big = frame("{\"method\": \"textDocument/didOpen\", \"params\": \""
+      + std::string(1 << 22, 'x') + "\"}");
+    io.write(big);
+    // the server is busy writing, and reads nothing until it is done.
+    const int NMESSAGES = 1000;
+    for (int i = 0; i < NMESSAGES; ++i) {
+      writeAll(serverStdout[1], frame("{\"id\": " + std::to_string(i) + ", \"result\": \""
+        + std::string(1000, 'y') + "\"}"));
+    }
+    int nread = 0;
+    while (nread < NMESSAGES) {
+      if (!io.tryRead()) {
+        std::this_thread::yield();
+        continue;
+      }
+      nread++;
+    }
+    // the server catches up.
+    std::string got;
+    while (got.size() < big.size()) {
+      char buf[1 << 16];
+      const int k = read(serverStdin[0], buf, sizeof(buf));
+      assert(k > 0);
+      got.append(buf, k);
+    }
+    assert(got == big);
+  }
+  fclose(stdinFile);
+  close(serverStdout[0]);
+  close(serverStdout[1]);
+  close(serverStdin[0]);
+}
+
+void test5() {
+  printf("### testing [io thread answers the requests it drops before sending them]\n");
+  int serverStdout[2];
+  int serverStdin[2];
+  FILE* stdinFile = nullptr;
+  makeServerPipes(serverStdout, serverStdin, &stdinFile);
+  {
+    LspIoThread io(serverStdout[0], stdinFile);
+    // fill the pipe, so that the requests wait in the outbox.
+    io.write(frame("{\"params\": \"" + std::string(1 << 20, 'x') + "\"}"));
+    io.send(json_object_ptr(json_tokener_parse("{\"id\": 1, \"method\": \"$/lean/plainGoal\", \"params\": {}}")));
+    io.send(json_object_ptr(json_tokener_parse("{\"method\": \"$/cancelRequest\", \"params\": {\"id\": 1}}")));
+    json_object_ptr o;
+    while (!(o = io.tryRead())) {
+      std::this_thread::yield();
+    }
+    assert(json_object_get_int(field(o, "id")) == 1);
+    assert(json_object_get_int(field(field(o, "error"), "code")) == LSP_REQUEST_CANCELLED);
+  }
+  fclose(stdinFile);
+  close(serverStdout[0]);
+  close(serverStdout[1]);
+  close(serverStdin[0]);
+}
+
+int main() {
+  test1();
+  test2();
+  test3();
+  test4();
+  test5();
+  return 0;
+}
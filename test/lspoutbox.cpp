@@ -0,0 +1,264 @@
+#include "datastructures/lspframer.h"
+#include "datastructures/lspoutbox.h"
+#include <assert.h>
+#include <chrono>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+LspOutboundMessage message(const std::string& json) {
+  LspOutboundMessage m;
+  m.msg = json_object_ptr(json_tokener_parse(json.c_str()));
+  assert(m.msg);
+  return m;
+}
+
+LspOutboundMessage request(int id, const char* method, const char* uri) {
+  return message("{\"jsonrpc\":\"2.0\",\"id\":" + std::to_string(id) + ",\"method\":\"" + method
+    + "\",\"params\":{\"textDocument\":{\"uri\":\"" + uri + "\"},\"position\":{\"line\":0,\"character\":0}}}");
+}
+
+LspOutboundMessage cancel(int id) {
+  return message("{\"jsonrpc\":\"2.0\",\"method\":\"$/cancelRequest\",\"params\":{\"id\":" + std::to_string(id) + "}}");
+}
+
+LspOutboundMessage didChange(const char* uri, int version, const std::string& text) {
+  return message(std::string("{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/didChange\",\"params\":")
+    + "{\"textDocument\":{\"uri\":\"" + uri + "\",\"version\":" + std::to_string(version) + "},"
+    + "\"contentChanges\":[{\"text\":\"" + text + "\"}]}}");
+}
+
+// a server's stdin, that the server does not read until asked to.
+struct Pipe {
+  int fds[2];
+  LspFramer framer;
+  std::vector<json_object_ptr> read; // what the server read, parsed.
+
+  Pipe() {
+    const int rc = pipe(fds);
+    assert(rc == 0);
+    for (int fd : fds) {
+      fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    }
+  }
+  ~Pipe() {
+    close(fds[0]);
+    close(fds[1]);
+  }
+
+  // read everything written so far.
+  void drain() {
+    char buf[4096];
+    int k = 0;
+    while ((k = ::read(fds[0], buf, sizeof(buf))) > 0) {
+      framer.feed(buf, k, [this](json_object* o) { this->read.push_back(json_object_ptr(o)); });
+    }
+  }
+
+  // write what `box` can to the server, which must not have hung up.
+  void flush(LspOutbox& box) {
+    const bool serverOpen = box.flush(fds[1], nullptr);
+    assert(serverOpen);
+  }
+};
+
+// `o[key]`, which must exist.
+json_object* field(json_object* o, const char* key) {
+  json_object* v = nullptr;
+  const bool found = json_object_object_get_ex(o, key, &v);
+  assert(found);
+  return v;
+}
+
+const char* method(json_object* o) {
+  return json_object_get_string(field(o, "method"));
+}
+
+int intAt(json_object* o, const std::vector<const char*>& path) {
+  for (const char* key : path) {
+    o = field(o, key);
+  }
+  return json_object_get_int(o);
+}
+
+// the texts of the content changes of the `didChange` `o`.
+std::vector<std::string> changes(json_object* o) {
+  json_object* changes = field(field(o, "params"), "contentChanges");
+  std::vector<std::string> out;
+  for (int i = 0; i < (int)json_object_array_length(changes); ++i) {
+    out.push_back(json_object_get_string(field(json_object_array_get_idx(changes, i), "text")));
+  }
+  return out;
+}
+
+void test1() {
+  printf("### testing [outbox writes queued messages in order, framed]\n");
+  Pipe p;
+  LspOutbox box;
+  box.push(request(1, "$/lean/plainGoal", "file:///a.lean"));
+  LspOutboundMessage raw;
+  raw.raw = "Content-Length: 2\r\n\r\n{}";
+  box.push(std::move(raw));
+  box.push(message("{\"jsonrpc\":\"2.0\",\"method\":\"initialized\",\"params\":{}}"));
+  assert(box.size() == 3);
+  p.flush(box);
+  assert(box.empty());
+  p.drain();
+  assert(p.read.size() == 3);
+  assert(strcmp(method(p.read[0]), "$/lean/plainGoal") == 0);
+  assert(intAt(p.read[0], { "id" }) == 1);
+  assert(json_object_object_get_ex(p.read[1], "method", nullptr) == 0);
+  assert(strcmp(method(p.read[2]), "initialized") == 0);
+  assert(box.ncoalesced() == 0);
+}
+
+void test2() {
+  printf("### testing [outbox drops a queued request with its cancel]\n");
+  Pipe p;
+  LspOutbox box;
+  box.push(request(1, "$/lean/plainGoal", "file:///a.lean"));
+  box.push(request(2, "textDocument/hover", "file:///a.lean"));
+  box.push(cancel(1));
+  assert(box.size() == 1);
+  assert(box.ncoalesced() == 2);
+  std::vector<LspRequestId> dropped = box.takeDroppedRequests();
+  assert(dropped.size() == 1 && dropped[0] == LspRequestId(1));
+  assert(box.takeDroppedRequests().empty());
+  // the server may already have it: the cancel must reach it.
+  box.push(cancel(3));
+  assert(box.size() == 2);
+  assert(box.ncoalesced() == 2);
+
+  p.flush(box);
+  p.drain();
+  assert(p.read.size() == 2);
+  assert(intAt(p.read[0], { "id" }) == 2);
+  assert(strcmp(method(p.read[1]), "$/cancelRequest") == 0);
+  assert(intAt(p.read[1], { "params", "id" }) == 3);
+}
+
+void test3() {
+  printf("### testing [outbox merges a didChange into the previous one of its document]\n");
+  Pipe p;
+  LspOutbox box;
+  box.push(didChange("file:///a.lean", 1, "a"));
+  box.push(didChange("file:///b.lean", 1, "b"));
+  // about another document: merged across.
+  box.push(didChange("file:///a.lean", 2, "c"));
+  assert(box.size() == 2);
+  // a request sees version 2: not merged across.
+  box.push(request(5, "textDocument/hover", "file:///a.lean"));
+  box.push(didChange("file:///a.lean", 3, "d"));
+  assert(box.size() == 4);
+  // once the request is dropped, nothing sees version 2.
+  box.push(cancel(5));
+  assert(box.size() == 2);
+  box.push(didChange("file:///a.lean", 4, "e"));
+  assert(box.size() == 2);
+  LspOutboundMessage raw;
+  raw.raw = "Content-Length: 2\r\n\r\n{}";
+  box.push(std::move(raw));
+  // raw messages may be about anything.
+  box.push(didChange("file:///a.lean", 5, "f"));
+  assert(box.size() == 4);
+  assert(box.ncoalesced() == 5);
+
+  p.flush(box);
+  p.drain();
+  assert(p.read.size() == 4);
+  assert(intAt(p.read[0], { "params", "textDocument", "version" }) == 4);
+  assert(changes(p.read[0]) == std::vector<std::string>({ "a", "c", "d", "e" }));
+  assert(intAt(p.read[1], { "params", "textDocument", "version" }) == 1);
+  assert(changes(p.read[1]) == std::vector<std::string>({ "b" }));
+  assert(intAt(p.read[3], { "params", "textDocument", "version" }) == 5);
+  assert(changes(p.read[3]) == std::vector<std::string>({ "f" }));
+}
+
+void test4() {
+  printf("### testing [outbox never blocks, and never supersedes a message it started writing]\n");
+  Pipe p;
+  fcntl(p.fds[1], F_SETPIPE_SZ, 4096);
+  LspOutbox box;
+  const std::string big(1 << 20, 'x');
+  box.push(didChange("file:///a.lean", 1, big));
+  box.push(request(7, "$/lean/plainGoal", "file:///a.lean"));
+  // the server reads nothing: the first message is partly written.
+  p.flush(box);
+  assert(box.size() == 2);
+  // only unstarted messages are superseded.
+  box.push(cancel(7));
+  box.push(didChange("file:///a.lean", 2, "y"));
+  assert(box.size() == 2);
+  assert(box.takeDroppedRequests().size() == 1);
+
+  while (!box.empty()) {
+    p.drain();
+    p.flush(box);
+  }
+  p.drain();
+  assert(p.read.size() == 2);
+  assert(changes(p.read[0]) == std::vector<std::string>({ big }));
+  assert(intAt(p.read[1], { "params", "textDocument", "version" }) == 2);
+  assert(changes(p.read[1]) == std::vector<std::string>({ "y" }));
+}
+
+void test5() {
+  printf("### testing [outbox drops everything once the server closes its stdin]\n");
+  Pipe p;
+  close(p.fds[0]);
+  p.fds[0] = open("/dev/null", O_RDONLY);
+  LspOutbox box;
+  box.push(request(1, "$/lean/plainGoal", "file:///a.lean"));
+  const bool serverOpen = box.flush(p.fds[1], nullptr);
+  assert(!serverOpen);
+  assert(box.empty());
+}
+
+void bench() {
+  printf("### benchmarking [outbox coalesces keystrokes while the server is busy]\n");
+  Pipe p;
+  fcntl(p.fds[1], F_SETPIPE_SZ, 4096);
+  LspOutbox box;
+  // the server is busy with a large document.
+  box.push(didChange("file:///a.lean", 0, std::string(1 << 16, 'x')));
+  box.push(request(0, "$/lean/plainGoal", "file:///a.lean"));
+  p.flush(box);
+  const int N = 10000;
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (int i = 1; i <= N; ++i) {
+    box.push(didChange("file:///a.lean", i, "k"));
+    // a goal request after every keystroke, superseding the last one.
+    box.push(cancel(i - 1));
+    box.push(request(i, "$/lean/plainGoal", "file:///a.lean"));
+    p.flush(box);
+  }
+  const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  // the document, one `didChange` of every keystroke, and the last request.
+  printf("  %d keystrokes in %.3fs | %.0f keystrokes/s | %d messages queued, %lld coalesced\n",
+    N, seconds, N / seconds, box.size(), (long long)box.ncoalesced());
+  assert(box.size() == 3);
+  while (!box.empty()) {
+    p.drain();
+    p.flush(box);
+  }
+  p.drain();
+  assert(p.read.size() == 3);
+  assert(changes(p.read[1]).size() == N);
+  assert(intAt(p.read[2], { "id" }) == N);
+}
+
+int main() {
+  // the server of `test5` hangs up.
+  signal(SIGPIPE, SIG_IGN);
+  test1();
+  test2();
+  test3();
+  test4();
+  test5();
+  bench();
+  return 0;
+}
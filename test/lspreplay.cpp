@@ -0,0 +1,314 @@
+// plays captures back through `lsp-replay-server`, whose path is the first
+// argument, and measures the client's transport on them.
+#include "datastructures/lspcapture.h"
+#include "datastructures/lspiothread.h"
+#include "datastructures/lspresponsestore.h"
+#include "lsptestutil.h"
+#include "subprocess.h"
+#include <assert.h>
+#include <fcntl.h>
+#include <map>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+const char* g_replayServer = nullptr;
+
+std::string request(int id, const char* method) {
+  return "{\"jsonrpc\":\"2.0\",\"id\":" + std::to_string(id) + ",\"method\":\"" + method + "\",\"params\":{}}";
+}
+
+std::string response(int id, const std::string& result) {
+  return "{\"jsonrpc\":\"2.0\",\"id\":" + std::to_string(id) + ",\"result\":" + result + "}";
+}
+
+std::string notification(const char* method, const std::string& params) {
+  return std::string("{\"jsonrpc\":\"2.0\",\"method\":\"") + method + "\",\"params\":" + params + "}";
+}
+
+// a capture, as `LspIoThread` would record it.
+struct CaptureBuilder {
+  std::unique_ptr<LspCaptureWriter> writer;
+  Clock::time_point start = Clock::now();
+  int64_t tMicros = 0;
+
+  explicit CaptureBuilder(const fs::path& path) {
+    this->writer = LspCaptureWriter::open(path, this->start);
+    assert(this->writer);
+  }
+
+  // record `body`, framed, `afterMicros` after the previous record.
+  // The server's messages are split into reads of `readSize` bytes.
+  void add(LspCaptureDirection dir, const std::string& body, int64_t afterMicros = 0, int readSize = 1 << 16) {
+    this->tMicros += afterMicros;
+    const std::string framed = frame(body);
+    const int chunk = dir == LCD_ServerToClient ? readSize : framed.size();
+    for (int i = 0; i < (int)framed.size(); i += chunk) {
+      this->writer->record(dir, framed.data() + i, std::min<int>(chunk, framed.size() - i),
+        this->start + std::chrono::microseconds(this->tMicros));
+    }
+  }
+};
+
+// a replay server on a capture, with a client talking to it.
+struct ReplaySession {
+  subprocess_s process;
+  std::unique_ptr<LspIoThread> io;
+
+  // if `record` is given, the client captures the session to it.
+  ReplaySession(const fs::path& capture, const char* speed, const fs::path& record = fs::path()) {
+    const char* argv[] = { g_replayServer, capture.c_str(), speed, NULL };
+    // as `LeanServerState` launches servers: only our end is non-blocking.
+    const int options = subprocess_option_inherit_environment | subprocess_option_enable_async;
+    int rc = subprocess_create(NULL, argv, options, &this->process);
+    assert(rc == 0);
+    const int stdoutFd = fileno(subprocess_stdout(&this->process));
+    rc = fcntl(stdoutFd, F_SETFL, fcntl(stdoutFd, F_GETFL) | O_NONBLOCK);
+    assert(rc == 0);
+    this->io = std::make_unique<LspIoThread>(stdoutFd, subprocess_stdin(&this->process),
+      record.empty() ? nullptr : LspCaptureWriter::open(record, Clock::now()));
+  }
+
+  ~ReplaySession() {
+    this->io.reset();
+    // hang up, so that the server exits.
+    fclose(this->process.stdin_file);
+    this->process.stdin_file = NULL;
+    int ret = -1;
+    const int rc = subprocess_join(&this->process, &ret);
+    assert(rc == 0);
+    assert(ret == 0);
+    subprocess_destroy(&this->process);
+  }
+
+  // the next message from the server, waiting for it.
+  json_object_ptr read() {
+    while (true) {
+      if (json_object_ptr o = this->io->tryRead()) {
+        return o;
+      }
+      assert(!this->io->serverExited());
+      std::this_thread::yield();
+    }
+  }
+};
+
+// `o[key]`, which must exist.
+json_object* field(json_object* o, const char* key) {
+  json_object* v = nullptr;
+  const bool found = json_object_object_get_ex(o, key, &v);
+  assert(found);
+  return v;
+}
+
+int intField(json_object* o, const char* key) {
+  return json_object_get_int(field(o, key));
+}
+
+void test1() {
+  printf("### testing [capture files round trip]\n");
+  const fs::path path = fs::temp_directory_path() / "elide-lspreplay-test1.lspcap";
+  std::vector<std::string> bodies;
+  {
+    CaptureBuilder b(path);
+    bodies.push_back(request(0, "initialize"));
+    b.add(LCD_ClientToServer, bodies.back());
+    bodies.push_back(response(0, "{\"capabilities\":{}}"));
+    b.add(LCD_ServerToClient, bodies.back(), 410000, 7); // split mid-header and mid-body.
+    bodies.push_back(notification("textDocument/publishDiagnostics", "{\"uri\":\"file:///a.lean\",\"diagnostics\":[]}"));
+    b.add(LCD_ServerToClient, bodies.back(), 1, 3);
+    bodies.push_back(request(1, "$/lean/plainGoal"));
+    b.add(LCD_ClientToServer, bodies.back(), 1000000000); // varints wider than 32 bits of microseconds.
+  }
+
+  std::vector<LspCaptureRecord> records;
+  bool ok = lspCaptureRead(path, &records);
+  assert(ok);
+  assert(records[0].dir == LCD_ClientToServer && records[0].tMicros == 0);
+  assert(records[1].dir == LCD_ServerToClient && records[1].tMicros == 410000 && records[1].bytes.size() == 7);
+  assert(records.back().tMicros == 410001 + 1000000000);
+
+  const std::vector<LspCaptureMessage> msgs = lspCaptureMessages(records);
+  assert(msgs.size() == bodies.size());
+  const int64_t times[] = { 0, 410000, 410001, 410001 + 1000000000 };
+  for (int i = 0; i < (int)msgs.size(); ++i) {
+    json_object_ptr got = msgs[i].msg;
+    json_object_ptr expected = json_tokener_parse(bodies[i].c_str());
+    assert(json_object_equal(got, expected));
+    assert(msgs[i].tMicros == times[i]);
+  }
+
+  // truncated in the middle of a record.
+  fs::resize_file(path, fs::file_size(path) - 3);
+  records.clear();
+  ok = lspCaptureRead(path, &records);
+  assert(!ok);
+  // not a capture.
+  FILE* f = fopen(path.c_str(), "wb");
+  fputs("Content-Length: 2\r\n\r\n{}", f);
+  fclose(f);
+  records.clear();
+  ok = lspCaptureRead(path, &records);
+  assert(!ok);
+  fs::remove(path);
+}
+
+void test2() {
+  printf("### testing [replay maps request IDs, and keeps causality and timing]\n");
+  const fs::path path = fs::temp_directory_path() / "elide-lspreplay-test2.lspcap";
+  {
+    CaptureBuilder b(path);
+    b.add(LCD_ClientToServer, request(0, "initialize"));
+    b.add(LCD_ServerToClient, response(0, "{\"capabilities\":{}}"), 100000);
+    b.add(LCD_ClientToServer, request(1, "$/lean/plainGoal"), 5000);
+    b.add(LCD_ClientToServer, request(2, "$/lean/plainTermGoal"), 10);
+    // answered out of order.
+    b.add(LCD_ServerToClient, response(2, "{\"goal\":\"⊢ ℕ\"}"), 100000);
+    b.add(LCD_ServerToClient, notification("$/lean/fileProgress", "{\"processing\":[]}"), 10);
+    b.add(LCD_ServerToClient, response(1, "{\"rendered\":\"⊢ True\"}"), 100000);
+  }
+
+  // at 4x speed, the 300ms the server took in the capture take at least 75ms.
+  const fs::path recordPath = fs::temp_directory_path() / "elide-lspreplay-test2-record.lspcap";
+  std::unique_ptr<ReplaySession> session = std::make_unique<ReplaySession>(path, "4", recordPath);
+  ReplaySession& s = *session;
+  const Clock::time_point start = Clock::now();
+  s.io->write(frame(request(100, "initialize")));
+  json_object_ptr o = s.read();
+  assert(intField(o, "id") == 100);
+  const double initSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+  assert(initSeconds >= 0.025);
+
+  // the live client numbers its requests differently.
+  s.io->write(frame(request(205, "$/lean/plainGoal")));
+  s.io->write(frame(request(206, "$/lean/plainTermGoal")));
+  o = s.read();
+  assert(intField(o, "id") == 206);
+  o = s.read();
+  assert(!json_object_object_get_ex(o, "id", nullptr));
+  o = s.read();
+  assert(intField(o, "id") == 205);
+  assert(strcmp(json_object_get_string(field(field(o, "result"), "rendered")), "⊢ True") == 0);
+  const double totalSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+  assert(totalSeconds >= 0.075);
+  session.reset();
+
+  // the client recorded the session as it went.
+  std::vector<LspCaptureRecord> records;
+  const bool ok = lspCaptureRead(recordPath, &records);
+  assert(ok);
+  const std::vector<LspCaptureMessage> msgs = lspCaptureMessages(records);
+  const LspCaptureDirection dirs[] = { LCD_ClientToServer, LCD_ServerToClient, LCD_ClientToServer,
+    LCD_ClientToServer, LCD_ServerToClient, LCD_ServerToClient, LCD_ServerToClient };
+  assert(msgs.size() == 7);
+  for (int i = 0; i < 7; ++i) {
+    assert(msgs[i].dir == dirs[i]);
+    assert(i == 0 || msgs[i].tMicros >= msgs[i - 1].tMicros);
+  }
+  assert(msgs[6].tMicros >= 75000);
+  fs::remove(recordPath);
+  fs::remove(path);
+}
+
+// a capture shaped like an editing session with lean: goals asked for at
+// every cursor move, with big goal states, and bursts of diagnostics and
+// progress notifications as the file is elaborated.
+int buildSessionCapture(const fs::path& path, int nrounds) {
+  CaptureBuilder b(path);
+  int id = 0;
+  int nserver = 0;
+  b.add(LCD_ClientToServer, request(id, "initialize"));
+  b.add(LCD_ServerToClient, response(id++, "{\"capabilities\":{}}"), 400000);
+  nserver++;
+  std::string goal = "\"";
+  for (int i = 0; i < 200; ++i) {
+    goal += "h" + std::to_string(i) + " : ∀ (n : ℕ), n + 0 = n\\n";
+  }
+  goal += "⊢ True\"";
+  for (int r = 0; r < nrounds; ++r) {
+    b.add(LCD_ClientToServer, request(id, "$/lean/plainGoal"), 1000);
+    b.add(LCD_ClientToServer, request(id + 1, "$/lean/plainTermGoal"), 10);
+    for (int d = 0; d < 20; ++d) {
+      std::string diagnostics = "[";
+      for (int k = 0; k < 10; ++k) {
+        diagnostics += std::string(k ? "," : "") + "{\"range\":{\"start\":{\"line\":" + std::to_string(d * 10 + k)
+          + ",\"character\":2},\"end\":{\"line\":" + std::to_string(d * 10 + k)
+          + ",\"character\":9}},\"severity\":1,\"message\":\"unknown identifier 'foo'\"}";
+      }
+      diagnostics += "]";
+      b.add(LCD_ServerToClient, notification("textDocument/publishDiagnostics",
+        "{\"uri\":\"file:///a.lean\",\"version\":" + std::to_string(r) + ",\"diagnostics\":" + diagnostics + "}"), 50, 4096);
+      b.add(LCD_ServerToClient, notification("$/lean/fileProgress",
+        "{\"textDocument\":{\"uri\":\"file:///a.lean\",\"version\":" + std::to_string(r)
+        + "},\"processing\":[{\"range\":{\"start\":{\"line\":" + std::to_string(d * 10) + ",\"character\":0},\"end\":{\"line\":200,\"character\":0}}}]}"), 50, 4096);
+      nserver += 2;
+    }
+    b.add(LCD_ServerToClient, response(id + 1, "{\"goal\":" + goal + "}"), 2000, 4096);
+    b.add(LCD_ServerToClient, response(id, "{\"rendered\":" + goal + ",\"goals\":[" + goal + "]}"), 20000, 4096);
+    nserver += 2;
+    id += 2;
+  }
+  return nserver;
+}
+
+void bench() {
+  printf("### benchmarking [replayed session through the LSP transport]\n");
+  const fs::path path = fs::temp_directory_path() / "elide-lspreplay-bench.lspcap";
+  const int nrounds = 50;
+  const int nserver = buildSessionCapture(path, nrounds);
+  std::vector<LspCaptureRecord> records;
+  const bool ok = lspCaptureRead(path, &records);
+  assert(ok);
+  int64_t nbytes = 0;
+  for (const LspCaptureRecord& r : records) {
+    nbytes += r.dir == LCD_ServerToClient ? r.bytes.size() : 0;
+  }
+
+  // as fast as the client allows, so that the client is what is measured.
+  ReplaySession s(path, "0");
+  const Clock::time_point start = Clock::now();
+  int id = 1000;
+  s.io->write(frame(request(id++, "initialize")));
+  for (int r = 0; r < nrounds; ++r) {
+    s.io->write(frame(request(id++, "$/lean/plainGoal")));
+    s.io->write(frame(request(id++, "$/lean/plainTermGoal")));
+  }
+  // dispatch as `LeanServerState::tick_nonblocking` does: responses into a
+  // store, notifications by method.
+  LspResponseStore responses;
+  std::map<std::string, int> nnotifications;
+  int ntaken = 0;
+  for (int i = 0; i < nserver; ++i) {
+    json_object_ptr o = s.read();
+    json_object* ido = nullptr;
+    if (json_object_object_get_ex(o, "id", &ido)) {
+      const int rid = json_object_get_int(ido);
+      assert(rid >= 1000 && rid < id);
+      responses.insert(rid, std::move(o), Clock::now());
+      ntaken += (bool)responses.take(rid);
+    } else {
+      nnotifications[json_object_get_string(field(o, "method"))]++;
+    }
+  }
+  const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  assert(ntaken == 1 + 2 * nrounds);
+  assert(nnotifications["textDocument/publishDiagnostics"] == 20 * nrounds);
+  assert(responses.size() == 0);
+  const double mb = nbytes / (1024.0 * 1024.0);
+  printf("  %d messages, %.1f MB from the server in %.3fs | %.0f messages/s | %.1f MB/s\n",
+    nserver, mb, seconds, nserver / seconds, mb / seconds);
+  fs::remove(path);
+}
+
+int main(int argc, char** argv) {
+  assert(argc == 2 && "usage: lspreplay <path to lsp-replay-server>");
+  g_replayServer = argv[1];
+  test1();
+  test2();
+  bench();
+  return 0;
+}
@@ -0,0 +1,124 @@
+#include "datastructures/lspresponsestore.h"
+#include <assert.h>
+#include <map>
+#include <stdio.h>
+#include <stdlib.h>
+
+using Clock = LspResponseStore::Clock;
+
+json_object_ptr response(int id) {
+  json_object* o = json_object_new_object();
+  json_object_object_add(o, "id", json_object_new_int(id));
+  return json_object_ptr(o);
+}
+
+int responseId(json_object_ptr& o) {
+  json_object* id = nullptr;
+  const bool found = json_object_object_get_ex(o, "id", &id);
+  assert(found);
+  return json_object_get_int(id);
+}
+
+void test1() {
+  printf("### testing [a response is taken once, and owned by its taker]\n");
+  LspResponseStore store;
+  const Clock::time_point t0 = Clock::now();
+  json_object_ptr r = response(3);
+  json_object* raw = r;
+  store.insert(LspRequestId(3), std::move(r), t0);
+  assert(store.size() == 1);
+  assert(store.contains(LspRequestId(3)));
+  assert(!store.contains(LspRequestId(4)));
+  const bool tookUnknown = store.take(LspRequestId(-1)).has_value();
+  assert(!tookUnknown);
+  const bool droppedUnknown = store.drop(LspRequestId(-1));
+  assert(!droppedUnknown);
+  assert(store.size() == 1);
+
+  std::optional<json_object_ptr> taken = store.take(LspRequestId(3));
+  assert(taken.has_value());
+  assert((json_object*)*taken == raw);
+  assert(responseId(*taken) == 3);
+  assert(store.size() == 0);
+  const bool tookTwice = store.take(LspRequestId(3)).has_value();
+  assert(!tookTwice);
+  assert(store.ndropped() == 0);
+}
+
+void test2() {
+  printf("### testing [random inserts, takes and drops against std::map]\n");
+  srand(42);
+  LspResponseStore store;
+  std::map<int, bool> model;
+  const Clock::time_point t0 = Clock::now();
+  int nextId = 0;
+  int maxCapacity = 0;
+  for (int step = 0; step < 200000; ++step) {
+    // grow to a few thousand responses, then drain, a few times over.
+    const bool growing = (step / 25000) % 2 == 0;
+    const int op = rand() % 4;
+    if (op < (growing ? 3 : 1)) {
+      const int id = nextId++;
+      store.insert(LspRequestId(id), response(id), t0);
+      model[id] = true;
+    } else if (nextId > 0) {
+      const int id = rand() % nextId;
+      const bool expected = model.erase(id);
+      if (op == 3) {
+        const bool dropped = store.drop(LspRequestId(id));
+        assert(dropped == expected);
+      } else {
+        std::optional<json_object_ptr> r = store.take(LspRequestId(id));
+        assert(r.has_value() == expected);
+        if (r) {
+          assert(responseId(*r) == id);
+        }
+      }
+    }
+    assert(store.size() == (int)model.size());
+    assert(store.capacity() >= 2 * store.size());
+    maxCapacity = std::max(maxCapacity, store.capacity());
+  }
+  for (int id = 0; id < nextId; ++id) {
+    assert(store.contains(LspRequestId(id)) == (model.count(id) == 1));
+  }
+  for (const auto& kv : model) {
+    const bool took = store.take(LspRequestId(kv.first)).has_value();
+    assert(took);
+  }
+  assert(maxCapacity > LSP_RESPONSE_STORE_MIN_CAPACITY);
+  assert(store.size() == 0);
+  assert(store.capacity() == LSP_RESPONSE_STORE_MIN_CAPACITY);
+}
+
+void test3() {
+  printf("### testing [unclaimed responses expire, and the table shrinks back]\n");
+  LspResponseStore store;
+  const Clock::time_point t0 = Clock::now();
+  for (int i = 0; i < 1000; ++i) {
+    store.insert(LspRequestId(i), response(i), t0 + std::chrono::milliseconds(i));
+  }
+  assert(store.size() == 1000);
+  assert(store.capacity() >= 2000);
+  const int nexpiredEarly = store.expire(t0 + LSP_RESPONSE_TTL);
+  assert(nexpiredEarly == 0);
+  // everything that arrived in the first 500ms is now too old.
+  const int nexpired = store.expire(t0 + LSP_RESPONSE_TTL + std::chrono::milliseconds(500));
+  assert(nexpired == 500);
+  assert(store.size() == 500);
+  for (int i = 0; i < 1000; ++i) {
+    assert(store.contains(LspRequestId(i)) == (i >= 500));
+  }
+  const int nexpiredLate = store.expire(t0 + 2 * LSP_RESPONSE_TTL);
+  assert(nexpiredLate == 500);
+  assert(store.size() == 0);
+  assert(store.capacity() == LSP_RESPONSE_STORE_MIN_CAPACITY);
+  assert(store.ndropped() == 1000);
+}
+
+int main() {
+  test1();
+  test2();
+  test3();
+  return 0;
+}
@@ -0,0 +1,163 @@
+#include "datastructures/lspscheduler.h"
+#include <assert.h>
+#include <stdio.h>
+#include <vector>
+
+using Clock = LspScheduler::Clock;
+
+// every request that `s` lets through at `now`, in order.
+std::vector<int> drain(LspScheduler& s, Clock::time_point now) {
+  std::vector<int> out;
+  while (std::optional<LspRequestId> id = s.next(now)) {
+    out.push_back(id->id);
+  }
+  return out;
+}
+
+void test1() {
+  printf("### testing [scheduler sends the most urgent class first, oldest first]\n");
+  LspScheduler s;
+  const Clock::time_point t0 = Clock::now();
+  s.enqueue(1, LRC_Background, t0);
+  s.enqueue(2, LRC_Completion, t0);
+  s.enqueue(3, LRC_Goto, t0);
+  s.enqueue(4, LRC_Interactive, t0);
+  s.enqueue(5, LRC_Interactive, t0);
+  const std::vector<int> sent = drain(s, t0);
+  assert(sent == std::vector<int>({ 4, 5, 3, 2, 1 }));
+  assert(lspRequestClassOfKind(LRK_PlainGoal) == LRC_Interactive);
+  assert(lspRequestClassOfKind(LRK_Hover) == LRC_Interactive);
+  assert(lspRequestClassOfKind(LRK_Goto) == LRC_Goto);
+  assert(lspRequestClassOfKind(LRK_Completion) == LRC_Completion);
+}
+
+void test2() {
+  printf("### testing [scheduler caps the requests in flight per class]\n");
+  LspScheduler s;
+  const Clock::time_point t0 = Clock::now();
+  const int cap = LSP_REQUEST_CLASS_POLICIES[LRC_Completion].maxInFlight;
+  for (int i = 0; i < cap + 2; ++i) {
+    s.enqueue(i, LRC_Completion, t0);
+  }
+  s.enqueue(100, LRC_Interactive, t0);
+  std::vector<int> sent = drain(s, t0);
+  assert((int)sent.size() == cap + 1);
+  assert(sent[0] == 100);
+  assert(s.ninFlight(LRC_Completion) == cap);
+  assert(s.nqueued(LRC_Completion) == 2);
+
+  // an answer makes room for one more.
+  s.finish(sent[1], true, t0 + std::chrono::milliseconds(10));
+  const std::vector<int> afterAnswer = drain(s, t0);
+  assert(afterAnswer == std::vector<int>({ cap }));
+  // so does a cancel.
+  s.finish(cap, false, t0);
+  const std::vector<int> afterCancel = drain(s, t0);
+  assert(afterCancel == std::vector<int>({ cap + 1 }));
+  // finishing what is not in flight does nothing.
+  s.finish(12345, true, t0);
+  s.finish(cap, true, t0);
+  assert(s.ninFlight(LRC_Completion) == cap);
+
+  const LspRequestClassStats& stats = s.stats(LRC_Completion);
+  assert(stats.nsent == cap + 2);
+  assert(stats.nanswered == 1);
+  assert(stats.maxLatency == std::chrono::milliseconds(10));
+}
+
+void test3() {
+  printf("### testing [scheduler forgets unqueued requests]\n");
+  LspScheduler s;
+  const Clock::time_point t0 = Clock::now();
+  s.enqueue(1, LRC_Interactive, t0);
+  s.enqueue(2, LRC_Interactive, t0);
+  const bool unqueued = s.unqueue(1);
+  assert(unqueued);
+  const bool unqueuedTwice = s.unqueue(1);
+  assert(!unqueuedTwice);
+  const std::vector<int> sent = drain(s, t0);
+  assert(sent == std::vector<int>({ 2 }));
+  // it is in flight, not queued.
+  const bool unqueuedInFlight = s.unqueue(2);
+  assert(!unqueuedInFlight);
+}
+
+void test4() {
+  printf("### testing [scheduler gives up on requests past their deadline]\n");
+  LspScheduler s;
+  const Clock::time_point t0 = Clock::now();
+  const std::chrono::milliseconds deadline = LSP_REQUEST_CLASS_POLICIES[LRC_Completion].deadline;
+  const int cap = LSP_REQUEST_CLASS_POLICIES[LRC_Completion].maxInFlight;
+  for (int i = 0; i < cap + 1; ++i) {
+    s.enqueue(i, LRC_Completion, t0);
+  }
+  s.enqueue(100, LRC_Completion, t0 + deadline);
+  const std::vector<int> sent = drain(s, t0);
+  assert((int)sent.size() == cap);
+  const std::vector<LspExpiredRequest> early = s.expire(t0 + deadline - std::chrono::milliseconds(1));
+  assert(early.empty());
+
+  // the ones in flight, and the oldest queued one.
+  std::vector<LspExpiredRequest> expired = s.expire(t0 + deadline);
+  assert((int)expired.size() == cap + 1);
+  int ninFlight = 0;
+  for (const LspExpiredRequest& e : expired) {
+    assert(e.id.id <= cap);
+    ninFlight += e.inFlight;
+    assert(e.inFlight == (e.id.id < cap));
+  }
+  assert(ninFlight == cap);
+  assert(s.ninFlight(LRC_Completion) == 0);
+  assert(s.stats(LRC_Completion).nexpired == cap + 1);
+  // an expired request is forgotten: its late answer frees nothing.
+  s.finish(0, true, t0 + deadline);
+  assert(s.stats(LRC_Completion).nanswered == 0);
+  const std::vector<int> late = drain(s, t0 + deadline);
+  assert(late == std::vector<int>({ 100 }));
+}
+
+void bench() {
+  printf("### benchmarking [scheduler under a storm of superseded requests]\n");
+  LspScheduler s;
+  const int N = 200000;
+  const Clock::time_point start = Clock::now();
+  // each keystroke fires goal requests and a completion, which supersedes
+  // the previous completion if it is still queued. The server answers
+  // what is in flight every few keystrokes.
+  int id = 0;
+  int lastCompletion = -1;
+  int nsent = 0;
+  int nsuperseded = 0;
+  std::vector<LspRequestId> inFlight;
+  for (int i = 0; i < N; ++i) {
+    const Clock::time_point now = start + std::chrono::microseconds(i);
+    nsuperseded += s.unqueue(lastCompletion);
+    s.enqueue(id++, LRC_Interactive, now);
+    lastCompletion = id;
+    s.enqueue(id++, LRC_Completion, now);
+    while (std::optional<LspRequestId> sent = s.next(now)) {
+      inFlight.push_back(*sent);
+      nsent++;
+    }
+    if (i % 4 == 0) {
+      for (LspRequestId answered : inFlight) {
+        s.finish(answered, true, now);
+      }
+      inFlight.clear();
+    }
+    s.expire(now);
+  }
+  const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  printf("  %d keystrokes in %.3fs | %.0f ns/keystroke | %d sent | %d completions superseded\n",
+    N, seconds, 1e9 * seconds / N, nsent, nsuperseded);
+  assert(s.nqueued(LRC_Completion) <= 1);
+}
+
+int main() {
+  test1();
+  test2();
+  test3();
+  test4();
+  bench();
+  return 0;
+}
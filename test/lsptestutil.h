@@ -0,0 +1,7 @@
+#pragma once
+#include <string>
+
+// `body` as a language server sends it: a `Content-Length` header, then `body`.
+inline std::string frame(const std::string& body) {
+  return "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+}
@@ -0,0 +1,73 @@
+#include "algorithms/lzcompress.h"
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+void roundtrip(const std::string& raw) {
+  std::string compressed;
+  lzCompress(raw.data(), raw.size(), &compressed);
+  std::string out(raw.size(), '\0');
+  const bool ok = lzDecompress(compressed.data(), compressed.size(), &out[0], out.size());
+  assert(ok);
+  assert(out == raw);
+  // the exact length is required.
+  std::string longer(raw.size() + 1, '\0');
+  assert(!lzDecompress(compressed.data(), compressed.size(), &longer[0], longer.size()));
+}
+
+void test1() {
+  printf("### testing [roundtrip]\n");
+  roundtrip("");
+  roundtrip("a");
+  roundtrip("abc");
+  roundtrip("abcd");
+  roundtrip("aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa");
+  roundtrip(std::string(100000, 'x'));
+  std::string text;
+  for (int i = 0; i < 2000; ++i) {
+    text += "theorem foo" + std::to_string(i % 37) + " : n + 0 = n := by simp\n";
+  }
+  roundtrip(text);
+  unsigned seed = 3;
+  for (int trial = 0; trial < 200; ++trial) {
+    std::string s;
+    const int len = trial * 37 % 5000;
+    for (int i = 0; i < len; ++i) {
+      seed = seed * 1103515245 + 12345;
+      // small alphabets make for many (and overlapping) matches.
+      s.push_back('a' + (seed >> 16) % (1 + trial % 4));
+    }
+    roundtrip(s);
+  }
+}
+
+void test2() {
+  printf("### testing [compresses repetitive text]\n");
+  std::string text;
+  for (int i = 0; i < 1000; ++i) {
+    text += "  intro n\n  simp [Nat.add_comm]\n";
+  }
+  std::string compressed;
+  lzCompress(text.data(), text.size(), &compressed);
+  printf("  %d -> %d bytes\n", (int)text.size(), (int)compressed.size());
+  assert(compressed.size() * 20 < text.size());
+}
+
+void test3() {
+  printf("### testing [rejects malformed input]\n");
+  char out[64];
+  // a back reference before the start of the output.
+  const char badOffset[] = { 0x10, 'a', 0x05, 0x00 };
+  assert(!lzDecompress(badOffset, sizeof(badOffset), out, 10));
+  // literals past the end of the input.
+  const char truncated[] = { 0x50, 'a', 'b' };
+  assert(!lzDecompress(truncated, sizeof(truncated), out, 5));
+}
+
+int main() {
+  test1();
+  test2();
+  test3();
+  return 0;
+}
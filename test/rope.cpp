@@ -0,0 +1,148 @@
+#include "datastructures/abuf.h"
+#include "datastructures/rope.h"
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+// check that `rope` holds exactly the values of `expected`.
+void check(const Rope<int>& rope, const std::vector<int>& expected) {
+  assert(rope.size() == (int)expected.size());
+  for (int i = 0; i < (int)expected.size(); ++i) {
+    assert(rope[i] == expected[i]);
+  }
+  rope.forEach([&](int i, const int& v) { assert(v == expected[i]); });
+}
+
+void test1() {
+  printf("### testing [insert/erase against std::vector]\n");
+  Rope<int> rope;
+  std::vector<int> expected;
+  unsigned seed = 42;
+  for (int i = 0; i < 2000; ++i) {
+    seed = seed * 1103515245 + 12345;
+    const int op = (seed >> 16) % 3;
+    if (op < 2 || expected.size() == 0) {
+      const int at = (seed >> 8) % (expected.size() + 1);
+      rope.insert(at, i);
+      expected.insert(expected.begin() + at, i);
+    } else {
+      const int at = (seed >> 8) % expected.size();
+      rope.erase(at);
+      expected.erase(expected.begin() + at);
+    }
+  }
+  check(rope, expected);
+  printf("  size: %d\n", rope.size());
+}
+
+void test2() {
+  printf("### testing [snapshots are unaffected by edits]\n");
+  std::vector<int> vals;
+  for (int i = 0; i < 100; ++i) { vals.push_back(i); }
+  Rope<int> rope(vals);
+  check(rope, vals);
+
+  Rope<int> snapshot = rope;
+  assert(snapshot.isSameSnapshot(rope));
+  rope.getMut(50) = -1;
+  rope.erase(0);
+  rope.push_back(100);
+  assert(!snapshot.isSameSnapshot(rope));
+  check(snapshot, vals);
+
+  std::vector<int> edited(vals.begin() + 1, vals.end());
+  edited[49] = -1;
+  edited.push_back(100);
+  check(rope, edited);
+  assert(!(rope == snapshot));
+}
+
+// hash of `rows`, computed from scratch.
+uint64_t freshHash(const std::vector<std::string>& rows) {
+  std::vector<abuf> bufs;
+  for (const std::string& row : rows) {
+    bufs.push_back(abuf::from_copy_str(row.c_str()));
+  }
+  return Rope<abuf>(std::move(bufs)).hash();
+}
+
+void test3() {
+  printf("### testing [hash is maintained across edits]\n");
+  Rope<abuf> rope;
+  std::vector<std::string> expected;
+  assert(rope.hash() == freshHash(expected));
+  unsigned seed = 7;
+  for (int i = 0; i < 1000; ++i) {
+    seed = seed * 1103515245 + 12345;
+    const int op = (seed >> 16) % 3;
+    const std::string s = std::to_string((seed >> 8) % 50);
+    if (op == 0 || expected.size() == 0) {
+      const int at = (seed >> 4) % (expected.size() + 1);
+      rope.insert(at, abuf::from_copy_str(s.c_str()));
+      expected.insert(expected.begin() + at, s);
+    } else if (op == 1) {
+      const int at = (seed >> 4) % expected.size();
+      rope.erase(at);
+      expected.erase(expected.begin() + at);
+    } else {
+      const int at = (seed >> 4) % expected.size();
+      rope.getMut(at).appendstr(s.c_str());
+      expected[at] += s;
+    }
+    if (i % 10 == 0) {
+      assert(rope.hash() == freshHash(expected));
+    }
+  }
+  assert(rope.hash() == freshHash(expected));
+
+  // snapshots keep their hash, and equal contents hash equally.
+  Rope<abuf> snapshot = rope;
+  const uint64_t h = snapshot.hash();
+  rope.getMut(0).appendChar('x');
+  assert(rope.hash() != h);
+  assert(snapshot.hash() == h);
+  abuf& row = rope.getMut(0);
+  row.truncateNCodepoints(Size<Codepoint>(row.ncodepoints().size - 1));
+  assert(rope.hash() == h);
+
+  // order matters, and so do empty rows.
+  assert(freshHash({ "a", "b" }) != freshHash({ "b", "a" }));
+  assert(freshHash({ "ab" }) != freshHash({ "a", "b" }));
+  assert(freshHash({}) != freshHash({ "" }));
+  assert(freshHash({ "" }) != freshHash({ "", "" }));
+}
+
+void test4() {
+  printf("### testing [equality of ropes that share some of their nodes]\n");
+  std::vector<int> vals;
+  for (int i = 0; i < 1000; ++i) { vals.push_back(i); }
+  Rope<int> rope(vals);
+  Rope<int> copy = rope;
+  // the same values, in a tree of another shape.
+  const Rope<int> rebuilt(vals);
+  assert(rope == rebuilt && rebuilt == rope);
+
+  copy.getMut(500) = -1;
+  assert(!(rope == copy) && !(copy == rope));
+  copy.getMut(500) = 500;
+  assert(rope == copy && !copy.isSameSnapshot(rope));
+
+  // an insert and an erase that cancel out shift the shared subtrees.
+  copy.insert(10, 7);
+  copy.erase(11);
+  assert(!(rope == copy));
+  copy.getMut(10) = 10;
+  assert(rope == copy && copy == rebuilt);
+  copy.erase(999);
+  assert(!(rope == copy));
+  copy.push_back(999);
+  assert(rope == copy);
+}
+
+int main() {
+  test1();
+  test2();
+  test3();
+  test4();
+  return 0;
+}
@@ -0,0 +1,62 @@
+#include "algorithms/search.h"
+#include <stdio.h>
+#include <string>
+
+int naive_find(const std::string &hay, const std::string &needle) {
+  const size_t ix = hay.find(needle);
+  return ix == std::string::npos ? -1 : (int)ix;
+}
+
+int naive_rfind(const std::string &hay, const std::string &needle) {
+  const size_t ix = hay.rfind(needle);
+  return ix == std::string::npos ? -1 : (int)ix;
+}
+
+// random string over a small alphabet, so that partial matches are common.
+std::string random_string(unsigned &seed, int len, int alphabet) {
+  std::string s;
+  for (int i = 0; i < len; ++i) {
+    seed = seed * 1103515245 + 12345;
+    s += (char)('a' + (seed >> 16) % alphabet);
+  }
+  return s;
+}
+
+void test1() {
+  printf("### testing [search_find / search_rfind against std::string]\n");
+  unsigned seed = 1;
+  for (int iter = 0; iter < 3000; ++iter) {
+    const int alphabet = 2 + iter % 3;
+    const std::string hay = random_string(seed, iter % 200, alphabet);
+    // needles on both sides of the Horspool cutoff.
+    const int m = 1 + (iter * 7) % (SEARCH_HORSPOOL_MIN_NEEDLE_LEN + 8);
+    std::string needle = random_string(seed, m, alphabet);
+    if (iter % 2 == 0 && (int)hay.size() >= m) {
+      // plant the needle so that there is a match.
+      needle = hay.substr((iter * 13) % (hay.size() - m + 1), m);
+    }
+    assert(search_find(hay.c_str(), hay.size(), needle.c_str(), m) == naive_find(hay, needle));
+    assert(search_rfind(hay.c_str(), hay.size(), needle.c_str(), m) == naive_rfind(hay, needle));
+    assert(search_find_short_scalar(hay.c_str(), hay.size(), needle.c_str(), m) == naive_find(hay, needle));
+    assert(search_find_horspool(hay.c_str(), hay.size(), needle.c_str(), m) == naive_find(hay, needle));
+  }
+}
+
+void test2() {
+  printf("### testing [search_find_any]\n");
+  const char *needles[] = {"Content-Length:", "\r\n\r\n", "\n"};
+  const int lens[] = {15, 4, 1};
+  const std::string hay = "junk\rContent-Length: 10\r\n\r\n{}";
+  int which = -1;
+  assert(search_find_any(hay.c_str(), hay.size(), needles, lens, 2, &which) == 5);
+  assert(which == 0);
+  assert(search_find_any(hay.c_str(), hay.size(), needles + 1, lens + 1, 2, &which) == 23);
+  assert(which == 0); // "\r\n\r\n" is listed first, and matches at the same index as "\n".
+  assert(search_find_any(hay.c_str(), 20, needles + 1, lens + 1, 2, &which) == -1);
+}
+
+int main() {
+  test1();
+  test2();
+  return 0;
+}
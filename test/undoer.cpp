@@ -0,0 +1,298 @@
+#include "datastructures/rowseditlog.h"
+#include "datastructures/undoer.h"
+#include <assert.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+// rows that log their edits, like `FileConfigUndoState`.
+struct LinesDelta {
+  std::vector<RowsEdit> edits;
+  bool empty() const { return edits.empty(); }
+  size_t nbytes() const { return RowsEditLog::nbytes(edits); }
+  void serialize(std::string* out) const { RowsEditLog::serialize(edits, out); }
+  static bool deserialize(const char* p, const char* end, LinesDelta* out) {
+    return RowsEditLog::deserialize(&p, end, &out->edits) && p == end;
+  }
+};
+
+struct Lines {
+  using Delta = LinesDelta;
+  Rope<abuf> rows;
+  RowsEditLog log;
+
+  Delta takeDelta() {
+    Delta out;
+    out.edits = log.take(rows);
+    return out;
+  }
+
+  uint64_t stateHash() const {
+    return rows.hash();
+  }
+
+  void applyDelta(const Delta& delta, bool forward) {
+    assert(log.empty());
+    RowsEditLog::replay(rows, delta.edits, forward);
+  }
+};
+
+std::vector<std::string> toStrings(const Rope<abuf>& rows) {
+  std::vector<std::string> out;
+  rows.forEach([&](int, const abuf& row) { out.push_back(row.to_std_string()); });
+  return out;
+}
+
+// the undoer as it was when it kept whole snapshots, as the reference.
+struct SnapshotUndoer {
+  std::vector<std::string> rows;
+  bool inUndoRedo = false;
+  std::vector<std::vector<std::string>> undoStack;
+  std::vector<std::vector<std::string>> redoStack;
+
+  void doUndo() {
+    if (undoStack.empty()) {
+      return;
+    }
+    if (!inUndoRedo) {
+      inUndoRedo = true;
+      redoStack.push_back(rows);
+      rows = undoStack.back();
+    } else {
+      if (undoStack.size() == 1) {
+        return;
+      }
+      redoStack.push_back(undoStack.back());
+      undoStack.pop_back();
+      rows = undoStack.back();
+    }
+  }
+
+  void doRedo() {
+    if (redoStack.empty()) {
+      return;
+    }
+    undoStack.push_back(redoStack.back());
+    redoStack.pop_back();
+    rows = undoStack.back();
+  }
+
+  void mkUndoMemento() {
+    inUndoRedo = false;
+    redoStack.clear();
+    if (!undoStack.empty() && undoStack.back() == rows) {
+      return;
+    }
+    undoStack.push_back(rows);
+  }
+};
+
+void test1() {
+  printf("### testing [RowsEditLog replays edits both ways]\n");
+  Rope<abuf> rows;
+  for (int i = 0; i < 5; ++i) {
+    rows.push_back(abuf::from_copy_str(std::to_string(i).c_str()));
+  }
+  const std::vector<std::string> before = toStrings(rows);
+
+  RowsEditLog log;
+  log.getMut(rows, 1).appendstr("a");
+  log.getMut(rows, 1).appendstr("b"); // coalesced with the edit above.
+  log.insert(rows, 0, abuf::from_copy_str("new"));
+  log.erase(rows, 4);
+  log.getMut(rows, 0).appendstr("!");
+  const std::vector<std::string> after = toStrings(rows);
+  assert((after == std::vector<std::string> { "new!", "0", "1ab", "2", "4" }));
+
+  const std::vector<RowsEdit> edits = log.take(rows);
+  assert(log.empty());
+  assert(edits.size() == 4);
+  RowsEditLog::replay(rows, edits, /*forward=*/false);
+  assert(toStrings(rows) == before);
+  RowsEditLog::replay(rows, edits, /*forward=*/true);
+  assert(toStrings(rows) == after);
+}
+
+void test2() {
+  printf("### testing [Undoer matches the snapshot undoer]\n");
+  srand(42);
+  for (int trial = 0; trial < 200; ++trial) {
+    Undoer<Lines> undoer;
+    SnapshotUndoer ref;
+    for (int i = 0; i < 3; ++i) {
+      undoer.rows.push_back(abuf::from_copy_str("row"));
+      ref.rows.push_back("row");
+    }
+    for (int step = 0; step < 200; ++step) {
+      const int op = rand() % 10;
+      const int n = ref.rows.size();
+      if (op < 5) {
+        // edit.
+        const int kind = rand() % 4;
+        const char c = 'a' + rand() % 26;
+        if (kind == 0 || n == 0) {
+          const int at = rand() % (n + 1);
+          undoer.log.insert(undoer.rows, at, abuf::from_copy_buf(&c, 1));
+          ref.rows.insert(ref.rows.begin() + at, std::string(1, c));
+        } else if (kind == 1) {
+          const int at = rand() % n;
+          undoer.log.erase(undoer.rows, at);
+          ref.rows.erase(ref.rows.begin() + at);
+        } else if (kind == 2) {
+          const int at = rand() % n;
+          undoer.log.getMut(undoer.rows, at).appendChar(c);
+          ref.rows[at] += c;
+        } else {
+          // drop the last character, which can cancel out an append.
+          const int at = rand() % n;
+          if (ref.rows[at].empty()) {
+            continue;
+          }
+          abuf& row = undoer.log.getMut(undoer.rows, at);
+          row.truncateNCodepoints(Size<Codepoint>(row.ncodepoints().size - 1));
+          ref.rows[at].pop_back();
+        }
+      } else if (op < 7) {
+        undoer.mkUndoMemento();
+        ref.mkUndoMemento();
+      } else if (op < 9) {
+        undoer.doUndo();
+        ref.doUndo();
+      } else {
+        undoer.doRedo();
+        ref.doRedo();
+      }
+      assert(toStrings(undoer.rows) == ref.rows);
+    }
+  }
+}
+
+void test3() {
+  printf("### testing [undo history stays within budget]\n");
+  Undoer<Lines> undoer;
+  const size_t BUDGET = 256 << 10;
+  undoer.setUndoBudget(BUDGET);
+  std::vector<std::vector<std::string>> history;
+  for (int i = 0; i < 20; ++i) {
+    undoer.rows.push_back(abuf::from_copy_str(std::string(100, 'a' + i).c_str()));
+  }
+  undoer.mkUndoMemento();
+  history.push_back(toStrings(undoer.rows));
+  // each step costs the bytes that it appends, not the row that it edits.
+  std::string appended;
+  for (int i = 0; i < 50; ++i) {
+    appended += "edit " + std::to_string(i) + " ";
+  }
+  for (int step = 0; step < 2000; ++step) {
+    undoer.log.getMut(undoer.rows, step % 20).appendstr(appended.c_str());
+    undoer.mkUndoMemento();
+    history.push_back(toStrings(undoer.rows));
+    const UndoMemoryStats stats = undoer.undoMemoryStats();
+    assert(stats.undoBytes + stats.redoBytes <= BUDGET);
+  }
+  const UndoMemoryStats stats = undoer.undoMemoryStats();
+  printf("  %d steps kept (%d compressed), %d evicted, %d bytes\n",
+    stats.nundo, stats.ncompressed, stats.nevicted, (int)stats.undoBytes);
+  assert(stats.nevicted > 0);
+  assert(stats.ncompressed > 0);
+  assert(stats.nundo + stats.nevicted == 2000);
+
+  // every step that was kept can be undone, including the compressed ones.
+  // The first undo enters undo/redo mode, and does not move.
+  undoer.doUndo();
+  assert(toStrings(undoer.rows) == history.back());
+  for (int k = 1; k <= stats.nundo; ++k) {
+    undoer.doUndo();
+    assert(toStrings(undoer.rows) == history[history.size() - 1 - k]);
+  }
+  // the oldest kept state is as far as we go.
+  undoer.doUndo();
+  assert(toStrings(undoer.rows) == history[history.size() - 1 - stats.nundo]);
+  for (int k = stats.nundo - 1; k >= 0; --k) {
+    undoer.doRedo();
+    assert(toStrings(undoer.rows) == history[history.size() - 1 - k]);
+  }
+}
+
+void test4() {
+  printf("### testing [RowsEditLog rejects corrupt serialized edits]\n");
+  std::vector<RowsEdit> edits(1);
+  edits[0].at = 3;
+  edits[0].deleted.push_back(abuf::from_copy_str("old"));
+  edits[0].inserted.push_back(abuf::from_copy_str("new"));
+  std::string bytes;
+  RowsEditLog::serialize(edits, &bytes);
+  const char* end = bytes.data() + bytes.size();
+  const char* p = bytes.data();
+  std::vector<RowsEdit> out;
+  const bool ok = RowsEditLog::deserialize(&p, end, &out);
+  assert(ok && p == end);
+  assert(out.size() == 1 && out[0].at == 3);
+  assert(out[0].inserted[0].to_std_string() == "new");
+
+  // a count of edits, or of rows, that cannot fit in what is left fails
+  // before anything is allocated for it.
+  for (const int offset : { 0, 3 * (int)sizeof(int) }) {
+    std::string corrupt = bytes;
+    const int huge = INT_MAX;
+    memcpy(&corrupt[offset], &huge, sizeof(int));
+    p = corrupt.data();
+    out.clear();
+    assert(!RowsEditLog::deserialize(&p, corrupt.data() + corrupt.size(), &out));
+  }
+  for (size_t n = 0; n < bytes.size(); ++n) {
+    p = bytes.data();
+    out.clear();
+    assert(!RowsEditLog::deserialize(&p, bytes.data() + n, &out));
+  }
+}
+
+void test5() {
+  printf("### testing [RowsEditLog keeps only the bytes that an in-place edit changed]\n");
+  Rope<abuf> rows;
+  const std::string longRow(100000, 'x');
+  rows.push_back(abuf::from_copy_str(longRow.c_str()));
+  rows.push_back(abuf::from_copy_str("aλb"));
+  RowsEditLog log;
+  log.getMut(rows, 0).insertByte(Size<Codepoint>(50000), 'y');
+  log.getMut(rows, 0).insertByte(Size<Codepoint>(50001), 'z');
+  // `λ` to `μ` differ in their last byte only.
+  log.getMut(rows, 1).setBytes("aμb", 4);
+  // edits that put the row back are not an edit.
+  log.getMut(rows, 0);
+  log.getMut(rows, 1).appendChar('!');
+  log.getMut(rows, 1).truncateNCodepoints(Size<Codepoint>(3));
+  const std::vector<std::string> after = toStrings(rows);
+
+  std::vector<RowsEdit> edits = log.take(rows);
+  assert(edits.size() == 2);
+  assert(edits[0].at == 0 && edits[0].byteIx == 50000);
+  assert(edits[0].deletedBytes == "" && edits[0].insertedBytes == "yz");
+  assert(edits[1].at == 1 && edits[1].byteIx == 2);
+  assert(edits[1].deletedBytes == "\xbb" && edits[1].insertedBytes == "\xbc");
+  assert(RowsEditLog::nbytes(edits) < 1000);
+
+  std::string bytes;
+  RowsEditLog::serialize(edits, &bytes);
+  assert(bytes.size() < 100);
+  const char* p = bytes.data();
+  std::vector<RowsEdit> decoded;
+  const bool ok = RowsEditLog::deserialize(&p, bytes.data() + bytes.size(), &decoded);
+  assert(ok);
+  RowsEditLog::replay(rows, decoded, /*forward=*/false);
+  assert(toStrings(rows) == std::vector<std::string>({ longRow, "aλb" }));
+  RowsEditLog::replay(rows, decoded, /*forward=*/true);
+  assert(toStrings(rows) == after);
+}
+
+int main() {
+  test1();
+  test2();
+  test3();
+  test4();
+  test5();
+  return 0;
+}
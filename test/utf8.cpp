@@ -1,4 +1,7 @@
-#include <lib.h>
+#include "datastructures/utf8.h"
+#include <stdio.h>
+#include <string.h>
+#include <string>
 
 const char *strs[] = {"$", "£",  "ह",  "𐍈"};
 
@@ -54,10 +57,112 @@ void test3() {
   }
 }
 
+// random mix of 1, 2, 3 and 4 byte code points, with runs of ASCII so the
+// vector kernels see both all-ASCII and mixed chunks.
+std::string random_utf8(unsigned &seed, int ncodepoints) {
+  const char *cps[] = {"a", "b", " ", "$", "£", "ह", "𐍈", "∀", "ℕ", "→"};
+  std::string s;
+  for (int i = 0; i < ncodepoints; ++i) {
+    seed = seed * 1103515245 + 12345;
+    const int r = (seed >> 16) % 16;
+    s += cps[r < 10 ? r : r % 4];
+  }
+  return s;
+}
+
+void test4() {
+  printf("### testing [utf8 count/index kernels agree with scalar]\n");
+  unsigned seed = 3;
+  for (int iter = 0; iter < 200; ++iter) {
+    const std::string s = random_utf8(seed, iter);
+    const int len = s.size();
+    const int n = utf8_count_code_points_scalar(s.c_str(), len);
+    assert(n == iter);
+    assert(utf8_count_code_points(s.c_str(), len) == n);
+#ifdef UTF8_HAVE_X86_SIMD
+    assert(utf8_count_code_points_sse2(s.c_str(), len) == n);
+    if (__builtin_cpu_supports("avx2")) {
+      assert(utf8_count_code_points_avx2(s.c_str(), len) == n);
+    }
+#endif
+    for (int i = 0; i <= n; ++i) {
+      const int b = utf8_byte_ix_of_code_point_scalar(s.c_str(), len, i);
+      assert(b == len || !utf8_is_continuation_byte(s[b]));
+      assert(utf8_count_code_points_scalar(s.c_str(), b) == i);
+      assert(utf8_byte_ix_of_code_point(s.c_str(), len, i) == b);
+#ifdef UTF8_HAVE_X86_SIMD
+      assert(utf8_byte_ix_of_code_point_sse2(s.c_str(), len, i) == b);
+      if (__builtin_cpu_supports("avx2")) {
+        assert(utf8_byte_ix_of_code_point_avx2(s.c_str(), len, i) == b);
+      }
+#endif
+      if (b > 0) {
+        const int prev = utf8_prev_code_point_begin(s.c_str(), b);
+        assert(prev + utf8_prev_code_point_len(s.c_str(), b - 1) == b);
+        assert(prev + utf8_next_code_point_len(s.c_str() + prev) == b);
+      }
+    }
+  }
+}
+
+// check all validators against `expected`.
+void check_validate(const std::string &s, bool expected) {
+  assert(utf8_validate_scalar(s.c_str(), s.size()) == expected);
+  assert(utf8_validate(s.c_str(), s.size()) == expected);
+#ifdef UTF8_HAVE_X86_SIMD
+  assert(utf8_validate_sse2(s.c_str(), s.size()) == expected);
+  if (__builtin_cpu_supports("avx2")) {
+    assert(utf8_validate_avx2(s.c_str(), s.size()) == expected);
+  }
+#endif
+}
+
+void test5() {
+  printf("### testing [utf8_validate]\n");
+  const char *invalid[] = {
+    "\x80",             // lone continuation byte.
+    "\xC0\xAF",         // overlong '/'.
+    "\xE0\x80\xAF",     // overlong '/'.
+    "\xED\xA0\x80",     // surrogate U+D800.
+    "\xF4\x90\x80\x80", // U+110000.
+    "\xF5\x80\x80\x80", // lead byte past U+10FFFF.
+    "\xE2\x88",         // truncated.
+    "\xE2\x28\xA1",     // bad continuation byte.
+  };
+  unsigned seed = 11;
+  for (int iter = 0; iter < 100; ++iter) {
+    // place the defect at every alignment relative to the vector width.
+    const std::string prefix = random_utf8(seed, iter % 40);
+    const std::string suffix = random_utf8(seed, iter % 7);
+    check_validate(prefix + suffix, true);
+    for (const char *bad : invalid) {
+      check_validate(prefix + bad + suffix, false);
+    }
+  }
+  check_validate(std::string(100, 'x'), true);
+  check_validate("\xF4\x8F\xBF\xBF", true); // U+10FFFF.
+}
+
+void test6() {
+  printf("### testing [utf8_count_utf16_code_units]\n");
+  // '$', '£', 'ह' take one UTF-16 code unit, '𐍈' takes a surrogate pair.
+  for (int i = 0; i < 4; ++i) {
+    const int n = utf8_count_utf16_code_units(strs[i], strlen(strs[i]));
+    printf("  utf16 length of '%s' = %d\n", strs[i], n);
+    assert(n == (i < 3 ? 1 : 2));
+  }
+  const std::string s = std::string(40, 'x') + "\xF0\x9D\x94\xB8" + "ℕ" + std::string(20, 'y');
+  assert(utf8_count_utf16_code_units(s.data(), s.size()) == 40 + 2 + 1 + 20);
+  assert(utf8_count_utf16_code_units("", 0) == 0);
+}
+
 int main() {
   test1();
   test2();
   test3();
+  test4();
+  test5();
+  test6();
   return 0;
 }
 